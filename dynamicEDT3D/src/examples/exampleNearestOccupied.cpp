@@ -0,0 +1,151 @@
+/**
+* dynamicEDT3D:
+* A library for incrementally updatable Euclidean distance transforms in 3D.
+* @author C. Sprunk, B. Lau, W. Burgard, University of Freiburg, Copyright (C) 2011.
+* @see http://octomap.sourceforge.net/
+* License: New BSD License
+*/
+
+/*
+ * Copyright (c) 2011-2012, C. Sprunk, B. Lau, W. Burgard, University of Freiburg
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the University of Freiburg nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <dynamicEDT3D/dynamicEDTOctomap.h>
+#include <octomap/octomap_timing.h>
+
+#include <iostream>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+// Compares the distance to the closest obstacle from DynamicEDTOctomap with the
+// nearest occupied query of the octree (OcTree::getDistanceToNearestOccupied())
+// on random maps of increasing size.
+
+double timediff(const timeval& start, const timeval& stop){
+  return (stop.tv_sec - start.tv_sec) + 1.0e-6 *(stop.tv_usec - start.tv_usec);
+}
+
+double randomValue(double min, double max){
+  return min + (max - min) * double(rand()) / RAND_MAX;
+}
+
+/// map of size^3 meters with random box obstacles, one per 8 m^3 on average
+void generateMap(octomap::OcTree& tree, double size){
+  unsigned int num_obstacles = (unsigned int) (size * size * size / 8.0);
+  double resolution = tree.getResolution();
+  for (unsigned int i = 0; i < num_obstacles; ++i){
+    octomap::point3d min((float) randomValue(0.0, size), (float) randomValue(0.0, size), (float) randomValue(0.0, size));
+    octomap::point3d extent((float) randomValue(0.2, 0.8), (float) randomValue(0.2, 0.8), (float) randomValue(0.2, 0.8));
+    for (double x = min.x(); x < std::min(double(min.x() + extent.x()), size); x += resolution)
+      for (double y = min.y(); y < std::min(double(min.y() + extent.y()), size); y += resolution)
+        for (double z = min.z(); z < std::min(double(min.z() + extent.z()), size); z += resolution)
+          tree.updateNode(octomap::point3d((float) x, (float) y, (float) z), true, true);
+  }
+  tree.updateInnerOccupancy();
+}
+
+int main( int argc, char *argv[] ) {
+  double max_size = 16.0;
+  unsigned int num_queries = 10000;
+  if (argc > 3){
+    std::cout << "usage: " << argv[0] << " [max_map_size] [num_queries]  (optional, default: 16 10000)" << std::endl;
+    exit(0);
+  }
+  if (argc > 1)
+    max_size = atof(argv[1]);
+  if (argc > 2)
+    num_queries = atoi(argv[2]);
+
+  const float maxDist = 2.0;
+  srand(42);
+
+  std::cout << "map size | occupied voxels | EDT: update [s], query [us] | nearest occupied: query [us] | max. difference [m], mismatches" << std::endl;
+  for (double size = 4.0; size <= max_size; size *= 2.0){
+    octomap::OcTree tree(0.1);
+    generateMap(tree, size);
+    size_t num_occupied = 0;
+    for (octomap::OcTree::leaf_iterator it = tree.begin_leafs(), end = tree.end_leafs(); it != end; ++it)
+      if (tree.isNodeOccupied(*it))
+        ++num_occupied;
+
+    std::vector<octomap::point3d> queries(num_queries);
+    for (unsigned int q = 0; q < num_queries; ++q)
+      queries[q] = octomap::point3d((float) randomValue(0.0, size), (float) randomValue(0.0, size), (float) randomValue(0.0, size));
+
+    timeval start;
+    timeval stop;
+    gettimeofday(&start, NULL);
+    DynamicEDTOctomap distmap(maxDist, &tree, octomap::point3d(0, 0, 0),
+                              octomap::point3d((float) size, (float) size, (float) size), false);
+    distmap.update();
+    gettimeofday(&stop, NULL);
+    double time_update = timediff(start, stop);
+
+    std::vector<float> distances_edt(num_queries);
+    octomap::point3d closest;
+    gettimeofday(&start, NULL);
+    for (unsigned int q = 0; q < num_queries; ++q)
+      distmap.getDistanceAndClosestObstacle(queries[q], distances_edt[q], closest);
+    gettimeofday(&stop, NULL);
+    double time_edt = timediff(start, stop) / num_queries;
+
+    std::vector<double> distances_tree(num_queries);
+    gettimeofday(&start, NULL);
+    for (unsigned int q = 0; q < num_queries; ++q)
+      distances_tree[q] = tree.getDistanceToNearestOccupied(queries[q], closest, maxDist);
+    gettimeofday(&stop, NULL);
+    double time_tree = timediff(start, stop) / num_queries;
+
+    // the distance map measures between voxel centers, the tree from the query point
+    // to the voxel volume: both differ by up to one voxel diagonal
+    const double tolerance = sqrt(3.0) * tree.getResolution() + 1e-4;
+    double max_difference = 0.0;
+    unsigned int num_mismatches = 0;
+    for (unsigned int q = 0; q < num_queries; ++q){
+      if (distances_edt[q] == DynamicEDTOctomap::distanceValue_Error)
+        continue;
+      bool found_edt = distances_edt[q] < maxDist;
+      bool found_tree = distances_tree[q] >= 0.0;
+      if (found_edt && found_tree){
+        double difference = fabs(distances_edt[q] - distances_tree[q]);
+        max_difference = std::max(max_difference, difference);
+        if (difference > tolerance)
+          ++num_mismatches;
+      } else if (found_edt ? distances_edt[q] < maxDist - tolerance : (found_tree && distances_tree[q] < maxDist - tolerance)){
+        ++num_mismatches;
+      }
+    }
+
+    printf("%6.0f m | %15u | %10.3f %10.3f | %28.3f | %10.3f %u\n", size, (unsigned int) num_occupied,
+           time_update, 1e6 * time_edt, 1e6 * time_tree, max_difference, num_mismatches);
+  }
+
+  return 0;
+}
@@ -39,6 +39,10 @@
 #include <string>
 #include <iostream>
 #include <map>
+#include <vector>
+#include <stdint.h>
+
+#include "Compression.h"
 
 namespace octomap {
 
@@ -107,6 +111,10 @@ namespace octomap {
     bool write(const std::string& filename) const;
     /// Write file header and complete tree to stream (serialization)
     bool write(std::ostream& s) const;
+    /// Write file header and complete tree to file in a compressed container (see Compression)
+    bool writeCompressed(const std::string& filename, Compression::Codec codec = Compression::defaultCodec()) const;
+    /// Write file header and complete tree to stream in a compressed container (see Compression)
+    bool writeCompressed(std::ostream& s, Compression::Codec codec = Compression::defaultCodec()) const;
 
     /**
      * Creates a certain OcTree (factory pattern)
@@ -131,6 +139,7 @@ namespace octomap {
 
     /// Read the file header, create the appropriate class and deserialize.
     /// This creates a new octree which you need to delete yourself.
+    /// Compressed files (see writeCompressed()) are detected and decompressed.
     static AbstractOcTree* read(std::istream &s);
 
     /**
@@ -150,6 +159,10 @@ namespace octomap {
 
   protected:
     static bool readHeader(std::istream &s, std::string& id, unsigned& size, double& res);
+    /// Reads the header like readHeader(s, id, size, res), additionally the subtree sizes of binary files
+    /// (see AbstractOccupancyOcTree::getBinarySubtreeSizes(), empty if not present)
+    static bool readHeader(std::istream &s, std::string& id, unsigned& size, double& res,
+                           unsigned& subtree_depth, std::vector<uint64_t>& subtree_sizes);
     static void registerTreeType(AbstractOcTree* tree);
 
     static const std::string fileHeader;
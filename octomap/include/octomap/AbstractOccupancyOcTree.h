@@ -88,11 +88,98 @@ namespace octomap {
      */
     bool writeBinaryConst(std::ostream &s) const;
 
+    /**
+     * Writes OcTree to a binary file like writeBinary(), in a compressed container
+     * (see Compression). readBinary() detects and decompresses it.
+     * @return success of operation
+     */
+    bool writeBinaryCompressed(const std::string& filename, Compression::Codec codec = Compression::defaultCodec());
+
+    /// Writes OcTree to a binary stream like writeBinary(), in a compressed container
+    bool writeBinaryCompressed(std::ostream &s, Compression::Codec codec = Compression::defaultCodec());
+
+    /// Writes the part of the OcTree in the bounding box to a binary file, see writeBinary(std::ostream&, ...)
+    bool writeBinary(const std::string& filename, const point3d& bbx_min, const point3d& bbx_max) const;
+
+    /**
+     * Writes the part of the maximum likelihood OcTree in the bounding box [bbx_min, bbx_max]
+     * to a binary stream, e.g. to extract map tiles without copying the tree. Nodes crossing
+     * the bounding box are split, everything outside is unknown, and equal leafs are pruned.
+     * The result can be read with readBinary() or merged into a tree with readSubtree().
+     * @return success of operation
+     */
+    bool writeBinary(std::ostream &s, const point3d& bbx_min, const point3d& bbx_max) const;
+
+    /// Writes the subtree of a node to a binary file, see writeSubtree(std::ostream&, ...)
+    bool writeSubtree(const std::string& filename, const OcTreeKey& key, unsigned int depth) const;
+
+    /**
+     * Writes the maximum likelihood subtree of the node at depth containing key to a
+     * binary stream. Key and depth of the node are stored in the header (see
+     * binarySubtreeFileHeader), readSubtree() grafts it into a tree at that node.
+     * @return success of operation
+     */
+    bool writeSubtree(std::ostream &s, const OcTreeKey& key, unsigned int depth) const;
+
+    /// Grafts a subtree from a binary file into the tree, see readSubtree(std::istream&)
+    bool readSubtree(const std::string& filename);
+
+    /**
+     * Reads a subtree (see writeSubtree()) or a complete binary tree (e.g. a tile from
+     * writeBinary() with a bounding box) and grafts it into the existing tree at the
+     * node stored in the header: all known nodes of the subtree replace the tree's
+     * nodes in their volume, where the subtree is unknown the tree is kept. Resolutions
+     * need to match. The tree is not pruned afterwards.
+     * @return success of operation
+     */
+    bool readSubtree(std::istream &s);
+
+    /// Like readSubtree(std::istream&), grafting at the node (at the depth stored in the header) containing key
+    bool readSubtree(std::istream &s, const OcTreeKey& key);
+
+    /**
+     * Enables writing the byte sizes of the subtrees at depth 2 to the header of binary
+     * files ("subtrees" line), so that readBinary() can decode them in parallel.
+     * Readers without support skip the line with a warning. Writing the index takes
+     * an additional pass over the tree.
+     *
+     * @param enable write the index (default: off)
+     */
+    void useSubtreeIndex(bool enable) { subtree_index = enable; }
+
+    /// @return true if binary files are written with subtree sizes, see useSubtreeIndex()
+    bool isSubtreeIndexUsed() const { return subtree_index; }
+
     /// Writes the actual data, implemented in OccupancyOcTreeBase::writeBinaryData()
     virtual std::ostream& writeBinaryData(std::ostream &s) const = 0;
+
+    /**
+     * Computes the sizes (in bytes) of the binary data of all subtrees below inner nodes
+     * at subtree_depth, in the order in which they are written. They are stored in the
+     * header of binary files for reading the subtrees in parallel, see
+     * OccupancyOcTreeBase::getBinarySubtreeSizes(). The default implementation returns none.
+     */
+    virtual void getBinarySubtreeSizes(unsigned int subtree_depth, std::vector<uint64_t>& subtree_sizes) const;
+
+    /**
+     * Encodes the part of the tree in the bounding box like writeBinaryData() (used by
+     * writeBinary() with bounding box), implemented in OccupancyOcTreeBase::getBinaryDataBBX().
+     * num_nodes is set to the number of encoded nodes, 0 if the bounding box is unknown.
+     * @return success (false in the default implementation)
+     */
+    virtual bool getBinaryDataBBX(const point3d& bbx_min, const point3d& bbx_max,
+                                  std::vector<char>& data, size_t& num_nodes) const;
+
+    /**
+     * Encodes the subtree of the node at depth containing key like writeBinaryData() (used by
+     * writeSubtree()), implemented in OccupancyOcTreeBase::getBinarySubtreeData().
+     * @return success (false in the default implementation)
+     */
+    virtual bool getBinarySubtreeData(const OcTreeKey& key, unsigned int depth,
+                                      std::vector<char>& data, size_t& num_nodes) const;
     
     /**
-     * Reads an OcTree from an input stream.
+     * Reads an OcTree from an input stream (also compressed, see writeBinaryCompressed()).
      * Existing nodes of the tree are deleted before the tree is read.
      * @return success of operation
      */
@@ -108,6 +195,23 @@ namespace octomap {
     /// Reads the actual data, implemented in OccupancyOcTreeBase::readBinaryData()
     virtual std::istream& readBinaryData(std::istream &s) = 0;
 
+    /**
+     * Reads the actual data with the subtree sizes from the file header (see
+     * getBinarySubtreeSizes()), implemented in OccupancyOcTreeBase::readBinaryData().
+     * The default implementation ignores the subtree sizes.
+     */
+    virtual std::istream& readBinaryData(std::istream &s, unsigned int subtree_depth,
+                                         const std::vector<uint64_t>& subtree_sizes);
+
+    /**
+     * Grafts the binary data of a subtree into the tree at the node at depth containing key
+     * (used by readSubtree()), implemented in OccupancyOcTreeBase::readBinarySubtreeData().
+     * num_nodes is set to the number of nodes read.
+     * @return success (false in the default implementation)
+     */
+    virtual bool readBinarySubtreeData(std::istream &s, const OcTreeKey& key, unsigned int depth,
+                                       size_t& num_nodes);
+
     // -- occupancy queries
 
     /// queries whether a node is occupied according to the tree's parameter for "occupancy"
@@ -187,13 +291,13 @@ namespace octomap {
     /// sets the threshold for occupancy (sensor model)
     void setOccupancyThres(double prob){occ_prob_thres_log = logodds(prob); }
     /// sets the probability for a "hit" (will be converted to logodds) - sensor model
-    void setProbHit(double prob){prob_hit_log = logodds(prob); assert(prob_hit_log >= 0.0);}
+    virtual void setProbHit(double prob){prob_hit_log = logodds(prob); assert(prob_hit_log >= 0.0);}
     /// sets the probability for a "miss" (will be converted to logodds) - sensor model
-    void setProbMiss(double prob){prob_miss_log = logodds(prob); assert(prob_miss_log <= 0.0);}
+    virtual void setProbMiss(double prob){prob_miss_log = logodds(prob); assert(prob_miss_log <= 0.0);}
     /// sets the minimum threshold for occupancy clamping (sensor model)
-    void setClampingThresMin(double thresProb){clamping_thres_min = logodds(thresProb); }
+    virtual void setClampingThresMin(double thresProb){clamping_thres_min = logodds(thresProb); }
     /// sets the maximum threshold for occupancy clamping (sensor model)
-    void setClampingThresMax(double thresProb){clamping_thres_max = logodds(thresProb); }
+    virtual void setClampingThresMax(double thresProb){clamping_thres_max = logodds(thresProb); }
 
     /// @return threshold (probability) for occupancy - sensor model
     double getOccupancyThres() const {return probability(occ_prob_thres_log); }
@@ -224,6 +328,28 @@ namespace octomap {
   protected:
     /// Try to read the old binary format for conversion, will be removed in the future
     bool readBinaryLegacyHeader(std::istream &s, unsigned int& size, double& res);
+
+    /// Writes the common header lines of binary files (without "data"), starting with first_line
+    void writeBinaryHeader(std::ostream &s, const std::string& first_line, size_t num_nodes) const;
+
+    /// readSubtree(), grafting at the node containing key if given, the stored node otherwise
+    bool readSubtree(std::istream &s, const OcTreeKey* key);
+
+    /// States of the 4 children encoded in one byte of binary data (2 bits each), as bit masks
+    struct BinaryChildCodes {
+      uint8_t free;
+      uint8_t occupied;
+      uint8_t inner;
+    };
+
+    /// @return decoding table for all 256 bytes of binary data, see OccupancyOcTreeBase::writeBinaryNode()
+    static const BinaryChildCodes* binaryChildCodes();
+    static std::vector<BinaryChildCodes> computeBinaryChildCodes();
+
+    /// depth of the subtrees whose sizes are stored in binary files (i.e. up to 64 subtrees)
+    static const unsigned int binarySubtreeDepth = 2;
+    /// write the subtree sizes to binary files, see useSubtreeIndex()
+    bool subtree_index;
     
     // occupancy parameters of tree, stored in logodds:
     float clamping_thres_min;
@@ -233,6 +359,8 @@ namespace octomap {
     float occ_prob_thres_log;
 
     static const std::string binaryFileHeader;
+    /// first line of subtree files (see writeSubtree()), which store key and depth of the subtree in the header
+    static const std::string binarySubtreeFileHeader;
   };
 
 }; // end namespace
@@ -0,0 +1,142 @@
+/*
+ * OctoMap - An Efficient Probabilistic 3D Mapping Framework Based on Octrees
+ * http://octomap.github.com/
+ *
+ * Copyright (c) 2009-2013, K.M. Wurm and A. Hornung, University of Freiburg
+ * All rights reserved.
+ * License: New BSD
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the University of Freiburg nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef OCTOMAP_BLOCK_OCTREE_H
+#define OCTOMAP_BLOCK_OCTREE_H
+
+
+#include <octomap/OcTreeNode.h>
+#include <octomap/OccupancyOcTreeBase.h>
+
+namespace octomap {
+
+  /**
+   * Occupancy node with contiguous children: all 8 children of a node are
+   * stored in one block (instead of an array of 8 pointers to separately
+   * allocated nodes), existing children are marked in a bitmask. This saves
+   * one indirection and the pointer array per inner node, and keeps siblings
+   * in the same cache lines. The bitmask fits into the padding of OcTreeNode,
+   * so the node itself does not grow.
+   *
+   * Children are only accessible through the tree (OcTreeBaseImpl::getNodeChild() etc.),
+   * the deprecated child functions of OcTreeDataNode can't be used.
+   */
+  class BlockOcTreeNode : public OcTreeNode {
+  public:
+    template<typename NODE, typename I> friend class OcTreeBaseImpl;
+
+    typedef ChildBlockLayout ChildLayout;
+
+    BlockOcTreeNode() : OcTreeNode(), child_mask(0) {}
+
+    /// Copies only the node data, the tree maintains the children
+    BlockOcTreeNode(const BlockOcTreeNode& rhs) : OcTreeNode(), child_mask(0) { value = rhs.value; }
+
+    /// Copies only the node data, the tree maintains the children (and child_mask)
+    void copyData(const BlockOcTreeNode& from){
+      OcTreeNode::copyData(from);
+    }
+
+    /**
+     * @return mean of all children's occupancy probabilities, in log odds
+     */
+    double getMeanChildLogOdds() const;
+
+    /**
+     * @return maximum of children's occupancy probabilities, in log odds
+     */
+    float getMaxChildLogOdds() const;
+
+    /// update this node's occupancy according to its children's maximum occupancy
+    inline void updateOccupancyChildren() {
+      this->setLogOdds(this->getMaxChildLogOdds());  // conservative
+    }
+
+  protected:
+    inline const BlockOcTreeNode* childBlock() const {
+      return static_cast<const BlockOcTreeNode*>(static_cast<const void*>(children));
+    }
+
+    /// bit i is set if child i exists in the children block
+    uint8_t child_mask;
+  };
+
+
+  /**
+   * Occupancy octree with the same functionality as OcTree, but using
+   * BlockOcTreeNode with contiguous children blocks as memory layout.
+   */
+  class BlockOcTree : public OccupancyOcTreeBase <BlockOcTreeNode> {
+
+  public:
+    /// Default constructor, sets resolution of leafs
+    BlockOcTree(double resolution);
+
+    /// virtual constructor: creates a new object of same type
+    /// (Covariant return type requires an up-to-date compiler)
+    BlockOcTree* create() const {return new BlockOcTree(resolution); }
+
+    std::string getTreeType() const {return "BlockOcTree";}
+
+  protected:
+    /**
+     * Static member object which ensures that this OcTree's prototype
+     * ends up in the classIDMapping only once. You need this as a 
+     * static member in any derived octree class in order to read .ot
+     * files through the AbstractOcTree factory. You should also call
+     * ensureLinking() once from the constructor.
+     */
+    class StaticMemberInitializer{
+    public:
+      StaticMemberInitializer() {
+        BlockOcTree* tree = new BlockOcTree(0.1);
+        tree->clearKeyRays();
+        AbstractOcTree::registerTreeType(tree);
+      }
+
+      /**
+       * Dummy function to ensure that MSVC does not drop the
+       * StaticMemberInitializer, causing this tree failing to register.
+       * Needs to be called from the constructor of this octree.
+       */
+      void ensureLinking() {};
+    };
+
+    /// to ensure static initialization (only once)
+    static StaticMemberInitializer blockOcTreeMemberInit;
+  };
+
+} // end namespace
+
+#endif
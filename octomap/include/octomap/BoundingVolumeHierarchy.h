@@ -0,0 +1,110 @@
+/*
+ * OctoMap - An Efficient Probabilistic 3D Mapping Framework Based on Octrees
+ * http://octomap.github.com/
+ *
+ * Copyright (c) 2009-2013, K.M. Wurm and A. Hornung, University of Freiburg
+ * All rights reserved.
+ * License: New BSD
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the University of Freiburg nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef OCTOMAP_BOUNDING_VOLUME_HIERARCHY_H
+#define OCTOMAP_BOUNDING_VOLUME_HIERARCHY_H
+
+#include <vector>
+
+#include "octomap_types.h"
+
+namespace octomap {
+
+  /**
+   * Bounding volume hierarchy over a static set of axis-aligned boxes, e.g. the
+   * world-frame extents of the submaps in a MapCollection. Queries return the
+   * indices of all boxes containing a point, overlapping a box or intersected
+   * by a ray, in ascending order.
+   *
+   * The hierarchy is a binary tree stored in a flat array, built top-down by
+   * splitting the boxes at the median of their centers along the largest axis.
+   * Changing the boxes requires rebuilding it with build().
+   */
+  class BoundingVolumeHierarchy {
+  public:
+    BoundingVolumeHierarchy();
+
+    /**
+     * Builds the hierarchy for the boxes [box_min[i], box_max[i]], which are
+     * reported by the queries as index i. Empty boxes (min > max on any axis)
+     * are never reported.
+     */
+    void build(const std::vector<point3d>& box_min, const std::vector<point3d>& box_max);
+
+    void clear();
+
+    /// @return number of boxes the hierarchy was built for (incl. empty ones)
+    size_t size() const { return boxes_min.size(); }
+
+    /// Clears boxes and fills it with the indices of all boxes containing p
+    void queryPoint(const point3d& p, std::vector<unsigned int>& boxes) const;
+
+    /// Clears boxes and fills it with the indices of all boxes overlapping [min, max]
+    void queryBox(const point3d& min, const point3d& max, std::vector<unsigned int>& boxes) const;
+
+    /**
+     * Clears boxes and fills it with the indices of all boxes intersected by the ray
+     * from origin in direction (need not be normalized) within max_range.
+     * max_range <= 0: unlimited
+     */
+    void queryRay(const point3d& origin, const point3d& direction, double max_range,
+                  std::vector<unsigned int>& boxes) const;
+
+  protected:
+    /// inner node: children at the next index and at second_child,
+    /// leaf (num_boxes > 0): boxes items[first_box .. first_box + num_boxes - 1]
+    struct Node {
+      point3d min;
+      point3d max;
+      unsigned int first_box;
+      unsigned int num_boxes;
+      unsigned int second_child;
+    };
+
+    /// builds the subtree for items[begin, end), returns the index of its root
+    unsigned int buildRecursive(unsigned int begin, unsigned int end, const std::vector<point3d>& centers);
+
+    template <class OVERLAP>
+    void query(const OVERLAP& overlap, std::vector<unsigned int>& boxes) const;
+
+    static const unsigned int MAX_LEAF_BOXES = 4;
+
+    std::vector<Node> nodes;
+    std::vector<unsigned int> items; ///< box indices, grouped by leaf
+    std::vector<point3d> boxes_min;
+    std::vector<point3d> boxes_max;
+  };
+
+} // namespace
+
+#endif
@@ -0,0 +1,208 @@
+/*
+ * OctoMap - An Efficient Probabilistic 3D Mapping Framework Based on Octrees
+ * http://octomap.github.com/
+ *
+ * Copyright (c) 2009-2013, K.M. Wurm and A. Hornung, University of Freiburg
+ * All rights reserved.
+ * License: New BSD
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the University of Freiburg nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef OCTOMAP_BUFFERED_IO_H
+#define OCTOMAP_BUFFERED_IO_H
+
+
+#include <iostream>
+#include <vector>
+#include <string.h>
+#include <stdint.h>
+
+namespace octomap {
+
+  /**
+   * Buffered writing of the node data of a tree to an output stream: small
+   * writes (a few bytes per node) are collected in one large buffer, which
+   * is passed to the stream only when full, on flush() or on destruction.
+   * The bytes written to the stream are the same as with single s.write() calls.
+   */
+  class BufferedWriter {
+  public:
+    BufferedWriter(std::ostream& s, size_t buffer_size = DEFAULT_BUFFER_SIZE);
+    /// flushes the buffer
+    ~BufferedWriter();
+
+    inline void write(const void* data, size_t size){
+      if (size > size_t(buffer_end - pos))
+        writeSlow(data, size);
+      else {
+        memcpy(pos, data, size);
+        pos += size;
+      }
+    }
+
+    template <typename T>
+    inline void write(const T& value) { write(&value, sizeof(T)); }
+
+    inline void put(char c){
+      if (pos == buffer_end)
+        flush();
+      *pos++ = c;
+    }
+
+    /// writes value as variable length integer (7 bits per byte, lowest first)
+    inline void writeVarint(uint64_t value){
+      while (value >= 0x80){
+        put(char(value | 0x80));
+        value >>= 7;
+      }
+      put(char(value));
+    }
+
+    /// passes the buffered data to the stream, @return s.good()
+    bool flush();
+
+    std::ostream& stream() { return s; }
+
+    static const size_t DEFAULT_BUFFER_SIZE = 1 << 20;
+
+  protected:
+    void writeSlow(const void* data, size_t size);
+
+    std::ostream& s;
+    std::vector<char> buffer;
+    char* pos;
+    char* buffer_end;
+  };
+
+  /**
+   * Buffered reading of the node data of a tree from an input stream: the
+   * stream is read in large blocks, small reads are served from the buffer.
+   * Data read ahead is returned to the stream on finish() or destruction by
+   * seeking back, so that the stream is left directly after the last byte
+   * consumed, as with single s.read() calls. Streams which cannot seek are
+   * read without buffer.
+   */
+  class BufferedReader {
+  public:
+    BufferedReader(std::istream& s, size_t buffer_size = DEFAULT_BUFFER_SIZE);
+    /// calls finish()
+    ~BufferedReader();
+
+    /// @return false if the stream ended before size bytes could be read
+    inline bool read(void* data, size_t size){
+      if (size > size_t(buffer_end - pos))
+        return readSlow(data, size);
+      memcpy(data, pos, size);
+      pos += size;
+      return true;
+    }
+
+    template <typename T>
+    inline bool read(T& value) { return read(&value, sizeof(T)); }
+
+    /// reads a variable length integer written by BufferedWriter::writeVarint()
+    inline bool readVarint(uint64_t& value){
+      value = 0;
+      for (unsigned int shift = 0; shift < 64; shift += 7){
+        unsigned char c;
+        if (!read(c))
+          return false;
+        value |= uint64_t(c & 0x7f) << shift;
+        if (!(c & 0x80))
+          return true;
+      }
+      failed = true; // more than 64 bits
+      return false;
+    }
+
+    /// @return false if a read failed (end of stream)
+    bool good() const { return !failed; }
+
+    /**
+     * Returns the data read ahead to the stream. Sets the failbit of the
+     * stream if a read failed. Further reads go to the stream directly.
+     */
+    void finish();
+
+    std::istream& stream() { return s; }
+
+    static const size_t DEFAULT_BUFFER_SIZE = 1 << 20;
+
+  protected:
+    bool readSlow(void* data, size_t size);
+    /// refills the (empty) buffer from the stream
+    void fill();
+
+    std::istream& s;
+    std::vector<char> buffer;
+    const char* pos;
+    const char* buffer_end;
+    bool failed;
+    bool finished;
+  };
+
+  /**
+   * Detects at compile time whether a node type implements readData(BufferedReader&)
+   * and writeData(BufferedWriter&) const, or only the std::istream / std::ostream
+   * overloads. The probes convert to the streams only by a user-defined conversion,
+   * so overload resolution prefers the buffered overloads when they are visible.
+   */
+  template <class NODE>
+  class BufferedNodeIO {
+    typedef char Yes;
+    typedef char (&No)[2];
+
+    struct ReaderProbe : public BufferedReader {
+      operator std::istream&();
+    };
+    struct WriterProbe : public BufferedWriter {
+      operator std::ostream&();
+    };
+
+    static Yes check(BufferedReader&);
+    static Yes check(BufferedWriter&);
+    static No check(std::istream&);
+    static No check(std::ostream&);
+
+    // only used in unevaluated sizeof expressions, never defined
+    static NODE& node();
+    static const NODE& constNode();
+    static ReaderProbe& reader();
+    static WriterProbe& writer();
+
+  public:
+    static const bool read = sizeof(check(node().readData(reader()))) == sizeof(Yes);
+    static const bool write = sizeof(check(constNode().writeData(writer()))) == sizeof(Yes);
+  };
+
+  /// tag for dispatching on BufferedNodeIO<NODE>::read / write
+  template <bool BUFFERED>
+  struct BufferedNodeIOTag {};
+
+} // namespace
+
+#endif
@@ -98,6 +98,8 @@ namespace octomap {
     // file I/O
     std::istream& readData(std::istream &s);
     std::ostream& writeData(std::ostream &s) const;
+    BufferedReader& readData(BufferedReader &s);
+    BufferedWriter& writeData(BufferedWriter &s) const;
     
   protected:
     Color color;
@@ -0,0 +1,109 @@
+/*
+ * OctoMap - An Efficient Probabilistic 3D Mapping Framework Based on Octrees
+ * http://octomap.github.com/
+ *
+ * Copyright (c) 2009-2013, K.M. Wurm and A. Hornung, University of Freiburg
+ * All rights reserved.
+ * License: New BSD
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the University of Freiburg nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef OCTOMAP_COMPRESSION_H
+#define OCTOMAP_COMPRESSION_H
+
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace octomap {
+
+  /**
+   * Compressed container for OcTree files (.ot and .bt). The uncompressed
+   * file (including its header) is split into blocks of fixed size, which
+   * are compressed independently, so they can be (de-)compressed in parallel
+   * with OpenMP. The container starts with its own header line, see
+   * fileHeader; AbstractOcTree::read() and AbstractOccupancyOcTree::readBinary()
+   * detect it and decompress transparently.
+   *
+   * Codecs: LZ is a byte-oriented LZ77 codec in the style of LZ4 and always
+   * available, ZLIB compresses better but requires OctoMap to be built with zlib.
+   */
+  class Compression {
+  public:
+    enum Codec {LZ = 1, ZLIB = 2};
+
+    /// @return whether codec can be used in this build
+    static bool isAvailable(Codec codec);
+    /// @return ZLIB if available, LZ otherwise
+    static Codec defaultCodec();
+
+    /**
+     * Writes data (a complete uncompressed file) as compressed container to s
+     * @return success
+     */
+    static bool write(std::ostream& s, const std::string& data, Codec codec = defaultCodec(),
+                      size_t block_size = DEFAULT_BLOCK_SIZE);
+
+    /**
+     * Reads a compressed container from s, which is positioned directly after
+     * the first line (fileHeader), and decompresses it into data
+     * @return success
+     */
+    static bool read(std::istream& s, std::string& data);
+
+    /// LZ compression of one block, appended to dst
+    static void compressLZ(const char* src, size_t size, std::vector<char>& dst);
+    /// LZ decompression of one block into dst, which needs to have exactly the uncompressed size
+    static bool decompressLZ(const char* src, size_t size, char* dst, size_t dst_size);
+
+    /// First line of compressed files
+    static const std::string fileHeader;
+    static const size_t DEFAULT_BLOCK_SIZE = 1 << 20;
+
+  protected:
+    static bool compressBlock(Codec codec, const char* src, size_t size, std::vector<char>& dst);
+    static bool decompressBlock(Codec codec, const char* src, size_t size, char* dst, size_t dst_size);
+  };
+
+  /// Read-only stream buffer on existing memory (e.g. decompressed data), which is not copied
+  class MemoryStreamBuf : public std::streambuf {
+  public:
+    MemoryStreamBuf(const char* data, size_t size) {
+      char* begin = const_cast<char*>(data);
+      setg(begin, begin, begin + size);
+    }
+
+  protected:
+    pos_type seekoff(off_type off, std::ios_base::seekdir dir,
+                     std::ios_base::openmode which = std::ios_base::in | std::ios_base::out);
+    pos_type seekpos(pos_type pos, std::ios_base::openmode which = std::ios_base::in | std::ios_base::out);
+  };
+
+} // end namespace
+
+#endif
@@ -56,6 +56,10 @@ namespace octomap {
 
     CountingOcTreeNode();
     ~CountingOcTreeNode();
+
+    void copyData(const CountingOcTreeNode& from){
+      OcTreeDataNode<unsigned int>::copyData(from);
+    }
     
     inline unsigned int getCount() const { return getValue(); }
     inline void increaseCount() { value++; }
@@ -0,0 +1,315 @@
+/*
+ * OctoMap - An Efficient Probabilistic 3D Mapping Framework Based on Octrees
+ * http://octomap.github.com/
+ *
+ * Copyright (c) 2009-2013, K.M. Wurm and A. Hornung, University of Freiburg
+ * All rights reserved.
+ * License: New BSD
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the University of Freiburg nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef OCTOMAP_LINEAR_OCTREE_H
+#define OCTOMAP_LINEAR_OCTREE_H
+
+
+#include <algorithm>
+#include <vector>
+
+#include <octomap/octomap_types.h>
+#include <octomap/octomap_utils.h>
+#include <octomap/OcTreeKey.h>
+#include <octomap/MortonKey.h>
+
+namespace octomap {
+
+  /// Leaf of a LinearOcTree: occupancy and depth, the key is implied by the position in the tree
+  struct LinearOcTreeNode {
+    float value;          ///< occupancy in log odds
+    uint8_t depth;
+
+    inline float getLogOdds() const { return value; }
+    inline float getValue() const { return value; }
+    inline double getOccupancy() const { return probability(value); }
+    inline unsigned int getDepth() const { return depth; }
+  };
+
+  /**
+   * Read-only occupancy octree without pointers for frozen maps (e.g. for
+   * localization). Only the leafs are stored, sorted by the Morton code
+   * (see MortonKey) of their smallest key, with the node data in a separate
+   * array. A leaf at depth d covers the codes [code, code + 8^(16-d)),
+   * so a query is the last leaf starting at or before the query code.
+   *
+   * Searches first look up the range of leafs in a small index over the top
+   * levels of the tree and then use binary search within it. For queries of
+   * neighbouring voxels (e.g. along a ray), search() with a hint and castRay()
+   * use galloping search from the previous result instead.
+   *
+   * \code
+   * OcTree tree(0.05);
+   * ...
+   * LinearOcTree linear(tree);
+   * const LinearOcTreeNode* node = linear.search(point3d(1.0, 2.0, 0.5));
+   * if (node && linear.isNodeOccupied(node)) ...
+   * \endcode
+   *
+   * In contrast to OcTree, there are no inner nodes: search() always returns
+   * the leaf containing the key.
+   */
+  class LinearOcTree {
+  public:
+    LinearOcTree();
+
+    /// Creates the leaf array of any occupancy octree (e.g. OcTree, ColorOcTree)
+    template <class TREE>
+    explicit LinearOcTree(const TREE& tree);
+
+    /// Replaces the leafs by the ones of tree
+    template <class TREE>
+    void build(const TREE& tree);
+
+    void clear();
+
+    double getResolution() const { return resolution; }
+    unsigned int getTreeDepth() const { return tree_depth; }
+    double getNodeSize(unsigned depth) const { return resolution * double(1 << (tree_depth - depth)); }
+    float getOccupancyThresLog() const { return occupancy_thres_log; }
+    /// @return number of leafs in the tree
+    size_t size() const { return nodes.size(); }
+    /// @return memory usage of the leafs and the index in bytes
+    size_t memoryUsage() const;
+
+    /// @return leaf i (in Morton order)
+    const LinearOcTreeNode& getLeaf(size_t i) const { return nodes[i]; }
+    /// @return key of leaf i, the center key at its depth as in OcTreeBaseImpl::leaf_iterator::getKey()
+    OcTreeKey getLeafKey(size_t i) const;
+
+    /**
+     * Search the leaf containing key. Same result as OcTreeBaseImpl::search()
+     * for the tree the LinearOcTree was built from (at full depth).
+     * @return pointer to the leaf if found, NULL otherwise (unknown space)
+     */
+    inline const LinearOcTreeNode* search(const OcTreeKey& key) const {
+      size_t i = findLeaf(MortonKey::encode(key));
+      return i == NOT_FOUND ? NULL : &nodes[i];
+    }
+    const LinearOcTreeNode* search(const point3d& value) const;
+    const LinearOcTreeNode* search(double x, double y, double z) const;
+
+    /**
+     * Same as search(), with galloping search starting at the leaf index hint
+     * (from the previous call, initialized with 0). Faster than the indexed
+     * binary search if consecutive queries are neighbouring voxels, e.g. along
+     * a ray, slower for queries scattered over a region.
+     */
+    inline const LinearOcTreeNode* search(const OcTreeKey& key, size_t& hint) const {
+      size_t i = findLeaf(MortonKey::encode(key), hint);
+      return i == NOT_FOUND ? NULL : &nodes[i];
+    }
+
+    inline bool isNodeOccupied(const LinearOcTreeNode* node) const {
+      return node->value >= occupancy_thres_log;
+    }
+    inline bool isNodeOccupied(const LinearOcTreeNode& node) const {
+      return node.value >= occupancy_thres_log;
+    }
+
+    /**
+     * Same as OccupancyOcTreeBase::castRay(), with identical results for the same tree.
+     * Leafs larger than a voxel are crossed in one step.
+     */
+    bool castRay(const point3d& origin, const point3d& direction, point3d& end,
+                 bool ignoreUnknownCells = false, double maxRange = -1.0) const;
+
+    // -- key conversion, see OcTreeBaseImpl
+
+    inline key_type coordToKey(double coordinate) const {
+      return ((int) floor(resolution_factor * coordinate)) + tree_max_val;
+    }
+    inline OcTreeKey coordToKey(const point3d& coord) const {
+      return OcTreeKey(coordToKey(coord(0)), coordToKey(coord(1)), coordToKey(coord(2)));
+    }
+    bool coordToKeyChecked(double coordinate, key_type& key) const;
+    bool coordToKeyChecked(const point3d& coord, OcTreeKey& key) const;
+
+    inline double keyToCoord(key_type key) const {
+      return (double((int) key - (int) tree_max_val) + 0.5) * resolution;
+    }
+    double keyToCoord(key_type key, unsigned depth) const;
+    inline point3d keyToCoord(const OcTreeKey& key) const {
+      return point3d(float(keyToCoord(key[0])), float(keyToCoord(key[1])), float(keyToCoord(key[2])));
+    }
+    inline point3d keyToCoord(const OcTreeKey& key, unsigned depth) const {
+      return point3d(float(keyToCoord(key[0], depth)), float(keyToCoord(key[1], depth)), float(keyToCoord(key[2], depth)));
+    }
+
+    /**
+     * Iterator over the leafs of a LinearOcTree intersecting a bounding box,
+     * in Morton order (the same order as OcTreeBaseImpl::leaf_bbx_iterator, which
+     * additionally returns leafs ending directly before the minimum).
+     * Subdivides the implicit tree like a traversal of OcTree, but splits the
+     * leaf range of a node into its children with binary searches. The
+     * traversal stack has a fixed size and is not allocated.
+     */
+    class leaf_bbx_iterator {
+    public:
+      leaf_bbx_iterator() : tree(NULL), stack_size(0), current(NOT_FOUND) {}
+      leaf_bbx_iterator(const LinearOcTree* tree, const OcTreeKey& min, const OcTreeKey& max);
+
+      bool operator==(const leaf_bbx_iterator& other) const {
+        return current == other.current && (current == NOT_FOUND || tree == other.tree);
+      }
+      bool operator!=(const leaf_bbx_iterator& other) const { return !(*this == other); }
+
+      leaf_bbx_iterator& operator++() { next(); return *this; }
+      leaf_bbx_iterator operator++(int) { leaf_bbx_iterator result = *this; next(); return result; }
+
+      const LinearOcTreeNode* operator->() const { return &tree->nodes[current]; }
+      const LinearOcTreeNode& operator*() const { return tree->nodes[current]; }
+
+      /// @return the center coordinate of the current leaf
+      point3d getCoordinate() const { return tree->keyToCoord(getKey(), getDepth()); }
+      double getX() const { return tree->keyToCoord(getKey()[0], getDepth()); }
+      double getY() const { return tree->keyToCoord(getKey()[1], getDepth()); }
+      double getZ() const { return tree->keyToCoord(getKey()[2], getDepth()); }
+      /// @return the side of the volume occupied by the current leaf
+      double getSize() const { return tree->getNodeSize(getDepth()); }
+      unsigned getDepth() const { return tree->nodes[current].depth; }
+      /// @return the OcTreeKey of the current leaf
+      OcTreeKey getKey() const { return tree->getLeafKey(current); }
+      /// @return index of the current leaf in the tree
+      size_t getIndex() const { return current; }
+
+    protected:
+      /// node of the implicit tree with the range of leafs starting in it
+      struct StackElement {
+        uint64_t code;
+        size_t begin;
+        size_t end;
+        uint8_t level;   ///< tree_depth - depth
+      };
+
+      /// advances to the next leaf intersecting the bounding box
+      void next();
+      bool intersects(uint64_t code, unsigned int level) const;
+
+      const LinearOcTree* tree;
+      OcTreeKey min;
+      OcTreeKey max;
+      unsigned int stack_size;
+      StackElement stack[7 * 16 + 1]; ///< at most 7 siblings waiting per level
+      size_t current;
+    };
+
+    /// @return beginning of the leafs in the bounding box [min, max] of keys
+    leaf_bbx_iterator begin_leafs_bbx(const OcTreeKey& min, const OcTreeKey& max) const {
+      return leaf_bbx_iterator(this, min, max);
+    }
+    /// @return beginning of the leafs in the bounding box [min, max] of coordinates
+    leaf_bbx_iterator begin_leafs_bbx(const point3d& min, const point3d& max) const;
+    /// @return end of the bounding box iteration
+    const leaf_bbx_iterator end_leafs_bbx() const { return leaf_bbx_iterator(); }
+
+    static const size_t NOT_FOUND = ~size_t(0);
+
+  protected:
+    /// @return number of codes covered by a leaf at depth
+    inline uint64_t leafSpan(unsigned int depth) const {
+      return uint64_t(1) << (3 * (tree_depth - depth));
+    }
+
+    /// @return index of the leaf containing code, NOT_FOUND if there is none
+    inline size_t findLeaf(uint64_t code) const {
+      if (codes.empty())
+        return NOT_FOUND;
+      const size_t bucket = (size_t) (code >> index_shift);
+      size_t i = std::upper_bound(codes.begin() + index[bucket], codes.begin() + index[bucket + 1], code)
+        - codes.begin();
+      return coveringLeaf(i, code);
+    }
+
+    /// findLeaf() with galloping search from hint, hint is set to the last leaf starting at or before code
+    size_t findLeaf(uint64_t code, size_t& hint) const;
+
+    /// @return the leaf before index i if it contains code, NOT_FOUND otherwise
+    inline size_t coveringLeaf(size_t i, uint64_t code) const {
+      if (i == 0 || code - codes[i - 1] >= leafSpan(nodes[i - 1].depth))
+        return NOT_FOUND;
+      return i - 1;
+    }
+
+    /// sorts the leafs (if needed) and creates the index
+    void finishBuild();
+
+    enum RayState {FREE, OCCUPIED, UNKNOWN};
+    /// state and key range [node_min, node_max] of the leaf or unknown cell containing key
+    RayState searchRayNode(const OcTreeKey& key, OcTreeKey& node_min, OcTreeKey& node_max, size_t& hint) const;
+
+    std::vector<uint64_t> codes;          ///< Morton code of the smallest key of each leaf, ascending
+    std::vector<LinearOcTreeNode> nodes;
+    std::vector<uint32_t> index;          ///< first leaf with code >= bucket << index_shift, per bucket
+    unsigned int index_shift;
+
+    double resolution;
+    double resolution_factor;   ///< = 1. / resolution
+    unsigned int tree_depth;
+    unsigned int tree_max_val;
+    float occupancy_thres_log;
+  };
+
+
+  template <class TREE>
+  LinearOcTree::LinearOcTree(const TREE& tree)
+    : index_shift(48), resolution(0.0), resolution_factor(0.0), tree_depth(16), tree_max_val(32768),
+      occupancy_thres_log(0.0f)
+  {
+    build(tree);
+  }
+
+  template <class TREE>
+  void LinearOcTree::build(const TREE& tree){
+    clear();
+    resolution = tree.getResolution();
+    resolution_factor = 1.0 / resolution;
+    tree_depth = tree.getTreeDepth();
+    tree_max_val = 1 << (tree_depth - 1);
+    occupancy_thres_log = tree.getOccupancyThresLog();
+
+    codes.reserve(tree.getNumLeafNodes());
+    nodes.reserve(tree.getNumLeafNodes());
+    for (typename TREE::leaf_iterator it = tree.begin_leafs(), end = tree.end_leafs(); it != end; ++it){
+      LinearOcTreeNode node;
+      node.value = it->getLogOdds();
+      node.depth = (uint8_t) it.getDepth();
+      codes.push_back(MortonKey::encode(it.getKey()) & ~(leafSpan(node.depth) - 1));
+      nodes.push_back(node);
+    }
+    finishBuild();
+  }
+
+} // end namespace
+
+#endif
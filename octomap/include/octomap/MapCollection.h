@@ -37,10 +37,21 @@
 
 #include <vector>
 #include <octomap/MapNode.h>
+#include <octomap/BoundingVolumeHierarchy.h>
 
 namespace octomap {
 
   
+  /**
+   * Collection of submaps (MAPNODE: MapNode<TREETYPE>) with their poses in the world frame.
+   *
+   * Queries only search the submaps whose world-frame bounding box overlaps the query point or
+   * ray, using a bounding volume hierarchy which is built by updateIndex(). All methods which
+   * give non-const access to nodes (addNode(), begin(), end(), queryNode()) invalidate the
+   * index, since maps or poses may change. Queries without a valid index search all submaps,
+   * so call updateIndex() again after changing the collection. Queries do not modify the
+   * collection and can run in parallel.
+   */
   template <class MAPNODE>
   class MapCollection {
   public:
@@ -58,9 +69,17 @@ namespace octomap {
 
     double getOccupancy(const point3d& p);
 
+    /// Casts the ray in all submaps intersecting it (in parallel with OpenMP),
+    /// end is the closest hit. See OccupancyOcTreeBase::castRay().
     bool castRay(const point3d& origin, const point3d& direction, point3d& end,
                  bool ignoreUnknownCells=false, double maxRange=-1.0) const;
 
+    /// Rebuilds the index of the world-frame bounding boxes of the submaps, used by queries
+    /// until it is invalidated (see class description)
+    void updateIndex();
+    /// @return true if queries use the index
+    bool isIndexValid() const { return index_valid; }
+
     bool writePointcloud(std::string filename);
     bool write(std::string filename);
 
@@ -72,8 +91,8 @@ namespace octomap {
 
     typedef typename std::vector<MAPNODE*>::iterator iterator;
     typedef typename std::vector<MAPNODE*>::const_iterator const_iterator;
-    iterator begin() { return nodes.begin(); }
-    iterator end()   { return nodes.end(); }
+    iterator begin() { index_valid = false; return nodes.begin(); }
+    iterator end()   { index_valid = false; return nodes.end(); }
     const_iterator begin() const { return nodes.begin(); }
     const_iterator end() const { return nodes.end(); }
     size_t size() const { return nodes.size(); }
@@ -90,10 +109,20 @@ namespace octomap {
     static void splitPathAndFilename(std::string &filenamefullpath, std::string* path, std::string *filename);
     static std::string combinePathAndFilename(std::string path, std::string filename);
     static bool readTagValue(std::string tag, std::ifstream &infile, std::string* value);
+
+    /// submaps which can contain p: from the index if it is valid, else all
+    void queryPointCandidates(const point3d& p, std::vector<unsigned int>& candidates) const;
+    /// submaps which the ray can intersect: from the index if it is valid, else all
+    void queryRayCandidates(const point3d& origin, const point3d& direction, double maxRange,
+                            std::vector<unsigned int>& candidates) const;
     
   protected:
 
     std::vector<MAPNODE*> nodes;
+
+    /// world-frame bounding boxes of the nodes, see updateIndex()
+    BoundingVolumeHierarchy index;
+    bool index_valid;
   };
 
 } // end namespace
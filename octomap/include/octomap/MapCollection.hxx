@@ -38,11 +38,11 @@
 namespace octomap {
   
   template <class MAPNODE>
-  MapCollection<MAPNODE>::MapCollection() {
+  MapCollection<MAPNODE>::MapCollection() : index_valid(false) {
   }
 
   template <class MAPNODE>
-  MapCollection<MAPNODE>::MapCollection(std::string filename) {
+  MapCollection<MAPNODE>::MapCollection(std::string filename) : index_valid(false) {
     this->read(filename);
   }
 
@@ -58,6 +58,8 @@ namespace octomap {
     // for(typename std::vector<MAPNODE*>::iterator it= nodes.begin(); it != nodes.end(); ++it)
     //   delete *it;
     nodes.clear();
+    index.clear();
+    index_valid = false;
   }
 
   template <class MAPNODE>
@@ -115,6 +117,7 @@ namespace octomap {
         return false;
       } else {
         nodes.push_back(node);
+        index_valid = false;
       }
     }
     infile.close();
@@ -124,6 +127,7 @@ namespace octomap {
   template <class MAPNODE>
   void MapCollection<MAPNODE>::addNode( MAPNODE* node){
     nodes.push_back(node);
+    index_valid = false;
   }
 
   template <class MAPNODE>
@@ -138,24 +142,92 @@ namespace octomap {
     return false;
   }
 
+  template <class MAPNODE>
+  void MapCollection<MAPNODE>::updateIndex() {
+    std::vector<point3d> boxes_min(nodes.size());
+    std::vector<point3d> boxes_max(nodes.size());
+    for (size_t i = 0; i < nodes.size(); ++i){
+      typename MAPNODE::TreeType* map = nodes[i]->getMap();
+      if (map == NULL || map->size() == 0){
+        // empty box, never returned by queries
+        boxes_min[i] = point3d(1, 1, 1);
+        boxes_max[i] = point3d(-1, -1, -1);
+        continue;
+      }
+      double min_x, min_y, min_z, max_x, max_y, max_z;
+      map->getMetricMin(min_x, min_y, min_z);
+      map->getMetricMax(max_x, max_y, max_z);
+      // two voxels of padding cover rounding in the transformations and voxels entered
+      // by rays up to maxRange (the range is checked for voxel centers)
+      double padding = 2.0 * map->getResolution();
+      min_x -= padding; min_y -= padding; min_z -= padding;
+      max_x += padding; max_y += padding; max_z += padding;
+
+      // world-frame box around the transformed corners
+      pose6d origin = nodes[i]->getOrigin();
+      for (unsigned int c = 0; c < 8; ++c){
+        point3d corner((float) ((c & 1) ? max_x : min_x), (float) ((c & 2) ? max_y : min_y),
+                       (float) ((c & 4) ? max_z : min_z));
+        corner = origin.transform(corner);
+        for (unsigned int j = 0; j < 3; ++j){
+          if (c == 0 || corner(j) < boxes_min[i](j)) boxes_min[i](j) = corner(j);
+          if (c == 0 || corner(j) > boxes_max[i](j)) boxes_max[i](j) = corner(j);
+        }
+      }
+    }
+    index.build(boxes_min, boxes_max);
+    index_valid = true;
+  }
+
+  template <class MAPNODE>
+  void MapCollection<MAPNODE>::queryPointCandidates(const point3d& p, std::vector<unsigned int>& candidates) const {
+    if (index_valid){
+      index.queryPoint(p, candidates);
+      return;
+    }
+    candidates.resize(nodes.size());
+    for (size_t i = 0; i < nodes.size(); ++i)
+      candidates[i] = (unsigned int) i;
+  }
+
+  template <class MAPNODE>
+  void MapCollection<MAPNODE>::queryRayCandidates(const point3d& origin, const point3d& direction, double maxRange,
+                                                  std::vector<unsigned int>& candidates) const {
+    if (index_valid){
+      index.queryRay(origin, direction, maxRange, candidates);
+      return;
+    }
+    candidates.resize(nodes.size());
+    for (size_t i = 0; i < nodes.size(); ++i)
+      candidates[i] = (unsigned int) i;
+  }
+
   template <class MAPNODE>
   MAPNODE* MapCollection<MAPNODE>::queryNode(const point3d& p) {
-    for (const_iterator it = this->begin(); it != this->end(); ++it) {
-      point3d ptrans = (*it)->getOrigin().inv().transform(p);
-      typename MAPNODE::TreeType::NodeType* n = (*it)->getMap()->search(ptrans);
+    std::vector<unsigned int> candidates;
+    queryPointCandidates(p, candidates);
+    // the returned node may be changed
+    index_valid = false;
+    for (size_t i = 0; i < candidates.size(); ++i) {
+      MAPNODE* node = nodes[candidates[i]];
+      point3d ptrans = node->getOrigin().inv().transform(p);
+      typename MAPNODE::TreeType::NodeType* n = node->getMap()->search(ptrans);
       if (!n) continue;
-      if ((*it)->getMap()->isNodeOccupied(n)) return (*it);
+      if (node->getMap()->isNodeOccupied(n)) return node;
     }
     return 0;
   }
 
   template <class MAPNODE>
   bool MapCollection<MAPNODE>::isOccupied(const point3d& p) const {
-    for (const_iterator it = this->begin(); it != this->end(); ++it) {
-      point3d ptrans = (*it)->getOrigin().inv().transform(p);
-      typename MAPNODE::TreeType::NodeType* n = (*it)->getMap()->search(ptrans);
+    std::vector<unsigned int> candidates;
+    queryPointCandidates(p, candidates);
+    for (size_t i = 0; i < candidates.size(); ++i) {
+      MAPNODE* node = nodes[candidates[i]];
+      point3d ptrans = node->getOrigin().inv().transform(p);
+      typename MAPNODE::TreeType::NodeType* n = node->getMap()->search(ptrans);
       if (!n) continue;
-      if ((*it)->getMap()->isNodeOccupied(n)) return true;
+      if (node->getMap()->isNodeOccupied(n)) return true;
     }
     return false;
   }
@@ -171,9 +243,12 @@ namespace octomap {
   double MapCollection<MAPNODE>::getOccupancy(const point3d& p) {
     double max_occ_val = 0;
     bool is_unknown = true;
-    for (const_iterator it = this->begin(); it != this->end(); ++it) {
-      point3d ptrans = (*it)->getOrigin().inv().transform(p);
-      typename MAPNODE::TreeType::NodeType* n = (*it)->getMap()->search(ptrans);
+    std::vector<unsigned int> candidates;
+    queryPointCandidates(p, candidates);
+    for (size_t i = 0; i < candidates.size(); ++i) {
+      MAPNODE* node = nodes[candidates[i]];
+      point3d ptrans = node->getOrigin().inv().transform(p);
+      typename MAPNODE::TreeType::NodeType* n = node->getMap()->search(ptrans);
       if (n) {
         double occ = n->getOccupancy();
         if (occ > max_occ_val) max_occ_val = occ;
@@ -188,28 +263,43 @@ namespace octomap {
   template <class MAPNODE>
   bool MapCollection<MAPNODE>::castRay(const point3d& origin, const point3d& direction, point3d& end,
                                        bool ignoreUnknownCells, double maxRange) const {
+    // rays cannot hit submaps they do not intersect
+    std::vector<unsigned int> candidates;
+    queryRayCandidates(origin, direction, maxRange, candidates);
+    const int num_candidates = (int) candidates.size();
+    std::vector<char> hits(num_candidates, 0);
+    std::vector<double> distances(num_candidates);
+    std::vector<point3d> endpoints(num_candidates);
+
+    // the parallel region only pays off for a few submaps
+#ifdef _OPENMP
+    #pragma omp parallel for schedule(dynamic) if (num_candidates >= 4)
+#endif
+    for (int i = 0; i < num_candidates; ++i) {
+      MAPNODE* node = nodes[candidates[i]];
+      pose6d inverse_origin = node->getOrigin().inv();
+      point3d origin_trans = inverse_origin.transform(origin);
+      point3d direction_trans = inverse_origin.rot().rotate(direction);
+      point3d temp_endpoint;
+      if (node->getMap()->castRay(origin_trans, direction_trans, temp_endpoint, ignoreUnknownCells, maxRange)) {
+        hits[i] = 1;
+        distances[i] = origin_trans.distance(temp_endpoint);
+        endpoints[i] = node->getOrigin().transform(temp_endpoint);
+      }
+    }
+
+    // closest hit, on equal distances the first submap
     bool hit_obstacle = false;
     double min_dist = 1e6;
-    // SPEEDUP: use openMP to do raycasting in parallel
-    // SPEEDUP: use bounding boxes to determine submaps 
-    for (const_iterator it = this->begin(); it != this->end(); ++it) {
-      point3d origin_trans = (*it)->getOrigin().inv().transform(origin);
-      point3d direction_trans = (*it)->getOrigin().inv().rot().rotate(direction);
-      printf("ray from %.2f,%.2f,%.2f in dir %.2f,%.2f,%.2f in node %s\n",
-             origin_trans.x(), origin_trans.y(), origin_trans.z(),
-             direction_trans.x(), direction_trans.y(), direction_trans.z(),
-             (*it)->getId().c_str());
-      point3d temp_endpoint;
-      if ((*it)->getMap()->castRay(origin_trans, direction_trans, temp_endpoint, ignoreUnknownCells, maxRange)) {
-        printf("hit obstacle in node %s\n", (*it)->getId().c_str());
-        double current_dist =  origin_trans.distance(temp_endpoint);
-        if (current_dist < min_dist) {
-          min_dist = current_dist;
-          end = (*it)->getOrigin().transform(temp_endpoint);
-        }
-        hit_obstacle = true;
-      } // end if hit obst
-    } // end for
+    for (int i = 0; i < num_candidates; ++i) {
+      if (!hits[i])
+        continue;
+      if (distances[i] < min_dist) {
+        min_dist = distances[i];
+        end = endpoints[i];
+      }
+      hit_obstacle = true;
+    }
     return hit_obstacle;
   }
 
@@ -259,7 +349,9 @@ namespace octomap {
 
   template <class MAPNODE>
   MAPNODE* MapCollection<MAPNODE>::queryNode(std::string id) {
-    for (const_iterator it = this->begin(); it != this->end(); ++it) {
+    // the returned node may be changed
+    index_valid = false;
+    for (const_iterator it = nodes.begin(); it != nodes.end(); ++it) {
       if ((*it)->getId() == id) return *(it);
     }
     return 0;
@@ -0,0 +1,362 @@
+/*
+ * OctoMap - An Efficient Probabilistic 3D Mapping Framework Based on Octrees
+ * http://octomap.github.com/
+ *
+ * Copyright (c) 2009-2013, K.M. Wurm and A. Hornung, University of Freiburg
+ * All rights reserved.
+ * License: New BSD
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the University of Freiburg nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef OCTOMAP_MAPPED_OCTREE_H
+#define OCTOMAP_MAPPED_OCTREE_H
+
+
+#include <deque>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <octomap/octomap_types.h>
+#include <octomap/octomap_utils.h>
+#include <octomap/OcTreeKey.h>
+
+namespace octomap {
+
+  /**
+   * Node of a MappedOcTree. Nodes are stored in breadth-first order in one
+   * array without pointers: the existing children of a node are stored
+   * consecutively starting at index "children", in child index order.
+   */
+  struct MappedOcTreeNode {
+    float value;          ///< occupancy in log odds
+    uint32_t children;    ///< array index of the first existing child
+    uint8_t child_mask;   ///< bit i is set if child i exists
+    uint8_t padding[3];
+
+    inline float getLogOdds() const { return value; }
+    inline float getValue() const { return value; }
+    inline double getOccupancy() const { return probability(value); }
+    inline bool hasChildren() const { return child_mask != 0; }
+    inline bool childExists(unsigned int i) const { return (child_mask & (1 << i)) != 0; }
+  };
+
+  /// File header of a MappedOcTree (.mot), followed directly by the node array
+  struct MappedOcTreeHeader {
+    char magic[8];              ///< "OCTOMOT" (zero-terminated)
+    uint32_t version;
+    uint32_t byte_order;        ///< 0x01020304 in the byte order of the writing machine
+    char tree_type[32];         ///< getTreeType() of the converted tree
+    double resolution;
+    float occupancy_thres_log;
+    uint32_t tree_depth;
+    uint64_t num_nodes;
+  };
+
+  /**
+   * Read-only occupancy octree which is queried directly in a memory-mapped
+   * file (.mot). Opening only maps the file, nodes are loaded by the OS on
+   * first access, so there is no parsing or allocation at startup
+   * (in contrast to AbstractOcTree::read()). Child indices are checked when
+   * they are followed, children outside of the node array of a corrupt file
+   * are treated as unknown. validate() checks a whole file explicitly.
+   *
+   * Files are written from any occupancy octree with write() or with
+   * convert_octree. Only the log odds occupancy of nodes is stored, in the
+   * byte order of the writing machine.
+   *
+   * \code
+   * OcTree tree(0.05);
+   * ...
+   * MappedOcTree::write(tree, "map.mot");
+   * MappedOcTree mapped;
+   * if (mapped.open("map.mot")){
+   *   const MappedOcTreeNode* node = mapped.search(point3d(1.0, 2.0, 0.5));
+   *   if (node && mapped.isNodeOccupied(node)) ...
+   * }
+   * \endcode
+   */
+  class MappedOcTree {
+  public:
+    MappedOcTree();
+    ~MappedOcTree();
+
+    /**
+     * Maps the file (read-only), @return success. A previously opened file is closed.
+     * Only the header is checked, e.g. truncated files fail to open.
+     */
+    bool open(const std::string& filename);
+
+    /**
+     * Checks the child indices of all nodes: children need to be stored after
+     * their parent and inside the node array. Reads the whole file.
+     * @return false if the file is corrupt (or not open)
+     */
+    bool validate() const;
+    /// Unmaps the file
+    void close();
+    bool isOpen() const { return header != NULL; }
+
+    /**
+     * Writes an occupancy octree (e.g. OcTree, ColorOcTree) as MappedOcTree file.
+     * Trees are linearized breadth-first, so only one level is kept in memory.
+     */
+    template <class TREE>
+    static bool write(const TREE& tree, const std::string& filename);
+
+    /// Writes an occupancy octree as MappedOcTree to a binary stream, see write()
+    template <class TREE>
+    static bool write(const TREE& tree, std::ostream& s);
+
+    /// @return type of the tree which was converted into this file
+    std::string getTreeType() const { return std::string(header->tree_type); }
+    double getResolution() const { return resolution; }
+    unsigned int getTreeDepth() const { return tree_depth; }
+    double getNodeSize(unsigned depth) const { return resolution * double(1 << (tree_depth - depth)); }
+    float getOccupancyThresLog() const { return header->occupancy_thres_log; }
+    /// @return number of nodes in the tree
+    size_t size() const { return header ? (size_t) header->num_nodes : 0; }
+
+    const MappedOcTreeNode* getRoot() const { return size() > 0 ? nodes : NULL; }
+    /// @return child pos of node (which needs to exist), NULL if its index is outside of a corrupt file
+    inline const MappedOcTreeNode* getNodeChild(const MappedOcTreeNode* node, unsigned int pos) const {
+      if (!childrenInside(node))
+        return NULL;
+      return nodes + node->children + popcount(node->child_mask & ((1 << pos) - 1));
+    }
+
+    /**
+     * Search node at specified depth given a key (depth=0: search full tree depth).
+     * Same semantics as OcTreeBaseImpl::search().
+     * @return pointer to node if found, NULL otherwise
+     */
+    const MappedOcTreeNode* search(const OcTreeKey& key, unsigned int depth = 0) const;
+    const MappedOcTreeNode* search(const point3d& value, unsigned int depth = 0) const;
+    const MappedOcTreeNode* search(double x, double y, double z, unsigned int depth = 0) const;
+
+    inline bool isNodeOccupied(const MappedOcTreeNode* node) const {
+      return node->value >= header->occupancy_thres_log;
+    }
+    inline bool isNodeOccupied(const MappedOcTreeNode& node) const {
+      return node.value >= header->occupancy_thres_log;
+    }
+
+    /// Same as OccupancyOcTreeBase::castRay(), with identical results for the same tree
+    bool castRay(const point3d& origin, const point3d& direction, point3d& end,
+                 bool ignoreUnknownCells = false, double maxRange = -1.0) const;
+
+    // -- key conversion, see OcTreeBaseImpl
+
+    inline key_type coordToKey(double coordinate) const {
+      return ((int) floor(resolution_factor * coordinate)) + tree_max_val;
+    }
+    inline OcTreeKey coordToKey(const point3d& coord) const {
+      return OcTreeKey(coordToKey(coord(0)), coordToKey(coord(1)), coordToKey(coord(2)));
+    }
+    bool coordToKeyChecked(double coordinate, key_type& key) const;
+    bool coordToKeyChecked(const point3d& coord, OcTreeKey& key) const;
+
+    inline double keyToCoord(key_type key) const {
+      return (double((int) key - (int) tree_max_val) + 0.5) * resolution;
+    }
+    double keyToCoord(key_type key, unsigned depth) const;
+    inline point3d keyToCoord(const OcTreeKey& key) const {
+      return point3d(float(keyToCoord(key[0])), float(keyToCoord(key[1])), float(keyToCoord(key[2])));
+    }
+    inline point3d keyToCoord(const OcTreeKey& key, unsigned depth) const {
+      return point3d(float(keyToCoord(key[0], depth)), float(keyToCoord(key[1], depth)), float(keyToCoord(key[2], depth)));
+    }
+
+    /**
+     * Iterator over the leaf nodes of a MappedOcTree, in the same order as
+     * OcTreeBaseImpl::leaf_iterator. The traversal stack has a fixed size
+     * and is not allocated.
+     */
+    class leaf_iterator {
+    public:
+      leaf_iterator() : tree(NULL), max_depth(0), stack_size(0) {}
+      leaf_iterator(const MappedOcTree* tree, unsigned char max_depth = 0);
+
+      bool operator==(const leaf_iterator& other) const {
+        return stack_size == other.stack_size
+            && (stack_size == 0 || (tree == other.tree && top().node == other.top().node
+                                    && top().depth == other.top().depth));
+      }
+      bool operator!=(const leaf_iterator& other) const { return !(*this == other); }
+
+      leaf_iterator& operator++();
+      leaf_iterator operator++(int) { leaf_iterator result = *this; ++(*this); return result; }
+
+      const MappedOcTreeNode* operator->() const { return top().node; }
+      const MappedOcTreeNode& operator*() const { return *(top().node); }
+
+      /// @return the center coordinate of the current node
+      point3d getCoordinate() const { return tree->keyToCoord(top().key, top().depth); }
+      double getX() const { return tree->keyToCoord(top().key[0], top().depth); }
+      double getY() const { return tree->keyToCoord(top().key[1], top().depth); }
+      double getZ() const { return tree->keyToCoord(top().key[2], top().depth); }
+      /// @return the side of the volume occupied by the current node
+      double getSize() const { return tree->getNodeSize(top().depth); }
+      unsigned getDepth() const { return unsigned(top().depth); }
+      /// @return the OcTreeKey of the current node
+      const OcTreeKey& getKey() const { return top().key; }
+
+    protected:
+      struct StackElement {
+        const MappedOcTreeNode* node;
+        OcTreeKey key;
+        uint8_t depth;
+      };
+
+      const StackElement& top() const { return stack[stack_size - 1]; }
+      /// replaces the top element by its children until it is a leaf (or at max_depth)
+      void descend();
+
+      const MappedOcTree* tree;
+      uint8_t max_depth;
+      unsigned int stack_size;
+      StackElement stack[7 * 16 + 1]; ///< at most 7 siblings waiting per level
+    };
+
+    /// @return beginning of the tree as leaf iterator
+    leaf_iterator begin_leafs(unsigned char maxDepth = 0) const { return leaf_iterator(this, maxDepth); }
+    /// @return end of the tree as leaf iterator
+    const leaf_iterator end_leafs() const { return leaf_iterator(); }
+
+    static const uint32_t VERSION = 1;
+
+  protected:
+    static inline unsigned int popcount(unsigned int mask) {
+      mask = mask - ((mask >> 1) & 0x55);
+      mask = (mask & 0x33) + ((mask >> 2) & 0x33);
+      return (mask + (mask >> 4)) & 0x0f;
+    }
+
+    /// @return true if the children of node are inside the node array
+    inline bool childrenInside(const MappedOcTreeNode* node) const {
+      return uint64_t(node->children) + popcount(node->child_mask) <= header->num_nodes;
+    }
+
+    /// static member to create the header of files
+    static void initHeader(MappedOcTreeHeader& header, const std::string& tree_type, double resolution,
+                           float occupancy_thres_log, unsigned int tree_depth, uint64_t num_nodes);
+
+    /// Path of the last search during castRay(), see OccupancyOcTreeBase::RayCastCache
+    struct RayCastCache {
+      enum State {FREE, OCCUPIED, UNKNOWN};
+
+      RayCastCache() : path_length(0) {}
+
+      OcTreeKey key;
+      const MappedOcTreeNode* path[17];
+      unsigned int path_length;
+    };
+
+    RayCastCache::State searchRayNode(const OcTreeKey& key, OcTreeKey& node_min, OcTreeKey& node_max,
+                                      RayCastCache& cache) const;
+
+    const MappedOcTreeHeader* header;
+    const MappedOcTreeNode* nodes;
+    void* data;                 ///< start of the mapped file
+    size_t data_size;
+
+    double resolution;
+    double resolution_factor;   ///< = 1. / resolution
+    unsigned int tree_depth;
+    unsigned int tree_max_val;
+
+  private:
+    MappedOcTree(const MappedOcTree&);
+    MappedOcTree& operator=(const MappedOcTree&);
+  };
+
+
+  template <class TREE>
+  bool MappedOcTree::write(const TREE& tree, const std::string& filename){
+    std::ofstream file(filename.c_str(), std::ios_base::out | std::ios_base::binary);
+    if (!file.is_open()){
+      OCTOMAP_ERROR_STR("Filestream to "<< filename << " not open, nothing written.");
+      return false;
+    }
+    return write(tree, file);
+  }
+
+  template <class TREE>
+  bool MappedOcTree::write(const TREE& tree, std::ostream& s){
+    typedef typename TREE::NodeType NODE;
+    if (tree.size() > 0xffffffffu){
+      OCTOMAP_ERROR_STR("Tree with " << tree.size() << " nodes is too large for a MappedOcTree");
+      return false;
+    }
+
+    MappedOcTreeHeader file_header;
+    initHeader(file_header, tree.getTreeType(), tree.getResolution(), tree.getOccupancyThresLog(),
+               tree.getTreeDepth(), tree.size());
+    s.write((const char*) &file_header, sizeof(file_header));
+
+    // breadth-first: children of each node get the next free indices
+    std::deque<const NODE*> queue;
+    if (tree.getRoot())
+      queue.push_back(tree.getRoot());
+    uint32_t next_index = 1;
+    std::vector<MappedOcTreeNode> buffer;
+    buffer.reserve(65536);
+    while (!queue.empty()){
+      const NODE* node = queue.front();
+      queue.pop_front();
+
+      MappedOcTreeNode mapped;
+      mapped.value = node->getLogOdds();
+      mapped.children = 0;
+      mapped.child_mask = 0;
+      mapped.padding[0] = mapped.padding[1] = mapped.padding[2] = 0;
+      if (tree.nodeHasChildren(node)){
+        mapped.children = next_index;
+        for (unsigned int i = 0; i < 8; ++i){
+          if (tree.nodeChildExists(node, i)){
+            mapped.child_mask |= (uint8_t) (1 << i);
+            queue.push_back(tree.getNodeChild(node, i));
+            ++next_index;
+          }
+        }
+      }
+
+      buffer.push_back(mapped);
+      if (buffer.size() == buffer.capacity()){
+        s.write((const char*) &buffer[0], buffer.size() * sizeof(MappedOcTreeNode));
+        buffer.clear();
+      }
+    }
+    if (!buffer.empty())
+      s.write((const char*) &buffer[0], buffer.size() * sizeof(MappedOcTreeNode));
+
+    return s.good();
+  }
+
+} // end namespace
+
+#endif
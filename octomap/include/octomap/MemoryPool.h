@@ -0,0 +1,105 @@
+/*
+ * OctoMap - An Efficient Probabilistic 3D Mapping Framework Based on Octrees
+ * http://octomap.github.com/
+ *
+ * Copyright (c) 2009-2013, K.M. Wurm and A. Hornung, University of Freiburg
+ * All rights reserved.
+ * License: New BSD
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the University of Freiburg nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef OCTOMAP_MEMORY_POOL_H
+#define OCTOMAP_MEMORY_POOL_H
+
+#include <cstddef>
+#include <vector>
+
+namespace octomap {
+
+  /**
+   * Pool allocator for objects of a fixed size, used by OcTreeBaseImpl to
+   * allocate nodes and children arrays from large slabs instead of issuing
+   * one heap allocation per node (see OcTreeBaseImpl::useNodePool()).
+   *
+   * Released elements are kept in a free list and reused by the next call
+   * to allocate(). Memory is only returned to the system in clear() or when
+   * the pool is destroyed. The pool hands out raw memory only, object
+   * construction and destruction is up to the caller (placement new).
+   *
+   * \note Not thread-safe.
+   */
+  class MemoryPool {
+  public:
+    /**
+     * @param element_size size in bytes of a single element (will be padded for alignment)
+     * @param elements_per_slab number of elements allocated at once when the pool runs empty
+     */
+    MemoryPool(size_t element_size, size_t elements_per_slab = 4096);
+    ~MemoryPool();
+
+    /// @return pointer to uninitialized memory for one element
+    void* allocate();
+
+    /// Returns an element obtained by allocate() to the pool for reuse
+    void deallocate(void* ptr);
+
+    /// Releases all slabs. All elements handed out before are invalid afterwards!
+    void clear();
+
+    /// @return number of elements currently handed out
+    size_t size() const { return num_allocated; }
+
+    /// @return padded size of a single element in bytes
+    size_t elementSize() const { return element_size; }
+
+    /// @return memory reserved by the pool in bytes (including unused elements)
+    size_t memoryUsage() const { return slabs.size() * elements_per_slab * element_size; }
+
+  private:
+    /// not copyable, elements are owned by the pool
+    MemoryPool(const MemoryPool&);
+    MemoryPool& operator=(const MemoryPool&);
+
+    /// allocates a new slab and makes it the current one
+    void addSlab();
+
+    struct FreeElement {
+      FreeElement* next;
+    };
+
+    size_t element_size;
+    size_t elements_per_slab;
+    std::vector<char*> slabs;
+    FreeElement* free_list; ///< released elements, reused first
+    char* slab_pos; ///< next never used element in the current slab
+    char* slab_end;
+    size_t num_allocated;
+  };
+
+} // end namespace
+
+#endif
@@ -0,0 +1,177 @@
+/*
+ * OctoMap - An Efficient Probabilistic 3D Mapping Framework Based on Octrees
+ * http://octomap.github.com/
+ *
+ * Copyright (c) 2009-2013, K.M. Wurm and A. Hornung, University of Freiburg
+ * All rights reserved.
+ * License: New BSD
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the University of Freiburg nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef OCTOMAP_MORTON_KEY_H
+#define OCTOMAP_MORTON_KEY_H
+
+#include <stdint.h>
+#include <algorithm>
+#include <vector>
+
+#if defined(__BMI2__)
+  #include <immintrin.h>
+#endif
+
+#include "OcTreeKey.h"
+
+namespace octomap {
+
+  /**
+   * OcTreeKey encoded as Morton code (Z-order): the bits of the three key
+   * axes are interleaved, x in bit 0, y in bit 1 and z in bit 2 of every
+   * 3 bit group. Each group is the child index (as in computeChildIdx())
+   * of one tree level, with the lowest level in the lowest group.
+   *
+   * Keys of the same subtree are contiguous in Morton order, so sorted keys
+   * share most of their path from the root. Child indices, ancestors and
+   * common ancestors are simple shift and mask operations on the code.
+   */
+  class MortonKey {
+  public:
+    MortonKey() : code(0) {}
+    explicit MortonKey(uint64_t code) : code(code) {}
+    explicit MortonKey(const OcTreeKey& key) : code(encode(key)) {}
+
+    OcTreeKey toKey() const { return decode(code); }
+
+    bool operator== (const MortonKey& other) const { return code == other.code; }
+    bool operator!= (const MortonKey& other) const { return code != other.code; }
+    bool operator< (const MortonKey& other) const { return code < other.code; }
+
+    /// child index (0..7) at level from the bottom, same as computeChildIdx(key, level)
+    unsigned int childIdx(unsigned int level) const {
+      return (unsigned int)(code >> (3 * level)) & 7;
+    }
+
+    /// key of the ancestor at level from the bottom, same as computeIndexKey(level, key)
+    MortonKey ancestor(unsigned int level) const {
+      return MortonKey(level >= 16 ? 0 : code & (~uint64_t(0) << (3 * level)));
+    }
+
+    /**
+     * Level (from the bottom) of the deepest node that contains both keys,
+     * 0 if the keys are equal. The depth of that node in a tree of depth
+     * tree_depth is tree_depth - level.
+     */
+    unsigned int commonAncestorLevel(const MortonKey& other) const {
+      uint64_t diff = code ^ other.code;
+      if (diff == 0)
+        return 0;
+      return highestBit(diff) / 3 + 1;
+    }
+
+    static inline uint64_t encode(const OcTreeKey& key){
+#if defined(__BMI2__)
+      return _pdep_u64(key[0], AXIS_MASK) | _pdep_u64(key[1], AXIS_MASK << 1)
+        | _pdep_u64(key[2], AXIS_MASK << 2);
+#else
+      return spread(key[0]) | (spread(key[1]) << 1) | (spread(key[2]) << 2);
+#endif
+    }
+
+    static inline OcTreeKey decode(uint64_t code){
+#if defined(__BMI2__)
+      return OcTreeKey((key_type) _pext_u64(code, AXIS_MASK), (key_type) _pext_u64(code, AXIS_MASK << 1),
+                       (key_type) _pext_u64(code, AXIS_MASK << 2));
+#else
+      return OcTreeKey(compact(code), compact(code >> 1), compact(code >> 2));
+#endif
+    }
+
+    uint64_t code;
+
+  protected:
+    /// every third bit of the lower 48 bits (the x axis)
+    static const uint64_t AXIS_MASK = 0x0000249249249249ULL;
+
+    /// spreads the 16 bits of v to every third bit
+    static inline uint64_t spread(key_type v){
+      uint64_t x = v;
+      x = (x | (x << 16)) & 0x00000000ff0000ffULL;
+      x = (x | (x << 8))  & 0x000000f00f00f00fULL;
+      x = (x | (x << 4))  & 0x00000c30c30c30c3ULL;
+      x = (x | (x << 2))  & AXIS_MASK;
+      return x;
+    }
+
+    /// inverse of spread(), collects every third bit
+    static inline key_type compact(uint64_t x){
+      x &= AXIS_MASK;
+      x = (x ^ (x >> 2))  & 0x00000c30c30c30c3ULL;
+      x = (x ^ (x >> 4))  & 0x000000f00f00f00fULL;
+      x = (x ^ (x >> 8))  & 0x00000000ff0000ffULL;
+      x = (x ^ (x >> 16)) & 0x000000000000ffffULL;
+      return (key_type) x;
+    }
+
+    static inline unsigned int highestBit(uint64_t x){
+#if defined(__GNUC__)
+      return 63 - __builtin_clzll(x);
+#else
+      unsigned int bit = 0;
+      while (x >>= 1)
+        ++bit;
+      return bit;
+#endif
+    }
+  };
+
+  /**
+   * Sorts keys in Morton (Z-) order. Applying updates in this order lets
+   * consecutive descents from the root share their cached upper path.
+   */
+  inline void sortKeysMorton(std::vector<OcTreeKey>& keys){
+    std::vector<uint64_t> codes(keys.size());
+    for (size_t i = 0; i < keys.size(); ++i)
+      codes[i] = MortonKey::encode(keys[i]);
+    std::sort(codes.begin(), codes.end());
+    for (size_t i = 0; i < keys.size(); ++i)
+      keys[i] = MortonKey::decode(codes[i]);
+  }
+
+  /// all keys of the set in Morton (Z-) order
+  inline void sortKeysMorton(const KeySet& key_set, std::vector<OcTreeKey>& keys){
+    std::vector<uint64_t> codes;
+    codes.reserve(key_set.size());
+    for (KeySet::const_iterator it = key_set.begin(); it != key_set.end(); ++it)
+      codes.push_back(MortonKey::encode(*it));
+    std::sort(codes.begin(), codes.end());
+    keys.resize(codes.size());
+    for (size_t i = 0; i < codes.size(); ++i)
+      keys[i] = MortonKey::decode(codes[i]);
+  }
+
+} // namespace
+
+#endif
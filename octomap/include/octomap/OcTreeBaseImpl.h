@@ -39,11 +39,22 @@
 #include <limits>
 #include <iterator>
 #include <stack>
+#include <algorithm>
 #include <bitset>
+#include <new>
 
 #include "octomap_types.h"
 #include "OcTreeKey.h"
+#include "MortonKey.h"
+#include "Pointcloud.h"
+#include "OcTreeRegion.h"
+#include "OcTreeDataNode.h"
 #include "ScanGraph.h"
+#include "MemoryPool.h"
+
+#ifdef _OPENMP
+  #include <omp.h>
+#endif
 
 
 namespace octomap {
@@ -77,6 +88,8 @@ namespace octomap {
   public:
     /// Make the templated NODE type available from the outside
     typedef NODE NodeType;
+    /// Memory layout of the node children, see OcTreeDataNode::ChildLayout
+    typedef typename NODE::ChildLayout ChildLayout;
 
     // the actual iterator implementation is included here
     // as a member from this file
@@ -120,6 +133,32 @@ namespace octomap {
     void clearKeyRays(){
       keyrays.clear();
     }
+
+    /**
+     * Sets the number of threads for parallelized operations such as
+     * insertPointCloud(). Defaults to the number of OpenMP threads.
+     * Without OpenMP support, only a single thread can be used.
+     */
+    void setNumThreads(unsigned int num_threads);
+
+    /// @return number of threads used for parallelized operations, see setNumThreads()
+    inline unsigned int getNumThreads() const { return num_threads; }
+
+    /**
+     * Enables or disables pooled allocation of nodes and children arrays.
+     * With the pool, nodes are handed out from large slabs and memory of
+     * deleted or pruned nodes is reused, which avoids one heap allocation per
+     * node and improves memory locality for large maps. The allocation mode
+     * can only be changed while the tree is empty, i.e., right after
+     * construction or after clear().
+     *
+     * @param enable use the node pool (default for new trees: off)
+     * @return true if the tree uses the requested allocation mode afterwards
+     */
+    bool useNodePool(bool enable);
+
+    /// @return true if nodes are allocated from a node pool, see useNodePool()
+    bool isNodePoolUsed() const { return node_pool != NULL; }
     
     // -- Tree structure operations formerly contained in the nodes ---
    
@@ -151,6 +190,9 @@ namespace octomap {
      * \return true if node has at least one child
      */
     bool nodeHasChildren(const NODE* node) const;
+
+    /// \return bitmask of the existing children of node (bit i: child i exists)
+    unsigned int nodeChildMask(const NODE* node) const;
     
     /**
      * Expands a node (reverse of pruning): All children are created and
@@ -199,6 +241,15 @@ namespace octomap {
      */
     NODE* search(const OcTreeKey& key, unsigned int depth = 0) const;
 
+    /**
+     *  Search the node containing the voxel of key at the lowest level, same as search(key).
+     *  Additionally returns the depth of that node, which may be a pruned inner node.
+     *  In unknown space (NULL is returned), found_depth is the depth of the largest
+     *  unknown node containing the voxel, i.e. the missing child of the deepest existing node.
+     *  @return pointer to node if found, NULL otherwise
+     */
+    NODE* searchWithDepth(const OcTreeKey& key, unsigned int& found_depth) const;
+
     /**
      *  Delete a node (if exists) given a 3d point. Will always
      *  delete at the lowest level unless depth !=0, and expand pruned inner nodes as needed.
@@ -321,6 +372,23 @@ namespace octomap {
     /// Pruning the tree first produces smaller files (lossless compression)
     std::ostream& writeData(std::ostream &s) const;
 
+    /**
+     * Writes the subtree of the node at depth containing key like writeData(). If the
+     * node is part of a pruned leaf above, that leaf is written (without children).
+     *
+     * @return false if there is no such node (nothing written) or writing failed
+     */
+    bool writeSubtreeData(std::ostream &s, const OcTreeKey& key, unsigned int depth) const;
+
+    /**
+     * Replaces the subtree of the node at depth containing key with data written by
+     * writeSubtreeData(). Missing nodes on the path are created, pruned leafs on the path
+     * expanded. The values of the nodes above are not updated.
+     *
+     * @return false if the data could not be read completely (the subtree may be partial)
+     */
+    bool readSubtreeData(std::istream &s, const OcTreeKey& key, unsigned int depth);
+
     typedef leaf_iterator iterator;
 
     /// @return beginning of the tree as leaf iterator
@@ -349,6 +417,73 @@ namespace octomap {
     /// @return end of the tree as iterator to all nodes (incl. inner)
     const tree_iterator end_tree() const {return tree_iterator_end;}
 
+    /**
+     * Calls functor(NODE* node, const OcTreeKey& key, unsigned int depth, unsigned int thread)
+     * for all leafs up to max_depth, with the same key and depth as leaf_iterator. The tree is
+     * split into subtrees at split_depth (0: the least depth with enough subtrees for load
+     * balancing) which are traversed in parallel with getNumThreads() threads.
+     *
+     * The functor is called concurrently from several threads (thread: 0 .. getNumThreads()-1)
+     * and in no particular order. It may change the values of the nodes, but not the tree structure.
+     */
+    template <class FUNCTOR>
+    void parallelForEachLeaf(FUNCTOR& functor, unsigned int max_depth = 0, unsigned int split_depth = 0) const {
+      parallelTraversal(functor, true, NULL, NULL, max_depth, split_depth);
+    }
+
+    /// Parallel version of leaf_bbx_iterator, see parallelForEachLeaf().
+    /// Only leafs overlapping the bounding box [min, max] are visited.
+    template <class FUNCTOR>
+    void parallelForEachLeafBBX(const OcTreeKey& min, const OcTreeKey& max, FUNCTOR& functor,
+                                unsigned int max_depth = 0, unsigned int split_depth = 0) const {
+      parallelTraversal(functor, true, &min, &max, max_depth, split_depth);
+    }
+
+    /// Parallel version of leaf_bbx_iterator, see parallelForEachLeaf().
+    /// @return false if the bounding box is not within the tree (nothing is visited)
+    template <class FUNCTOR>
+    bool parallelForEachLeafBBX(const point3d& min, const point3d& max, FUNCTOR& functor,
+                                unsigned int max_depth = 0, unsigned int split_depth = 0) const {
+      OcTreeKey min_key, max_key;
+      if (!coordToKeyChecked(min, min_key) || !coordToKeyChecked(max, max_key))
+        return false;
+      parallelTraversal(functor, true, &min_key, &max_key, max_depth, split_depth);
+      return true;
+    }
+
+    /// Parallel version of tree_iterator: calls the functor for all nodes (incl. inner)
+    /// up to max_depth, see parallelForEachLeaf(). Inner nodes above the split depth
+    /// are visited by the calling thread (thread 0) before the subtrees.
+    template <class FUNCTOR>
+    void parallelForEachNode(FUNCTOR& functor, unsigned int max_depth = 0, unsigned int split_depth = 0) const {
+      parallelTraversal(functor, false, NULL, NULL, max_depth, split_depth);
+    }
+
+    /**
+     * Calls functor(NODE* node, const OcTreeKey& key, unsigned int depth) for all leafs
+     * up to max_depth overlapping the region (RegionAABB, RegionSphere, RegionOBB or a class
+     * with the same interface), in the order of leaf_iterator.
+     *
+     * The bounds of the region are converted into key intervals for every depth once, so
+     * only children overlapping these are visited. Nodes on the boundary are classified
+     * against the region, subtrees completely inside are visited without further tests.
+     */
+    template <class REGION, class FUNCTOR>
+    void forEachLeafInRegion(const REGION& region, FUNCTOR& functor, unsigned int max_depth = 0) const;
+
+    /**
+     * Collects centers, sizes and values of all leafs up to max_depth overlapping the
+     * region, see forEachLeafInRegion().
+     *
+     * @param region query region
+     * @param leafs cleared and filled with the leafs (reserve it to avoid allocations)
+     * @param max_depth maximum depth of the query, 0: tree depth
+     * @return number of leafs found
+     */
+    template <class REGION>
+    size_t getLeafsInRegion(const REGION& region, LeafBuffer<typename NODE::DataType>& leafs,
+                            unsigned int max_depth = 0) const;
+
     //
     // Key / coordinate conversion functions
     //
@@ -497,6 +632,27 @@ namespace octomap {
       return point3d(float(keyToCoord(key[0], depth)), float(keyToCoord(key[1], depth)), float(keyToCoord(key[2], depth)));
     }
 
+    /**
+     * Converts all points of a scan into OcTreeKeys, with boundary checking. The result is
+     * identical to calling coordToKeyChecked() for each point, but the conversion is
+     * vectorized with SSE2 / AVX when available.
+     *
+     * @param points 3d coordinates to convert
+     * @param keys resized to the number of points, the keys of invalid points are undefined
+     * @param valid resized to the number of points, true if the point is within the octree
+     * @return number of valid points
+     */
+    size_t coordsToKeys(const Pointcloud& points, std::vector<OcTreeKey>& keys, std::vector<bool>& valid) const;
+
+    /**
+     * Converts keys at the lowest tree level into the coordinates of their centers,
+     * identical to calling keyToCoord() for each key (vectorized with SSE2 / AVX when available).
+     *
+     * @param keys keys to convert
+     * @param points cleared and filled with one point per key
+     */
+    void keysToCoords(const std::vector<OcTreeKey>& keys, Pointcloud& points) const;
+
  protected:
     /// Constructor to enable derived classes to change tree constants.
     /// This usually requires a re-implementation of some core tree-traversal functions as well!
@@ -511,15 +667,45 @@ namespace octomap {
     void calcNumNodesRecurs(NODE* node, size_t& num_nodes) const;
     
     /// recursive call of readData()
-    std::istream& readNodesRecurs(NODE*, std::istream &s);
+    BufferedReader& readNodesRecurs(NODE*, BufferedReader &s);
     
     /// recursive call of writeData()
-    std::ostream& writeNodesRecurs(const NODE*, std::ostream &s) const;
+    BufferedWriter& writeNodesRecurs(const NODE*, BufferedWriter &s) const;
+
+    /// reads the payload of a node with its readData(BufferedReader&)
+    static void readNodeData(NODE* node, BufferedReader& s, BufferedNodeIOTag<true>) {
+      node->readData(s);
+    }
+
+    /// node types which only implement readData(std::istream&) read from the
+    /// stream directly, all following nodes are then read without buffer
+    static void readNodeData(NODE* node, BufferedReader& s, BufferedNodeIOTag<false>) {
+      s.finish();
+      node->readData(s.stream());
+    }
+
+    /// writes the payload of a node with its writeData(BufferedWriter&)
+    static void writeNodeData(const NODE* node, BufferedWriter& s, BufferedNodeIOTag<true>) {
+      node->writeData(s);
+    }
+
+    /// node types which only implement writeData(std::ostream&) write to the stream directly
+    static void writeNodeData(const NODE* node, BufferedWriter& s, BufferedNodeIOTag<false>) {
+      s.flush();
+      node->writeData(s.stream());
+    }
     
     /// Recursively delete a node and all children. Deallocates memory
     /// but does NOT set the node ptr to NULL nor updates tree size.
     void deleteNodeRecurs(NODE* node);
 
+    /// Recursively delete all children of a node and free its children storage.
+    /// Does NOT update tree size.
+    void deleteNodeChildrenRecurs(NODE* node);
+
+    /// recursive deep copy of the data and all children of src into dst
+    void copyNodesRecurs(const NODE* src, NODE* dst);
+
     /// recursive call of deleteNode()
     bool deleteNodeRecurs(NODE* node, unsigned int depth, unsigned int max_depth, const OcTreeKey& key);
 
@@ -537,8 +723,140 @@ namespace octomap {
     OcTreeBaseImpl<NODE,INTERFACE>& operator=(const OcTreeBaseImpl<NODE,INTERFACE>&);
 
   protected:  
+    /// Allocates the (empty) children storage of node (from the pool if enabled)
     void allocNodeChildren(NODE* node);
 
+    /// Frees the (empty) children array of node and sets it to NULL.
+    /// All children need to be deleted before.
+    void deallocNodeChildren(NODE* node);
+
+    /// Allocates and constructs a new node (from the node pool if enabled).
+    /// Does not change the tree size.
+    NODE* allocNode();
+
+    /// Destructs and frees a single node allocated by allocNode()
+    void deallocNode(NODE* node);
+
+    /// Changes tree_size by delta when nodes are created or deleted. While size tracking
+    /// is per thread (see beginThreadSizeTracking()), the change is recorded for the calling thread.
+    inline void changeTreeSize(long delta){
+#ifdef _OPENMP
+      if (!thread_size_changes.empty()){
+        thread_size_changes[omp_get_thread_num() * THREAD_SIZE_STRIDE] += delta;
+        return;
+      }
+#endif
+      tree_size += delta;
+      size_changed = true;
+    }
+
+    /**
+     * Starts tracking node count changes separately for each thread, so that
+     * threads can modify disjoint subtrees in parallel without synchronization.
+     * Needs to be ended with endThreadSizeTracking() outside of the parallel region.
+     */
+    void beginThreadSizeTracking();
+
+    /// (re)creates one KeyRay buffer per thread (see getNumThreads()) if there are fewer,
+    /// e.g. after clearKeyRays(). Call outside of parallel regions.
+    inline void ensureKeyRays(){
+      if (keyrays.size() < num_threads)
+        keyrays.resize(num_threads);
+    }
+
+    /// Adds the node count changes of all threads to tree_size and ends per-thread tracking
+    void endThreadSizeTracking();
+
+    /// node with its key and depth, as on the stack of the iterators
+    struct TraversalElement {
+      NODE* node;
+      OcTreeKey key;
+      unsigned int depth;
+    };
+
+    /// Implementation of parallelForEachLeaf() / parallelForEachNode(), a depth first traversal
+    /// of subtrees in parallel. min_key / max_key are NULL for the complete tree.
+    template <class FUNCTOR>
+    void parallelTraversal(FUNCTOR& functor, bool leafs_only, const OcTreeKey* min_key, const OcTreeKey* max_key,
+                           unsigned int max_depth, unsigned int split_depth) const;
+
+    /// @return true if the node at depth with (center) key overlaps the key bounding box [min_key, max_key]
+    bool nodeInKeyBBX(const OcTreeKey& key, unsigned int depth, const OcTreeKey& min_key, const OcTreeKey& max_key) const;
+
+    /// Converts the bounds of a region into a key bounding box, clipped to the tree.
+    /// @return false if the region is completely outside of the tree
+    bool regionToKeyBBX(const point3d& min, const point3d& max, OcTreeKey& min_key, OcTreeKey& max_key) const;
+
+    /// functor of getLeafsInRegion(), appends to a LeafBuffer
+    struct LeafBufferFunctor {
+      LeafBufferFunctor(const OcTreeBaseImpl<NODE,INTERFACE>* tree, LeafBuffer<typename NODE::DataType>& leafs)
+        : tree(tree), leafs(leafs) {}
+
+      void operator()(NODE* node, const OcTreeKey& key, unsigned int depth){
+        leafs.push_back(tree->keyToCoord(key, depth), (float) tree->getNodeSize(depth), node->getValue());
+      }
+
+      const OcTreeBaseImpl<NODE,INTERFACE>* tree;
+      LeafBuffer<typename NODE::DataType>& leafs;
+    };
+
+    /// extent of the visited leafs per thread, for calcMinMax()
+    struct MinMaxFunctor {
+      /// values of one thread, a cache line apart
+      struct Extent {
+        double value[3];
+        char padding[64 - 3 * sizeof(double)];
+      };
+
+      MinMaxFunctor(const OcTreeBaseImpl<NODE,INTERFACE>* tree)
+        : tree(tree), min_values(tree->getNumThreads()), max_values(tree->getNumThreads()) {
+        for (size_t t = 0; t < min_values.size(); ++t){
+          for (unsigned int i = 0; i < 3; ++i){
+            min_values[t].value[i] = std::numeric_limits<double>::max();
+            max_values[t].value[i] = -std::numeric_limits<double>::max();
+          }
+        }
+      }
+
+      void operator()(NODE*, const OcTreeKey& key, unsigned int depth, unsigned int thread){
+        double size = tree->getNodeSize(depth);
+        for (unsigned int i = 0; i < 3; ++i){
+          double node_min = tree->keyToCoord(key[i], depth) - size / 2.0;
+          if (node_min < min_values[thread].value[i]) min_values[thread].value[i] = node_min;
+          if (node_min + size > max_values[thread].value[i]) max_values[thread].value[i] = node_min + size;
+        }
+      }
+
+      const OcTreeBaseImpl<NODE,INTERFACE>* tree;
+      std::vector<Extent> min_values;
+      std::vector<Extent> max_values;
+    };
+
+    /// \name Child storage, specific to NODE::ChildLayout
+    /// (selected at compile time by the layout tag)
+    /// @{
+    static size_t childrenStorageSize(ChildPointerLayout);
+    static size_t childrenStorageSize(ChildBlockLayout);
+    void initNodeChildren(NODE* node, void* storage, ChildPointerLayout);
+    void initNodeChildren(NODE* node, void* storage, ChildBlockLayout);
+    bool nodeChildExists(const NODE* node, unsigned int childIdx, ChildPointerLayout) const;
+    bool nodeChildExists(const NODE* node, unsigned int childIdx, ChildBlockLayout) const;
+    bool nodeHasChildren(const NODE* node, ChildPointerLayout) const;
+    bool nodeHasChildren(const NODE* node, ChildBlockLayout) const;
+    unsigned int nodeChildMask(const NODE* node, ChildPointerLayout) const;
+    unsigned int nodeChildMask(const NODE* node, ChildBlockLayout) const;
+    NODE* childPointer(const NODE* node, unsigned int childIdx, ChildPointerLayout) const;
+    NODE* childPointer(const NODE* node, unsigned int childIdx, ChildBlockLayout) const;
+    /// constructs child childIdx in the (existing) children storage of node
+    NODE* constructNodeChild(NODE* node, unsigned int childIdx, ChildPointerLayout);
+    NODE* constructNodeChild(NODE* node, unsigned int childIdx, ChildBlockLayout);
+    /// destructs child childIdx (without children) of node, keeps the children storage
+    void destructNodeChild(NODE* node, unsigned int childIdx, ChildPointerLayout);
+    void destructNodeChild(NODE* node, unsigned int childIdx, ChildBlockLayout);
+    size_t memoryUsage(size_t num_inner_nodes, ChildPointerLayout) const;
+    size_t memoryUsage(size_t num_inner_nodes, ChildBlockLayout) const;
+    /// @}
+
     NODE* root; ///< Pointer to the root NODE, NULL for empty tree
 
     // constants of the tree
@@ -560,6 +878,16 @@ namespace octomap {
 
     /// data structure for ray casting, array for multithreading
     std::vector<KeyRay> keyrays;
+    /// number of threads for parallelized operations, independent of keyrays (see clearKeyRays())
+    unsigned int num_threads;
+
+    /// pools for nodes and their children arrays, NULL if disabled (see useNodePool())
+    MemoryPool* node_pool;
+    MemoryPool* children_pool;
+
+    /// per-thread node count changes (one cache line apart), empty if not tracked per thread
+    std::vector<long> thread_size_changes;
+    static const unsigned int THREAD_SIZE_STRIDE = 64 / sizeof(long);
 
     const leaf_iterator leaf_iterator_end;
     const leaf_bbx_iterator leaf_iterator_bbx_end;
@@ -39,6 +39,12 @@
   #include <omp.h>
 #endif
 
+#if defined(__AVX__)
+  #include <immintrin.h>
+#elif defined(__SSE2__)
+  #include <emmintrin.h>
+#endif
+
 namespace octomap {
 
 
@@ -67,6 +73,8 @@ namespace octomap {
   template <class NODE,class I>
   OcTreeBaseImpl<NODE,I>::~OcTreeBaseImpl(){
     clear();
+    delete node_pool;
+    delete children_pool;
   }
 
 
@@ -77,9 +85,12 @@ namespace octomap {
   {
     init();
 
-    // copy nodes recursively:
-    if (rhs.root)
-      root = new NODE(*(rhs.root));
+    // copy nodes recursively, keeping the allocation mode and child layout:
+    useNodePool(rhs.isNodePoolUsed());
+    if (rhs.root){
+      root = allocNode();
+      copyNodesRecurs(rhs.root, root);
+    }
 
   }
 
@@ -92,6 +103,8 @@ namespace octomap {
       min_value[i] = std::numeric_limits<double>::max( );
     }
     size_changed = true;
+    node_pool = NULL;
+    children_pool = NULL;
 
     // create as many KeyRays as there are OMP_THREADS defined,
     // one buffer for each thread
@@ -107,6 +120,7 @@ namespace octomap {
 #else
     this->keyrays.resize(1);
 #endif
+    this->num_threads = this->keyrays.size();
 
   }
 
@@ -119,6 +133,14 @@ namespace octomap {
     size_t this_size = this->tree_size;
     this->tree_size = other.tree_size;
     other.tree_size = this_size;
+
+    // nodes are owned by the pools, need to move along with them
+    MemoryPool* this_pool = node_pool;
+    node_pool = other.node_pool;
+    other.node_pool = this_pool;
+    this_pool = children_pool;
+    children_pool = other.children_pool;
+    other.children_pool = this_pool;
   }
 
   template <class NODE,class I>
@@ -168,19 +190,68 @@ namespace octomap {
 
     size_changed = true;
   }
+
+  template <class NODE,class I>
+  bool OcTreeBaseImpl<NODE,I>::useNodePool(bool enable) {
+    if (enable == isNodePoolUsed())
+      return true;
+
+    if (root != NULL){
+      OCTOMAP_ERROR("Node allocation can only be changed for an empty tree, call clear() first.\n");
+      return false;
+    }
+
+    if (enable){
+      node_pool = new MemoryPool(sizeof(NODE));
+      children_pool = new MemoryPool(childrenStorageSize(ChildLayout()));
+    } else {
+      delete node_pool;
+      delete children_pool;
+      node_pool = NULL;
+      children_pool = NULL;
+    }
+    return true;
+  }
   
+  template <class NODE,class I>
+  void OcTreeBaseImpl<NODE,I>::setNumThreads(unsigned int num_threads) {
+    assert(num_threads > 0);
+#ifdef _OPENMP
+    this->keyrays.resize(num_threads);
+#else
+    if (num_threads > 1)
+      OCTOMAP_WARNING("Compiled without OpenMP, using a single thread.\n");
+    this->keyrays.resize(1);
+#endif
+    this->num_threads = this->keyrays.size();
+  }
+
+  template <class NODE,class I>
+  void OcTreeBaseImpl<NODE,I>::beginThreadSizeTracking() {
+    thread_size_changes.assign(num_threads * THREAD_SIZE_STRIDE, 0);
+  }
+
+  template <class NODE,class I>
+  void OcTreeBaseImpl<NODE,I>::endThreadSizeTracking() {
+    long delta = 0;
+    for (size_t i = 0; i < thread_size_changes.size(); i += THREAD_SIZE_STRIDE)
+      delta += thread_size_changes[i];
+    thread_size_changes.clear();
+
+    tree_size += delta;
+    size_changed = true;
+  }
+
   template <class NODE,class I>
   NODE* OcTreeBaseImpl<NODE,I>::createNodeChild(NODE* node, unsigned int childIdx){
     assert(childIdx < 8);
     if (node->children == NULL) {
       allocNodeChildren(node);
     }
-    assert (node->children[childIdx] == NULL);
-    NODE* newNode = new NODE();
-    node->children[childIdx] = static_cast<AbstractOcTreeNode*>(newNode);
+    assert (!nodeChildExists(node, childIdx));
+    NODE* newNode = constructNodeChild(node, childIdx, ChildLayout());
     
-    tree_size++;
-    size_changed = true;
+    changeTreeSize(1);
     
     return newNode;
   }
@@ -188,26 +259,24 @@ namespace octomap {
   template <class NODE,class I>
   void OcTreeBaseImpl<NODE,I>::deleteNodeChild(NODE* node, unsigned int childIdx){
     assert((childIdx < 8) && (node->children != NULL));
-    assert(node->children[childIdx] != NULL);
-    delete static_cast<NODE*>(node->children[childIdx]); // TODO delete check if empty
-    node->children[childIdx] = NULL;
+    assert(nodeChildExists(node, childIdx));
+    destructNodeChild(node, childIdx, ChildLayout()); // TODO delete check if empty
     
-    tree_size--;
-    size_changed = true;
+    changeTreeSize(-1);
   }
   
   template <class NODE,class I>  
   NODE* OcTreeBaseImpl<NODE,I>::getNodeChild(NODE* node, unsigned int childIdx) const{
     assert((childIdx < 8) && (node->children != NULL));
-    assert(node->children[childIdx] != NULL);
-    return static_cast<NODE*>(node->children[childIdx]);
+    assert(nodeChildExists(node, childIdx));
+    return childPointer(node, childIdx, ChildLayout());
   }
     
   template <class NODE,class I>
   const NODE* OcTreeBaseImpl<NODE,I>::getNodeChild(const NODE* node, unsigned int childIdx) const{
     assert((childIdx < 8) && (node->children != NULL));
-    assert(node->children[childIdx] != NULL);
-    return static_cast<const NODE*>(node->children[childIdx]);
+    assert(nodeChildExists(node, childIdx));
+    return childPointer(node, childIdx, ChildLayout());
   }
   
   template <class NODE,class I>
@@ -234,25 +303,19 @@ namespace octomap {
   template <class NODE,class I>
   bool OcTreeBaseImpl<NODE,I>::nodeChildExists(const NODE* node, unsigned int childIdx) const{
     assert(childIdx < 8);
-    if ((node->children != NULL) && (node->children[childIdx] != NULL))
-      return true;
-    else
-      return false;
+    return nodeChildExists(node, childIdx, ChildLayout());
   }
   
   template <class NODE,class I>
   bool OcTreeBaseImpl<NODE,I>::nodeHasChildren(const NODE* node) const {
-    if (node->children == NULL)
-      return false;
+    return nodeHasChildren(node, ChildLayout());
+  }
     
-    for (unsigned int i = 0; i<8; i++){
-      if (node->children[i] != NULL)
-        return true;
-    }
-    return false;
+  template <class NODE,class I>
+  unsigned int OcTreeBaseImpl<NODE,I>::nodeChildMask(const NODE* node) const {
+    return nodeChildMask(node, ChildLayout());
   }
 
-    
   template <class NODE,class I>
   void OcTreeBaseImpl<NODE,I>::expandNode(NODE* node){
     assert(!nodeHasChildren(node));
@@ -276,20 +339,159 @@ namespace octomap {
     for (unsigned int i=0;i<8;i++) {
       deleteNodeChild(node, i);
     }
-    delete[] node->children;
-    node->children = NULL;
+    deallocNodeChildren(node);
 
     return true;
   }
   
   template <class NODE,class I>
   void OcTreeBaseImpl<NODE,I>::allocNodeChildren(NODE* node){
-    // TODO NODE*
-    node->children = new AbstractOcTreeNode*[8];
+    assert(node->children == NULL);
+    void* storage;
+    if (children_pool)
+      storage = children_pool->allocate();
+    else
+      storage = ::operator new(childrenStorageSize(ChildLayout()));
+    initNodeChildren(node, storage, ChildLayout());
+  }
+
+  template <class NODE,class I>
+  void OcTreeBaseImpl<NODE,I>::deallocNodeChildren(NODE* node){
+    assert(node->children != NULL);
+    assert(!nodeHasChildren(node));
+    if (children_pool)
+      children_pool->deallocate(node->children);
+    else
+      ::operator delete(node->children);
+    node->children = NULL;
+  }
+
+  // -- child layout: array of 8 pointers to separately allocated children ---
+
+  template <class NODE,class I>
+  size_t OcTreeBaseImpl<NODE,I>::childrenStorageSize(ChildPointerLayout){
+    return sizeof(AbstractOcTreeNode*[8]);
+  }
+
+  template <class NODE,class I>
+  void OcTreeBaseImpl<NODE,I>::initNodeChildren(NODE* node, void* storage, ChildPointerLayout){
+    node->children = static_cast<AbstractOcTreeNode**>(storage);
     for (unsigned int i=0; i<8; i++) {
       node->children[i] = NULL;
     }
   }
+
+  template <class NODE,class I>
+  bool OcTreeBaseImpl<NODE,I>::nodeChildExists(const NODE* node, unsigned int childIdx, ChildPointerLayout) const{
+    return ((node->children != NULL) && (node->children[childIdx] != NULL));
+  }
+
+  template <class NODE,class I>
+  bool OcTreeBaseImpl<NODE,I>::nodeHasChildren(const NODE* node, ChildPointerLayout) const{
+    if (node->children == NULL)
+      return false;
+
+    for (unsigned int i = 0; i<8; i++){
+      if (node->children[i] != NULL)
+        return true;
+    }
+    return false;
+  }
+
+  template <class NODE,class I>
+  unsigned int OcTreeBaseImpl<NODE,I>::nodeChildMask(const NODE* node, ChildPointerLayout) const{
+    if (node->children == NULL)
+      return 0;
+
+    unsigned int mask = 0;
+    for (unsigned int i = 0; i<8; i++){
+      if (node->children[i] != NULL)
+        mask |= (1 << i);
+    }
+    return mask;
+  }
+
+  template <class NODE,class I>
+  NODE* OcTreeBaseImpl<NODE,I>::childPointer(const NODE* node, unsigned int childIdx, ChildPointerLayout) const{
+    return static_cast<NODE*>(node->children[childIdx]);
+  }
+
+  template <class NODE,class I>
+  NODE* OcTreeBaseImpl<NODE,I>::constructNodeChild(NODE* node, unsigned int childIdx, ChildPointerLayout){
+    NODE* newNode = allocNode();
+    node->children[childIdx] = static_cast<AbstractOcTreeNode*>(newNode);
+    return newNode;
+  }
+
+  template <class NODE,class I>
+  void OcTreeBaseImpl<NODE,I>::destructNodeChild(NODE* node, unsigned int childIdx, ChildPointerLayout){
+    deallocNode(static_cast<NODE*>(node->children[childIdx]));
+    node->children[childIdx] = NULL;
+  }
+
+  // -- child layout: one contiguous block of 8 children + bitmask ------------
+
+  template <class NODE,class I>
+  size_t OcTreeBaseImpl<NODE,I>::childrenStorageSize(ChildBlockLayout){
+    return 8 * sizeof(NODE);
+  }
+
+  template <class NODE,class I>
+  void OcTreeBaseImpl<NODE,I>::initNodeChildren(NODE* node, void* storage, ChildBlockLayout){
+    // children are only constructed in their slot when created
+    node->children = static_cast<AbstractOcTreeNode**>(storage);
+    node->child_mask = 0;
+  }
+
+  template <class NODE,class I>
+  bool OcTreeBaseImpl<NODE,I>::nodeChildExists(const NODE* node, unsigned int childIdx, ChildBlockLayout) const{
+    return (node->child_mask & (1 << childIdx)) != 0;
+  }
+
+  template <class NODE,class I>
+  bool OcTreeBaseImpl<NODE,I>::nodeHasChildren(const NODE* node, ChildBlockLayout) const{
+    return node->child_mask != 0;
+  }
+
+  template <class NODE,class I>
+  unsigned int OcTreeBaseImpl<NODE,I>::nodeChildMask(const NODE* node, ChildBlockLayout) const{
+    return node->child_mask;
+  }
+
+  template <class NODE,class I>
+  NODE* OcTreeBaseImpl<NODE,I>::childPointer(const NODE* node, unsigned int childIdx, ChildBlockLayout) const{
+    return static_cast<NODE*>(static_cast<void*>(node->children)) + childIdx;
+  }
+
+  template <class NODE,class I>
+  NODE* OcTreeBaseImpl<NODE,I>::constructNodeChild(NODE* node, unsigned int childIdx, ChildBlockLayout){
+    node->child_mask |= (1 << childIdx);
+    return new (childPointer(node, childIdx, ChildBlockLayout())) NODE();
+  }
+
+  template <class NODE,class I>
+  void OcTreeBaseImpl<NODE,I>::destructNodeChild(NODE* node, unsigned int childIdx, ChildBlockLayout){
+    childPointer(node, childIdx, ChildBlockLayout())->~NODE();
+    node->child_mask &= ~(1 << childIdx);
+  }
+
+  template <class NODE,class I>
+  NODE* OcTreeBaseImpl<NODE,I>::allocNode(){
+    if (node_pool)
+      return new (node_pool->allocate()) NODE();
+    else
+      return new NODE();
+  }
+
+  template <class NODE,class I>
+  void OcTreeBaseImpl<NODE,I>::deallocNode(NODE* node){
+    if (node_pool){
+      node->~NODE();
+      node_pool->deallocate(node);
+    } else {
+      delete node;
+    }
+  }
   
   
 
@@ -380,6 +582,104 @@ namespace octomap {
     }
   }
 
+#if defined(__SSE2__) && !defined(__AVX__)
+  /// floor() of two doubles converted to int32 in the lower two lanes (SSE2 has no rounding instruction)
+  inline __m128i floorToInt32(__m128d values){
+    __m128i truncated = _mm_cvttpd_epi32(values);
+    // -1 where truncation rounded up (negative non-integral values)
+    __m128d rounded_up = _mm_cmpgt_pd(_mm_cvtepi32_pd(truncated), values);
+    return _mm_add_epi32(truncated, _mm_shuffle_epi32(_mm_castpd_si128(rounded_up), _MM_SHUFFLE(3, 3, 2, 0)));
+  }
+#endif
+
+  template <class NODE,class I>
+  size_t OcTreeBaseImpl<NODE,I>::coordsToKeys(const Pointcloud& points, std::vector<OcTreeKey>& keys,
+                                              std::vector<bool>& valid) const{
+    const size_t num_points = points.size();
+    keys.resize(num_points);
+    valid.resize(num_points);
+    size_t num_valid = 0;
+
+#if defined(__AVX__) || defined(__SSE2__)
+    // same operations as coordToKeyChecked(), all three coordinates at once:
+    // float -> double, scale, floor, truncate to int, shift by tree_max_val
+    const __m128i offset = _mm_set1_epi32((int) tree_max_val);
+    // unsigned comparison scaled < 2*tree_max_val with signed instructions: flip the sign bits
+    const __m128i sign = _mm_set1_epi32((int) 0x80000000u);
+    const __m128i limit = _mm_set1_epi32((int) ((2 * tree_max_val) ^ 0x80000000u));
+#if defined(__AVX__)
+    const __m256d factor = _mm256_set1_pd(resolution_factor);
+#else
+    const __m128d factor = _mm_set1_pd(resolution_factor);
+#endif
+    int scaled_coord[4];
+    for (size_t i = 0; i < num_points; ++i){
+      const float* coord = &points[i](0);
+#if defined(__AVX__)
+      // the fourth lane is ignored, only read it when another point follows
+      __m128 xyz = (i + 1 < num_points) ? _mm_loadu_ps(coord) : _mm_setr_ps(coord[0], coord[1], coord[2], 0.0f);
+      __m128i scaled = _mm256_cvttpd_epi32(_mm256_floor_pd(_mm256_mul_pd(_mm256_cvtps_pd(xyz), factor)));
+#else
+      __m128 xy = _mm_loadl_pi(_mm_setzero_ps(), (const __m64*) coord);
+      __m128i scaled_xy = floorToInt32(_mm_mul_pd(_mm_cvtps_pd(xy), factor));
+      __m128i scaled_z = floorToInt32(_mm_mul_pd(_mm_cvtps_pd(_mm_load_ss(coord + 2)), factor));
+      __m128i scaled = _mm_unpacklo_epi64(scaled_xy, scaled_z);
+#endif
+      scaled = _mm_add_epi32(scaled, offset);
+      __m128i in_range = _mm_cmplt_epi32(_mm_xor_si128(scaled, sign), limit);
+      _mm_storeu_si128((__m128i*) scaled_coord, scaled);
+      keys[i] = OcTreeKey((key_type) scaled_coord[0], (key_type) scaled_coord[1], (key_type) scaled_coord[2]);
+      bool point_valid = (_mm_movemask_ps(_mm_castsi128_ps(in_range)) & 7) == 7;
+      valid[i] = point_valid;
+      if (point_valid)
+        ++num_valid;
+    }
+#else
+    for (size_t i = 0; i < num_points; ++i){
+      bool point_valid = coordToKeyChecked(points[i], keys[i]);
+      valid[i] = point_valid;
+      if (point_valid)
+        ++num_valid;
+    }
+#endif
+    return num_valid;
+  }
+
+  template <class NODE,class I>
+  void OcTreeBaseImpl<NODE,I>::keysToCoords(const std::vector<OcTreeKey>& keys, Pointcloud& points) const{
+    points.clear();
+    points.reserve(keys.size());
+
+#if defined(__AVX__) || defined(__SSE2__)
+    // (double(key - tree_max_val) + 0.5) * resolution, rounded to float as in keyToCoord()
+    const __m128i offset = _mm_set1_epi32((int) tree_max_val);
+#if defined(__AVX__)
+    const __m256d half = _mm256_set1_pd(0.5);
+    const __m256d res = _mm256_set1_pd(resolution);
+#else
+    const __m128d half = _mm_set1_pd(0.5);
+    const __m128d res = _mm_set1_pd(resolution);
+#endif
+    float coord[4];
+    for (size_t i = 0; i < keys.size(); ++i){
+      const OcTreeKey& key = keys[i];
+      __m128i shifted = _mm_sub_epi32(_mm_setr_epi32(key[0], key[1], key[2], 0), offset);
+#if defined(__AVX__)
+      __m128 xyz = _mm256_cvtpd_ps(_mm256_mul_pd(_mm256_add_pd(_mm256_cvtepi32_pd(shifted), half), res));
+#else
+      __m128 xy = _mm_cvtpd_ps(_mm_mul_pd(_mm_add_pd(_mm_cvtepi32_pd(shifted), half), res));
+      __m128 z = _mm_cvtpd_ps(_mm_mul_pd(_mm_add_pd(_mm_cvtepi32_pd(_mm_unpackhi_epi64(shifted, shifted)), half), res));
+      __m128 xyz = _mm_movelh_ps(xy, z);
+#endif
+      _mm_storeu_ps(coord, xyz);
+      points.push_back(coord[0], coord[1], coord[2]);
+    }
+#else
+    for (size_t i = 0; i < keys.size(); ++i)
+      points.push_back(keyToCoord(keys[i]));
+#endif
+  }
+
   template <class NODE,class I>
   key_type OcTreeBaseImpl<NODE,I>::adjustKeyAtDepth(key_type key, unsigned int depth) const{
     unsigned int diff = tree_depth - depth;
@@ -471,6 +771,31 @@ namespace octomap {
   }
 
 
+  template <class NODE,class I>
+  NODE* OcTreeBaseImpl<NODE,I>::searchWithDepth (const OcTreeKey& key, unsigned int& found_depth) const {
+    found_depth = 0;
+    if (root == NULL)
+      return NULL;
+
+    NODE* curNode (root);
+    for (int i=(tree_depth-1); i>=0; --i) {
+      unsigned int pos = computeChildIdx(key, i);
+      if (nodeChildExists(curNode, pos)) {
+        curNode = getNodeChild(curNode, pos);
+        ++found_depth;
+      } else if (!nodeHasChildren(curNode)) {
+        // pruned node
+        return curNode;
+      } else {
+        // unknown child
+        ++found_depth;
+        return NULL;
+      }
+    }
+    return curNode;
+  }
+
+
   template <class NODE,class I>
   bool OcTreeBaseImpl<NODE,I>::deleteNode(const point3d& value, unsigned int depth) {
     OcTreeKey key;
@@ -505,7 +830,11 @@ namespace octomap {
     if (depth == 0)
       depth = tree_depth;
 
-    return deleteNodeRecurs(root, 0, depth, key);
+    bool deleted = deleteNodeRecurs(root, 0, depth, key);
+    // the root lost its last child, without children it would be a leaf covering everything
+    if (deleted)
+      clear();
+    return deleted;
   }
 
   template <class NODE,class I>
@@ -514,6 +843,11 @@ namespace octomap {
       deleteNodeRecurs(root);
       this->tree_size = 0;
       this->root = NULL;
+      // hand the slabs back to the system
+      if (node_pool){
+        node_pool->clear();
+        children_pool->clear();
+      }
       // max extent of tree changed:
       this->size_changed = true;
     }
@@ -651,6 +985,7 @@ namespace octomap {
   bool OcTreeBaseImpl<NODE,I>::computeRay(const point3d& origin, const point3d& end,
                                     std::vector<point3d>& _ray) {
     _ray.clear();
+    ensureKeyRays();
     if (!computeRayKeys(origin, end, keyrays.at(0))) return false;
     for (KeyRay::const_iterator it = keyrays[0].begin(); it != keyrays[0].end(); ++it) {
       _ray.push_back(keyToCoord(*it));
@@ -663,17 +998,38 @@ namespace octomap {
     assert(node);
     // TODO: maintain tree size?
     
+    deleteNodeChildrenRecurs(node);
+    deallocNode(node);
+  }
+
+  template <class NODE,class I>
+  void OcTreeBaseImpl<NODE,I>::deleteNodeChildrenRecurs(NODE* node){
     if (node->children != NULL) {
       for (unsigned int i=0; i<8; i++) {
-        if (node->children[i] != NULL){
-          this->deleteNodeRecurs(static_cast<NODE*>(node->children[i]));
+        if (nodeChildExists(node, i)){
+          this->deleteNodeChildrenRecurs(getNodeChild(node, i));
+          destructNodeChild(node, i, ChildLayout());
         }
       }
-      delete[] node->children;
-      node->children = NULL;
+      deallocNodeChildren(node);
     } // else: node has no children
-      
-    delete node;
+  }
+
+  template <class NODE,class I>
+  void OcTreeBaseImpl<NODE,I>::copyNodesRecurs(const NODE* src, NODE* dst){
+    assert(src && dst);
+    // NODE needs to declare copyData(const NODE&), see OcTreeDataNode::copyData()
+    void (NODE::*copy_data)(const NODE&) = &NODE::copyData;
+    (dst->*copy_data)(*src);
+
+    if (src->children != NULL){
+      allocNodeChildren(dst);
+      for (unsigned int i=0; i<8; i++) {
+        if (nodeChildExists(src, i)){
+          copyNodesRecurs(getNodeChild(src, i), constructNodeChild(dst, i, ChildLayout()));
+        }
+      }
+    }
   }
   
 
@@ -701,6 +1057,15 @@ namespace octomap {
     // follow down further, fix inner nodes on way back up
     bool deleteChild = deleteNodeRecurs(getNodeChild(node, pos), depth+1, max_depth, key);
     if (deleteChild){
+      // an inner node is deleted with its complete subtree
+      NODE* child = getNodeChild(node, pos);
+      if (nodeHasChildren(child)){
+        size_t num_deleted = 0;
+        calcNumNodesRecurs(child, num_deleted);
+        changeTreeSize(-(long)num_deleted);
+      }
+      // also frees the children array left empty by the recursion
+      deleteNodeChildrenRecurs(child);
       // TODO: lazy eval?
       // TODO delete check depth, what happens to inner nodes with children?
       this->deleteNodeChild(node, pos);
@@ -761,35 +1126,29 @@ namespace octomap {
 
   template <class NODE,class I>
   std::ostream& OcTreeBaseImpl<NODE,I>::writeData(std::ostream &s) const{
-    if (root)
-      writeNodesRecurs(root, s);
+    if (root){
+      BufferedWriter writer(s);
+      writeNodesRecurs(root, writer);
+    }
 
     return s;
   }
   
   template <class NODE,class I>
-  std::ostream& OcTreeBaseImpl<NODE,I>::writeNodesRecurs(const NODE* node, std::ostream &s) const{
-    node->writeData(s);
+  BufferedWriter& OcTreeBaseImpl<NODE,I>::writeNodesRecurs(const NODE* node, BufferedWriter &s) const{
+    writeNodeData(node, s, BufferedNodeIOTag<BufferedNodeIO<NODE>::write>());
     
     // 1 bit for each children; 0: empty, 1: allocated
-    std::bitset<8> children;
+    char children_char = 0;
     for (unsigned int i=0; i<8; i++) {
       if (nodeChildExists(node, i))
-        children[i] = 1;
-      else
-        children[i] = 0;
+        children_char |= (char) (1 << i);
     }
-
-    char children_char = (char) children.to_ulong();
-    s.write((char*)&children_char, sizeof(char));
-
-//     std::cout << "wrote: " << value << " "
-//               << children.to_string<char,std::char_traits<char>,std::allocator<char> >() 
-//               << std::endl;
+    s.put(children_char);
 
     // recursively write children
     for (unsigned int i=0; i<8; i++) {
-      if (children[i] == 1) {
+      if (children_char & (1 << i)) {
         this->writeNodesRecurs(getNodeChild(node, i), s);
       }
     }
@@ -813,28 +1172,83 @@ namespace octomap {
       return s;
     }
 
-    root = new NODE();
-    readNodesRecurs(root, s);
+    root = allocNode();
+    {
+      BufferedReader reader(s);
+      readNodesRecurs(root, reader);
+    }
     
     tree_size = calcNumNodes();  // compute number of nodes
     return s;
   }
   
   template <class NODE,class I>
-  std::istream& OcTreeBaseImpl<NODE,I>::readNodesRecurs(NODE* node, std::istream &s) {
+  bool OcTreeBaseImpl<NODE,I>::writeSubtreeData(std::ostream &s, const OcTreeKey& key, unsigned int depth) const{
+    const NODE* node = (depth == 0) ? root : search(key, depth);
+    if (node == NULL)
+      return false;
+
+    BufferedWriter writer(s);
+    writeNodesRecurs(node, writer);
+    return writer.flush();
+  }
+
+  template <class NODE,class I>
+  bool OcTreeBaseImpl<NODE,I>::readSubtreeData(std::istream &s, const OcTreeKey& key, unsigned int depth){
+    if (depth > tree_depth){
+      OCTOMAP_ERROR("Subtree depth %u exceeds the tree depth %u", depth, tree_depth);
+      return false;
+    }
+
+    // find or create the node, existing leafs on the way are expanded
+    bool created = false;
+    if (root == NULL){
+      root = allocNode();
+      tree_size++;
+      size_changed = true;
+      created = true;
+    }
+    NODE* node = root;
+    for (unsigned int d = 0; d < depth; ++d){
+      const unsigned int pos = computeChildIdx(key, tree_depth - 1 - d);
+      if (!nodeChildExists(node, pos)){
+        if (!created && !nodeHasChildren(node))
+          expandNode(node);
+        else {
+          createNodeChild(node, pos);
+          created = true;
+        }
+      }
+      node = getNodeChild(node, pos);
+    }
+
+    if (nodeHasChildren(node)){
+      size_t num_deleted = 0;
+      calcNumNodesRecurs(node, num_deleted);
+      deleteNodeChildrenRecurs(node);
+      changeTreeSize(-(long)num_deleted);
+    }
+
+    BufferedReader reader(s);
+    readNodesRecurs(node, reader);
+    if (!reader.good()){
+      OCTOMAP_ERROR_STR("Error reading subtree data, the subtree may be incomplete");
+      return false;
+    }
+    return true;
+  }
+
+  template <class NODE,class I>
+  BufferedReader& OcTreeBaseImpl<NODE,I>::readNodesRecurs(NODE* node, BufferedReader &s) {
     
-    node->readData(s);
+    readNodeData(node, s, BufferedNodeIOTag<BufferedNodeIO<NODE>::read>());
     
     char children_char;
-    s.read((char*)&children_char, sizeof(char));
-    std::bitset<8> children ((unsigned long long) children_char);
-
-    //std::cout << "read: " << node->getValue() << " "
-    //            << children.to_string<char,std::char_traits<char>,std::allocator<char> >()
-    //            << std::endl;
+    if (!s.read(children_char))
+      return s;
 
     for (unsigned int i=0; i<8; i++) {
-      if (children[i] == 1){
+      if (children_char & (1 << i)){
         NODE* newNode = createNodeChild(node, i);
         readNodesRecurs(newNode, s);
       }
@@ -896,6 +1310,237 @@ namespace octomap {
     z = maxZ - minZ;
   }
 
+  template <class NODE,class I>
+  template <class FUNCTOR>
+  void OcTreeBaseImpl<NODE,I>::parallelTraversal(FUNCTOR& functor, bool leafs_only, const OcTreeKey* min_key,
+                                                 const OcTreeKey* max_key, unsigned int max_depth,
+                                                 unsigned int split_depth) const {
+    if (root == NULL)
+      return;
+    if (max_depth == 0 || max_depth > tree_depth)
+      max_depth = tree_depth;
+
+    // split into subtrees (tasks) level by level, until split_depth or enough tasks
+    // for load balancing. Inner nodes above are visited here, leafs remain as tasks.
+    std::vector<TraversalElement> tasks(1);
+    tasks[0].node = root;
+    tasks[0].key = OcTreeKey(tree_max_val, tree_max_val, tree_max_val);
+    tasks[0].depth = 0;
+    std::vector<TraversalElement> next_tasks;
+    for (unsigned int depth = 0; depth < max_depth; ++depth){
+      if ((split_depth > 0) ? (depth >= split_depth) : (tasks.size() >= 8 * num_threads))
+        break;
+
+      next_tasks.clear();
+      key_type center_offset_key = tree_max_val >> (depth + 1);
+      for (size_t t = 0; t < tasks.size(); ++t){
+        const TraversalElement& task = tasks[t];
+        if (task.depth < depth || !nodeHasChildren(task.node)){
+          next_tasks.push_back(task);
+          continue;
+        }
+        if (!leafs_only)
+          functor(task.node, task.key, task.depth, 0u);
+        TraversalElement child;
+        child.depth = depth + 1;
+        for (unsigned int i = 0; i < 8; ++i){
+          if (nodeChildExists(task.node, i)){
+            computeChildKey(i, center_offset_key, task.key, child.key);
+            if (min_key && !nodeInKeyBBX(child.key, child.depth, *min_key, *max_key))
+              continue;
+            child.node = getNodeChild(task.node, i);
+            next_tasks.push_back(child);
+          }
+        }
+      }
+      tasks.swap(next_tasks);
+    }
+
+#ifdef _OPENMP
+    omp_set_num_threads(num_threads);
+    #pragma omp parallel for schedule(dynamic)
+#endif
+    for (int t = 0; t < (int)tasks.size(); ++t){
+      unsigned int thread = 0;
+#ifdef _OPENMP
+      thread = omp_get_thread_num();
+#endif
+      // depth first in the order of the iterators. At most 7 siblings per level
+      // wait on the stack, keys limit the tree depth to 16.
+      TraversalElement stack[8 * 16];
+      unsigned int stack_size = 0;
+      stack[stack_size++] = tasks[t];
+      while (stack_size > 0){
+        TraversalElement current = stack[--stack_size];
+        unsigned int child_mask = (current.depth < max_depth) ? nodeChildMask(current.node) : 0;
+        if (child_mask == 0 || !leafs_only)
+          functor(current.node, current.key, current.depth, thread);
+        if (child_mask == 0)
+          continue;
+
+        key_type center_offset_key = tree_max_val >> (current.depth + 1);
+        for (int i = 7; i >= 0; --i){
+          if (child_mask & (1 << i)){
+            TraversalElement& child = stack[stack_size];
+            computeChildKey(i, center_offset_key, current.key, child.key);
+            child.depth = current.depth + 1;
+            if (min_key && !nodeInKeyBBX(child.key, child.depth, *min_key, *max_key))
+              continue;
+            child.node = getNodeChild(current.node, i);
+            ++stack_size;
+          }
+        }
+      }
+    }
+  }
+
+  template <class NODE,class I>
+  bool OcTreeBaseImpl<NODE,I>::nodeInKeyBBX(const OcTreeKey& key, unsigned int depth,
+                                            const OcTreeKey& min_key, const OcTreeKey& max_key) const {
+    // the key of a node is its center, the first key of the upper half
+    unsigned int size = 1u << (tree_depth - depth);
+    for (unsigned int i = 0; i < 3; ++i){
+      unsigned int node_min = key[i] - (size >> 1);
+      if (node_min > max_key[i] || node_min + size - 1 < min_key[i])
+        return false;
+    }
+    return true;
+  }
+
+  template <class NODE,class I>
+  bool OcTreeBaseImpl<NODE,I>::regionToKeyBBX(const point3d& min, const point3d& max,
+                                              OcTreeKey& min_key, OcTreeKey& max_key) const {
+    const double key_limit = double(2 * tree_max_val - 1);
+    for (unsigned int i = 0; i < 3; ++i){
+      // clamp before the conversion to int, regions may extend far beyond the tree
+      double min_k = floor(resolution_factor * min(i)) + tree_max_val;
+      double max_k = floor(resolution_factor * max(i)) + tree_max_val;
+      if (max_k < 0.0 || min_k > key_limit || min_k > max_k)
+        return false;
+      min_key[i] = (key_type) std::max(min_k, 0.0);
+      max_key[i] = (key_type) std::min(max_k, key_limit);
+    }
+    return true;
+  }
+
+  template <class NODE,class I>
+  template <class REGION, class FUNCTOR>
+  void OcTreeBaseImpl<NODE,I>::forEachLeafInRegion(const REGION& region, FUNCTOR& functor,
+                                                   unsigned int max_depth) const {
+    if (root == NULL)
+      return;
+    if (max_depth == 0 || max_depth > tree_depth)
+      max_depth = tree_depth;
+
+    point3d bounds_min, bounds_max;
+    region.getBounds(bounds_min, bounds_max);
+    OcTreeKey min_key, max_key;
+    if (!regionToKeyBBX(bounds_min, bounds_max, min_key, max_key))
+      return;
+
+    // key intervals of the region at every depth: the node at depth d with center key k
+    // has the index k >> (tree_depth - d) along each axis
+    key_type min_index[3][16 + 1];
+    key_type max_index[3][16 + 1];
+    for (unsigned int i = 0; i < 3; ++i){
+      for (unsigned int d = 0; d <= tree_depth; ++d){
+        min_index[i][d] = min_key[i] >> (tree_depth - d);
+        max_index[i][d] = max_key[i] >> (tree_depth - d);
+      }
+    }
+    // children in the lower / upper half along x, y and z (see computeChildIdx())
+    static const unsigned int lower_children[3] = {0x55, 0x33, 0x0F};
+    static const unsigned int upper_children[3] = {0xAA, 0xCC, 0xF0};
+
+    // flags of the nodes on the stack, once set they hold for all descendants
+    const unsigned char IN_KEY_BBX = 1;  // no further key interval checks
+    const unsigned char IN_REGION = 2;   // no further classification
+
+    struct RegionElement {
+      NODE* node;
+      OcTreeKey key;
+      unsigned char depth;
+      unsigned char flags;
+    };
+    // depth first in the order of the iterators: at most 7 siblings per level wait on the stack
+    RegionElement stack[7 * 16 + 1];
+    unsigned int stack_size = 0;
+    stack[0].node = root;
+    stack[0].key = OcTreeKey(tree_max_val, tree_max_val, tree_max_val);
+    stack[0].depth = 0;
+    stack[0].flags = REGION::KEY_BOUNDS_EXACT ? IN_REGION : 0;
+    if (min_key == OcTreeKey(0, 0, 0) && max_key == OcTreeKey(2 * tree_max_val - 1, 2 * tree_max_val - 1, 2 * tree_max_val - 1))
+      stack[0].flags |= IN_KEY_BBX;
+    if (!REGION::KEY_BOUNDS_EXACT && !(stack[0].flags & IN_REGION)){
+      region::Overlap overlap = region.classify(point3d(0, 0, 0), getNodeSize(0) / 2.0);
+      if (overlap == region::OUTSIDE)
+        return;
+      if (overlap == region::INSIDE)
+        stack[0].flags |= IN_REGION;
+    }
+    ++stack_size;
+
+    while (stack_size > 0){
+      const RegionElement current = stack[--stack_size];
+      unsigned int child_mask = (current.depth < max_depth) ? nodeChildMask(current.node) : 0;
+      if (child_mask == 0){
+        functor(current.node, current.key, current.depth);
+        continue;
+      }
+
+      const unsigned int child_depth = current.depth + 1;
+      if (!(current.flags & IN_KEY_BBX)){
+        for (unsigned int i = 0; i < 3; ++i){
+          key_type lower_index = key_type((current.key[i] >> (tree_depth - current.depth)) << 1);
+          unsigned int axis_mask = 0;
+          if (lower_index >= min_index[i][child_depth])
+            axis_mask |= lower_children[i];
+          if (lower_index + 1 <= max_index[i][child_depth])
+            axis_mask |= upper_children[i];
+          child_mask &= axis_mask;
+        }
+      }
+
+      const key_type center_offset_key = tree_max_val >> child_depth;
+      const double child_half_size = getNodeSize(child_depth) / 2.0;
+      for (int pos = 7; pos >= 0; --pos){
+        if (!(child_mask & (1 << pos)))
+          continue;
+        RegionElement& child = stack[stack_size];
+        computeChildKey(pos, center_offset_key, current.key, child.key);
+        child.depth = (unsigned char) child_depth;
+        child.flags = current.flags;
+        if (!(child.flags & IN_KEY_BBX)){
+          // the keys covered by the child are [key - offset, key + offset - 1], offset >= 1 above the last level
+          key_type offset = std::max(center_offset_key, key_type(1));
+          if (child.key[0] - center_offset_key >= min_key[0] && child.key[0] + offset - 1 <= max_key[0]
+              && child.key[1] - center_offset_key >= min_key[1] && child.key[1] + offset - 1 <= max_key[1]
+              && child.key[2] - center_offset_key >= min_key[2] && child.key[2] + offset - 1 <= max_key[2])
+            child.flags |= IN_KEY_BBX;
+        }
+        if (!(child.flags & IN_REGION)){
+          region::Overlap overlap = region.classify(keyToCoord(child.key, child_depth), child_half_size);
+          if (overlap == region::OUTSIDE)
+            continue;
+          if (overlap == region::INSIDE)
+            child.flags |= IN_REGION;
+        }
+        child.node = getNodeChild(current.node, pos);
+        ++stack_size;
+      }
+    }
+  }
+
+  template <class NODE,class I>
+  template <class REGION>
+  size_t OcTreeBaseImpl<NODE,I>::getLeafsInRegion(const REGION& region, LeafBuffer<typename NODE::DataType>& leafs,
+                                                  unsigned int max_depth) const {
+    leafs.clear();
+    LeafBufferFunctor collect(this, leafs);
+    forEachLeafInRegion(region, collect, max_depth);
+    return leafs.numLeafs();
+  }
+
   template <class NODE,class I>
   void OcTreeBaseImpl<NODE,I>::calcMinMax() {
     if (!size_changed)
@@ -909,30 +1554,16 @@ namespace octomap {
       return;
     }
 
+    // extent of the leafs for each thread, combined afterwards
+    MinMaxFunctor extent(this);
+    this->parallelForEachLeaf(extent);
     for (unsigned i = 0; i< 3; i++){
       max_value[i] = -std::numeric_limits<double>::max();
       min_value[i] = std::numeric_limits<double>::max();
-    }
-
-    for(typename OcTreeBaseImpl<NODE,I>::leaf_iterator it = this->begin(),
-        end=this->end(); it!= end; ++it)
-    {
-      double size = it.getSize();
-      double halfSize = size/2.0;
-      double x = it.getX() - halfSize;
-      double y = it.getY() - halfSize;
-      double z = it.getZ() - halfSize;
-      if (x < min_value[0]) min_value[0] = x;
-      if (y < min_value[1]) min_value[1] = y;
-      if (z < min_value[2]) min_value[2] = z;
-
-      x += size;
-      y += size;
-      z += size;
-      if (x > max_value[0]) max_value[0] = x;
-      if (y > max_value[1]) max_value[1] = y;
-      if (z > max_value[2]) max_value[2] = z;
-
+      for (size_t t = 0; t < extent.min_values.size(); ++t){
+        if (extent.min_values[t].value[i] < min_value[i]) min_value[i] = extent.min_values[t].value[i];
+        if (extent.max_values[t].value[i] > max_value[i]) max_value[i] = extent.max_values[t].value[i];
+      }
     }
 
     size_changed = false;
@@ -1039,9 +1670,22 @@ namespace octomap {
   size_t OcTreeBaseImpl<NODE,I>::memoryUsage() const{
     size_t num_leaf_nodes = this->getNumLeafNodes();
     size_t num_inner_nodes = tree_size - num_leaf_nodes;
+    return memoryUsage(num_inner_nodes, ChildLayout());
+  }
+
+  template <class NODE,class I>
+  size_t OcTreeBaseImpl<NODE,I>::memoryUsage(size_t num_inner_nodes, ChildPointerLayout) const{
     return (sizeof(OcTreeBaseImpl<NODE,I>) + memoryUsageNode() * tree_size + num_inner_nodes * sizeof(NODE*[8]));
   }
 
+  template <class NODE,class I>
+  size_t OcTreeBaseImpl<NODE,I>::memoryUsage(size_t num_inner_nodes, ChildBlockLayout) const{
+    // all nodes except for the root live in the children blocks of their parents
+    if (root == NULL)
+      return sizeof(OcTreeBaseImpl<NODE,I>);
+    return (sizeof(OcTreeBaseImpl<NODE,I>) + memoryUsageNode() + num_inner_nodes * childrenStorageSize(ChildBlockLayout()));
+  }
+
   template <class NODE,class I>
   void OcTreeBaseImpl<NODE,I>::getUnknownLeafCenters(point3d_list& node_centers, point3d pmin, point3d pmax, unsigned int depth) const {
 
@@ -36,6 +36,7 @@
 
 
 #include "octomap_types.h"
+#include "BufferedIO.h"
 #include "assert.h"
 
 namespace octomap {
@@ -48,6 +49,15 @@ namespace octomap {
   // forward declaration for friend in OcTreeDataNode
   template<typename NODE,typename I> class OcTreeBaseImpl;
 
+  /// Child layout (see OcTreeDataNode::ChildLayout): "children" is an array of
+  /// 8 pointers to individually allocated child nodes (default)
+  struct ChildPointerLayout {};
+
+  /// Child layout (see OcTreeDataNode::ChildLayout): "children" points to one
+  /// contiguous block holding all 8 child nodes, existing children are marked
+  /// in a bitmask "child_mask" of the parent. See BlockOcTreeNode for an example.
+  struct ChildBlockLayout {};
+
   /**
    * Basic node in the OcTree that can hold arbitrary data of type T in value.
    * This is the base class for nodes used in an OcTree. The used implementation
@@ -78,7 +88,10 @@ namespace octomap {
     ~OcTreeDataNode();
 
     /// Copy the payload (data in "value") from rhs into this node
-    /// Opposed to copy ctor, this does not clone the children as well
+    /// Opposed to copy ctor, this does not clone the children as well.
+    /// Required for every node type: trees are copied node by node with
+    /// NODE::copyData(const NODE&), so derived nodes need to declare it (and
+    /// copy their additional data), otherwise copying the tree does not compile.
     void copyData(const OcTreeDataNode& from);
     
     /// Equals operator, compares if the stored value is identical
@@ -112,10 +125,24 @@ namespace octomap {
     /// Write node payload (data only) to binary stream
     std::ostream& writeData(std::ostream &s) const;
 
+    /// Read node payload from buffered binary stream, used by the tree for file IO.
+    /// Nodes with additional data should override it together with readData(std::istream&).
+    /// If they only override readData(std::istream&), the tree reads them through that (unbuffered).
+    BufferedReader& readData(BufferedReader &s);
+
+    /// Write node payload to buffered binary stream, used by the tree for file IO.
+    /// Nodes with additional data should override it together with writeData(std::ostream&).
+    /// If they only override writeData(std::ostream&), the tree writes them through that (unbuffered).
+    BufferedWriter& writeData(BufferedWriter &s) const;
+
 
     /// Make the templated data type available from the outside
     typedef T DataType;
 
+    /// Memory layout of the children, used by the tree to access them.
+    /// Derived nodes can change it by redefining ChildLayout.
+    typedef ChildPointerLayout ChildLayout;
+
 
   protected:
     void allocChildren();
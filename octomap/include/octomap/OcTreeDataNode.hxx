@@ -123,6 +123,18 @@ namespace octomap {
     return s;
   }
 
+  template <typename T>
+  BufferedReader& OcTreeDataNode<T>::readData(BufferedReader &s) {
+    s.read(value);
+    return s;
+  }
+
+  template <typename T>
+  BufferedWriter& OcTreeDataNode<T>::writeData(BufferedWriter &s) const{
+    s.write(value);
+    return s;
+  }
+
 
   // ============================================================
   // =  private methodes  =======================================
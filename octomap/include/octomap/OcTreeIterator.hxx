@@ -74,20 +74,20 @@
       iterator_base(const iterator_base& other)
       : tree(other.tree), maxDepth(other.maxDepth), stack(other.stack) {}
 
-      /// Comparison between iterators. First compares the tree, then stack size and top element of stack.
+      /// Comparison between iterators. First compares the tree (NULL for end iterators),
+      /// then stack size and top element of stack.
       bool operator==(const iterator_base& other) const {
-        return (tree ==other.tree && stack.size() == other.stack.size()
-            && (stack.size()==0 || (stack.size() > 0 && (stack.top().node == other.stack.top().node
+        if (tree != other.tree || stack.size() != other.stack.size())
+          return false;
+        return (stack.empty() || (stack.top().node == other.stack.top().node
                 && stack.top().depth == other.stack.top().depth
-                && stack.top().key == other.stack.top().key ))));
+                && stack.top().key == other.stack.top().key));
       }
 
-      /// Comparison between iterators. First compares the tree, then stack size and top element of stack.
+      /// Comparison between iterators. First compares the tree (NULL for end iterators),
+      /// then stack size and top element of stack.
       bool operator!=(const iterator_base& other) const {
-        return (tree !=other.tree || stack.size() != other.stack.size()
-            || (stack.size() > 0 && ((stack.top().node != other.stack.top().node
-                || stack.top().depth != other.stack.top().depth
-                || stack.top().key != other.stack.top().key ))));
+        return !(*this == other);
       }
 
       iterator_base& operator=(const iterator_base& other){
@@ -154,12 +154,46 @@
       };
 
 
+      /**
+       * Recursion stack of fixed capacity within the iterator, so that iterators
+       * are created and copied without allocation. Only the used part is copied.
+       */
+      class Stack {
+      public:
+        Stack() : num_elements(0) {}
+        Stack(const Stack& other) : num_elements(other.num_elements) {
+          std::copy(other.elements, other.elements + num_elements, elements);
+        }
+        Stack& operator=(const Stack& other){
+          num_elements = other.num_elements;
+          std::copy(other.elements, other.elements + num_elements, elements);
+          return *this;
+        }
+
+        bool empty() const { return num_elements == 0; }
+        size_t size() const { return num_elements; }
+        StackElement& top() { return elements[num_elements - 1]; }
+        const StackElement& top() const { return elements[num_elements - 1]; }
+        void push(const StackElement& element) {
+          assert(num_elements < CAPACITY);
+          elements[num_elements++] = element;
+        }
+        void pop() { --num_elements; }
+
+      private:
+        /// at most 7 siblings waiting per level (keys limit the depth to 16), the current
+        /// node and the root pushed twice by the leaf iterators on construction
+        static const unsigned int CAPACITY = 7 * 16 + 2;
+        StackElement elements[CAPACITY];
+        unsigned int num_elements;
+      };
+
     protected:
       OcTreeBaseImpl<NodeType,INTERFACE> const* tree; ///< Octree this iterator is working on
       uint8_t maxDepth; ///< Maximum depth for depth-limited queries
 
-      /// Internal recursion stack. Apparently a stack of vector works fastest here.
-      std::stack<StackElement,std::vector<StackElement> > stack;
+      /// Internal recursion stack
+      Stack stack;
       
       /// One step of depth-first tree traversal.
       /// How this is used depends on the actual iterator.
@@ -169,13 +203,25 @@
         if (top.depth == maxDepth)
           return;
 
+        pushChildren(top, tree->nodeChildMask(top.node));
+      }
+
+      /// Replaces the top of the stack by the children of its node in child_mask
+      void replaceByChildren(unsigned int child_mask){
+        StackElement top = stack.top();
+        stack.pop();
+        pushChildren(top, child_mask);
+      }
+
+      /// Pushes the children of top in child_mask on the stack
+      void pushChildren(const StackElement& top, unsigned int child_mask){
         StackElement s;
         s.depth = top.depth +1;
 
         key_type center_offset_key = tree->tree_max_val >> s.depth;
         // push on stack in reverse order
         for (int i=7; i>=0; --i) {
-          if (tree->nodeChildExists(top.node,i)) {
+          if (child_mask & (1 << i)) {
             computeChildKey(i, center_offset_key, top.key, s.key);
             s.node = tree->getNodeChild(top.node, i);
             //OCTOMAP_DEBUG_STR("Current depth: " << int(top.depth) << " new: "<< int(s.depth) << " child#" << i <<" ptr: "<<s.node);
@@ -298,11 +344,11 @@
               this->stack.pop();
 
               // skip forward to next leaf
-              while(!this->stack.empty()  
-                  && this->stack.top().depth < this->maxDepth
-                  && this->tree->nodeHasChildren(this->stack.top().node))
-              {
-                this->singleIncrement();
+              while(!this->stack.empty() && this->stack.top().depth < this->maxDepth){
+                unsigned int child_mask = this->tree->nodeChildMask(this->stack.top().node);
+                if (child_mask == 0)
+                  break;
+                this->replaceByChildren(child_mask);
               }
               // done: either stack is empty (== end iterator) or a next leaf node is reached!
               if (this->stack.empty())
@@ -412,11 +458,11 @@
           this->stack.pop();
 
           // skip forward to next leaf
-          while(!this->stack.empty()  
-              && this->stack.top().depth < this->maxDepth
-              && this->tree->nodeHasChildren(this->stack.top().node))
-          {
-            this->singleIncrement();
+          while(!this->stack.empty() && this->stack.top().depth < this->maxDepth){
+            unsigned int child_mask = this->tree->nodeChildMask(this->stack.top().node);
+            if (child_mask == 0)
+              break;
+            replaceByChildren(child_mask);
           }
           // done: either stack is empty (== end iterator) or a next leaf node is reached!
           if (this->stack.empty())
@@ -429,7 +475,8 @@
 
     protected:
 
-      void singleIncrement(){
+      /// Replaces the top of the stack by the children of its node in child_mask within the bbx
+      void replaceByChildren(unsigned int child_mask){
         typename iterator_base::StackElement top = this->stack.top();
         this->stack.pop();
 
@@ -438,7 +485,7 @@
         key_type center_offset_key = this->tree->tree_max_val >> s.depth;
         // push on stack in reverse order
         for (int i=7; i>=0; --i) {
-          if (this->tree->nodeChildExists(top.node, i)) {
+          if (child_mask & (1 << i)) {
             computeChildKey(i, center_offset_key, top.key, s.key);
 
             // overlap of query bbx and child bbx?
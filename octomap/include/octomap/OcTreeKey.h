@@ -40,6 +40,12 @@
 #include <ciso646>
 
 #include <assert.h>
+#include <stdint.h>
+#include <cstddef>
+#include <algorithm>
+#include <iterator>
+#include <utility>
+#include <vector>
 
 /* Libc++ does not implement the TR1 namespace, all c++11 related functionality
  * is instead implemented in the std namespace.
@@ -120,20 +126,373 @@ namespace octomap {
     
   };
   
+  /**
+   * Hashing of OcTreeKeys for the flat hash tables KeySet and KeyBoolMap:
+   * keys are packed into a 64 bit word (16 bit per axis) and spread over
+   * the table with a multiplicative (Fibonacci) hash. This keeps keys of
+   * axis-aligned structures apart, which collide a lot with OcTreeKey::KeyHash.
+   */
+  struct PackedKeyHash {
+    /// packed values >= 2^48 are no valid keys, used to mark free and deleted slots
+    static const uint64_t EMPTY = ~uint64_t(0);
+    static const uint64_t DELETED = ~uint64_t(0) - 1;
+
+    static inline uint64_t pack(const OcTreeKey& key){
+      return uint64_t(key.k[0]) | (uint64_t(key.k[1]) << 16) | (uint64_t(key.k[2]) << 32);
+    }
+
+    static inline OcTreeKey unpack(uint64_t packed){
+      return OcTreeKey(key_type(packed), key_type(packed >> 16), key_type(packed >> 32));
+    }
+
+    /// @return slot index for a table with 2^(64-shift) slots
+    static inline size_t index(uint64_t packed, unsigned int shift){
+      return size_t(((packed ^ (packed >> 29)) * uint64_t(0x9E3779B97F4A7C15ULL)) >> shift);
+    }
+  };
+
+  /**
+   * Flat hash table (open addressing with linear probing) of packed
+   * OcTreeKeys, the common part of KeySet and KeyBoolMap. Erased keys
+   * are marked as deleted, so erasing never moves other entries.
+   * Inserting can rehash, which invalidates all iterators.
+   */
+  class PackedKeyTable {
+  public:
+    PackedKeyTable() : num_keys(0), num_deleted(0), shift(64) {}
+
+    size_t size() const { return num_keys; }
+    bool empty() const { return num_keys == 0; }
+    /// number of slots
+    size_t capacity() const { return slots.size(); }
+
+  protected:
+    /// @return slot of key, or capacity() if not contained
+    size_t findSlot(uint64_t packed) const {
+      if (slots.empty())
+        return 0;
+      const size_t mask = slots.size() - 1;
+      for (size_t i = PackedKeyHash::index(packed, shift); ; i = (i + 1) & mask){
+        if (slots[i] == packed)
+          return i;
+        if (slots[i] == PackedKeyHash::EMPTY)
+          return slots.size();
+      }
+    }
+
+    /**
+     * Looks up key and reserves a slot for it if not contained. Needs to
+     * be preceded by a call to prepareInsert().
+     * @return slot of the key and whether it was newly inserted
+     */
+    std::pair<size_t, bool> insertSlot(uint64_t packed) {
+      const size_t mask = slots.size() - 1;
+      size_t free_slot = slots.size();
+      for (size_t i = PackedKeyHash::index(packed, shift); ; i = (i + 1) & mask){
+        if (slots[i] == packed)
+          return std::make_pair(i, false);
+        if (slots[i] == PackedKeyHash::DELETED){
+          if (free_slot == slots.size())
+            free_slot = i;
+        } else if (slots[i] == PackedKeyHash::EMPTY){
+          if (free_slot == slots.size())
+            free_slot = i;
+          else
+            --num_deleted; // reusing a deleted slot
+          slots[free_slot] = packed;
+          ++num_keys;
+          return std::make_pair(free_slot, true);
+        }
+      }
+    }
+
+    void eraseSlot(size_t i){
+      slots[i] = PackedKeyHash::DELETED;
+      --num_keys;
+      ++num_deleted;
+    }
+
+    /// @return true if the slots need to be rehashed before one more key can be inserted
+    bool needsRehash() const {
+      // max. load factor 1/2 (incl. deleted slots)
+      return 2 * (num_keys + num_deleted + 1) > slots.size();
+    }
+
+    /// @return number of slots for n keys (power of two)
+    static size_t slotsFor(size_t n){
+      size_t num_slots = 16;
+      while (num_slots < 2 * (n + 1))
+        num_slots *= 2;
+      return num_slots;
+    }
+
+    /// replaces all slots by num_slots empty ones, returns the old ones in old_slots
+    void resetSlots(size_t num_slots, std::vector<uint64_t>& old_slots){
+      old_slots.swap(slots);
+      slots.assign(num_slots, uint64_t(PackedKeyHash::EMPTY));
+      num_keys = 0;
+      num_deleted = 0;
+      shift = 64;
+      for (size_t n = num_slots; n > 1; n /= 2)
+        --shift;
+    }
+
+    void swapTable(PackedKeyTable& other){
+      slots.swap(other.slots);
+      std::swap(num_keys, other.num_keys);
+      std::swap(num_deleted, other.num_deleted);
+      std::swap(shift, other.shift);
+    }
+
+    /// @return index of the first used slot at or after i
+    size_t nextUsed(size_t i) const {
+      while (i < slots.size() && slots[i] >= PackedKeyHash::DELETED)
+        ++i;
+      return i;
+    }
+
+    std::vector<uint64_t> slots;
+    size_t num_keys;
+    size_t num_deleted;
+    unsigned int shift; ///< 64 - log2(number of slots)
+  };
+
   /**
    * Data structure to efficiently compute the nodes to update from a scan
-   * insertion using a hash set.
-   * @note you need to use boost::unordered_set instead if your compiler does not
-   * yet support tr1!
+   * insertion using a hash set. Flat hash set (see PackedKeyTable) with
+   * the interface of a (const) unordered_set<OcTreeKey>.
    */
-  typedef unordered_ns::unordered_set<OcTreeKey, OcTreeKey::KeyHash> KeySet;
+  class KeySet : public PackedKeyTable {
+  public:
+    typedef OcTreeKey value_type;
+    typedef size_t size_type;
+
+    /// Iterates over all keys, in no particular order.
+    class const_iterator {
+    public:
+      typedef std::forward_iterator_tag iterator_category;
+      typedef OcTreeKey value_type;
+      typedef std::ptrdiff_t difference_type;
+      typedef const OcTreeKey* pointer;
+      typedef const OcTreeKey& reference;
+
+      const_iterator() : set(NULL), i(0) {}
+      const_iterator(const KeySet* set, size_t i) : set(set), i(i) {}
+
+      const OcTreeKey& operator*() const { return set->keys[i]; }
+      const OcTreeKey* operator->() const { return &(set->keys[i]); }
+      const_iterator& operator++() { i = set->nextUsed(i + 1); return *this; }
+      const_iterator operator++(int) { const_iterator result = *this; ++(*this); return result; }
+      bool operator==(const const_iterator& other) const { return i == other.i; }
+      bool operator!=(const const_iterator& other) const { return i != other.i; }
+
+    private:
+      friend class KeySet;
+      const KeySet* set;
+      size_t i;
+    };
+    typedef const_iterator iterator;
+
+    KeySet() {}
+
+    const_iterator begin() const { return const_iterator(this, nextUsed(0)); }
+    const_iterator end() const { return const_iterator(this, slots.size()); }
+
+    const_iterator find(const OcTreeKey& key) const {
+      return const_iterator(this, findSlot(PackedKeyHash::pack(key)));
+    }
+
+    size_t count(const OcTreeKey& key) const {
+      return (findSlot(PackedKeyHash::pack(key)) < slots.size()) ? 1 : 0;
+    }
+
+    std::pair<iterator, bool> insert(const OcTreeKey& key){
+      if (needsRehash())
+        rehash(num_keys + 1);
+      std::pair<size_t, bool> result = insertSlot(PackedKeyHash::pack(key));
+      if (result.second)
+        keys[result.first] = key;
+      return std::make_pair(const_iterator(this, result.first), result.second);
+    }
+
+    template <class InputIterator>
+    void insert(InputIterator first, InputIterator last){
+      for (; first != last; ++first)
+        insert(*first);
+    }
+
+    /// @return iterator to the key after the erased one
+    iterator erase(const_iterator it){
+      eraseSlot(it.i);
+      return const_iterator(this, nextUsed(it.i + 1));
+    }
+
+    size_t erase(const OcTreeKey& key){
+      size_t i = findSlot(PackedKeyHash::pack(key));
+      if (i >= slots.size())
+        return 0;
+      eraseSlot(i);
+      return 1;
+    }
+
+    void clear(){
+      std::vector<uint64_t> old_slots;
+      resetSlots(0, old_slots);
+      shift = 64;
+      keys.clear();
+    }
+
+    /// Prepares the set for n keys without rehashing
+    void reserve(size_t n){
+      if (2 * (n + num_deleted + 1) > slots.size())
+        rehash(n);
+    }
+
+    void swap(KeySet& other){
+      swapTable(other);
+      keys.swap(other.keys);
+    }
+
+  protected:
+    void rehash(size_t n){
+      std::vector<uint64_t> old_slots;
+      std::vector<OcTreeKey> old_keys;
+      old_keys.swap(keys);
+      resetSlots(slotsFor(std::max(n, num_keys)), old_slots);
+      keys.resize(slots.size());
+      for (size_t i = 0; i < old_slots.size(); ++i){
+        if (old_slots[i] < PackedKeyHash::DELETED)
+          keys[insertSlot(old_slots[i]).first] = old_keys[i];
+      }
+    }
+
+    /// key of each slot (unpacked, so iterators can return references), valid for used slots
+    std::vector<OcTreeKey> keys;
+  };
+
+  /**
+   * Flat hash map from OcTreeKeys to values of type T (see PackedKeyTable),
+   * with the interface of an unordered_map<OcTreeKey, T>.
+   */
+  template <typename T>
+  class KeyMap : public PackedKeyTable {
+  public:
+    typedef std::pair<OcTreeKey, T> value_type;
+    typedef T mapped_type;
+    typedef size_t size_type;
+
+    /// Iterates over all (key, value) pairs, in no particular order.
+    template <class MAP, class VALUE>
+    class iterator_base {
+    public:
+      typedef std::forward_iterator_tag iterator_category;
+      typedef VALUE value_type;
+      typedef std::ptrdiff_t difference_type;
+      typedef VALUE* pointer;
+      typedef VALUE& reference;
+
+      iterator_base() : map(NULL), i(0) {}
+      iterator_base(MAP* map, size_t i) : map(map), i(i) {}
+      /// conversion of iterator to const_iterator
+      template <class OTHER_MAP, class OTHER_VALUE>
+      iterator_base(const iterator_base<OTHER_MAP, OTHER_VALUE>& other) : map(other.map), i(other.i) {}
+
+      VALUE& operator*() const { return map->entries[i]; }
+      VALUE* operator->() const { return &(map->entries[i]); }
+      iterator_base& operator++() { i = map->nextUsed(i + 1); return *this; }
+      iterator_base operator++(int) { iterator_base result = *this; ++(*this); return result; }
+      bool operator==(const iterator_base& other) const { return i == other.i; }
+      bool operator!=(const iterator_base& other) const { return i != other.i; }
+
+      MAP* map;
+      size_t i;
+    };
+    typedef iterator_base<KeyMap<T>, value_type> iterator;
+    typedef iterator_base<const KeyMap<T>, const value_type> const_iterator;
+
+    KeyMap() {}
+
+    iterator begin() { return iterator(this, nextUsed(0)); }
+    iterator end() { return iterator(this, slots.size()); }
+    const_iterator begin() const { return const_iterator(this, nextUsed(0)); }
+    const_iterator end() const { return const_iterator(this, slots.size()); }
+
+    iterator find(const OcTreeKey& key) { return iterator(this, findSlot(PackedKeyHash::pack(key))); }
+    const_iterator find(const OcTreeKey& key) const { return const_iterator(this, findSlot(PackedKeyHash::pack(key))); }
+
+    size_t count(const OcTreeKey& key) const {
+      return (findSlot(PackedKeyHash::pack(key)) < slots.size()) ? 1 : 0;
+    }
+
+    /// Inserts value if its key is not contained yet (existing values are not changed)
+    std::pair<iterator, bool> insert(const value_type& value){
+      if (needsRehash())
+        rehash(num_keys + 1);
+      std::pair<size_t, bool> result = insertSlot(PackedKeyHash::pack(value.first));
+      if (result.second)
+        entries[result.first] = value;
+      return std::make_pair(iterator(this, result.first), result.second);
+    }
+
+    T& operator[](const OcTreeKey& key){
+      return insert(value_type(key, T())).first->second;
+    }
+
+    /// @return iterator to the entry after the erased one
+    iterator erase(iterator it){
+      eraseSlot(it.i);
+      return iterator(this, nextUsed(it.i + 1));
+    }
+
+    size_t erase(const OcTreeKey& key){
+      size_t i = findSlot(PackedKeyHash::pack(key));
+      if (i >= slots.size())
+        return 0;
+      eraseSlot(i);
+      return 1;
+    }
+
+    void clear(){
+      std::vector<uint64_t> old_slots;
+      resetSlots(0, old_slots);
+      shift = 64;
+      entries.clear();
+    }
+
+    /// Prepares the map for n entries without rehashing
+    void reserve(size_t n){
+      if (2 * (n + num_deleted + 1) > slots.size())
+        rehash(n);
+    }
+
+    void swap(KeyMap<T>& other){
+      swapTable(other);
+      entries.swap(other.entries);
+    }
+
+  protected:
+    void rehash(size_t n){
+      std::vector<uint64_t> old_slots;
+      std::vector<value_type> old_entries;
+      old_entries.swap(entries);
+      resetSlots(slotsFor(std::max(n, num_keys)), old_slots);
+      entries.resize(slots.size());
+      for (size_t i = 0; i < old_slots.size(); ++i){
+        if (old_slots[i] < PackedKeyHash::DELETED)
+          entries[insertSlot(old_slots[i]).first] = old_entries[i];
+      }
+    }
+
+    /// (key, value) of each slot, valid for used slots
+    std::vector<value_type> entries;
+  };
 
   /**
    * Data structrure to efficiently track changed nodes as a combination of
    * OcTreeKeys and a bool flag (to denote newly created nodes)
    *
    */
-  typedef unordered_ns::unordered_map<OcTreeKey, bool, OcTreeKey::KeyHash> KeyBoolMap;
+  typedef KeyMap<bool> KeyBoolMap;
 
 
   class KeyRay {
@@ -58,6 +58,10 @@ namespace octomap {
     OcTreeNode();
     ~OcTreeNode();
 
+    void copyData(const OcTreeNode& from){
+      OcTreeDataNode<float>::copyData(from);
+    }
+
     
     // -- node occupancy  ----------------------------
 
@@ -0,0 +1,241 @@
+/*
+ * OctoMap - An Efficient Probabilistic 3D Mapping Framework Based on Octrees
+ * http://octomap.github.com/
+ *
+ * Copyright (c) 2009-2013, K.M. Wurm and A. Hornung, University of Freiburg
+ * All rights reserved.
+ * License: New BSD
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the University of Freiburg nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef OCTOMAP_OCTREE_REGION_H
+#define OCTOMAP_OCTREE_REGION_H
+
+#include <cmath>
+#include <vector>
+
+#include "octomap_types.h"
+
+namespace octomap {
+
+  /**
+   * Regions for OcTreeBaseImpl::forEachLeafInRegion() / getLeafsInRegion().
+   *
+   * A region provides its axis-aligned bounds, which are converted into key
+   * intervals per tree depth once per query, and classifies axis-aligned cubes
+   * (nodes, given by center and half size) against its volume. Nodes touching
+   * the region count as overlapping.
+   */
+  namespace region {
+    enum Overlap { OUTSIDE = 0, PARTIAL = 1, INSIDE = 2 };
+  }
+
+  /**
+   * Axis-aligned box [min, max]. As for leaf_bbx_iterator, the corners are
+   * converted into keys, so all leafs overlapping the voxels of the corners are
+   * included. The key intervals are exact, classify() is never needed in queries.
+   */
+  class RegionAABB {
+  public:
+    static const bool KEY_BOUNDS_EXACT = true;
+
+    RegionAABB(const point3d& min, const point3d& max) : min(min), max(max) {}
+
+    void getBounds(point3d& bounds_min, point3d& bounds_max) const {
+      bounds_min = min;
+      bounds_max = max;
+    }
+
+    region::Overlap classify(const point3d& center, double half_size) const {
+      bool inside = true;
+      for (unsigned int i = 0; i < 3; ++i){
+        if (center(i) - half_size > max(i) || center(i) + half_size < min(i))
+          return region::OUTSIDE;
+        if (center(i) - half_size < min(i) || center(i) + half_size > max(i))
+          inside = false;
+      }
+      return inside ? region::INSIDE : region::PARTIAL;
+    }
+
+    point3d min;
+    point3d max;
+  };
+
+  /// Sphere with center and radius
+  class RegionSphere {
+  public:
+    static const bool KEY_BOUNDS_EXACT = false;
+
+    RegionSphere(const point3d& center, double radius) : center(center), radius(radius) {}
+
+    void getBounds(point3d& bounds_min, point3d& bounds_max) const {
+      point3d r((float) radius, (float) radius, (float) radius);
+      bounds_min = center - r;
+      bounds_max = center + r;
+    }
+
+    region::Overlap classify(const point3d& node_center, double half_size) const {
+      // squared distances to the closest and the farthest point of the cube
+      double dist_min = 0.0, dist_max = 0.0;
+      for (unsigned int i = 0; i < 3; ++i){
+        double d = std::fabs(double(node_center(i)) - double(center(i)));
+        if (d > half_size)
+          dist_min += (d - half_size) * (d - half_size);
+        dist_max += (d + half_size) * (d + half_size);
+      }
+      double radius_sq = radius * radius;
+      if (dist_min > radius_sq)
+        return region::OUTSIDE;
+      return (dist_max <= radius_sq) ? region::INSIDE : region::PARTIAL;
+    }
+
+    point3d center;
+    double radius;
+  };
+
+  /**
+   * Oriented box with center, half extents along its own axes and the rotation
+   * of these axes into the tree frame. Overlap with nodes is tested exactly
+   * with the separating axis theorem.
+   */
+  class RegionOBB {
+  public:
+    static const bool KEY_BOUNDS_EXACT = false;
+
+    RegionOBB(const point3d& center, const point3d& half_extents, const octomath::Quaternion& rotation)
+      : center(center), half_extents(half_extents)
+    {
+      for (unsigned int j = 0; j < 3; ++j){
+        point3d unit(0, 0, 0);
+        unit(j) = 1.0f;
+        point3d rotated = rotation.rotate(unit);
+        for (unsigned int i = 0; i < 3; ++i){
+          axes[j][i] = rotated(i);
+          // epsilon avoids false separation on (near) parallel edges
+          abs_axes[j][i] = std::fabs(axes[j][i]) + 1e-9;
+        }
+      }
+    }
+
+    void getBounds(point3d& bounds_min, point3d& bounds_max) const {
+      for (unsigned int i = 0; i < 3; ++i){
+        double extent = 0.0;
+        for (unsigned int j = 0; j < 3; ++j)
+          extent += half_extents(j) * std::fabs(axes[j][i]);
+        bounds_min(i) = (float) (center(i) - extent);
+        bounds_max(i) = (float) (center(i) + extent);
+      }
+    }
+
+    region::Overlap classify(const point3d& node_center, double half_size) const {
+      double t[3];    // offset of the node in the tree frame
+      double t_obb[3]; // and along the box axes
+      for (unsigned int i = 0; i < 3; ++i)
+        t[i] = double(node_center(i)) - double(center(i));
+      for (unsigned int j = 0; j < 3; ++j)
+        t_obb[j] = axes[j][0] * t[0] + axes[j][1] * t[1] + axes[j][2] * t[2];
+
+      // tree axes
+      for (unsigned int i = 0; i < 3; ++i){
+        double r = half_extents(0) * abs_axes[0][i] + half_extents(1) * abs_axes[1][i] + half_extents(2) * abs_axes[2][i];
+        if (std::fabs(t[i]) > half_size + r)
+          return region::OUTSIDE;
+      }
+
+      // box axes, the node is inside if its projections on all of them are
+      bool inside = true;
+      for (unsigned int j = 0; j < 3; ++j){
+        double r = half_size * (abs_axes[j][0] + abs_axes[j][1] + abs_axes[j][2]);
+        if (std::fabs(t_obb[j]) > half_extents(j) + r)
+          return region::OUTSIDE;
+        if (std::fabs(t_obb[j]) + r > half_extents(j))
+          inside = false;
+      }
+      if (inside)
+        return region::INSIDE;
+
+      // cross products of tree axis i and box axis j
+      for (unsigned int i = 0; i < 3; ++i){
+        unsigned int i1 = (i + 1) % 3, i2 = (i + 2) % 3;
+        for (unsigned int j = 0; j < 3; ++j){
+          unsigned int j1 = (j + 1) % 3, j2 = (j + 2) % 3;
+          double r_node = half_size * (abs_axes[j][i1] + abs_axes[j][i2]);
+          double r_box = half_extents(j1) * abs_axes[j2][i] + half_extents(j2) * abs_axes[j1][i];
+          if (std::fabs(t[i2] * axes[j][i1] - t[i1] * axes[j][i2]) > r_node + r_box)
+            return region::OUTSIDE;
+        }
+      }
+      return region::PARTIAL;
+    }
+
+    point3d center;
+    point3d half_extents;
+    double axes[3][3];     ///< box axes (rows) in the tree frame
+    double abs_axes[3][3];
+  };
+
+  /**
+   * Result of OcTreeBaseImpl::getLeafsInRegion() as structure of arrays:
+   * center coordinates, node size and value of each leaf. Clearing keeps the
+   * allocated memory, so a buffer reserved once can be reused for many queries.
+   */
+  template <typename T>
+  class LeafBuffer {
+  public:
+    LeafBuffer() {}
+    explicit LeafBuffer(size_t capacity) { reserve(capacity); }
+
+    void reserve(size_t capacity){
+      x.reserve(capacity); y.reserve(capacity); z.reserve(capacity);
+      size.reserve(capacity); value.reserve(capacity);
+    }
+
+    void clear(){
+      x.clear(); y.clear(); z.clear();
+      size.clear(); value.clear();
+    }
+
+    void push_back(const point3d& center, float node_size, const T& node_value){
+      x.push_back(center.x()); y.push_back(center.y()); z.push_back(center.z());
+      size.push_back(node_size);
+      value.push_back(node_value);
+    }
+
+    size_t numLeafs() const { return x.size(); }
+    size_t capacity() const { return x.capacity(); }
+    bool empty() const { return x.empty(); }
+    point3d getCenter(size_t i) const { return point3d(x[i], y[i], z[i]); }
+
+    std::vector<float> x;
+    std::vector<float> y;
+    std::vector<float> z;
+    std::vector<float> size;
+    std::vector<T> value;
+  };
+
+} // namespace
+
+#endif
@@ -47,6 +47,52 @@
 
 namespace octomap {
 
+  /// Options for OccupancyOcTreeBase::castRays()
+  struct CastRayOptions {
+    CastRayOptions() : ignore_unknown(false), max_range(-1.0), packet_size(64) {}
+
+    bool ignore_unknown;        ///< see castRay()
+    double max_range;           ///< see castRay() (<= 0: no limit)
+    unsigned int packet_size;   ///< consecutive rays traced by one thread, sharing node lookups
+  };
+
+  /**
+   * Results of OccupancyOcTreeBase::castRays(), one entry per ray in each array.
+   * Rays with an origin outside of the tree end at their origin (hit false, distance 0).
+   */
+  struct CastRayResults {
+    std::vector<char> hits;         ///< whether an occupied cell was hit (return value of castRay())
+    std::vector<point3d> ends;      ///< center of the last cell on the ray (end of castRay())
+    std::vector<OcTreeKey> keys;    ///< key of the last cell on the ray
+    std::vector<float> distances;   ///< distance from the origin to the end point
+
+    void resize(size_t num_rays){
+      hits.resize(num_rays);
+      ends.resize(num_rays);
+      keys.resize(num_rays);
+      distances.resize(num_rays);
+    }
+  };
+
+  /**
+   * Results of OccupancyOcTreeBase::getNearestOccupied() and getOccupiedInRadius(),
+   * one entry per occupied leaf in each array, sorted by increasing distance.
+   */
+  struct NearestOccupiedResults {
+    std::vector<OcTreeKey> keys;        ///< key of the leaf
+    std::vector<unsigned int> depths;   ///< depth of the leaf (less than the tree depth for pruned leafs)
+    std::vector<point3d> centers;       ///< center of the leaf
+    std::vector<float> distances;       ///< distance from the query point to the leaf's volume (0 inside)
+
+    void clear(){
+      keys.clear();
+      depths.clear();
+      centers.clear();
+      distances.clear();
+    }
+    size_t size() const { return keys.size(); }
+  };
+
   /**
    * Base implementation for Occupancy Octrees (e.g. for mapping).
    * AbstractOccupancyOcTree serves as a common
@@ -76,6 +122,12 @@ namespace octomap {
     /// Copy constructor
     OccupancyOcTreeBase(const OccupancyOcTreeBase<NODE>& rhs);
 
+    /// Deletes the complete tree structure and the tracked dirty nodes
+    void clear();
+
+    /// Swaps the tree structures with the tracked dirty nodes, see OcTreeBaseImpl::swapContent()
+    void swapContent(OccupancyOcTreeBase<NODE>& rhs);
+
     /**
     * Integrate a Pointcloud (in global reference frame), parallelized with OpenMP.
     * Special care is taken that each voxel
@@ -258,6 +310,19 @@ namespace octomap {
      */
     virtual NODE* updateNode(double x, double y, double z, bool occupied, bool lazy_eval = false);
 
+    /**
+     * Manipulate the log_odds values of many voxels at once, with the same result
+     * as calling updateNode(key, log_odds_update, lazy_eval) for all entries in order.
+     * The updates are sorted in Morton (Z-) order and applied in a single depth-first
+     * traversal, inner nodes are updated (or pruned) once after all their children.
+     * Much faster than single updates for batches of nearby keys, e.g. along rays.
+     *
+     * @param updates pairs of OcTreeKey (at the lowest octree level) and log_odds update
+     * @param lazy_eval whether update of inner nodes is omitted after the update (default: false).
+     *   This speeds up the insertion, but you need to call updateInnerOccupancy() when done.
+     */
+    void updateNodes(const std::vector<std::pair<OcTreeKey, float> >& updates, bool lazy_eval = false);
+
 
     /**
      * Creates the maximum likelihood map by calling toMaxLikelihood on all
@@ -302,6 +367,57 @@ namespace octomap {
     virtual bool castRay(const point3d& origin, const point3d& direction, point3d& end,
                  bool ignoreUnknownCells=false, double maxRange=-1.0) const;
 
+    /**
+     * Casts many rays, with the same results as castRay() for each. The rays are split
+     * into packets of consecutive rays, which are distributed over the threads
+     * (see setNumThreads()). Rays of a packet share their search path, so lookups of
+     * coherent rays (e.g. neighboring beams of a sensor) start deep in the tree.
+     *
+     * @param[in] origins starting coordinate of each ray (or a single origin for all rays)
+     * @param[in] directions direction of each ray, does not need to be normalized
+     * @param[out] results hit flags, end points, end keys and distances of the rays
+     * @param[in] options unknown cells, maximum range and packet size, see CastRayOptions
+     */
+    void castRays(const std::vector<point3d>& origins, const std::vector<point3d>& directions,
+                  CastRayResults& results, const CastRayOptions& options = CastRayOptions()) const;
+
+    /**
+     * Searches the k occupied leafs closest to a point, best-first: nodes are visited in the
+     * order of their distance to the point. Inner nodes hold the maximum occupancy of their
+     * children, so subtrees with a free inner node contain no occupied leaf and are skipped
+     * (after lazy updates, call updateInnerOccupancy() first).
+     *
+     * @param[in] query point to search from, may be outside of the map
+     * @param[in] k maximum number of leafs to return
+     * @param[out] results cleared and filled with the keys, depths, centers and distances of
+     *   the leafs, sorted by increasing distance. Distances are measured to the closest point
+     *   of a leaf's volume (0 if the query is inside).
+     * @param[in] max_distance maximum distance of the leafs (<= 0: no limit, default)
+     * @param[in] max_depth depth of the leafs to search (0: tree depth, default)
+     * @return number of leafs found
+     */
+    size_t getNearestOccupied(const point3d& query, unsigned int k, NearestOccupiedResults& results,
+                              double max_distance = -1.0, unsigned int max_depth = 0) const;
+
+    /**
+     * Searches all occupied leafs within radius of a point, sorted by increasing distance.
+     * See getNearestOccupied().
+     * @return number of leafs found
+     */
+    size_t getOccupiedInRadius(const point3d& query, double radius, NearestOccupiedResults& results,
+                               unsigned int max_depth = 0) const;
+
+    /**
+     * Distance from a point to the closest occupied leaf (distance to obstacles),
+     * see getNearestOccupied().
+     *
+     * @param[in] query point to search from
+     * @param[out] closest center of the closest occupied leaf, if one was found
+     * @param[in] max_distance maximum distance of the search (<= 0: no limit, default)
+     * @return distance to the closest point of the leaf, -1 if there is no occupied leaf (within max_distance)
+     */
+    double getDistanceToNearestOccupied(const point3d& query, point3d& closest, double max_distance = -1.0) const;
+
     /**
      * Retrieves the entry point of a ray into a voxel. This is the closest intersection point of the ray
      * originating from origin and a plane of the axis aligned cube.
@@ -368,6 +484,32 @@ namespace octomap {
     /// Number of changes since last reset.
     size_t numChangesDetected() const { return changed_keys.size(); }
 
+    /**
+     * Writes the current log-odds of all changed nodes (see changedKeysBegin()) as a compact
+     * delta to synchronize a copy of the tree with applyDelta(), e.g. after every scan.
+     * Keys are sorted in Morton order and delta encoded as variable length integers,
+     * clamped values and deleted nodes need no value. Only the changes tracked by change
+     * detection are contained (new nodes and occupancy flips), call resetChangeDetection()
+     * after the delta was written.
+     *
+     * Format: "OTDL", version (uint8), resolution (double), number of entries (varint), per
+     * entry varint((Morton code - previous code) << 2 | tag) with tag 0: log-odds (float)
+     * follows, 1: node deleted, 2: clamped free, 3: clamped occupied.
+     *
+     * @return success of writing to the stream
+     */
+    bool writeDelta(std::ostream& s) const;
+
+    /**
+     * Applies a delta written by writeDelta() of a tree with the same resolution: changed
+     * nodes are set to their new log-odds (clamped values to the thresholds of this tree),
+     * deleted nodes are deleted. The inner nodes above the changes are updated and pruned.
+     *
+     * @return false on a wrong format, resolution or truncated delta (entries read so far
+     *   are applied)
+     */
+    bool applyDelta(std::istream& s);
+
 
     /**
      * Helper for insertPointCloud(). Computes all octree nodes affected by the point cloud
@@ -413,6 +555,15 @@ namespace octomap {
      */
     std::istream& readBinaryData(std::istream &s);
 
+    /**
+     * Reads the data like readBinaryData(s), using the sizes of the subtrees below
+     * subtree_depth from the file header (see getBinarySubtreeSizes()): the levels
+     * above are read from the stream with the raw data of all subtrees, which are
+     * then decoded in parallel (see setNumThreads()).
+     */
+    std::istream& readBinaryData(std::istream &s, unsigned int subtree_depth,
+                                 const std::vector<uint64_t>& subtree_sizes);
+
     /**
      * Read node from binary stream (max-likelihood value), recursively
      * continue with all children.
@@ -435,12 +586,48 @@ namespace octomap {
      */
     std::ostream& writeBinaryNode(std::ostream &s, const NODE* node) const;
 
+    /// readBinaryNode() from a buffered stream, used by readBinaryData()
+    BufferedReader& readBinaryNode(BufferedReader &s, NODE* node);
+
+    /// writeBinaryNode() to a buffered stream, used by writeBinaryData()
+    BufferedWriter& writeBinaryNode(BufferedWriter &s, const NODE* node) const;
+
     /**
      * Writes the data of the tree (without header) to the stream, recursively
      * calling writeBinaryNode (starting with root)
      */
     std::ostream& writeBinaryData(std::ostream &s) const;
 
+    /**
+     * Computes the sizes of the binary data (2 bytes per inner node) of the subtrees
+     * below all inner nodes at subtree_depth, in the order of writeBinaryData()
+     */
+    void getBinarySubtreeSizes(unsigned int subtree_depth, std::vector<uint64_t>& subtree_sizes) const;
+
+    /**
+     * Encodes the maximum likelihood tree in the bounding box [bbx_min, bbx_max] like
+     * writeBinaryData(): nodes crossing the bounding box are split, nodes outside are
+     * unknown, equal leafs are pruned. Used by writeBinary() with a bounding box.
+     */
+    bool getBinaryDataBBX(const point3d& bbx_min, const point3d& bbx_max,
+                          std::vector<char>& data, size_t& num_nodes) const;
+
+    /**
+     * Encodes the maximum likelihood subtree of the node at depth containing key
+     * like writeBinaryData(), used by writeSubtree()
+     */
+    bool getBinarySubtreeData(const OcTreeKey& key, unsigned int depth,
+                              std::vector<char>& data, size_t& num_nodes) const;
+
+    /**
+     * Grafts the binary data of a subtree (see getBinarySubtreeData()) at the node at depth
+     * containing key, which is created if necessary. Known nodes of the subtree replace the
+     * tree's nodes, unknown ones keep them. The occupancy of the node and all nodes above is
+     * updated. Used by readSubtree().
+     */
+    bool readBinarySubtreeData(std::istream &s, const OcTreeKey& key, unsigned int depth,
+                               size_t& num_nodes);
+
 
     /**
      * Updates the occupancy of all inner nodes to reflect their children's occupancy.
@@ -449,6 +636,28 @@ namespace octomap {
      **/
     void updateInnerOccupancy();
 
+    /**
+     * Updates the occupancy of the inner nodes above all leaves that were modified with
+     * lazy evaluation (updateNode(), setNodeValue(), updateNodes(), insertPointCloud())
+     * since the last call of this function or updateInnerOccupancy(). Only these subtrees
+     * are visited, which is much faster than updateInnerOccupancy() for local changes in
+     * a large map. Nodes modified directly (e.g. with setLogOdds()) are not tracked, call
+     * updateInnerOccupancy() in that case.
+     *
+     * The modified leaves are only tracked after enableDirtyTracking(), otherwise
+     * all inner nodes are updated as with updateInnerOccupancy().
+     *
+     * @param prune whether the updated inner nodes are also pruned (as with prune())
+     */
+    void updateDirtyInnerOccupancy(bool prune = false);
+
+    /// track leaves modified with lazy evaluation for updateDirtyInnerOccupancy() (default: off)
+    void enableDirtyTracking(bool enable) { use_dirty_tracking = enable; if (!enable) dirty_keys.clear(); }
+    bool isDirtyTrackingEnabled() const { return use_dirty_tracking; }
+
+    /// number of tracked inner nodes (parents of leaves) that need an update, see updateDirtyInnerOccupancy()
+    size_t numDirtyNodes() const { return dirty_keys.size(); }
+
 
     /// integrate a "hit" measurement according to the tree's sensor model
     virtual void integrateHit(NODE* occupancyNode) const;
@@ -473,6 +682,16 @@ namespace octomap {
      */
     inline bool integrateMissOnRay(const point3d& origin, const point3d& end, bool lazy_eval = false);
 
+    /**
+     * Updates all free and occupied cells (as computed by computeUpdate()) in parallel,
+     * with the same result as updating them one by one. The keys are partitioned into
+     * disjoint subtrees below a common depth, each subtree is updated by one thread
+     * without locking. Inner nodes above these subtrees are updated afterwards.
+     * Used by insertPointCloud() with more than one thread (see setNumThreads()),
+     * requires heap allocation (no node pool) and disabled change detection.
+     */
+    void updateNodesParallel(const KeySet& free_cells, const KeySet& occupied_cells, bool lazy_eval = false);
+
 
     // recursive calls ----------------------------
 
@@ -482,10 +701,115 @@ namespace octomap {
     NODE* setNodeValueRecurs(NODE* node, bool node_just_created, const OcTreeKey& key,
                            unsigned int depth, const float& log_odds_value, bool lazy_eval = false);
 
+    /// log_odds update of a key for updateNodes(), key in Morton order
+    typedef std::pair<MortonKey, float> MortonUpdate;
+
+    static bool mortonUpdateLess(const MortonUpdate& a, const MortonUpdate& b) { return a.first < b.first; }
+
+    /// applies the sorted updates [begin, end), which are all below node
+    void updateNodesRecurs(NODE* node, bool node_just_created, unsigned int depth,
+                           const MortonUpdate* begin, const MortonUpdate* end, bool lazy_eval = false);
+
+    /**
+     * Path of the last search during ray casting. Searches for nearby keys (along a ray,
+     * or on neighboring rays of a packet in castRays()) start at the deepest common node.
+     */
+    struct RayCastCache {
+      enum State {FREE, OCCUPIED, UNKNOWN};
+
+      RayCastCache() : path_length(0) {}
+
+      OcTreeKey key;            ///< key of the last search
+      NODE* path[17];           ///< nodes from the root to the last found node (up to depth 16)
+      unsigned int path_length; ///< number of valid nodes in path
+    };
+
+    /**
+     * Looks up the node containing the voxel of key for ray casting, starting at the
+     * deepest node shared with the last search in cache (if given).
+     * @param[out] node_min lowest key within the node (or unknown space)
+     * @param[out] node_max highest key within the node (or unknown space)
+     * @return occupancy state of the node
+     */
+    typename RayCastCache::State searchRayNode(const OcTreeKey& key, OcTreeKey& node_min, OcTreeKey& node_max,
+                                               RayCastCache* cache) const;
+
+    /// castRay() implementation, optionally with a cache of nodes shared with other rays
+    bool castRayCached(const point3d& origin, const point3d& direction, point3d& end, OcTreeKey& end_key,
+                       bool ignoreUnknownCells, double maxRange, RayCastCache* cache) const;
+
     void updateInnerOccupancyRecurs(NODE* node, unsigned int depth);
+
+    /// node of the best-first search in getNearestOccupied(), ordered as min heap by distance
+    struct NearestOccupiedElement {
+      double distance_sq;  ///< squared distance from the query point to the node's volume
+      NODE* node;
+      OcTreeKey key;
+      unsigned int depth;
+
+      bool operator<(const NearestOccupiedElement& other) const { return distance_sq > other.distance_sq; }
+    };
+
+    /// implementation of getNearestOccupied() with k = 0 for an unlimited number of leafs
+    size_t searchNearestOccupied(const point3d& query, unsigned int k, double max_distance, unsigned int max_depth,
+                                 NearestOccupiedResults& results) const;
+
+    /// @return squared distance from query to the volume of the node at depth with key
+    double nodeDistanceSq(const point3d& query, const OcTreeKey& key, unsigned int depth) const;
+
+    /**
+     * Creates the children of node encoded in the two bytes of binary data of node
+     * (see writeBinaryNode()), using a decoding table
+     * @return bit mask of the children with children (read next)
+     */
+    uint8_t readBinaryChildren(NODE* node, unsigned char child1to4, unsigned char child5to8);
+
+    /// readBinaryNode() from memory [data, end), @return position after the node's data, NULL if truncated
+    const char* readBinaryNode(const char* data, const char* end, NODE* node);
+
+    /// reads the nodes above subtree_depth from s and the raw data of the subtrees below (in data at offsets)
+    bool readBinaryTopRecurs(std::istream &s, NODE* node, unsigned int depth, unsigned int subtree_depth,
+                             const std::vector<size_t>& offsets, std::vector<char>& data,
+                             std::vector<NODE*>& subtree_nodes);
+
+    /**
+     * Appends the binary data of node (with key at depth) restricted to the keys in [min_key, max_key]
+     * to data, splitting leafs which cross the bounds. num_nodes is increased by the number of children written.
+     * @return false if nothing in the bounds is known (nothing appended)
+     */
+    bool writeBinaryNodeBBX(const NODE* node, const OcTreeKey& key, unsigned int depth, const OcTreeKey& min_key,
+                            const OcTreeKey& max_key, std::vector<char>& data, size_t& num_nodes) const;
+
+    /// grafts the binary data of node and its children into node, see readBinarySubtreeData()
+    bool readBinarySubtreeRecurs(BufferedReader &s, NODE* node, size_t& num_nodes);
+
+    /// sets the occupancy of inner nodes down to subtree_depth after reading their subtrees
+    void updateBinaryTopRecurs(NODE* node, unsigned int depth, unsigned int subtree_depth);
+
+    void getBinarySubtreeSizesRecurs(const NODE* node, unsigned int depth, unsigned int subtree_depth,
+                                     std::vector<uint64_t>& subtree_sizes) const;
+
+    /// @return number of nodes with children in the subtree of node (including node)
+    size_t calcNumInnerNodesRecurs(const NODE* node) const;
+
+    /// updates the inner nodes above the sorted dirty keys [begin, end), which are all below node
+    void updateDirtyInnerOccupancyRecurs(NODE* node, unsigned int depth, const MortonKey* begin,
+                                         const MortonKey* end, bool prune);
+
+    /// marks the inner nodes above a leaf modified with lazy evaluation
+    inline void markDirty(const OcTreeKey& key) { if (use_dirty_tracking) dirty_keys.insert(computeIndexKey(1, key)); }
     
     void toMaxLikelihoodRecurs(NODE* node, unsigned int depth, unsigned int max_depth);
 
+    /// converts the visited nodes to maximum likelihood, for toMaxLikelihood()
+    struct MaxLikelihoodFunctor {
+      MaxLikelihoodFunctor(const OccupancyOcTreeBase<NODE>* tree) : tree(tree) {}
+      void operator()(NODE* node, const OcTreeKey&, unsigned int, unsigned int){
+        tree->nodeToMaxLikelihood(node);
+      }
+      const OccupancyOcTreeBase<NODE>* tree;
+    };
+
 
   protected:
     bool use_bbx_limit;  ///< use bounding box for queries (needs to be set)?
@@ -497,6 +821,10 @@ namespace octomap {
     bool use_change_detection;
     /// Set of leaf keys (lowest level) which changed since last resetChangeDetection
     KeyBoolMap changed_keys;
+
+    bool use_dirty_tracking;
+    /// Parents of leaves modified with lazy evaluation, see updateDirtyInnerOccupancy()
+    KeySet dirty_keys;
     
 
   };
@@ -31,8 +31,9 @@
  * POSSIBILITY OF SUCH DAMAGE.
  */
 
-#include <bitset>
 #include <algorithm>
+#include <cmath>
+#include <set>
 
 #include <octomap/MCTables.h>
 
@@ -40,14 +41,16 @@ namespace octomap {
 
   template <class NODE>
   OccupancyOcTreeBase<NODE>::OccupancyOcTreeBase(double resolution)
-    : OcTreeBaseImpl<NODE,AbstractOccupancyOcTree>(resolution), use_bbx_limit(false), use_change_detection(false)
+    : OcTreeBaseImpl<NODE,AbstractOccupancyOcTree>(resolution), use_bbx_limit(false), use_change_detection(false),
+      use_dirty_tracking(false)
   {
 
   }
   
   template <class NODE>
   OccupancyOcTreeBase<NODE>::OccupancyOcTreeBase(double resolution, unsigned int tree_depth, unsigned int tree_max_val)
-    : OcTreeBaseImpl<NODE,AbstractOccupancyOcTree>(resolution, tree_depth, tree_max_val), use_bbx_limit(false), use_change_detection(false)
+    : OcTreeBaseImpl<NODE,AbstractOccupancyOcTree>(resolution, tree_depth, tree_max_val), use_bbx_limit(false), use_change_detection(false),
+      use_dirty_tracking(false)
   {
 
   }  
@@ -61,15 +64,28 @@ namespace octomap {
   OcTreeBaseImpl<NODE,AbstractOccupancyOcTree>(rhs), use_bbx_limit(rhs.use_bbx_limit),
     bbx_min(rhs.bbx_min), bbx_max(rhs.bbx_max),
     bbx_min_key(rhs.bbx_min_key), bbx_max_key(rhs.bbx_max_key),
-    use_change_detection(rhs.use_change_detection), changed_keys(rhs.changed_keys)
+    use_change_detection(rhs.use_change_detection), changed_keys(rhs.changed_keys),
+    use_dirty_tracking(rhs.use_dirty_tracking), dirty_keys(rhs.dirty_keys)
   {
     this->clamping_thres_min = rhs.clamping_thres_min;
     this->clamping_thres_max = rhs.clamping_thres_max;
     this->prob_hit_log = rhs.prob_hit_log;
     this->prob_miss_log = rhs.prob_miss_log;
     this->occ_prob_thres_log = rhs.occ_prob_thres_log;
+    this->subtree_index = rhs.subtree_index;
 
+  }
 
+  template <class NODE>
+  void OccupancyOcTreeBase<NODE>::clear(){
+    OcTreeBaseImpl<NODE,AbstractOccupancyOcTree>::clear();
+    dirty_keys.clear();
+  }
+
+  template <class NODE>
+  void OccupancyOcTreeBase<NODE>::swapContent(OccupancyOcTreeBase<NODE>& rhs){
+    OcTreeBaseImpl<NODE,AbstractOccupancyOcTree>::swapContent(rhs);
+    dirty_keys.swap(rhs.dirty_keys);
   }
 
   template <class NODE>
@@ -93,12 +109,22 @@ namespace octomap {
       computeUpdate(scan, sensor_origin, free_cells, occupied_cells, maxrange);
 
     // insert data into tree  -----------------------
+#ifdef _OPENMP
+    if (this->getNumThreads() > 1 && !this->isNodePoolUsed() && !use_change_detection
+        && free_cells.size() + occupied_cells.size() > 1000){
+      updateNodesParallel(free_cells, occupied_cells, lazy_eval);
+      return;
+    }
+#endif
+    std::vector<std::pair<OcTreeKey, float> > updates;
+    updates.reserve(free_cells.size() + occupied_cells.size());
     for (KeySet::iterator it = free_cells.begin(); it != free_cells.end(); ++it) {
-      updateNode(*it, false, lazy_eval);
+      updates.push_back(std::pair<OcTreeKey, float>(*it, this->prob_miss_log));
     }
     for (KeySet::iterator it = occupied_cells.begin(); it != occupied_cells.end(); ++it) {
-      updateNode(*it, true, lazy_eval);
+      updates.push_back(std::pair<OcTreeKey, float>(*it, this->prob_hit_log));
     }
+    updateNodes(updates, lazy_eval);
   }
 
   template <class NODE>
@@ -117,8 +143,9 @@ namespace octomap {
     if (pc.size() < 1)
       return;
 
+    this->ensureKeyRays();
 #ifdef _OPENMP
-    omp_set_num_threads(this->keyrays.size());
+    omp_set_num_threads(this->getNumThreads());
     #pragma omp parallel for
 #endif
     for (int i = 0; i < (int)pc.size(); ++i) {
@@ -144,23 +171,179 @@ namespace octomap {
     }
   }
 
+  template <class NODE>
+  void OccupancyOcTreeBase<NODE>::updateNodesParallel(const KeySet& free_cells, const KeySet& occupied_cells, bool lazy_eval) {
+    if (free_cells.empty() && occupied_cells.empty())
+      return;
+
+    const KeySet* cells[2] = {&free_cells, &occupied_cells};
+    const float log_odds_updates[2] = {this->prob_miss_log, this->prob_hit_log};
+
+    // bounding box of all updated keys
+    OcTreeKey min_key = *(cells[free_cells.empty() ? 1 : 0]->begin());
+    OcTreeKey max_key = min_key;
+    for (unsigned int c = 0; c < 2; ++c){
+      for (KeySet::const_iterator it = cells[c]->begin(); it != cells[c]->end(); ++it){
+        for (unsigned int i = 0; i < 3; ++i){
+          min_key[i] = std::min(min_key[i], (*it)[i]);
+          max_key[i] = std::max(max_key[i], (*it)[i]);
+        }
+      }
+    }
+
+    // shard depth: least depth with enough subtrees (shards) in the bounding box
+    // for load balancing between the threads
+    const unsigned int num_threads = this->getNumThreads();
+    unsigned int shard_depth = 0;
+    unsigned int shift = 0;
+    size_t num_shards = 1;
+    size_t shard_dims[3];
+    do {
+      ++shard_depth;
+      shift = this->tree_depth - shard_depth;
+      num_shards = 1;
+      for (unsigned int i = 0; i < 3; ++i){
+        shard_dims[i] = (max_key[i] >> shift) - (min_key[i] >> shift) + 1;
+        num_shards *= shard_dims[i];
+      }
+    } while (num_shards < 8 * num_threads && shard_depth < this->tree_depth);
+
+    // sort keys into shards, keeping their order of update (free before occupied)
+    std::vector<std::vector<OcTreeKey> > shard_keys[2];
+    for (unsigned int c = 0; c < 2; ++c){
+      shard_keys[c].resize(num_shards);
+      for (KeySet::const_iterator it = cells[c]->begin(); it != cells[c]->end(); ++it){
+        size_t shard = 0;
+        for (unsigned int i = 0; i < 3; ++i)
+          shard = shard * shard_dims[i] + (((*it)[i] >> shift) - (min_key[i] >> shift));
+        shard_keys[c][shard].push_back(*it);
+      }
+    }
+
+    // same early abort as in updateNode(): leaves already at the clamping threshold
+    // are skipped. Other updates never change this, so it can be checked up front.
+    // Remaining keys are sorted in Morton order for the updates.
+#ifdef _OPENMP
+    omp_set_num_threads(num_threads);
+    #pragma omp parallel for schedule(dynamic)
+#endif
+    for (int shard = 0; shard < (int)num_shards; ++shard){
+      for (unsigned int c = 0; c < 2; ++c){
+        std::vector<OcTreeKey>& keys = shard_keys[c][shard];
+        if (this->root != NULL){
+          size_t num_kept = 0;
+          for (size_t k = 0; k < keys.size(); ++k){
+            NODE* leaf = this->search(keys[k]);
+            if (!(leaf && ((log_odds_updates[c] >= 0 && leaf->getLogOdds() >= this->clamping_thres_max)
+                        || (log_odds_updates[c] <= 0 && leaf->getLogOdds() <= this->clamping_thres_min))))
+              keys[num_kept++] = keys[k];
+          }
+          keys.resize(num_kept);
+        }
+        sortKeysMorton(keys);
+      }
+    }
+
+    // create (or expand) all nodes above the shards serially, as updateNodeRecurs() would
+    bool created_root = false;
+    if (this->root == NULL){
+      this->root = this->allocNode();
+      this->tree_size++;
+      created_root = true;
+    }
+    std::vector<int> active_shards;
+    std::vector<NODE*> shard_nodes(num_shards, (NODE*) NULL);
+    std::vector<char> shard_created(num_shards, 0);
+    std::vector<std::set<NODE*> > ancestors(shard_depth);
+    for (size_t shard = 0; shard < num_shards; ++shard){
+      if (shard_keys[0][shard].empty() && shard_keys[1][shard].empty())
+        continue;
+
+      const OcTreeKey& key = shard_keys[0][shard].empty() ? shard_keys[1][shard][0] : shard_keys[0][shard][0];
+      NODE* node = this->root;
+      bool node_just_created = created_root;
+      for (unsigned int depth = 0; depth < shard_depth; ++depth){
+        ancestors[depth].insert(node);
+        unsigned int pos = computeChildIdx(key, this->tree_depth -1 - depth);
+        bool created_node = false;
+        if (!this->nodeChildExists(node, pos)) {
+          if (!this->nodeHasChildren(node) && !node_just_created)
+            this->expandNode(node);
+          else {
+            this->createNodeChild(node, pos);
+            created_node = true;
+          }
+        }
+        node = this->getNodeChild(node, pos);
+        node_just_created = created_node;
+      }
+      active_shards.push_back(shard);
+      shard_nodes[shard] = node;
+      shard_created[shard] = node_just_created;
+    }
+
+    // update disjoint subtrees in parallel
+    this->beginThreadSizeTracking();
+#ifdef _OPENMP
+    omp_set_num_threads(num_threads);
+    #pragma omp parallel for schedule(dynamic)
+#endif
+    for (int s = 0; s < (int)active_shards.size(); ++s){
+      int shard = active_shards[s];
+      bool node_just_created = shard_created[shard];
+      for (unsigned int c = 0; c < 2; ++c){
+        const std::vector<OcTreeKey>& keys = shard_keys[c][shard];
+        for (size_t k = 0; k < keys.size(); ++k){
+          updateNodeRecurs(shard_nodes[shard], node_just_created, keys[k], shard_depth, log_odds_updates[c], lazy_eval);
+          node_just_created = false;
+        }
+      }
+    }
+    this->endThreadSizeTracking();
+
+    // prune or update inner nodes above the shards, bottom-up
+    if (lazy_eval){
+      for (size_t shard = 0; shard < num_shards; ++shard){
+        for (unsigned int c = 0; c < 2; ++c){
+          for (size_t k = 0; k < shard_keys[c][shard].size(); ++k)
+            markDirty(shard_keys[c][shard][k]);
+        }
+      }
+    } else {
+      for (int depth = (int)shard_depth - 1; depth >= 0; --depth){
+        for (typename std::set<NODE*>::iterator it = ancestors[depth].begin(); it != ancestors[depth].end(); ++it){
+          if (!this->pruneNode(*it))
+            (*it)->updateOccupancyChildren();
+        }
+      }
+    }
+  }
+
   template <class NODE>
   void OccupancyOcTreeBase<NODE>::computeDiscreteUpdate(const Pointcloud& scan, const octomap::point3d& origin,
                                                 KeySet& free_cells, KeySet& occupied_cells,
                                                 double maxrange)
  {
-   Pointcloud discretePC;
-   discretePC.reserve(scan.size());
-   KeySet endpoints;
+   std::vector<OcTreeKey> keys;
+   std::vector<bool> valid;
+   this->coordsToKeys(scan, keys, valid);
 
-   for (int i = 0; i < (int)scan.size(); ++i) {
-     OcTreeKey k = this->coordToKey(scan[i]);
-     std::pair<KeySet::iterator,bool> ret = endpoints.insert(k);
-     if (ret.second){ // insertion took place => k was not in set
-       discretePC.push_back(this->keyToCoord(k));
+   std::vector<OcTreeKey> unique_keys;
+   unique_keys.reserve(scan.size());
+   Pointcloud outside; // points outside of the tree are kept as they are
+   KeySet endpoints;
+   for (size_t i = 0; i < keys.size(); ++i) {
+     if (!valid[i]){
+       outside.push_back(scan[i]);
+     } else if (endpoints.insert(keys[i]).second){ // insertion took place => key was not in set
+       unique_keys.push_back(keys[i]);
      }
    }
 
+   Pointcloud discretePC;
+   this->keysToCoords(unique_keys, discretePC);
+   discretePC.push_back(outside);
+
    computeUpdate(discretePC, origin, free_cells, occupied_cells, maxrange);
  }
 
@@ -170,11 +353,27 @@ namespace octomap {
                                                 KeySet& free_cells, KeySet& occupied_cells,
                                                 double maxrange)
   {
+    // each thread collects keys in its own sets (thread 0 directly in the output sets),
+    // they are merged after all rays are traced
+    const unsigned int num_threads = this->getNumThreads();
+    this->ensureKeyRays();
+    std::vector<KeySet> thread_cells(2 * (num_threads - 1));
+    std::vector<KeySet*> thread_free_cells(num_threads);
+    std::vector<KeySet*> thread_occupied_cells(num_threads);
+    thread_free_cells[0] = &free_cells;
+    thread_occupied_cells[0] = &occupied_cells;
+    for (unsigned int t = 1; t < num_threads; ++t){
+      thread_free_cells[t] = &thread_cells[2*t - 2];
+      thread_occupied_cells[t] = &thread_cells[2*t - 1];
+    }
 
-
+    // keys of all endpoints, converted at once
+    std::vector<OcTreeKey> endpoint_keys;
+    std::vector<bool> endpoint_valid;
+    this->coordsToKeys(scan, endpoint_keys, endpoint_valid);
 
 #ifdef _OPENMP
-    omp_set_num_threads(this->keyrays.size());
+    omp_set_num_threads(num_threads);
     #pragma omp parallel for schedule(guided)
 #endif
     for (int i = 0; i < (int)scan.size(); ++i) {
@@ -184,39 +383,25 @@ namespace octomap {
       threadIdx = omp_get_thread_num();
 #endif
       KeyRay* keyray = &(this->keyrays.at(threadIdx));
+      KeySet& free_set = *thread_free_cells[threadIdx];
+      KeySet& occupied_set = *thread_occupied_cells[threadIdx];
 
 
       if (!use_bbx_limit) { // no BBX specified
         if ((maxrange < 0.0) || ((p - origin).norm() <= maxrange) ) { // is not maxrange meas.
           // free cells
           if (this->computeRayKeys(origin, p, *keyray)){
-#ifdef _OPENMP
-            #pragma omp critical (free_insert)
-#endif
-            {
-              free_cells.insert(keyray->begin(), keyray->end());
-            }
+            free_set.insert(keyray->begin(), keyray->end());
           }
           // occupied endpoint
-          OcTreeKey key;
-          if (this->coordToKeyChecked(p, key)){
-#ifdef _OPENMP
-            #pragma omp critical (occupied_insert)
-#endif
-            {
-              occupied_cells.insert(key);
-            }
+          if (endpoint_valid[i]){
+            occupied_set.insert(endpoint_keys[i]);
           }
         } else { // user set a maxrange and length is above
           point3d direction = (p - origin).normalized ();
           point3d new_end = origin + direction * (float) maxrange;
           if (this->computeRayKeys(origin, new_end, *keyray)){
-#ifdef _OPENMP
-            #pragma omp critical (free_insert)
-#endif
-            {
-              free_cells.insert(keyray->begin(), keyray->end());
-            }
+            free_set.insert(keyray->begin(), keyray->end());
           }
         } // end if maxrange
       } else { // BBX was set
@@ -224,26 +409,15 @@ namespace octomap {
         if ( inBBX(p) && ((maxrange < 0.0) || ((p - origin).norm () <= maxrange) ) )  {
 
           // occupied endpoint
-          OcTreeKey key;
-          if (this->coordToKeyChecked(p, key)){
-#ifdef _OPENMP
-            #pragma omp critical (occupied_insert)
-#endif
-            {
-              occupied_cells.insert(key);
-            }
+          if (endpoint_valid[i]){
+            occupied_set.insert(endpoint_keys[i]);
           }
 
           // update freespace, break as soon as bbx limit is reached
           if (this->computeRayKeys(origin, p, *keyray)){
             for(KeyRay::reverse_iterator rit=keyray->rbegin(); rit != keyray->rend(); rit++) {
               if (inBBX(*rit)) {
-#ifdef _OPENMP
-                #pragma omp critical (free_insert)
-#endif
-                {
-                  free_cells.insert(*rit);
-                }
+                free_set.insert(*rit);
               }
               else break;
             }
@@ -253,12 +427,37 @@ namespace octomap {
 
     } // end for all points, end of parallel OMP loop
 
+    // merge occupied cells of all threads
+    for (unsigned int t = 1; t < num_threads; ++t){
+      occupied_cells.insert(thread_occupied_cells[t]->begin(), thread_occupied_cells[t]->end());
+      thread_occupied_cells[t]->clear();
+    }
+
     // prefer occupied cells over free ones (and make sets disjunct)
-    for(KeySet::iterator it = free_cells.begin(), end=free_cells.end(); it!= end; ){
-      if (occupied_cells.find(*it) != occupied_cells.end()){
-        it = free_cells.erase(it);
-      } else {
-        ++it;
+#ifdef _OPENMP
+    #pragma omp parallel for
+#endif
+    for (int t = 0; t < (int)num_threads; ++t){
+      KeySet& free_set = *thread_free_cells[t];
+      for(KeySet::iterator it = free_set.begin(), end=free_set.end(); it!= end; ){
+        if (occupied_cells.find(*it) != occupied_cells.end()){
+          it = free_set.erase(it);
+        } else {
+          ++it;
+        }
+      }
+    }
+
+    // merge free cells of all threads pairwise, ends up in free_cells (thread 0)
+    for (unsigned int step = 1; step < num_threads; step *= 2){
+#ifdef _OPENMP
+      #pragma omp parallel for
+#endif
+      for (int t = 0; t < (int)num_threads; t += 2*step){
+        if (t + step < num_threads){
+          thread_free_cells[t]->insert(thread_free_cells[t + step]->begin(), thread_free_cells[t + step]->end());
+          thread_free_cells[t + step]->clear();
+        }
       }
     }
   }
@@ -270,11 +469,14 @@ namespace octomap {
 
     bool createdRoot = false;
     if (this->root == NULL){
-      this->root = new NODE();
+      this->root = this->allocNode();
       this->tree_size++;
       createdRoot = true;
     }
 
+    if (lazy_eval)
+      markDirty(key);
+
     return setNodeValueRecurs(this->root, createdRoot, key, 0, log_odds_value, lazy_eval);
   }
 
@@ -312,11 +514,14 @@ namespace octomap {
 
     bool createdRoot = false;
     if (this->root == NULL){
-      this->root = new NODE();
+      this->root = this->allocNode();
       this->tree_size++;
       createdRoot = true;
     }
 
+    if (lazy_eval)
+      markDirty(key);
+
     return updateNodeRecurs(this->root, createdRoot, key, 0, log_odds_update, lazy_eval);
   }
 
@@ -363,6 +568,32 @@ namespace octomap {
     return updateNode(key, occupied, lazy_eval);
   }
 
+  template <class NODE>
+  void OccupancyOcTreeBase<NODE>::updateNodes(const std::vector<std::pair<OcTreeKey, float> >& updates, bool lazy_eval) {
+    if (updates.empty())
+      return;
+
+    // stable: updates of the same key keep their order
+    std::vector<MortonUpdate> sorted_updates;
+    sorted_updates.reserve(updates.size());
+    for (size_t i = 0; i < updates.size(); ++i){
+      sorted_updates.push_back(MortonUpdate(MortonKey(updates[i].first), updates[i].second));
+      if (lazy_eval)
+        markDirty(updates[i].first);
+    }
+    std::stable_sort(sorted_updates.begin(), sorted_updates.end(), mortonUpdateLess);
+
+    bool createdRoot = false;
+    if (this->root == NULL){
+      this->root = this->allocNode();
+      this->tree_size++;
+      createdRoot = true;
+    }
+
+    const MortonUpdate* begin = &sorted_updates[0];
+    updateNodesRecurs(this->root, createdRoot, 0, begin, begin + sorted_updates.size(), lazy_eval);
+  }
+
   template <class NODE>
   NODE* OccupancyOcTreeBase<NODE>::updateNodeRecurs(NODE* node, bool node_just_created, const OcTreeKey& key,
                                                     unsigned int depth, const float& log_odds_update, bool lazy_eval) {
@@ -490,10 +721,136 @@ namespace octomap {
     }
   }
 
+  template <class NODE>
+  void OccupancyOcTreeBase<NODE>::updateNodesRecurs(NODE* node, bool node_just_created, unsigned int depth,
+                                                    const MortonUpdate* begin, const MortonUpdate* end, bool lazy_eval) {
+    assert(node);
+    assert(begin != end);
+
+    // at last level, update node in order of the updates, end of recursion
+    if (depth == this->tree_depth) {
+      OcTreeKey key = begin->first.toKey();
+      for (const MortonUpdate* it = begin; it != end; ++it) {
+        // same early abort as in updateNode(), new nodes are not searched there
+        if (!node_just_created
+            && ((it->second >= 0 && node->getLogOdds() >= this->clamping_thres_max)
+            || ( it->second <= 0 && node->getLogOdds() <= this->clamping_thres_min)))
+          continue;
+
+        if (use_change_detection) {
+          bool occBefore = this->isNodeOccupied(node);
+          updateNodeLogOdds(node, it->second);
+
+          if (node_just_created){  // new node
+            changed_keys.insert(std::pair<OcTreeKey,bool>(key, true));
+          } else if (occBefore != this->isNodeOccupied(node)) {  // occupancy changed, track it
+            KeyBoolMap::iterator changed = changed_keys.find(key);
+            if (changed == changed_keys.end())
+              changed_keys.insert(std::pair<OcTreeKey,bool>(key, false));
+            else if (changed->second == false)
+              changed_keys.erase(changed);
+          }
+        } else {
+          updateNodeLogOdds(node, it->second);
+        }
+        node_just_created = false;
+      }
+      return;
+    }
+
+    // pruned node: updateNode() would stop at it for updates that don't change its value
+    if (!node_just_created && !this->nodeHasChildren(node)) {
+      while (begin != end
+             && ((begin->second >= 0 && node->getLogOdds() >= this->clamping_thres_max)
+             || ( begin->second <= 0 && node->getLogOdds() <= this->clamping_thres_min)))
+        ++begin;
+      if (begin == end)
+        return;
+    }
+
+    // updates of each child are consecutive in Morton order
+    const unsigned int level = this->tree_depth - 1 - depth;
+    const MortonUpdate* child_begin = begin;
+    while (child_begin != end) {
+      unsigned int pos = child_begin->first.childIdx(level);
+      const MortonUpdate* child_end = child_begin + 1;
+      while (child_end != end && child_end->first.childIdx(level) == pos)
+        ++child_end;
+
+      bool created_node = false;
+      if (!this->nodeChildExists(node, pos)) {
+        // child does not exist, but maybe it's a pruned node?
+        if (!this->nodeHasChildren(node) && !node_just_created)
+          this->expandNode(node);
+        else {
+          this->createNodeChild(node, pos);
+          created_node = true;
+        }
+      }
+      updateNodesRecurs(this->getNodeChild(node, pos), created_node, depth+1, child_begin, child_end, lazy_eval);
+      child_begin = child_end;
+    }
+
+    // prune node if possible, otherwise set own probability
+    if (!lazy_eval && !this->pruneNode(node))
+      node->updateOccupancyChildren();
+  }
+
   template <class NODE>
   void OccupancyOcTreeBase<NODE>::updateInnerOccupancy(){
     if (this->root)
       this->updateInnerOccupancyRecurs(this->root, 0);
+    dirty_keys.clear();
+  }
+
+  template <class NODE>
+  void OccupancyOcTreeBase<NODE>::updateDirtyInnerOccupancy(bool prune){
+    if (!use_dirty_tracking){
+      updateInnerOccupancy();
+      if (prune)
+        this->prune();
+      return;
+    }
+    if (this->root && !dirty_keys.empty() && this->tree_depth > 0){
+      std::vector<MortonKey> sorted_keys;
+      sorted_keys.reserve(dirty_keys.size());
+      for (KeySet::const_iterator it = dirty_keys.begin(); it != dirty_keys.end(); ++it)
+        sorted_keys.push_back(MortonKey(*it));
+      std::sort(sorted_keys.begin(), sorted_keys.end());
+
+      const MortonKey* begin = &sorted_keys[0];
+      updateDirtyInnerOccupancyRecurs(this->root, 0, begin, begin + sorted_keys.size(), prune);
+    }
+    dirty_keys.clear();
+  }
+
+  template <class NODE>
+  void OccupancyOcTreeBase<NODE>::updateDirtyInnerOccupancyRecurs(NODE* node, unsigned int depth, const MortonKey* begin,
+                                                                  const MortonKey* end, bool prune){
+    assert(node);
+
+    // only existing inner nodes need an update (keys may be outdated, e.g. after deleting nodes)
+    if (!this->nodeHasChildren(node))
+      return;
+
+    // dirty keys are at the level above the leaves
+    if (depth + 1 < this->tree_depth){
+      const unsigned int level = this->tree_depth - 1 - depth;
+      const MortonKey* child_begin = begin;
+      while (child_begin != end){
+        unsigned int pos = child_begin->childIdx(level);
+        const MortonKey* child_end = child_begin + 1;
+        while (child_end != end && child_end->childIdx(level) == pos)
+          ++child_end;
+
+        if (this->nodeChildExists(node, pos))
+          updateDirtyInnerOccupancyRecurs(this->getNodeChild(node, pos), depth+1, child_begin, child_end, prune);
+        child_begin = child_end;
+      }
+    }
+
+    if (!(prune && this->pruneNode(node)))
+      node->updateOccupancyChildren();
   }
 
   template <class NODE>
@@ -516,16 +873,9 @@ namespace octomap {
 
   template <class NODE>
   void OccupancyOcTreeBase<NODE>::toMaxLikelihood() {
-    if (this->root == NULL)
-      return;
-
-    // convert bottom up
-    for (unsigned int depth=this->tree_depth; depth>0; depth--) {
-      toMaxLikelihoodRecurs(this->root, 0, depth);
-    }
-
-    // convert root
-    nodeToMaxLikelihood(this->root);
+    // each node is converted independently of its children, all at once
+    MaxLikelihoodFunctor functor(this);
+    this->parallelForEachNode(functor);
   }
 
   template <class NODE>
@@ -638,6 +988,203 @@ namespace octomap {
   template <class NODE>
   bool OccupancyOcTreeBase<NODE>::castRay(const point3d& origin, const point3d& directionP, point3d& end, 
                                           bool ignoreUnknown, double maxRange) const {
+    OcTreeKey end_key;
+    RayCastCache cache;
+    return castRayCached(origin, directionP, end, end_key, ignoreUnknown, maxRange, &cache);
+  }
+
+  template <class NODE>
+  void OccupancyOcTreeBase<NODE>::castRays(const std::vector<point3d>& origins, const std::vector<point3d>& directions,
+                                           CastRayResults& results, const CastRayOptions& options) const {
+    assert(origins.size() == directions.size() || origins.size() == 1);
+    const int num_rays = (int) directions.size();
+    results.resize(num_rays);
+    if (num_rays == 0)
+      return;
+
+    const int packet_size = std::max(1, (int) options.packet_size);
+    const int num_packets = (num_rays + packet_size - 1) / packet_size;
+#ifdef _OPENMP
+    omp_set_num_threads(this->getNumThreads());
+    #pragma omp parallel for schedule(dynamic)
+#endif
+    for (int p = 0; p < num_packets; ++p){
+      RayCastCache cache;
+      const int packet_end = std::min(num_rays, (p + 1) * packet_size);
+      for (int i = p * packet_size; i < packet_end; ++i){
+        const point3d& origin = (origins.size() == 1) ? origins[0] : origins[i];
+        point3d& end = results.ends[i];
+        end = origin;
+        results.keys[i] = OcTreeKey(0, 0, 0);
+        results.hits[i] = castRayCached(origin, directions[i], end, results.keys[i],
+                                        options.ignore_unknown, options.max_range, &cache);
+        results.distances[i] = (end - origin).norm();
+      }
+    }
+  }
+
+  template <class NODE>
+  size_t OccupancyOcTreeBase<NODE>::getNearestOccupied(const point3d& query, unsigned int k,
+                                                       NearestOccupiedResults& results, double max_distance,
+                                                       unsigned int max_depth) const {
+    if (k == 0){
+      results.clear();
+      return 0;
+    }
+    return searchNearestOccupied(query, k, max_distance, max_depth, results);
+  }
+
+  template <class NODE>
+  size_t OccupancyOcTreeBase<NODE>::getOccupiedInRadius(const point3d& query, double radius,
+                                                        NearestOccupiedResults& results, unsigned int max_depth) const {
+    if (radius <= 0.0){
+      results.clear();
+      return 0;
+    }
+    return searchNearestOccupied(query, 0, radius, max_depth, results);
+  }
+
+  template <class NODE>
+  double OccupancyOcTreeBase<NODE>::getDistanceToNearestOccupied(const point3d& query, point3d& closest,
+                                                                 double max_distance) const {
+    NearestOccupiedResults results;
+    if (searchNearestOccupied(query, 1, max_distance, 0, results) == 0)
+      return -1.0;
+    closest = results.centers[0];
+    return results.distances[0];
+  }
+
+  template <class NODE>
+  double OccupancyOcTreeBase<NODE>::nodeDistanceSq(const point3d& query, const OcTreeKey& key,
+                                                   unsigned int depth) const {
+    double half_size = this->getNodeSize(depth) / 2.0;
+    double distance_sq = 0.0;
+    for (unsigned int i = 0; i < 3; ++i){
+      double d = fabs(double(query(i)) - this->keyToCoord(key[i], depth)) - half_size;
+      if (d > 0.0)
+        distance_sq += d * d;
+    }
+    return distance_sq;
+  }
+
+  template <class NODE>
+  size_t OccupancyOcTreeBase<NODE>::searchNearestOccupied(const point3d& query, unsigned int k, double max_distance,
+                                                          unsigned int max_depth, NearestOccupiedResults& results) const {
+    results.clear();
+    if (this->root == NULL || !this->isNodeOccupied(this->root))
+      return 0;
+    if (max_depth == 0 || max_depth > this->tree_depth)
+      max_depth = this->tree_depth;
+    const double max_distance_sq = (max_distance > 0.0) ? max_distance * max_distance
+                                                        : std::numeric_limits<double>::max();
+
+    // min heap of the nodes to visit, by their distance (a lower bound for their leafs)
+    std::vector<NearestOccupiedElement> heap;
+    heap.reserve(64);
+    NearestOccupiedElement current;
+    current.node = this->root;
+    current.key = OcTreeKey(this->tree_max_val, this->tree_max_val, this->tree_max_val);
+    current.depth = 0;
+    current.distance_sq = nodeDistanceSq(query, current.key, 0);
+    if (current.distance_sq <= max_distance_sq)
+      heap.push_back(current);
+
+    while (!heap.empty()){
+      std::pop_heap(heap.begin(), heap.end());
+      current = heap.back();
+      heap.pop_back();
+
+      // only occupied nodes are on the heap, leafs come off it sorted by distance
+      if (current.depth == max_depth || !this->nodeHasChildren(current.node)){
+        results.keys.push_back(current.key);
+        results.depths.push_back(current.depth);
+        results.centers.push_back(this->keyToCoord(current.key, current.depth));
+        results.distances.push_back((float) sqrt(current.distance_sq));
+        if (k > 0 && results.size() >= k)
+          break;
+        continue;
+      }
+
+      NearestOccupiedElement child;
+      child.depth = current.depth + 1;
+      const key_type center_offset_key = this->tree_max_val >> child.depth;
+      const unsigned int child_mask = this->nodeChildMask(current.node);
+      for (unsigned int i = 0; i < 8; ++i){
+        if (!(child_mask & (1 << i)))
+          continue;
+        child.node = this->getNodeChild(current.node, i);
+        // inner nodes hold the maximum occupancy of their children: free subtrees have no occupied leafs
+        if (!this->isNodeOccupied(child.node))
+          continue;
+        computeChildKey(i, center_offset_key, current.key, child.key);
+        child.distance_sq = nodeDistanceSq(query, child.key, child.depth);
+        if (child.distance_sq > max_distance_sq)
+          continue;
+        heap.push_back(child);
+        std::push_heap(heap.begin(), heap.end());
+      }
+    }
+    return results.size();
+  }
+
+  template <class NODE>
+  typename OccupancyOcTreeBase<NODE>::RayCastCache::State
+  OccupancyOcTreeBase<NODE>::searchRayNode(const OcTreeKey& key, OcTreeKey& node_min, OcTreeKey& node_max,
+                                           RayCastCache* cache) const {
+    // start at the deepest node on the path of the last search which also contains key
+    NODE* node = this->root;
+    unsigned int depth = 0;
+    if (cache && cache->path_length > 0){
+      unsigned int diff = (key[0] ^ cache->key[0]) | (key[1] ^ cache->key[1]) | (key[2] ^ cache->key[2]);
+      unsigned int common_depth = this->tree_depth;
+      for (; diff != 0; diff >>= 1)
+        --common_depth;
+      depth = std::min(common_depth, cache->path_length - 1);
+      node = cache->path[depth];
+    }
+
+    typename RayCastCache::State state = RayCastCache::UNKNOWN;
+    if (node != NULL){
+      if (cache)
+        cache->path[depth] = node;
+      for (int i = this->tree_depth - 1 - depth; i >= 0; --i) {
+        unsigned int pos = computeChildIdx(key, i);
+        if (this->nodeChildExists(node, pos)) {
+          node = this->getNodeChild(node, pos);
+          ++depth;
+          if (cache)
+            cache->path[depth] = node;
+        } else if (!this->nodeHasChildren(node)) {
+          // pruned node
+          break;
+        } else {
+          // unknown child
+          node = NULL;
+          break;
+        }
+      }
+      if (cache){
+        cache->key = key;
+        cache->path_length = depth + 1;
+      }
+      if (node == NULL)
+        ++depth;
+      else
+        state = this->isNodeOccupied(node) ? RayCastCache::OCCUPIED : RayCastCache::FREE;
+    }
+
+    unsigned int level = this->tree_depth - depth;
+    for (unsigned int j = 0; j < 3; ++j){
+      node_min[j] = key[j] & (key_type) (0xFFFF << level);
+      node_max[j] = node_min[j] + (key_type) ((1 << level) - 1);
+    }
+    return state;
+  }
+
+  template <class NODE>
+  bool OccupancyOcTreeBase<NODE>::castRayCached(const point3d& origin, const point3d& directionP, point3d& end,
+                                                OcTreeKey& end_key, bool ignoreUnknown, double maxRange,
+                                                RayCastCache* cache) const {
 
     /// ----------  see OcTreeBase::computeRayKeys  -----------
 
@@ -648,18 +1195,24 @@ namespace octomap {
       return false;
     }
 
-    NODE* startingNode = this->search(current_key);
-    if (startingNode){
-      if (this->isNodeOccupied(startingNode)){
-        // Occupied node found at origin 
-        // (need to convert from key, since origin does not need to be a voxel center)
-        end = this->keyToCoord(current_key);
-        return true;
-      }
-    } else if(!ignoreUnknown){
+    // Voxels in the key range [node_min, node_max] of the last found free (or ignored
+    // unknown) node need no search, the ray skips to the node's exit face. Only voxels
+    // entered before t_skip_max are skipped, their centers are within maxrange.
+    OcTreeKey node_min;
+    OcTreeKey node_max;
+    typename RayCastCache::State state = searchRayNode(current_key, node_min, node_max, cache);
+    if (state == RayCastCache::OCCUPIED){
+      // Occupied node found at origin 
+      // (need to convert from key, since origin does not need to be a voxel center)
+      end = this->keyToCoord(current_key);
+      end_key = current_key;
+      return true;
+    } else if (state == RayCastCache::UNKNOWN && !ignoreUnknown){
       end = this->keyToCoord(current_key);
+      end_key = current_key;
       return false;
     }
+    bool skip_node = (node_min != node_max);
 
     point3d direction = directionP.normalized();
     bool max_range_set = (maxRange > 0.0);
@@ -696,6 +1249,7 @@ namespace octomap {
 
     // for speedup:
     double maxrange_sq = maxRange *maxRange;
+    const double t_skip_max = max_range_set ? maxRange - this->resolution : std::numeric_limits<double>::max();
 
     // Incremental phase  ---------------------------------------------------------
 
@@ -704,6 +1258,27 @@ namespace octomap {
     while (!done) {
       unsigned int dim;
 
+      if (skip_node){
+        // advance to the last voxel on the ray inside the node: all crossings of voxel
+        // borders before the first crossing of the node's border
+        unsigned int remaining[3] = {0, 0, 0};
+        double t_exit = t_skip_max;
+        for (unsigned int j = 0; j < 3; ++j){
+          if (step[j] == 0)
+            continue;
+          remaining[j] = (step[j] > 0) ? node_max[j] - current_key[j] : current_key[j] - node_min[j];
+          t_exit = std::min(t_exit, tMax[j] + remaining[j] * tDelta[j]);
+        }
+        for (unsigned int j = 0; j < 3; ++j){
+          if (step[j] == 0 || tMax[j] >= t_exit)
+            continue;
+          unsigned int num_steps = std::min(remaining[j], (unsigned int) ceil((t_exit - tMax[j]) / tDelta[j]));
+          current_key[j] += step[j] * (int) num_steps;
+          tMax[j] += num_steps * tDelta[j];
+        }
+        skip_node = false;
+      }
+
       // find minimum tMax:
       if (tMax[0] < tMax[1]){
         if (tMax[0] < tMax[2]) dim = 0;
@@ -721,6 +1296,7 @@ namespace octomap {
         OCTOMAP_WARNING("Coordinate hit bounds in dim %d, aborting raycast\n", dim);
         // return border point nevertheless:
         end = this->keyToCoord(current_key);
+        end_key = current_key;
         return false;
       }
 
@@ -728,33 +1304,38 @@ namespace octomap {
       current_key[dim] += step[dim];
       tMax[dim] += tDelta[dim];
 
-
-      // generate world coords from key
-      end = this->keyToCoord(current_key);
-
       // check for maxrange:
       if (max_range_set){
+        end = this->keyToCoord(current_key);
         double dist_from_origin_sq(0.0);
         for (unsigned int j = 0; j < 3; j++) {
           dist_from_origin_sq += ((end(j) - origin(j)) * (end(j) - origin(j)));
         }
-        if (dist_from_origin_sq > maxrange_sq)
+        if (dist_from_origin_sq > maxrange_sq){
+          end_key = current_key;
           return false;
-
+        }
       }
 
-      NODE* currentNode = this->search(current_key);
-      if (currentNode){
-        if (this->isNodeOccupied(currentNode)) {
-          done = true;
-          break;
-        }
-        // otherwise: node is free and valid, raycasting continues
-      } else if (!ignoreUnknown){ // no node found, this usually means we are in "unknown" areas
+      // still within the last free node
+      if (current_key[dim] >= node_min[dim] && current_key[dim] <= node_max[dim])
+        continue;
+
+      state = searchRayNode(current_key, node_min, node_max, cache);
+      if (state == RayCastCache::OCCUPIED) {
+        done = true;
+        break;
+      } else if (state == RayCastCache::UNKNOWN && !ignoreUnknown){ // this usually means we are in "unknown" areas
+        end = this->keyToCoord(current_key);
+        end_key = current_key;
         return false;
       }
+      // otherwise: node is free (or unknown and ignored), raycasting continues
+      skip_node = (node_min != node_max);
     } // end while
 
+    end = this->keyToCoord(current_key);
+    end_key = current_key;
     return true;
   }
 
@@ -850,6 +1431,7 @@ namespace octomap {
   template <class NODE> inline bool 
   OccupancyOcTreeBase<NODE>::integrateMissOnRay(const point3d& origin, const point3d& end, bool lazy_eval) {
 
+    this->ensureKeyRays();
     if (!this->computeRayKeys(origin, end, this->keyrays.at(0))) {
       return false;
     }
@@ -935,8 +1517,11 @@ namespace octomap {
       return s;
     }
 
-    this->root = new NODE();
-    this->readBinaryNode(s, this->root);
+    this->root = this->allocNode();
+    {
+      BufferedReader reader(s);
+      this->readBinaryNode(reader, this->root);
+    }
     this->size_changed = true;
     this->tree_size = OcTreeBaseImpl<NODE,AbstractOccupancyOcTree>::calcNumNodes();  // compute number of nodes    
     return s;
@@ -945,144 +1530,555 @@ namespace octomap {
   template <class NODE>
   std::ostream& OccupancyOcTreeBase<NODE>::writeBinaryData(std::ostream &s) const{
     OCTOMAP_DEBUG("Writing %zu nodes to output stream...", this->size());
-    if (this->root)
-      this->writeBinaryNode(s, this->root);
+    if (this->root){
+      BufferedWriter writer(s);
+      this->writeBinaryNode(writer, this->root);
+    }
     return s;
   }
 
   template <class NODE>
-  std::istream& OccupancyOcTreeBase<NODE>::readBinaryNode(std::istream &s, NODE* node){
-
-    assert(node);
+  std::istream& OccupancyOcTreeBase<NODE>::readBinaryData(std::istream &s, unsigned int subtree_depth,
+                                                          const std::vector<uint64_t>& subtree_sizes){
+    if (subtree_depth == 0 || subtree_depth >= this->tree_depth)
+      return readBinaryData(s);
 
-    char child1to4_char;
-    char child5to8_char;
-    s.read((char*)&child1to4_char, sizeof(char));
-    s.read((char*)&child5to8_char, sizeof(char));
+    // tree needs to be newly created or cleared externally
+    if (this->root) {
+      OCTOMAP_ERROR_STR("Trying to read into an existing tree.");
+      return s;
+    }
 
-    std::bitset<8> child1to4 ((unsigned long long) child1to4_char);
-    std::bitset<8> child5to8 ((unsigned long long) child5to8_char);
+    // each subtree has at least its root node (2 bytes)
+    std::vector<size_t> offsets(subtree_sizes.size() + 1, 0);
+    for (size_t k = 0; k < subtree_sizes.size(); ++k){
+      if (subtree_sizes[k] < 2 || subtree_sizes[k] > std::numeric_limits<size_t>::max() - offsets[k]){
+        OCTOMAP_ERROR_STR("Invalid subtree size in the file header.");
+        s.setstate(std::ios_base::failbit);
+        return s;
+      }
+      offsets[k+1] = offsets[k] + (size_t) subtree_sizes[k];
+    }
+    std::vector<char> data(offsets.back());
+    std::vector<NODE*> subtree_nodes;
+
+    this->root = this->allocNode();
+    if (!readBinaryTopRecurs(s, this->root, 0, subtree_depth, offsets, data, subtree_nodes)
+        || subtree_nodes.size() != subtree_sizes.size()){
+      OCTOMAP_ERROR_STR("Binary data does not match the subtrees in the file header.");
+      s.setstate(std::ios_base::failbit);
+      subtree_nodes.clear();
+    }
 
-    //     std::cout << "read:  "
-    //        << child1to4.to_string<char,std::char_traits<char>,std::allocator<char> >() << " "
-    //        << child5to8.to_string<char,std::char_traits<char>,std::allocator<char> >() << std::endl;
+    // subtrees are disjoint, only the node pool is shared
+    const bool parallel = this->getNumThreads() > 1 && !this->isNodePoolUsed();
+    std::vector<char> success(subtree_nodes.size(), 0);
+    if (parallel)
+      this->beginThreadSizeTracking();
+#ifdef _OPENMP
+    omp_set_num_threads(this->getNumThreads());
+    #pragma omp parallel for schedule(dynamic) if(parallel)
+#endif
+    for (int k = 0; k < (int) subtree_nodes.size(); ++k){
+      const char* end = &data[0] + offsets[k+1];
+      success[k] = (readBinaryNode(&data[0] + offsets[k], end, subtree_nodes[k]) == end);
+    }
+    if (parallel)
+      this->endThreadSizeTracking();
+
+    for (size_t k = 0; k < success.size(); ++k){
+      if (!success[k]){
+        OCTOMAP_ERROR_STR("Binary data of subtree " << k << " does not match its size in the file header.");
+        s.setstate(std::ios_base::failbit);
+        break;
+      }
+    }
 
+    updateBinaryTopRecurs(this->root, 0, subtree_depth);
+    this->size_changed = true;
+    this->tree_size = OcTreeBaseImpl<NODE,AbstractOccupancyOcTree>::calcNumNodes();  // compute number of nodes
+    return s;
+  }
 
-    // inner nodes default to occupied
-    node->setLogOdds(this->clamping_thres_max);
+  template <class NODE>
+  void OccupancyOcTreeBase<NODE>::getBinarySubtreeSizes(unsigned int subtree_depth,
+                                                        std::vector<uint64_t>& subtree_sizes) const{
+    subtree_sizes.clear();
+    if (this->root && subtree_depth > 0)
+      getBinarySubtreeSizesRecurs(this->root, 0, subtree_depth, subtree_sizes);
+  }
 
-    for (unsigned int i=0; i<4; i++) {
-      if ((child1to4[i*2] == 1) && (child1to4[i*2+1] == 0)) {
-        // child is free leaf
-        this->createNodeChild(node, i);
-        this->getNodeChild(node, i)->setLogOdds(this->clamping_thres_min);
-      }
-      else if ((child1to4[i*2] == 0) && (child1to4[i*2+1] == 1)) {
-        // child is occupied leaf
-        this->createNodeChild(node, i);
-        this->getNodeChild(node, i)->setLogOdds(this->clamping_thres_max);
+  template <class NODE>
+  void OccupancyOcTreeBase<NODE>::getBinarySubtreeSizesRecurs(const NODE* node, unsigned int depth,
+                                                              unsigned int subtree_depth,
+                                                              std::vector<uint64_t>& subtree_sizes) const{
+    for (unsigned int i=0; i<8; i++) {
+      if (this->nodeChildExists(node, i)) {
+        const NODE* child = this->getNodeChild(node, i);
+        if (!this->nodeHasChildren(child))
+          continue;
+        if (depth + 1 == subtree_depth)
+          subtree_sizes.push_back(2 * calcNumInnerNodesRecurs(child));
+        else
+          getBinarySubtreeSizesRecurs(child, depth + 1, subtree_depth, subtree_sizes);
       }
-      else if ((child1to4[i*2] == 1) && (child1to4[i*2+1] == 1)) {
-        // child has children
-        this->createNodeChild(node, i);
-        this->getNodeChild(node, i)->setLogOdds(-200.); // child is unkown, we leave it uninitialized
+    }
+  }
+
+  template <class NODE>
+  size_t OccupancyOcTreeBase<NODE>::calcNumInnerNodesRecurs(const NODE* node) const{
+    size_t num_inner = 1;
+    for (unsigned int i=0; i<8; i++) {
+      if (this->nodeChildExists(node, i)) {
+        const NODE* child = this->getNodeChild(node, i);
+        if (this->nodeHasChildren(child))
+          num_inner += calcNumInnerNodesRecurs(child);
       }
     }
-    for (unsigned int i=0; i<4; i++) {
-      if ((child5to8[i*2] == 1) && (child5to8[i*2+1] == 0)) {
-        // child is free leaf
-        this->createNodeChild(node, i+4);
-        this->getNodeChild(node, i+4)->setLogOdds(this->clamping_thres_min);
+    return num_inner;
+  }
+
+  template <class NODE>
+  uint8_t OccupancyOcTreeBase<NODE>::readBinaryChildren(NODE* node, unsigned char child1to4, unsigned char child5to8){
+    const AbstractOccupancyOcTree::BinaryChildCodes* codes = this->binaryChildCodes();
+    const uint8_t free = codes[child1to4].free | (codes[child5to8].free << 4);
+    const uint8_t occupied = codes[child1to4].occupied | (codes[child5to8].occupied << 4);
+    const uint8_t inner = codes[child1to4].inner | (codes[child5to8].inner << 4);
+
+    // inner nodes default to occupied, their occupancy is set when all children have been read
+    node->setLogOdds(this->clamping_thres_max);
+    for (unsigned int i=0; i<8; i++) {
+      const uint8_t bit = (uint8_t) (1 << i);
+      if (free & bit)
+        this->createNodeChild(node, i)->setLogOdds(this->clamping_thres_min);
+      else if ((occupied | inner) & bit)
+        this->createNodeChild(node, i)->setLogOdds(this->clamping_thres_max);
+      // child is unkown otherwise
+    }
+    return inner;
+  }
+
+  template <class NODE>
+  std::istream& OccupancyOcTreeBase<NODE>::readBinaryNode(std::istream &s, NODE* node){
+    BufferedReader reader(s);
+    readBinaryNode(reader, node);
+    return s;
+  }
+
+  template <class NODE>
+  BufferedReader& OccupancyOcTreeBase<NODE>::readBinaryNode(BufferedReader &s, NODE* node){
+
+    assert(node);
+
+    char child_chars[2];
+    if (!s.read(child_chars, 2))
+      return s;
+    const uint8_t inner = readBinaryChildren(node, (unsigned char) child_chars[0], (unsigned char) child_chars[1]);
+
+    // read children's children and set the label
+    for (unsigned int i=0; i<8; i++) {
+      if (inner & (1 << i)) {
+        NODE* child = this->getNodeChild(node, i);
+        readBinaryNode(s, child);
+        child->setLogOdds(child->getMaxChildLogOdds());
       }
-      else if ((child5to8[i*2] == 0) && (child5to8[i*2+1] == 1)) {
-        // child is occupied leaf
-        this->createNodeChild(node, i+4);
-        this->getNodeChild(node, i+4)->setLogOdds(this->clamping_thres_max);
+    }
+
+    return s;
+  }
+
+  template <class NODE>
+  const char* OccupancyOcTreeBase<NODE>::readBinaryNode(const char* data, const char* end, NODE* node){
+    if (end - data < 2)
+      return NULL;
+    const uint8_t inner = readBinaryChildren(node, (unsigned char) data[0], (unsigned char) data[1]);
+    data += 2;
+
+    for (unsigned int i=0; i<8; i++) {
+      if (inner & (1 << i)) {
+        NODE* child = this->getNodeChild(node, i);
+        data = readBinaryNode(data, end, child);
+        if (data == NULL)
+          return NULL;
+        child->setLogOdds(child->getMaxChildLogOdds());
       }
-      else if ((child5to8[i*2] == 1) && (child5to8[i*2+1] == 1)) {
-        // child has children
-        this->createNodeChild(node, i+4);
-        this->getNodeChild(node, i+4)->setLogOdds(-200.); // set occupancy when all children have been read
+    }
+    return data;
+  }
+
+  template <class NODE>
+  bool OccupancyOcTreeBase<NODE>::readBinaryTopRecurs(std::istream &s, NODE* node, unsigned int depth,
+                                                      unsigned int subtree_depth, const std::vector<size_t>& offsets,
+                                                      std::vector<char>& data, std::vector<NODE*>& subtree_nodes){
+    char child_chars[2];
+    if (!s.read(child_chars, 2))
+      return false;
+    const uint8_t inner = readBinaryChildren(node, (unsigned char) child_chars[0], (unsigned char) child_chars[1]);
+
+    for (unsigned int i=0; i<8; i++) {
+      if (!(inner & (1 << i)))
+        continue;
+      NODE* child = this->getNodeChild(node, i);
+      if (depth + 1 < subtree_depth){
+        if (!readBinaryTopRecurs(s, child, depth + 1, subtree_depth, offsets, data, subtree_nodes))
+          return false;
+      } else {
+        // raw data of the subtree, decoded later
+        const size_t k = subtree_nodes.size();
+        if (k + 1 >= offsets.size() || !s.read(&data[0] + offsets[k], offsets[k+1] - offsets[k]))
+          return false;
+        subtree_nodes.push_back(child);
       }
-      // child is unkown, we leave it uninitialized
     }
+    return true;
+  }
 
-    // read children's children and set the label
+  template <class NODE>
+  void OccupancyOcTreeBase<NODE>::updateBinaryTopRecurs(NODE* node, unsigned int depth, unsigned int subtree_depth){
     for (unsigned int i=0; i<8; i++) {
       if (this->nodeChildExists(node, i)) {
         NODE* child = this->getNodeChild(node, i);
-        if (fabs(child->getLogOdds() + 200.)<1e-3) {
-          readBinaryNode(s, child);
+        if (this->nodeHasChildren(child)){
+          if (depth + 1 < subtree_depth)
+            updateBinaryTopRecurs(child, depth + 1, subtree_depth);
           child->setLogOdds(child->getMaxChildLogOdds());
         }
-      } // end if child exists
-    } // end for children
+      }
+    }
+  }
 
+  template <class NODE>
+  std::ostream& OccupancyOcTreeBase<NODE>::writeBinaryNode(std::ostream &s, const NODE* node) const{
+    BufferedWriter writer(s);
+    writeBinaryNode(writer, node);
     return s;
   }
 
   template <class NODE>
-  std::ostream& OccupancyOcTreeBase<NODE>::writeBinaryNode(std::ostream &s, const NODE* node) const{
+  BufferedWriter& OccupancyOcTreeBase<NODE>::writeBinaryNode(BufferedWriter &s, const NODE* node) const{
 
     assert(node);
 
     // 2 bits for each children, 8 children per node -> 16 bits
-    std::bitset<8> child1to4;
-    std::bitset<8> child5to8;
-
-    // 10 : child is free node
-    // 01 : child is occupied node
+    // 01 : child is free node
+    // 10 : child is occupied node
     // 00 : child is unkown node
     // 11 : child has children
-
-
-    // speedup: only set bits to 1, rest is init with 0 anyway,
-    //          can be one logic expression per bit
-
-    for (unsigned int i=0; i<4; i++) {
+    // (children 1-4 in the first byte, 5-8 in the second, starting at the lowest bits)
+    char child_chars[2] = {0, 0};
+    for (unsigned int i=0; i<8; i++) {
       if (this->nodeChildExists(node, i)) {
         const NODE* child = this->getNodeChild(node, i);
-        if      (this->nodeHasChildren(child))  { child1to4[i*2] = 1; child1to4[i*2+1] = 1; }
-        else if (this->isNodeOccupied(child)) { child1to4[i*2] = 0; child1to4[i*2+1] = 1; }
-        else                            { child1to4[i*2] = 1; child1to4[i*2+1] = 0; }
+        char code;
+        if      (this->nodeHasChildren(child)) code = 3;
+        else if (this->isNodeOccupied(child))   code = 2;
+        else                                     code = 1;
+        child_chars[i/4] |= (char) (code << (2 * (i%4)));
       }
-      else {
-        child1to4[i*2] = 0; child1to4[i*2+1] = 0;
+    }
+    s.write(child_chars, 2);
+
+    // write children's children
+    for (unsigned int i=0; i<8; i++) {
+      if (((child_chars[i/4] >> (2 * (i%4))) & 3) == 3)
+        writeBinaryNode(s, this->getNodeChild(node, i));
+    }
+
+    return s;
+  }
+
+  template <class NODE>
+  bool OccupancyOcTreeBase<NODE>::getBinaryDataBBX(const point3d& bbx_min, const point3d& bbx_max,
+                                                   std::vector<char>& data, size_t& num_nodes) const{
+    data.clear();
+    num_nodes = 0;
+    OcTreeKey min_key, max_key;
+    if (!this->coordToKeyChecked(bbx_min, min_key) || !this->coordToKeyChecked(bbx_max, max_key)){
+      OCTOMAP_ERROR_STR("Bounding box " << bbx_min << " - " << bbx_max << " is out of OcTree bounds");
+      return false;
+    }
+    for (unsigned int i=0; i<3; i++){
+      if (min_key[i] > max_key[i]){
+        OCTOMAP_ERROR_STR("Invalid bounding box " << bbx_min << " - " << bbx_max);
+        return false;
       }
     }
 
-    for (unsigned int i=0; i<4; i++) {
-      if (this->nodeChildExists(node, i+4)) {
-        const NODE* child = this->getNodeChild(node, i+4);
-        if      (this->nodeHasChildren(child))  { child5to8[i*2] = 1; child5to8[i*2+1] = 1; }
-        else if (this->isNodeOccupied(child)) { child5to8[i*2] = 0; child5to8[i*2+1] = 1; }
-        else                            { child5to8[i*2] = 1; child5to8[i*2+1] = 0; }
+    if (this->root){
+      OcTreeKey root_key(this->tree_max_val, this->tree_max_val, this->tree_max_val);
+      if (writeBinaryNodeBBX(this->root, root_key, 0, min_key, max_key, data, num_nodes))
+        num_nodes++;
+    }
+    return true;
+  }
+
+  template <class NODE>
+  bool OccupancyOcTreeBase<NODE>::getBinarySubtreeData(const OcTreeKey& key, unsigned int depth,
+                                                       std::vector<char>& data, size_t& num_nodes) const{
+    data.clear();
+    num_nodes = 0;
+    if (depth >= this->tree_depth){
+      OCTOMAP_ERROR("Subtree depth %u needs to be less than the tree depth %u", depth, this->tree_depth);
+      return false;
+    }
+
+    // key range of the node, a leaf above it is split
+    const key_type center_offset_key = this->tree_max_val >> depth;
+    OcTreeKey min_key = computeIndexKey(this->tree_depth - depth, key);
+    OcTreeKey max_key, node_key;
+    for (unsigned int i=0; i<3; i++){
+      max_key[i] = min_key[i] + 2 * center_offset_key - 1;
+      node_key[i] = min_key[i] + center_offset_key;
+    }
+
+    const NODE* node = this->search(key, depth);
+    if (node && writeBinaryNodeBBX(node, node_key, depth, min_key, max_key, data, num_nodes))
+      num_nodes++;
+    return true;
+  }
+
+  template <class NODE>
+  bool OccupancyOcTreeBase<NODE>::writeBinaryNodeBBX(const NODE* node, const OcTreeKey& key, unsigned int depth,
+                                                     const OcTreeKey& min_key, const OcTreeKey& max_key,
+                                                     std::vector<char>& data, size_t& num_nodes) const{
+    const size_t pos = data.size();
+    data.resize(pos + 2);
+
+    // leafs are only split when they cross the bounds, all children have the leaf's occupancy
+    const bool split_leaf = !this->nodeHasChildren(node);
+    const key_type center_offset_key = this->tree_max_val >> (depth + 1);
+    char child_chars[2] = {0, 0};
+    for (unsigned int i=0; i<8; i++) {
+      if (!split_leaf && !this->nodeChildExists(node, i))
+        continue;
+      const NODE* child = split_leaf ? node : this->getNodeChild(node, i);
+      OcTreeKey child_key;
+      computeChildKey(i, center_offset_key, key, child_key);
+
+      bool inside = true;
+      bool overlap = true;
+      for (unsigned int j=0; j<3; j++) {
+        const key_type child_min = child_key[j] - center_offset_key;
+        const key_type child_max = center_offset_key ? child_key[j] + center_offset_key - 1 : child_key[j];
+        inside = inside && child_min >= min_key[j] && child_max <= max_key[j];
+        overlap = overlap && child_max >= min_key[j] && child_min <= max_key[j];
       }
+      if (!overlap)
+        continue;
+
+      char code = 0;
+      if (inside && !this->nodeHasChildren(child))
+        code = this->isNodeOccupied(child) ? 2 : 1;
       else {
-        child5to8[i*2] = 0; child5to8[i*2+1] = 0;
+        const size_t child_pos = data.size();
+        if (writeBinaryNodeBBX(child, child_key, depth + 1, min_key, max_key, data, num_nodes)){
+          code = 3;
+          // prune 8 equal leafs (01010101: free, 10101010: occupied)
+          const unsigned char first = (unsigned char) data[child_pos];
+          if (data.size() == child_pos + 2 && first == (unsigned char) data[child_pos + 1]
+              && (first == 0x55 || first == 0xAA)){
+            data.resize(child_pos);
+            num_nodes -= 8;
+            code = (first == 0x55) ? 1 : 2;
+          }
+        }
+      }
+      if (code){
+        child_chars[i/4] |= (char) (code << (2 * (i%4)));
+        num_nodes++;
       }
     }
-    //     std::cout << "wrote: "
-    //        << child1to4.to_string<char,std::char_traits<char>,std::allocator<char> >() << " "
-    //        << child5to8.to_string<char,std::char_traits<char>,std::allocator<char> >() << std::endl;
 
-    char child1to4_char = (char) child1to4.to_ulong();
-    char child5to8_char = (char) child5to8.to_ulong();
+    if (child_chars[0] == 0 && child_chars[1] == 0){
+      data.resize(pos);
+      return false;
+    }
+    data[pos] = child_chars[0];
+    data[pos + 1] = child_chars[1];
+    return true;
+  }
 
-    s.write((char*)&child1to4_char, sizeof(char));
-    s.write((char*)&child5to8_char, sizeof(char));
+  template <class NODE>
+  bool OccupancyOcTreeBase<NODE>::readBinarySubtreeData(std::istream &s, const OcTreeKey& key, unsigned int depth,
+                                                        size_t& num_nodes){
+    num_nodes = 0;
+    if (depth >= this->tree_depth){
+      OCTOMAP_ERROR("Subtree depth %u needs to be less than the tree depth %u", depth, this->tree_depth);
+      return false;
+    }
+
+    // find or create the node, existing leafs on the way are expanded to keep their occupancy
+    bool created = false;
+    if (this->root == NULL){
+      this->root = this->allocNode();
+      this->tree_size++;
+      created = true;
+    }
+    std::vector<NODE*> path;
+    NODE* node = this->root;
+    for (unsigned int d = 0; d < depth; ++d){
+      path.push_back(node);
+      const unsigned int pos = computeChildIdx(key, this->tree_depth - 1 - d);
+      if (!this->nodeChildExists(node, pos)){
+        if (!created && !this->nodeHasChildren(node))
+          this->expandNode(node);
+        else {
+          this->createNodeChild(node, pos);
+          created = true;
+        }
+      }
+      node = this->getNodeChild(node, pos);
+    }
+    if (!created && !this->nodeHasChildren(node))
+      this->expandNode(node);
+
+    bool success;
+    {
+      BufferedReader reader(s);
+      success = readBinarySubtreeRecurs(reader, node, num_nodes);
+    }
+    if (!success){
+      OCTOMAP_ERROR_STR("Error reading subtree data, the tree may be partially updated");
+      return false;
+    }
+    num_nodes++;
+
+    node->setLogOdds(node->getMaxChildLogOdds());
+    for (typename std::vector<NODE*>::reverse_iterator it = path.rbegin(); it != path.rend(); ++it)
+      (*it)->setLogOdds((*it)->getMaxChildLogOdds());
+    return true;
+  }
+
+  template <class NODE>
+  bool OccupancyOcTreeBase<NODE>::readBinarySubtreeRecurs(BufferedReader &s, NODE* node, size_t& num_nodes){
+    char child_chars[2];
+    if (!s.read(child_chars, 2))
+      return false;
+    const AbstractOccupancyOcTree::BinaryChildCodes* codes = this->binaryChildCodes();
+    const unsigned char child1to4 = (unsigned char) child_chars[0];
+    const unsigned char child5to8 = (unsigned char) child_chars[1];
+    const uint8_t free = codes[child1to4].free | (codes[child5to8].free << 4);
+    const uint8_t inner = codes[child1to4].inner | (codes[child5to8].inner << 4);
+    const uint8_t known = free | inner | codes[child1to4].occupied | (codes[child5to8].occupied << 4);
+    // inner nodes have at least one known child
+    if (!known)
+      return false;
 
-    // write children's children
     for (unsigned int i=0; i<8; i++) {
-      if (this->nodeChildExists(node, i)) {
-        const NODE* child = this->getNodeChild(node, i);
-        if (this->nodeHasChildren(child)) {
-          writeBinaryNode(s, child);
+      const uint8_t bit = (uint8_t) (1 << i);
+      if (!(known & bit))
+        continue; // unknown in the subtree: keep the tree's child
+
+      NODE* child;
+      if (!this->nodeChildExists(node, i))
+        child = this->createNodeChild(node, i);
+      else {
+        child = this->getNodeChild(node, i);
+        if ((inner & bit) && !this->nodeHasChildren(child))
+          this->expandNode(child);
+        else if (!(inner & bit) && this->nodeHasChildren(child)){
+          size_t num_deleted = 0;
+          this->calcNumNodesRecurs(child, num_deleted);
+          this->deleteNodeChildrenRecurs(child);
+          this->changeTreeSize(-(long) num_deleted);
         }
       }
+      num_nodes++;
+
+      if (inner & bit){
+        if (!readBinarySubtreeRecurs(s, child, num_nodes))
+          return false;
+        child->setLogOdds(child->getMaxChildLogOdds());
+      } else
+        child->setLogOdds((free & bit) ? this->clamping_thres_min : this->clamping_thres_max);
     }
+    return true;
+  }
 
-    return s;
+  template <class NODE>
+  bool OccupancyOcTreeBase<NODE>::writeDelta(std::ostream& s) const {
+    std::vector<MortonKey> sorted_keys;
+    sorted_keys.reserve(changed_keys.size());
+    for (KeyBoolMap::const_iterator it = changed_keys.begin(); it != changed_keys.end(); ++it)
+      sorted_keys.push_back(MortonKey(it->first));
+    std::sort(sorted_keys.begin(), sorted_keys.end());
+
+    BufferedWriter writer(s);
+    writer.write("OTDL", 4);
+    writer.put(char(1)); // version
+    writer.write(this->resolution);
+    writer.writeVarint(sorted_keys.size());
+
+    uint64_t previous = 0;
+    for (size_t i = 0; i < sorted_keys.size(); ++i){
+      const NODE* node = this->search(sorted_keys[i].toKey());
+      uint64_t entry = (sorted_keys[i].code - previous) << 2;
+      previous = sorted_keys[i].code;
+      if (!node)
+        writer.writeVarint(entry | 1);
+      else if (node->getLogOdds() <= this->clamping_thres_min)
+        writer.writeVarint(entry | 2);
+      else if (node->getLogOdds() >= this->clamping_thres_max)
+        writer.writeVarint(entry | 3);
+      else {
+        writer.writeVarint(entry);
+        writer.write(node->getLogOdds());
+      }
+    }
+    return writer.flush();
+  }
+
+  template <class NODE>
+  bool OccupancyOcTreeBase<NODE>::applyDelta(std::istream& s){
+    BufferedReader reader(s);
+    char magic[4];
+    char version = 0;
+    double res = 0.0;
+    uint64_t num_entries = 0;
+    if (!reader.read(magic, 4) || !reader.read(version) || !reader.read(res) || !reader.readVarint(num_entries)){
+      OCTOMAP_ERROR_STR("Error reading delta header");
+      return false;
+    }
+    if (strncmp(magic, "OTDL", 4) != 0 || version != 1){
+      OCTOMAP_ERROR_STR("Stream does not contain a delta of version 1");
+      return false;
+    }
+    if (fabs(res - this->resolution) > 1e-6 * this->resolution){
+      OCTOMAP_ERROR_STR("Resolution of delta (" << res << ") does not match the tree (" << this->resolution << ")");
+      return false;
+    }
+
+    // only the changed subtrees are updated afterwards
+    const bool dirty_tracking = use_dirty_tracking;
+    use_dirty_tracking = true;
+    bool success = true;
+    uint64_t code = 0;
+    for (uint64_t i = 0; i < num_entries; ++i){
+      uint64_t entry;
+      float value = 0.0f;
+      if (!reader.readVarint(entry) || ((entry & 3) == 0 && !reader.read(value))){
+        OCTOMAP_ERROR_STR("Delta ended after " << i << " of " << num_entries << " entries");
+        success = false;
+        break;
+      }
+      code += entry >> 2;
+      if (code >> 48){
+        OCTOMAP_ERROR_STR("Invalid key in delta entry " << i);
+        success = false;
+        break;
+      }
+
+      OcTreeKey key = MortonKey(code).toKey();
+      switch (entry & 3){
+      case 0: setNodeValue(key, value, true); break;
+      case 1: this->deleteNode(key); markDirty(key); break;
+      case 2: setNodeValue(key, this->clamping_thres_min, true); break;
+      case 3: setNodeValue(key, this->clamping_thres_max, true); break;
+      }
+    }
+    updateDirtyInnerOccupancy(true);
+    use_dirty_tracking = dirty_tracking;
+    return success;
   }
 
   //-- Occupancy queries on nodes:
@@ -0,0 +1,174 @@
+/*
+ * OctoMap - An Efficient Probabilistic 3D Mapping Framework Based on Octrees
+ * http://octomap.github.com/
+ *
+ * Copyright (c) 2009-2013, K.M. Wurm and A. Hornung, University of Freiburg
+ * All rights reserved.
+ * License: New BSD
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the University of Freiburg nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef OCTOMAP_QUANTIZED_OCTREE_H
+#define OCTOMAP_QUANTIZED_OCTREE_H
+
+
+#include <octomap/OcTreeNode.h>
+#include <octomap/OccupancyOcTreeBase.h>
+
+namespace octomap {
+
+  /**
+   * Occupancy octree which keeps all log-odds values on a grid of quantization
+   * levels, so that they can be stored in 8 or 16 bits. The quantization step is
+   * a power of two, which makes all sums of levels exact in float: hit and miss
+   * updates as well as the clamping thresholds are rounded to the grid once when
+   * the sensor model is set, updateNodeLogOdds() then adds and clamps them as in
+   * OcTree and the values never leave the grid.
+   *
+   * The levels are written to .ot files instead of floats (2 or 3 instead of 5 bytes
+   * per node), reading them back is lossless. In memory, the nodes are OcTreeNodes:
+   * the float shares the alignment padding of the children pointer, a smaller value
+   * type would not make them smaller. Values set directly at nodes (e.g. with
+   * OcTreeNode::setLogOdds()) are rounded when the tree is written.
+   */
+  class QuantizedOcTree : public OccupancyOcTreeBase <OcTreeNode> {
+
+  public:
+    /**
+     * Default constructor, sets resolution of leafs and the quantization
+     * (see setQuantization()).
+     */
+    QuantizedOcTree(double resolution, unsigned int bits = 16, float step = 0.0f);
+
+    /// virtual constructor: creates a new object of same type
+    /// (Covariant return type requires an up-to-date compiler)
+    QuantizedOcTree* create() const {return new QuantizedOcTree(resolution, quantization_bits, quantization_step); }
+
+    std::string getTreeType() const {return "QuantizedOcTree";}
+
+    /**
+     * Sets the number of bits (8 or 16) and the step (in log odds) of the quantization.
+     * The step is rounded up to a power of two and increased if the clamping range does
+     * not fit into the bits, 0 selects the finest step. All nodes of the tree are rounded
+     * to the new levels.
+     */
+    void setQuantization(unsigned int bits, float step = 0.0f);
+
+    /// @return number of bits per stored log-odds value
+    unsigned int getQuantizationBits() const { return quantization_bits; }
+
+    /// @return quantization step in log odds
+    float getQuantizationStep() const { return quantization_step; }
+
+    /// @return level nearest to log_odds within the clamping thresholds
+    inline int quantizeLevel(float log_odds) const {
+      int level = int(floor(log_odds * inv_quantization_step + 0.5f));
+      return std::min(std::max(level, level_min), level_max);
+    }
+
+    /// @return value of the level nearest to log_odds within the clamping thresholds
+    inline float quantize(float log_odds) const {
+      return float(quantizeLevel(log_odds)) * quantization_step;
+    }
+
+    // sensor model, rounded to the quantization levels. A clamping range which does not
+    // fit into the bits with the current step increases the step, see setQuantization().
+    virtual void setProbHit(double prob);
+    virtual void setProbMiss(double prob);
+    virtual void setClampingThresMin(double thresProb);
+    virtual void setClampingThresMax(double thresProb);
+
+    /// Sets the node to the quantized log_odds_value, see OccupancyOcTreeBase::setNodeValue()
+    virtual OcTreeNode* setNodeValue(const OcTreeKey& key, float log_odds_value, bool lazy_eval = false);
+    using OccupancyOcTreeBase<OcTreeNode>::setNodeValue;
+
+    /// Reads the quantization and all nodes, the tree needs to be empty
+    std::istream& readData(std::istream &s);
+
+    /// Writes the quantization and all nodes with their levels
+    std::ostream& writeData(std::ostream &s) const;
+
+  protected:
+    /// hit and miss are on the grid and only need clamping, any other update is rounded
+    virtual void updateNodeLogOdds(OcTreeNode* occupancyNode, const float& update) const;
+
+    /// rounds the sensor model to the quantization levels
+    void updateQuantizedSensorModel();
+
+    /// requantizes with the smallest sufficient step if the clamping range does not fit, else updates the sensor model
+    void updateQuantizedClamping();
+
+    /// @return smallest power of two step with which the clamping range fits into bits
+    float minQuantizationStep(unsigned int bits) const;
+
+    void quantizeNodesRecurs(OcTreeNode* node);
+    template <typename LEVEL>
+    void writeNodesQuantizedRecurs(const OcTreeNode* node, BufferedWriter &s) const;
+    template <typename LEVEL>
+    void readNodesQuantizedRecurs(OcTreeNode* node, BufferedReader &s, float step);
+
+    unsigned int quantization_bits;
+    float quantization_step;
+    float inv_quantization_step;
+    int level_min;
+    int level_max;
+
+    // sensor model as set, before rounding (log odds)
+    float sensor_hit_log;
+    float sensor_miss_log;
+    float sensor_clamping_min;
+    float sensor_clamping_max;
+
+    /**
+     * Static member object which ensures that this OcTree's prototype
+     * ends up in the classIDMapping only once. You need this as a 
+     * static member in any derived octree class in order to read .ot
+     * files through the AbstractOcTree factory. You should also call
+     * ensureLinking() once from the constructor.
+     */
+    class StaticMemberInitializer{
+    public:
+      StaticMemberInitializer() {
+        QuantizedOcTree* tree = new QuantizedOcTree(0.1);
+        tree->clearKeyRays();
+        AbstractOcTree::registerTreeType(tree);
+      }
+
+      /**
+       * Dummy function to ensure that MSVC does not drop the
+       * StaticMemberInitializer, causing this tree failing to register.
+       * Needs to be called from the constructor of this octree.
+       */
+      void ensureLinking() {};
+    };
+
+    /// to ensure static initialization (only once)
+    static StaticMemberInitializer quantizedOcTreeMemberInit;
+  };
+
+} // end namespace
+
+#endif
@@ -0,0 +1,191 @@
+/*
+ * OctoMap - An Efficient Probabilistic 3D Mapping Framework Based on Octrees
+ * http://octomap.github.com/
+ *
+ * Copyright (c) 2009-2013, K.M. Wurm and A. Hornung, University of Freiburg
+ * All rights reserved.
+ * License: New BSD
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the University of Freiburg nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef OCTOMAP_TILED_OCTREE_H
+#define OCTOMAP_TILED_OCTREE_H
+
+
+#include <list>
+#include <string>
+#include <vector>
+
+#include "octomap_types.h"
+#include "OcTreeKey.h"
+
+namespace octomap {
+
+  /**
+   * Occupancy map which is larger than the available memory: the key space is
+   * partitioned into tiles (the subtrees at tile_depth), each stored in its own
+   * file in a directory, next to an index of all tiles. Tiles are loaded on demand
+   * into one in-memory tree of type TREE (an OccupancyOcTreeBase) when search(),
+   * updateNode(), insertPointCloud() or castRay() touch them. If the estimated
+   * memory usage exceeds the budget, the least recently used tiles are written
+   * back (if modified) and removed from memory before the next tiles are loaded.
+   *
+   * Tiles are stored with the complete node data (lossless, see
+   * OcTreeBaseImpl::writeSubtreeData()). Nodes returned by search() and
+   * updateNode() are valid until the next call which can load tiles. Queries
+   * above tile_depth and changes made to getTree() directly do not load or
+   * write back tiles.
+   */
+  template <class TREE>
+  class TiledOcTree {
+  public:
+    typedef typename TREE::NodeType NodeType;
+
+    /**
+     * Opens the tiled map in directory (which needs to exist). If it contains a tile
+     * index, its resolution and tile depth are used, otherwise a new map is created.
+     * If the index exists but cannot be read, the map is not opened (see isOpen()):
+     * it stays empty and nothing is written to directory.
+     *
+     * @param tile_depth depth of the tiles' root nodes (1 .. tree depth)
+     * @param max_memory memory budget in bytes for the loaded tiles
+     */
+    TiledOcTree(const std::string& directory, double resolution, unsigned int tile_depth = 8,
+                size_t max_memory = DEFAULT_MAX_MEMORY);
+    /// writes back all modified tiles, see flush()
+    ~TiledOcTree();
+
+    /// @return false if the tile index in the directory could not be read
+    bool isOpen() const { return is_open; }
+
+    /**
+     * Splits tree into tiles at tile_depth and writes them with the tile index
+     * to directory (which needs to exist), to be opened with TiledOcTree().
+     */
+    static bool writeTiles(const TREE& tree, const std::string& directory, unsigned int tile_depth);
+
+    NodeType* search(const OcTreeKey& key, unsigned int depth = 0);
+    NodeType* search(const point3d& value, unsigned int depth = 0);
+
+    /// TREE::updateNode() after loading the tile of key
+    NodeType* updateNode(const OcTreeKey& key, float log_odds_update, bool lazy_eval = false);
+    NodeType* updateNode(const OcTreeKey& key, bool occupied, bool lazy_eval = false);
+    NodeType* updateNode(const point3d& value, bool occupied, bool lazy_eval = false);
+
+    /// integrates a scan like TREE::insertPointCloud(), after loading all tiles it updates
+    void insertPointCloud(const Pointcloud& scan, const point3d& sensor_origin,
+                          double maxrange = -1., bool lazy_eval = false);
+
+    /**
+     * TREE::castRay() after loading all stored tiles along the ray, up to maxRange
+     * and (unless ignoreUnknownCells) up to the first tile which does not exist.
+     */
+    bool castRay(const point3d& origin, const point3d& direction, point3d& end,
+                 bool ignoreUnknownCells = false, double maxRange = -1.0);
+
+    /// writes all modified tiles and the tile index, loaded tiles stay in memory (fails if not isOpen())
+    bool flush();
+
+    /// the loaded part of the map
+    const TREE& getTree() const { return tree; }
+    double getResolution() const { return tree.getResolution(); }
+    unsigned int getTileDepth() const { return tile_depth; }
+    /// key of the tile containing key (its lower corner)
+    OcTreeKey getTileKey(const OcTreeKey& key) const { return computeIndexKey(tile_level, key); }
+
+    size_t getMaxMemory() const { return max_memory; }
+    void setMaxMemory(size_t max_memory) { this->max_memory = max_memory; }
+    /// estimated memory usage of the loaded tiles, O(1)
+    size_t estimatedMemoryUsage() const {
+      return tree.size() * (tree.memoryUsageNode() + sizeof(NodeType*));
+    }
+
+    /// number of tiles in the map (stored or in memory)
+    size_t numTiles() const { return tiles.size(); }
+    size_t numLoadedTiles() const { return lru.size(); }
+    /// number of tiles loaded / evicted since construction
+    size_t numTileLoads() const { return num_loads; }
+    size_t numTileEvictions() const { return num_evictions; }
+
+    static const size_t DEFAULT_MAX_MEMORY = 256 << 20;
+
+  protected:
+    struct Tile {
+      bool loaded;
+      bool modified;
+      bool stored;
+      typename std::list<OcTreeKey>::iterator lru_pos;
+    };
+    typedef unordered_ns::unordered_map<OcTreeKey, Tile, OcTreeKey::KeyHash> TileMap;
+
+    /**
+     * Makes the tile containing key available: stored tiles are loaded, new tiles
+     * are only created if modify is set. Marks the tile as most recently used.
+     * @return false if the tile does not exist
+     */
+    bool useTile(const OcTreeKey& key, bool modify);
+    void loadTile(const OcTreeKey& tile_key, Tile& tile);
+    /// writes back (if modified) and removes the tile from memory
+    void evictTile(const OcTreeKey& tile_key);
+    /// evicts the least recently used tiles until the memory budget is met
+    void evictTiles();
+    bool writeTile(const OcTreeKey& tile_key, Tile& tile);
+    /// updates the occupancy of the nodes above the tile
+    void updateTileParents(const OcTreeKey& tile_key);
+
+    /// reads the tile index, found is set if it exists. @return false if it exists but is invalid
+    bool readIndex(bool& found);
+    static bool writeIndex(const std::string& directory, double resolution, unsigned int tile_depth,
+                           const std::vector<OcTreeKey>& tile_keys);
+    static std::string indexFilename(const std::string& directory);
+    static std::string tileFilename(const std::string& directory, const OcTreeKey& tile_key, unsigned int tile_level);
+
+    TREE tree;
+    std::string directory;
+    /// false if the tile index could not be read, then no tiles or index are written
+    bool is_open;
+    unsigned int tile_depth;
+    /// tree_depth - tile_depth, number of key bits within a tile
+    unsigned int tile_level;
+    size_t max_memory;
+
+    TileMap tiles;
+    /// loaded tiles, most recently used first
+    std::list<OcTreeKey> lru;
+    /// bounding box of all tile keys
+    OcTreeKey tiles_min;
+    OcTreeKey tiles_max;
+
+    size_t num_loads;
+    size_t num_evictions;
+  };
+
+} // end namespace
+
+#include "octomap/TiledOcTree.hxx"
+
+#endif
@@ -0,0 +1,474 @@
+/*
+ * OctoMap - An Efficient Probabilistic 3D Mapping Framework Based on Octrees
+ * http://octomap.github.com/
+ *
+ * Copyright (c) 2009-2013, K.M. Wurm and A. Hornung, University of Freiburg
+ * All rights reserved.
+ * License: New BSD
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the University of Freiburg nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include <stdio.h>
+#include <cmath>
+#include <fstream>
+#include <limits>
+#include <sstream>
+
+namespace octomap {
+
+  template <class TREE>
+  TiledOcTree<TREE>::TiledOcTree(const std::string& directory, double resolution, unsigned int tile_depth,
+                                 size_t max_memory)
+    : tree(resolution), directory(directory), is_open(true), tile_depth(tile_depth), max_memory(max_memory),
+      tiles_min(std::numeric_limits<key_type>::max(), std::numeric_limits<key_type>::max(),
+                std::numeric_limits<key_type>::max()),
+      tiles_max(0, 0, 0), num_loads(0), num_evictions(0)
+  {
+    tree.enableDirtyTracking(true);
+    bool index_found = false;
+    if (!readIndex(index_found)){
+      // never overwrite an index which could not be read, its tiles would be lost
+      OCTOMAP_ERROR_STR("Tiled map in " << directory << " not opened, nothing will be written");
+      is_open = false;
+      tiles.clear();
+      tiles_min = OcTreeKey(std::numeric_limits<key_type>::max(), std::numeric_limits<key_type>::max(),
+                            std::numeric_limits<key_type>::max());
+      tiles_max = OcTreeKey(0, 0, 0);
+    }
+    if ((!index_found || !is_open) && (this->tile_depth < 1 || this->tile_depth > tree.getTreeDepth())){
+      OCTOMAP_ERROR("Tile depth %u needs to be in [1, %u], using %u\n", tile_depth, tree.getTreeDepth(),
+                    tree.getTreeDepth() / 2);
+      this->tile_depth = tree.getTreeDepth() / 2;
+    }
+    tile_level = tree.getTreeDepth() - this->tile_depth;
+  }
+
+  template <class TREE>
+  TiledOcTree<TREE>::~TiledOcTree() {
+    if (is_open)
+      flush();
+  }
+
+  template <class TREE>
+  bool TiledOcTree<TREE>::writeTiles(const TREE& tree, const std::string& directory, unsigned int tile_depth) {
+    if (tile_depth < 1 || tile_depth > tree.getTreeDepth()){
+      OCTOMAP_ERROR("Tile depth %u needs to be in [1, %u]\n", tile_depth, tree.getTreeDepth());
+      return false;
+    }
+    const unsigned int tile_level = tree.getTreeDepth() - tile_depth;
+    const unsigned int tile_keys = 1 << tile_level;
+
+    bool success = true;
+    std::vector<OcTreeKey> tile_keys_written;
+    for (typename TREE::tree_iterator it = tree.begin_tree(tile_depth), end = tree.end_tree(); it != end; ++it){
+      if (!it.isLeaf())
+        continue;
+
+      // leafs above tile_depth cover several tiles
+      const OcTreeKey first = it.getIndexKey();
+      const unsigned int extent = 1 << (tree.getTreeDepth() - it.getDepth());
+      for (unsigned int x = first[0]; x < first[0] + extent; x += tile_keys){
+        for (unsigned int y = first[1]; y < first[1] + extent; y += tile_keys){
+          for (unsigned int z = first[2]; z < first[2] + extent; z += tile_keys){
+            OcTreeKey tile_key(x, y, z);
+            std::string filename = tileFilename(directory, tile_key, tile_level);
+            std::ofstream file(filename.c_str(), std::ios_base::out | std::ios_base::binary);
+            if (!file.is_open() || !tree.writeSubtreeData(file, tile_key, tile_depth)){
+              OCTOMAP_ERROR_STR("Error writing tile to " << filename);
+              success = false;
+            } else
+              tile_keys_written.push_back(tile_key);
+          }
+        }
+      }
+    }
+    return writeIndex(directory, tree.getResolution(), tile_depth, tile_keys_written) && success;
+  }
+
+  template <class TREE>
+  typename TiledOcTree<TREE>::NodeType* TiledOcTree<TREE>::search(const OcTreeKey& key, unsigned int depth) {
+    if (depth == 0 || depth >= tile_depth){
+      evictTiles();
+      useTile(key, false);
+    }
+    return tree.search(key, depth);
+  }
+
+  template <class TREE>
+  typename TiledOcTree<TREE>::NodeType* TiledOcTree<TREE>::search(const point3d& value, unsigned int depth) {
+    OcTreeKey key;
+    if (!tree.coordToKeyChecked(value, key))
+      return NULL;
+    return search(key, depth);
+  }
+
+  template <class TREE>
+  typename TiledOcTree<TREE>::NodeType* TiledOcTree<TREE>::updateNode(const OcTreeKey& key, float log_odds_update,
+                                                                      bool lazy_eval) {
+    evictTiles();
+    useTile(key, true);
+    return tree.updateNode(key, log_odds_update, lazy_eval);
+  }
+
+  template <class TREE>
+  typename TiledOcTree<TREE>::NodeType* TiledOcTree<TREE>::updateNode(const OcTreeKey& key, bool occupied,
+                                                                      bool lazy_eval) {
+    evictTiles();
+    useTile(key, true);
+    return tree.updateNode(key, occupied, lazy_eval);
+  }
+
+  template <class TREE>
+  typename TiledOcTree<TREE>::NodeType* TiledOcTree<TREE>::updateNode(const point3d& value, bool occupied,
+                                                                      bool lazy_eval) {
+    OcTreeKey key;
+    if (!tree.coordToKeyChecked(value, key))
+      return NULL;
+    return updateNode(key, occupied, lazy_eval);
+  }
+
+  template <class TREE>
+  void TiledOcTree<TREE>::insertPointCloud(const Pointcloud& scan, const point3d& sensor_origin,
+                                           double maxrange, bool lazy_eval) {
+    KeySet free_cells, occupied_cells;
+    tree.computeUpdate(scan, sensor_origin, free_cells, occupied_cells, maxrange);
+
+    evictTiles();
+    std::vector<std::pair<OcTreeKey, float> > updates;
+    updates.reserve(free_cells.size() + occupied_cells.size());
+    for (KeySet::iterator it = free_cells.begin(); it != free_cells.end(); ++it)
+      updates.push_back(std::pair<OcTreeKey, float>(*it, tree.getProbMissLog()));
+    for (KeySet::iterator it = occupied_cells.begin(); it != occupied_cells.end(); ++it)
+      updates.push_back(std::pair<OcTreeKey, float>(*it, tree.getProbHitLog()));
+
+    OcTreeKey last_tile_key;
+    for (size_t i = 0; i < updates.size(); ++i){
+      OcTreeKey tile_key = getTileKey(updates[i].first);
+      if (i == 0 || tile_key != last_tile_key){
+        useTile(tile_key, true);
+        last_tile_key = tile_key;
+      }
+    }
+    tree.updateNodes(updates, lazy_eval);
+  }
+
+  template <class TREE>
+  bool TiledOcTree<TREE>::castRay(const point3d& origin, const point3d& direction, point3d& end,
+                                  bool ignoreUnknownCells, double maxRange) {
+    OcTreeKey key;
+    if (direction.norm() == 0.0 || !tree.coordToKeyChecked(origin, key))
+      return tree.castRay(origin, direction, end, ignoreUnknownCells, maxRange);
+
+    // 3D DDA over the tiles along the ray (see castRay())
+    const point3d dir = direction.normalized();
+    const double resolution = tree.getResolution();
+    const double tile_size = resolution * (1 << tile_level);
+    const int num_tiles = 1 << tile_depth;
+    const double center_offset = double(1 << (tree.getTreeDepth() - 1)) * resolution;
+    int tile[3];
+    int step[3];
+    double t_max[3];
+    double t_delta[3];
+    for (unsigned int i = 0; i < 3; ++i){
+      tile[i] = key[i] >> tile_level;
+      if (dir(i) > 0.0) step[i] = 1;
+      else if (dir(i) < 0.0) step[i] = -1;
+      else step[i] = 0;
+
+      if (step[i] != 0){
+        double border = (tile[i] + (step[i] > 0 ? 1 : 0)) * tile_size - center_offset;
+        t_max[i] = (border - origin(i)) / dir(i);
+        t_delta[i] = tile_size / fabs(dir(i));
+      } else {
+        t_max[i] = std::numeric_limits<double>::max();
+        t_delta[i] = std::numeric_limits<double>::max();
+      }
+    }
+
+    evictTiles();
+    while (true){
+      OcTreeKey tile_key(tile[0] << tile_level, tile[1] << tile_level, tile[2] << tile_level);
+      // ray ends in an unknown tile at the latest
+      if (!useTile(tile_key, false) && !ignoreUnknownCells)
+        break;
+
+      // no more tiles in the direction of the ray
+      bool leaving = tiles.empty();
+      for (unsigned int i = 0; i < 3; ++i){
+        leaving = leaving || (tile_key[i] < tiles_min[i] && step[i] <= 0)
+                          || (tile_key[i] > tiles_max[i] && step[i] >= 0);
+      }
+      if (leaving)
+        break;
+
+      unsigned int dim = 0;
+      if (t_max[1] < t_max[dim]) dim = 1;
+      if (t_max[2] < t_max[dim]) dim = 2;
+      if (maxRange > 0.0 && t_max[dim] > maxRange)
+        break;
+
+      // crossing close to an edge: the ray may also pass the neighbor tiles there
+      for (unsigned int i = 0; i < 3; ++i){
+        if (i != dim && step[i] != 0 && t_max[i] - t_max[dim] < 0.5 * resolution){
+          int neighbor = tile[i] + step[i];
+          if (neighbor >= 0 && neighbor < num_tiles){
+            OcTreeKey neighbor_key = tile_key;
+            neighbor_key[i] = neighbor << tile_level;
+            useTile(neighbor_key, false);
+          }
+        }
+      }
+
+      tile[dim] += step[dim];
+      if (tile[dim] < 0 || tile[dim] >= num_tiles)
+        break;
+      t_max[dim] += t_delta[dim];
+    }
+
+    return tree.castRay(origin, direction, end, ignoreUnknownCells, maxRange);
+  }
+
+  template <class TREE>
+  bool TiledOcTree<TREE>::flush() {
+    if (!is_open)
+      return false;
+    if (tree.numDirtyNodes() > 0)
+      tree.updateDirtyInnerOccupancy();
+
+    bool success = true;
+    for (std::list<OcTreeKey>::const_iterator it = lru.begin(); it != lru.end(); ++it){
+      Tile& tile = tiles.find(*it)->second;
+      if (tile.modified)
+        success = writeTile(*it, tile) && success;
+    }
+
+    std::vector<OcTreeKey> stored_keys;
+    for (typename TileMap::const_iterator it = tiles.begin(); it != tiles.end(); ++it){
+      if (it->second.stored)
+        stored_keys.push_back(it->first);
+    }
+    return writeIndex(directory, tree.getResolution(), tile_depth, stored_keys) && success;
+  }
+
+  template <class TREE>
+  bool TiledOcTree<TREE>::useTile(const OcTreeKey& key, bool modify) {
+    const OcTreeKey tile_key = getTileKey(key);
+    typename TileMap::iterator it = tiles.find(tile_key);
+    if (it == tiles.end()){
+      if (!modify)
+        return false;
+
+      Tile tile;
+      tile.loaded = true;
+      tile.modified = true;
+      tile.stored = false;
+      lru.push_front(tile_key);
+      tile.lru_pos = lru.begin();
+      tiles.insert(std::make_pair(tile_key, tile));
+      for (unsigned int i = 0; i < 3; ++i){
+        tiles_min[i] = std::min(tiles_min[i], tile_key[i]);
+        tiles_max[i] = std::max(tiles_max[i], tile_key[i]);
+      }
+      return true;
+    }
+
+    Tile& tile = it->second;
+    if (!tile.loaded)
+      loadTile(tile_key, tile);
+    else
+      lru.splice(lru.begin(), lru, tile.lru_pos);
+    if (modify)
+      tile.modified = true;
+    return true;
+  }
+
+  template <class TREE>
+  void TiledOcTree<TREE>::loadTile(const OcTreeKey& tile_key, Tile& tile) {
+    std::string filename = tileFilename(directory, tile_key, tile_level);
+    std::ifstream file(filename.c_str(), std::ios_base::in | std::ios_base::binary);
+    if (!file.is_open())
+      OCTOMAP_ERROR_STR("Tile file " << filename << " could not be opened");
+    else if (!tree.readSubtreeData(file, tile_key, tile_depth))
+      OCTOMAP_ERROR_STR("Error reading tile from " << filename);
+    updateTileParents(tile_key);
+
+    tile.loaded = true;
+    tile.modified = false;
+    lru.push_front(tile_key);
+    tile.lru_pos = lru.begin();
+    num_loads++;
+  }
+
+  template <class TREE>
+  void TiledOcTree<TREE>::evictTile(const OcTreeKey& tile_key) {
+    typename TileMap::iterator it = tiles.find(tile_key);
+    Tile& tile = it->second;
+    if (tile.modified && !writeTile(tile_key, tile)){
+      // keep the changes in memory
+      lru.splice(lru.begin(), lru, tile.lru_pos);
+      return;
+    }
+
+    // deletes the subtree, the nodes above are updated
+    tree.deleteNode(tile_key, tile_depth);
+    lru.erase(tile.lru_pos);
+    tile.loaded = false;
+    num_evictions++;
+    if (!tile.stored)
+      tiles.erase(it);
+  }
+
+  template <class TREE>
+  void TiledOcTree<TREE>::evictTiles() {
+    if (estimatedMemoryUsage() <= max_memory)
+      return;
+
+    // inner nodes need to be up to date when written
+    if (tree.numDirtyNodes() > 0)
+      tree.updateDirtyInnerOccupancy();
+
+    for (size_t n = lru.size(); n > 0 && estimatedMemoryUsage() > max_memory; --n){
+      OcTreeKey tile_key = lru.back();
+      evictTile(tile_key);
+    }
+  }
+
+  template <class TREE>
+  bool TiledOcTree<TREE>::writeTile(const OcTreeKey& tile_key, Tile& tile) {
+    if (!is_open)
+      return false;
+    std::string filename = tileFilename(directory, tile_key, tile_level);
+    if (tree.search(tile_key, tile_depth) == NULL){
+      // all nodes of the tile were deleted
+      if (tile.stored)
+        remove(filename.c_str());
+      tile.stored = false;
+      tile.modified = false;
+      return true;
+    }
+
+    std::ofstream file(filename.c_str(), std::ios_base::out | std::ios_base::binary);
+    if (!file.is_open() || !tree.writeSubtreeData(file, tile_key, tile_depth)){
+      OCTOMAP_ERROR_STR("Error writing tile to " << filename);
+      return false;
+    }
+    tile.stored = true;
+    tile.modified = false;
+    return true;
+  }
+
+  template <class TREE>
+  void TiledOcTree<TREE>::updateTileParents(const OcTreeKey& tile_key) {
+    for (unsigned int depth = tile_depth - 1; depth > 0; --depth){
+      NodeType* node = tree.search(tile_key, depth);
+      if (node && tree.nodeHasChildren(node))
+        node->updateOccupancyChildren();
+    }
+    if (tree.getRoot() && tree.nodeHasChildren(tree.getRoot()))
+      tree.getRoot()->updateOccupancyChildren();
+  }
+
+  template <class TREE>
+  bool TiledOcTree<TREE>::readIndex(bool& found) {
+    std::ifstream file(indexFilename(directory).c_str());
+    found = file.is_open();
+    if (!found)
+      return true;
+
+    std::string line;
+    std::getline(file, line);
+    std::string res_token, depth_token, tiles_token;
+    double res = 0.0;
+    unsigned int depth = 0;
+    size_t num_tiles = 0;
+    file >> res_token >> res >> depth_token >> depth >> tiles_token >> num_tiles;
+    if (line != "# Octomap tile index" || !file.good() || res_token != "res" || depth_token != "tile_depth"
+        || tiles_token != "tiles" || res <= 0.0 || depth < 1 || depth > tree.getTreeDepth()){
+      OCTOMAP_ERROR_STR("Invalid tile index in " << indexFilename(directory));
+      return false;
+    }
+
+    if (fabs(res - tree.getResolution()) > 1e-6 * res){
+      OCTOMAP_WARNING_STR("Using the resolution " << res << " of the tile index");
+      tree.setResolution(res);
+    }
+    tile_depth = depth;
+
+    Tile tile;
+    tile.loaded = false;
+    tile.modified = false;
+    tile.stored = true;
+    for (size_t i = 0; i < num_tiles; ++i){
+      unsigned int k[3];
+      if (!(file >> k[0] >> k[1] >> k[2])){
+        OCTOMAP_ERROR_STR("Tile index in " << indexFilename(directory) << " ended after " << i << " tiles");
+        return false;
+      }
+      OcTreeKey tile_key(k[0], k[1], k[2]);
+      tiles.insert(std::make_pair(tile_key, tile));
+      for (unsigned int j = 0; j < 3; ++j){
+        tiles_min[j] = std::min(tiles_min[j], tile_key[j]);
+        tiles_max[j] = std::max(tiles_max[j], tile_key[j]);
+      }
+    }
+    return true;
+  }
+
+  template <class TREE>
+  bool TiledOcTree<TREE>::writeIndex(const std::string& directory, double resolution, unsigned int tile_depth,
+                                     const std::vector<OcTreeKey>& tile_keys) {
+    std::string filename = indexFilename(directory);
+    std::ofstream file(filename.c_str());
+    if (!file.is_open()){
+      OCTOMAP_ERROR_STR("Filestream to " << filename << " not open, nothing written.");
+      return false;
+    }
+    file << "# Octomap tile index\n";
+    file << "res " << resolution << "\n";
+    file << "tile_depth " << tile_depth << "\n";
+    file << "tiles " << tile_keys.size() << "\n";
+    for (size_t i = 0; i < tile_keys.size(); ++i)
+      file << tile_keys[i][0] << " " << tile_keys[i][1] << " " << tile_keys[i][2] << "\n";
+    file.close();
+    return file.good();
+  }
+
+  template <class TREE>
+  std::string TiledOcTree<TREE>::indexFilename(const std::string& directory) {
+    return directory + "/tiles.index";
+  }
+
+  template <class TREE>
+  std::string TiledOcTree<TREE>::tileFilename(const std::string& directory, const OcTreeKey& tile_key,
+                                              unsigned int tile_level) {
+    std::ostringstream filename;
+    filename << directory << "/tile_" << (tile_key[0] >> tile_level) << "_" << (tile_key[1] >> tile_level)
+             << "_" << (tile_key[2] >> tile_level) << ".tile";
+    return filename.str();
+  }
+
+} // end namespace
@@ -36,6 +36,8 @@
 #include <octomap/OcTree.h>
 #include <octomap/CountingOcTree.h>
 
+#include <sstream>
+
 
 namespace octomap {
   AbstractOcTree::AbstractOcTree(){
@@ -71,6 +73,22 @@ namespace octomap {
     return true;
   }
 
+  bool AbstractOcTree::writeCompressed(const std::string& filename, Compression::Codec codec) const{
+    std::ofstream file(filename.c_str(), std::ios_base::out | std::ios_base::binary);
+
+    if (!file.is_open()){
+      OCTOMAP_ERROR_STR("Filestream to "<< filename << " not open, nothing written.");
+      return false;
+    }
+    return writeCompressed(file, codec);
+  }
+
+  bool AbstractOcTree::writeCompressed(std::ostream &s, Compression::Codec codec) const{
+    std::ostringstream buffer;
+    write(buffer);
+    return Compression::write(s, buffer.str(), codec);
+  }
+
   AbstractOcTree* AbstractOcTree::read(const std::string& filename){
     std::ifstream file(filename.c_str(), std::ios_base::in |std::ios_base::binary);
 
@@ -89,6 +107,14 @@ namespace octomap {
     // check if first line valid:
     std::string line;
     std::getline(s, line);
+    if (line.compare(0, Compression::fileHeader.length(), Compression::fileHeader) == 0){
+      std::string data;
+      if (!Compression::read(s, data))
+        return NULL;
+      MemoryStreamBuf buffer(data.data(), data.size());
+      std::istream decompressed(&buffer);
+      return read(decompressed);
+    }
     if (line.compare(0,fileHeader.length(), fileHeader) !=0){
       OCTOMAP_ERROR_STR("First line of OcTree file header does not start with \""<< fileHeader);
       return NULL;
@@ -117,9 +143,18 @@ namespace octomap {
   }
 
   bool AbstractOcTree::readHeader(std::istream& s, std::string& id, unsigned& size, double& res){
+    unsigned subtree_depth;
+    std::vector<uint64_t> subtree_sizes;
+    return readHeader(s, id, size, res, subtree_depth, subtree_sizes);
+  }
+
+  bool AbstractOcTree::readHeader(std::istream& s, std::string& id, unsigned& size, double& res,
+                                  unsigned& subtree_depth, std::vector<uint64_t>& subtree_sizes){
     id = "";
     size = 0;
     res = 0.0;
+    subtree_depth = 0;
+    subtree_sizes.clear();
 
     std::string token;
     bool headerRead = false;
@@ -146,6 +181,19 @@ namespace octomap {
         s >> res;
       else if (token == "size")
         s >> size;
+      else if (token == "subtrees"){
+        size_t num_subtrees = 0;
+        s >> subtree_depth >> num_subtrees;
+        // at most 8 subtrees per level, written for small depths only
+        if (!s.good() || subtree_depth == 0 || subtree_depth > 4
+            || num_subtrees > (size_t(1) << (3 * subtree_depth))){
+          OCTOMAP_ERROR_STR("Error reading OcTree header, invalid subtrees");
+          return false;
+        }
+        subtree_sizes.resize(num_subtrees);
+        for (size_t i = 0; i < num_subtrees && s.good(); ++i)
+          s >> subtree_sizes[i];
+      }
       else{
         OCTOMAP_WARNING_STR("Unknown keyword in OcTree header, skipping: "<<token);
         char c;
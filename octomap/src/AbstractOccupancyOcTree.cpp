@@ -35,9 +35,13 @@
 #include <octomap/AbstractOccupancyOcTree.h>
 #include <octomap/octomap_types.h>
 
+#include <sstream>
+#include <cmath>
+
 
 namespace octomap {
-  AbstractOccupancyOcTree::AbstractOccupancyOcTree(){
+  AbstractOccupancyOcTree::AbstractOccupancyOcTree()
+    : subtree_index(false) {
     // some sane default values:
     setOccupancyThres(0.5);   // = 0.0 in logodds
     setProbHit(0.7);          // = 0.85 in logodds
@@ -78,10 +82,17 @@ namespace octomap {
 
   bool AbstractOccupancyOcTree::writeBinaryConst(std::ostream &s) const{
     // write new header first:
-    s << binaryFileHeader <<"\n# (feel free to add / change comments, but leave the first line as it is!)\n#\n";
-    s << "id " << this->getTreeType() << std::endl;
-    s << "size "<< this->size() << std::endl;
-    s << "res " << this->getResolution() << std::endl;
+    writeBinaryHeader(s, binaryFileHeader, this->size());
+
+    std::vector<uint64_t> subtree_sizes;
+    if (subtree_index)
+      getBinarySubtreeSizes(binarySubtreeDepth, subtree_sizes);
+    if (!subtree_sizes.empty()){
+      s << "subtrees " << binarySubtreeDepth << " " << subtree_sizes.size();
+      for (size_t i = 0; i < subtree_sizes.size(); ++i)
+        s << " " << subtree_sizes[i];
+      s << std::endl;
+    }
     s << "data" << std::endl;
 
     writeBinaryData(s);
@@ -95,6 +106,167 @@ namespace octomap {
     }
   }
   
+  bool AbstractOccupancyOcTree::writeBinaryCompressed(const std::string& filename, Compression::Codec codec){
+    std::ofstream binary_outfile( filename.c_str(), std::ios_base::binary);
+
+    if (!binary_outfile.is_open()){
+      OCTOMAP_ERROR_STR("Filestream to "<< filename << " not open, nothing written.");
+      return false;
+    }
+    return writeBinaryCompressed(binary_outfile, codec);
+  }
+
+  bool AbstractOccupancyOcTree::writeBinaryCompressed(std::ostream &s, Compression::Codec codec){
+    std::ostringstream buffer;
+    if (!writeBinary(buffer))
+      return false;
+    return Compression::write(s, buffer.str(), codec);
+  }
+
+  bool AbstractOccupancyOcTree::writeBinary(const std::string& filename, const point3d& bbx_min,
+                                            const point3d& bbx_max) const{
+    std::ofstream binary_outfile( filename.c_str(), std::ios_base::binary);
+
+    if (!binary_outfile.is_open()){
+      OCTOMAP_ERROR_STR("Filestream to "<< filename << " not open, nothing written.");
+      return false;
+    }
+    return writeBinary(binary_outfile, bbx_min, bbx_max);
+  }
+
+  bool AbstractOccupancyOcTree::writeBinary(std::ostream &s, const point3d& bbx_min, const point3d& bbx_max) const{
+    std::vector<char> data;
+    size_t num_nodes = 0;
+    if (!getBinaryDataBBX(bbx_min, bbx_max, data, num_nodes))
+      return false;
+
+    writeBinaryHeader(s, binaryFileHeader, num_nodes);
+    s << "data" << std::endl;
+    if (!data.empty())
+      s.write(&data[0], data.size());
+    return s.good();
+  }
+
+  bool AbstractOccupancyOcTree::writeSubtree(const std::string& filename, const OcTreeKey& key,
+                                             unsigned int depth) const{
+    std::ofstream binary_outfile( filename.c_str(), std::ios_base::binary);
+
+    if (!binary_outfile.is_open()){
+      OCTOMAP_ERROR_STR("Filestream to "<< filename << " not open, nothing written.");
+      return false;
+    }
+    return writeSubtree(binary_outfile, key, depth);
+  }
+
+  bool AbstractOccupancyOcTree::writeSubtree(std::ostream &s, const OcTreeKey& key, unsigned int depth) const{
+    std::vector<char> data;
+    size_t num_nodes = 0;
+    if (!getBinarySubtreeData(key, depth, data, num_nodes))
+      return false;
+
+    writeBinaryHeader(s, binarySubtreeFileHeader, num_nodes);
+    s << "subtree " << key[0] << " " << key[1] << " " << key[2] << " " << depth << std::endl;
+    s << "data" << std::endl;
+    if (!data.empty())
+      s.write(&data[0], data.size());
+    return s.good();
+  }
+
+  bool AbstractOccupancyOcTree::readSubtree(const std::string& filename){
+    std::ifstream binary_infile( filename.c_str(), std::ios_base::binary);
+    if (!binary_infile.is_open()){
+      OCTOMAP_ERROR_STR("Filestream to "<< filename << " not open, nothing read.");
+      return false;
+    }
+    return readSubtree(binary_infile);
+  }
+
+  bool AbstractOccupancyOcTree::readSubtree(std::istream &s){
+    return readSubtree(s, NULL);
+  }
+
+  bool AbstractOccupancyOcTree::readSubtree(std::istream &s, const OcTreeKey& key){
+    return readSubtree(s, &key);
+  }
+
+  bool AbstractOccupancyOcTree::readSubtree(std::istream &s, const OcTreeKey* key){
+    std::string line;
+    std::getline(s, line);
+    if (line.compare(0, Compression::fileHeader.length(), Compression::fileHeader) == 0){
+      std::string data;
+      if (!Compression::read(s, data))
+        return false;
+      MemoryStreamBuf buffer(data.data(), data.size());
+      std::istream decompressed(&buffer);
+      return readSubtree(decompressed, key);
+    }
+
+    // complete trees are grafted at the root
+    OcTreeKey subtree_key(0, 0, 0);
+    unsigned int depth = 0;
+    if (line.compare(0, binarySubtreeFileHeader.length(), binarySubtreeFileHeader) != 0
+        && line.compare(0, binaryFileHeader.length(), binaryFileHeader) != 0){
+      OCTOMAP_ERROR_STR("First line of subtree file header does not start with \""<< binarySubtreeFileHeader << "\"");
+      return false;
+    }
+
+    size_t size = 0;
+    double res = 0.0;
+    std::string token;
+    bool header_read = false;
+    while (s.good() && !header_read){
+      s >> token;
+      if (token == "data")
+        header_read = true;
+      else if (token == "size")
+        s >> size;
+      else if (token == "res")
+        s >> res;
+      else if (token == "subtree"){
+        unsigned int k[3];
+        s >> k[0] >> k[1] >> k[2] >> depth;
+        subtree_key = OcTreeKey(k[0], k[1], k[2]);
+      }
+      else if (token.compare(0,1,"#") != 0 && token != "id" && token != "subtrees")
+        OCTOMAP_WARNING_STR("Unknown keyword in OcTree header, skipping: "<<token);
+      if (token != "size" && token != "res" && token != "subtree"){
+        // skip forward until end of line:
+        char c;
+        do {
+          c = s.get();
+        } while(s.good() && (c != '\n'));
+      }
+    }
+
+    if (!header_read){
+      OCTOMAP_ERROR_STR("Error reading subtree header");
+      return false;
+    }
+    if (fabs(res - this->getResolution()) > 1e-6 * this->getResolution()){
+      OCTOMAP_ERROR_STR("Resolution of subtree (" << res << ") does not match the tree (" << this->getResolution() << ")");
+      return false;
+    }
+    if (size == 0)
+      return true;
+
+    size_t num_nodes = 0;
+    if (!readBinarySubtreeData(s, key ? *key : subtree_key, depth, num_nodes))
+      return false;
+    if (num_nodes != size){
+      OCTOMAP_ERROR("Subtree size mismatch: # read nodes (%zu) != # expected nodes (%zu)\n", num_nodes, size);
+      return false;
+    }
+    return true;
+  }
+
+  void AbstractOccupancyOcTree::writeBinaryHeader(std::ostream &s, const std::string& first_line,
+                                                  size_t num_nodes) const{
+    s << first_line <<"\n# (feel free to add / change comments, but leave the first line as it is!)\n#\n";
+    s << "id " << this->getTreeType() << std::endl;
+    s << "size "<< num_nodes << std::endl;
+    s << "res " << this->getResolution() << std::endl;
+  }
+
   bool AbstractOccupancyOcTree::readBinaryLegacyHeader(std::istream &s, unsigned int& size, double& res) {
     
     if (!s.good()){
@@ -142,14 +314,34 @@ namespace octomap {
     std::string line;
     std::istream::pos_type streampos = s.tellg();
     std::getline(s, line);
+    if (line.compare(0, Compression::fileHeader.length(), Compression::fileHeader) == 0){
+      std::string data;
+      if (!Compression::read(s, data))
+        return false;
+      MemoryStreamBuf buffer(data.data(), data.size());
+      std::istream decompressed(&buffer);
+      return readBinary(decompressed);
+    }
     unsigned size;
     double res;
+    unsigned subtree_depth = 0;
+    std::vector<uint64_t> subtree_sizes;
     if (line.compare(0,AbstractOccupancyOcTree::binaryFileHeader.length(), AbstractOccupancyOcTree::binaryFileHeader) ==0){
       std::string id;
-      if (!AbstractOcTree::readHeader(s, id, size, res))
+      if (!AbstractOcTree::readHeader(s, id, size, res, subtree_depth, subtree_sizes))
         return false;
       
       OCTOMAP_DEBUG_STR("Reading binary octree type "<< id);
+
+      // each inner node takes 2 bytes, the subtrees cannot hold more
+      uint64_t total_size = 0;
+      for (size_t k = 0; k < subtree_sizes.size(); ++k){
+        if (subtree_sizes[k] > 2 * uint64_t(size) - total_size){
+          OCTOMAP_ERROR_STR("Subtree sizes in the file header exceed the tree size " << size);
+          return false;
+        }
+        total_size += subtree_sizes[k];
+      }
     } else{ // try to read old binary format:
       s.clear(); // clear eofbit of istream
       s.seekg(streampos);
@@ -166,8 +358,12 @@ namespace octomap {
     this->clear();
     this->setResolution(res);
     
-    if (size > 0)
-      this->readBinaryData(s);
+    if (size > 0){
+      if (subtree_sizes.empty())
+        this->readBinaryData(s);
+      else
+        this->readBinaryData(s, subtree_depth, subtree_sizes);
+    }
     
     if (size != this->size()){
       OCTOMAP_ERROR("Tree size mismatch: # read nodes (%zu) != # expected nodes (%d)\n",this->size(), size);
@@ -177,5 +373,56 @@ namespace octomap {
     return true;
   }
 
+  void AbstractOccupancyOcTree::getBinarySubtreeSizes(unsigned int /* subtree_depth */,
+                                                      std::vector<uint64_t>& subtree_sizes) const{
+    subtree_sizes.clear();
+  }
+
+  std::istream& AbstractOccupancyOcTree::readBinaryData(std::istream &s, unsigned int /* subtree_depth */,
+                                                        const std::vector<uint64_t>& /* subtree_sizes */){
+    return readBinaryData(s);
+  }
+
+  bool AbstractOccupancyOcTree::getBinaryDataBBX(const point3d& /* bbx_min */, const point3d& /* bbx_max */,
+                                                 std::vector<char>& /* data */, size_t& /* num_nodes */) const{
+    OCTOMAP_ERROR_STR("Writing bounding boxes is not implemented for " << this->getTreeType());
+    return false;
+  }
+
+  bool AbstractOccupancyOcTree::getBinarySubtreeData(const OcTreeKey& /* key */, unsigned int /* depth */,
+                                                     std::vector<char>& /* data */, size_t& /* num_nodes */) const{
+    OCTOMAP_ERROR_STR("Writing subtrees is not implemented for " << this->getTreeType());
+    return false;
+  }
+
+  bool AbstractOccupancyOcTree::readBinarySubtreeData(std::istream& /* s */, const OcTreeKey& /* key */,
+                                                      unsigned int /* depth */, size_t& /* num_nodes */){
+    OCTOMAP_ERROR_STR("Reading subtrees is not implemented for " << this->getTreeType());
+    return false;
+  }
+
+  std::vector<AbstractOccupancyOcTree::BinaryChildCodes> AbstractOccupancyOcTree::computeBinaryChildCodes(){
+    // 10 (= 1): free leaf, 01 (= 2): occupied leaf, 11: inner node, 00: unknown
+    std::vector<BinaryChildCodes> codes(256);
+    for (unsigned int byte = 0; byte < 256; ++byte){
+      BinaryChildCodes& code = codes[byte];
+      code.free = code.occupied = code.inner = 0;
+      for (unsigned int i = 0; i < 4; ++i){
+        unsigned int child = (byte >> (2*i)) & 3;
+        if (child == 1)      code.free |= (uint8_t) (1 << i);
+        else if (child == 2) code.occupied |= (uint8_t) (1 << i);
+        else if (child == 3) code.inner |= (uint8_t) (1 << i);
+      }
+    }
+    return codes;
+  }
+
+  const AbstractOccupancyOcTree::BinaryChildCodes* AbstractOccupancyOcTree::binaryChildCodes(){
+    // initialized once, also when trees are read on several threads
+    static const std::vector<BinaryChildCodes> codes = computeBinaryChildCodes();
+    return &codes[0];
+  }
+
   const std::string AbstractOccupancyOcTree::binaryFileHeader = "# Octomap OcTree binary file";
+  const std::string AbstractOccupancyOcTree::binarySubtreeFileHeader = "# Octomap OcTree binary subtree file";
 }
@@ -0,0 +1,228 @@
+/*
+ * OctoMap - An Efficient Probabilistic 3D Mapping Framework Based on Octrees
+ * http://octomap.github.com/
+ *
+ * Copyright (c) 2009-2013, K.M. Wurm and A. Hornung, University of Freiburg
+ * All rights reserved.
+ * License: New BSD
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the University of Freiburg nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include <octomap/BoundingVolumeHierarchy.h>
+
+namespace octomap {
+
+  namespace {
+
+    /// orders box indices by the center coordinate along one axis
+    struct CenterLess {
+      CenterLess(const std::vector<point3d>& centers, unsigned int axis) : centers(centers), axis(axis) {}
+      bool operator()(unsigned int a, unsigned int b) const { return centers[a](axis) < centers[b](axis); }
+      const std::vector<point3d>& centers;
+      unsigned int axis;
+    };
+
+    struct PointOverlap {
+      PointOverlap(const point3d& p) : p(p) {}
+      bool operator()(const point3d& min, const point3d& max) const {
+        return p.x() >= min.x() && p.x() <= max.x()
+            && p.y() >= min.y() && p.y() <= max.y()
+            && p.z() >= min.z() && p.z() <= max.z();
+      }
+      point3d p;
+    };
+
+    struct BoxOverlap {
+      BoxOverlap(const point3d& min, const point3d& max) : query_min(min), query_max(max) {}
+      bool operator()(const point3d& min, const point3d& max) const {
+        return query_min.x() <= max.x() && query_max.x() >= min.x()
+            && query_min.y() <= max.y() && query_max.y() >= min.y()
+            && query_min.z() <= max.z() && query_max.z() >= min.z();
+      }
+      point3d query_min;
+      point3d query_max;
+    };
+
+    /// slab test of a ray segment against boxes
+    struct RayOverlap {
+      RayOverlap(const point3d& origin, const point3d& direction, double max_range) {
+        double length = direction.norm();
+        for (unsigned int i = 0; i < 3; ++i){
+          this->origin[i] = origin(i);
+          this->direction[i] = direction(i) / length;
+          inv_direction[i] = (this->direction[i] != 0.0) ? 1.0 / this->direction[i] : 0.0;
+        }
+        t_max = (max_range > 0.0) ? max_range : std::numeric_limits<double>::max();
+      }
+
+      bool operator()(const point3d& min, const point3d& max) const {
+        double t_enter = 0.0;
+        double t_exit = t_max;
+        for (unsigned int i = 0; i < 3; ++i){
+          if (direction[i] == 0.0){
+            if (origin[i] < min(i) || origin[i] > max(i))
+              return false;
+            continue;
+          }
+          double t0 = (min(i) - origin[i]) * inv_direction[i];
+          double t1 = (max(i) - origin[i]) * inv_direction[i];
+          if (t0 > t1)
+            std::swap(t0, t1);
+          t_enter = std::max(t_enter, t0);
+          t_exit = std::min(t_exit, t1);
+          if (t_enter > t_exit)
+            return false;
+        }
+        return true;
+      }
+
+      double origin[3];
+      double direction[3];
+      double inv_direction[3];
+      double t_max;
+    };
+  }
+
+  BoundingVolumeHierarchy::BoundingVolumeHierarchy() {
+  }
+
+  void BoundingVolumeHierarchy::clear() {
+    nodes.clear();
+    items.clear();
+    boxes_min.clear();
+    boxes_max.clear();
+  }
+
+  void BoundingVolumeHierarchy::build(const std::vector<point3d>& box_min, const std::vector<point3d>& box_max) {
+    clear();
+    boxes_min = box_min;
+    boxes_max = box_max;
+
+    std::vector<point3d> centers(boxes_min.size());
+    for (unsigned int i = 0; i < boxes_min.size(); ++i){
+      if (boxes_min[i].x() > boxes_max[i].x() || boxes_min[i].y() > boxes_max[i].y() || boxes_min[i].z() > boxes_max[i].z())
+        continue;
+      centers[i] = (boxes_min[i] + boxes_max[i]) * 0.5;
+      items.push_back(i);
+    }
+    if (items.empty())
+      return;
+
+    nodes.reserve(2 * (items.size() / MAX_LEAF_BOXES + 1));
+    buildRecursive(0, (unsigned int) items.size(), centers);
+  }
+
+  unsigned int BoundingVolumeHierarchy::buildRecursive(unsigned int begin, unsigned int end,
+                                                       const std::vector<point3d>& centers) {
+    unsigned int index = (unsigned int) nodes.size();
+    nodes.push_back(Node());
+    Node node;
+    node.min = boxes_min[items[begin]];
+    node.max = boxes_max[items[begin]];
+    point3d center_min = centers[items[begin]];
+    point3d center_max = center_min;
+    for (unsigned int i = begin + 1; i < end; ++i){
+      for (unsigned int j = 0; j < 3; ++j){
+        node.min(j) = std::min(node.min(j), boxes_min[items[i]](j));
+        node.max(j) = std::max(node.max(j), boxes_max[items[i]](j));
+        center_min(j) = std::min(center_min(j), centers[items[i]](j));
+        center_max(j) = std::max(center_max(j), centers[items[i]](j));
+      }
+    }
+    node.second_child = 0;
+
+    if (end - begin <= MAX_LEAF_BOXES){
+      node.first_box = begin;
+      node.num_boxes = end - begin;
+    } else {
+      // split at the median center along the axis with the largest spread of centers
+      unsigned int axis = 0;
+      point3d spread = center_max - center_min;
+      if (spread.y() > spread(axis)) axis = 1;
+      if (spread.z() > spread(axis)) axis = 2;
+      unsigned int middle = begin + (end - begin) / 2;
+      std::nth_element(items.begin() + begin, items.begin() + middle, items.begin() + end, CenterLess(centers, axis));
+
+      node.first_box = 0;
+      node.num_boxes = 0;
+      buildRecursive(begin, middle, centers);
+      node.second_child = buildRecursive(middle, end, centers);
+    }
+    nodes[index] = node;
+    return index;
+  }
+
+  template <class OVERLAP>
+  void BoundingVolumeHierarchy::query(const OVERLAP& overlap, std::vector<unsigned int>& boxes) const {
+    boxes.clear();
+    if (nodes.empty())
+      return;
+
+    // the median split halves the boxes on every level, 64 entries suffice for 2^32 boxes
+    unsigned int stack[64];
+    unsigned int stack_size = 0;
+    stack[stack_size++] = 0;
+    while (stack_size > 0){
+      const unsigned int index = stack[--stack_size];
+      const Node& node = nodes[index];
+      if (!overlap(node.min, node.max))
+        continue;
+      if (node.num_boxes == 0){
+        stack[stack_size++] = node.second_child;
+        stack[stack_size++] = index + 1;
+        continue;
+      }
+      for (unsigned int i = node.first_box; i < node.first_box + node.num_boxes; ++i){
+        unsigned int box = items[i];
+        if (node.num_boxes == 1 || overlap(boxes_min[box], boxes_max[box]))
+          boxes.push_back(box);
+      }
+    }
+    std::sort(boxes.begin(), boxes.end());
+  }
+
+  void BoundingVolumeHierarchy::queryPoint(const point3d& p, std::vector<unsigned int>& boxes) const {
+    query(PointOverlap(p), boxes);
+  }
+
+  void BoundingVolumeHierarchy::queryBox(const point3d& min, const point3d& max, std::vector<unsigned int>& boxes) const {
+    query(BoxOverlap(min, max), boxes);
+  }
+
+  void BoundingVolumeHierarchy::queryRay(const point3d& origin, const point3d& direction, double max_range,
+                                         std::vector<unsigned int>& boxes) const {
+    if (direction.norm() == 0.0){
+      boxes.clear();
+      return;
+    }
+    query(RayOverlap(origin, direction, max_range), boxes);
+  }
+
+} // namespace
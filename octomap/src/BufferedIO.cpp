@@ -0,0 +1,140 @@
+/*
+ * OctoMap - An Efficient Probabilistic 3D Mapping Framework Based on Octrees
+ * http://octomap.github.com/
+ *
+ * Copyright (c) 2009-2013, K.M. Wurm and A. Hornung, University of Freiburg
+ * All rights reserved.
+ * License: New BSD
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the University of Freiburg nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include <octomap/BufferedIO.h>
+#include <octomap/octomap_types.h>
+
+namespace octomap {
+
+  BufferedWriter::BufferedWriter(std::ostream& s, size_t buffer_size)
+    : s(s), buffer(buffer_size > 0 ? buffer_size : 1)
+  {
+    pos = &buffer[0];
+    buffer_end = pos + buffer.size();
+  }
+
+  BufferedWriter::~BufferedWriter(){
+    flush();
+  }
+
+  bool BufferedWriter::flush(){
+    if (pos != &buffer[0]){
+      s.write(&buffer[0], pos - &buffer[0]);
+      pos = &buffer[0];
+    }
+    return s.good();
+  }
+
+  void BufferedWriter::writeSlow(const void* data, size_t size){
+    flush();
+    if (size >= buffer.size())
+      s.write((const char*) data, size);
+    else {
+      memcpy(pos, data, size);
+      pos += size;
+    }
+  }
+
+
+  BufferedReader::BufferedReader(std::istream& s, size_t buffer_size)
+    : s(s), pos(NULL), buffer_end(NULL), failed(false), finished(false)
+  {
+    // data read ahead can only be returned to seekable streams
+    if (s.good() && s.tellg() != std::istream::pos_type(-1))
+      buffer.resize(buffer_size);
+  }
+
+  BufferedReader::~BufferedReader(){
+    finish();
+  }
+
+  void BufferedReader::finish(){
+    if (finished)
+      return;
+    finished = true;
+
+    const std::streamoff unread = buffer_end - pos;
+    pos = buffer_end = NULL;
+    if (unread > 0){
+      s.clear();
+      s.seekg(-unread, std::ios_base::cur);
+    }
+    if (failed)
+      s.setstate(std::ios_base::failbit);
+    else if (!buffer.empty())
+      s.clear(s.rdstate() & ~(std::ios_base::failbit | std::ios_base::eofbit));
+  }
+
+  void BufferedReader::fill(){
+    if (finished || buffer.empty() || !s.good())
+      return;
+    s.read(&buffer[0], buffer.size());
+    pos = &buffer[0];
+    buffer_end = pos + s.gcount();
+  }
+
+  bool BufferedReader::readSlow(void* data, size_t size){
+    if (failed)
+      return false;
+
+    char* dst = (char*) data;
+    const size_t available = buffer_end - pos;
+    if (available > 0){
+      memcpy(dst, pos, available);
+      dst += available;
+      size -= available;
+      pos = buffer_end;
+    }
+
+    if (finished || size >= buffer.size()){
+      // large reads (and all reads without buffer or after finish()) go directly to the stream
+      if (!s.read(dst, size)){
+        failed = true;
+        return false;
+      }
+      return true;
+    }
+
+    fill();
+    if (size > size_t(buffer_end - pos)){
+      pos = buffer_end;
+      failed = true;
+      return false;
+    }
+    memcpy(dst, pos, size);
+    pos += size;
+    return true;
+  }
+
+} // namespace
@@ -51,6 +51,20 @@ namespace octomap {
     return s;
   }
 
+  BufferedWriter& ColorOcTreeNode::writeData(BufferedWriter &s) const {
+    s.write(value); // occupancy
+    s.write(color); // color
+
+    return s;
+  }
+
+  BufferedReader& ColorOcTreeNode::readData(BufferedReader &s) {
+    s.read(value); // occupancy
+    s.read(color); // color
+
+    return s;
+  }
+
   ColorOcTreeNode::Color ColorOcTreeNode::getAverageChildColor() const {
     int mr = 0;
     int mg = 0;
@@ -118,8 +132,7 @@ namespace octomap {
     for (unsigned int i=0;i<8;i++) {
       deleteNodeChild(node, i);
     }
-    delete[] node->children;
-    node->children = NULL;
+    deallocNodeChildren(node);
 
     return true;
   }
@@ -0,0 +1,392 @@
+/*
+ * OctoMap - An Efficient Probabilistic 3D Mapping Framework Based on Octrees
+ * http://octomap.github.com/
+ *
+ * Copyright (c) 2009-2013, K.M. Wurm and A. Hornung, University of Freiburg
+ * All rights reserved.
+ * License: New BSD
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the University of Freiburg nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include <octomap/Compression.h>
+#include <octomap/octomap_types.h>
+#include <octomap/octomap_utils.h>
+
+#include <string.h>
+#include <algorithm>
+#include <limits>
+
+#ifdef OCTOMAP_ZLIB
+  #include <zlib.h>
+#endif
+
+namespace octomap {
+
+  const std::string Compression::fileHeader = "# Octomap compressed file";
+
+  static const unsigned int LZ_MIN_MATCH = 4;
+  static const unsigned int LZ_MAX_OFFSET = 65535;
+  static const unsigned int LZ_HASH_BITS = 14;
+  /// upper bound of the decompressed / compressed size of a block (deflate: 1032, LZ: 255)
+  static const size_t MAX_COMPRESSION_RATIO = 1032;
+  /// untrusted sizes are read in chunks, so a header cannot allocate more than is in the stream
+  static const size_t READ_CHUNK_SIZE = 1 << 20;
+
+  static inline uint32_t readUInt32(const char* p){
+    uint32_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+  }
+
+  /// appends length - 15 (the part exceeding a token nibble) in bytes of 255 + remainder
+  static inline void appendLength(size_t length, std::vector<char>& dst){
+    for (; length >= 255; length -= 255)
+      dst.push_back((char) 255);
+    dst.push_back((char) length);
+  }
+
+  static bool readChunked(std::istream& s, size_t size, std::vector<char>& buffer){
+    buffer.clear();
+    while (buffer.size() < size){
+      size_t begin = buffer.size();
+      size_t chunk = std::min(READ_CHUNK_SIZE, size - begin);
+      buffer.resize(begin + chunk);
+      if (!s.read(&buffer[begin], chunk))
+        return false;
+    }
+    return true;
+  }
+
+  static inline bool readLength(const unsigned char*& p, const unsigned char* end, size_t& length){
+    unsigned char c;
+    do {
+      if (p == end)
+        return false;
+      c = *p++;
+      length += c;
+    } while (c == 255);
+    return true;
+  }
+
+  /// one sequence: token (literal length | match length - LZ_MIN_MATCH), literals, offset, match length
+  static void appendSequence(const char* literals, size_t num_literals, size_t offset, size_t match_length,
+                             std::vector<char>& dst){
+    size_t match_code = (match_length > 0) ? match_length - LZ_MIN_MATCH : 0;
+    unsigned char token = (unsigned char) (((num_literals < 15 ? num_literals : 15) << 4)
+                                           | (match_code < 15 ? match_code : 15));
+    dst.push_back((char) token);
+    if (num_literals >= 15)
+      appendLength(num_literals - 15, dst);
+    dst.insert(dst.end(), literals, literals + num_literals);
+    if (match_length == 0) // last sequence
+      return;
+    dst.push_back((char) (offset & 0xff));
+    dst.push_back((char) (offset >> 8));
+    if (match_code >= 15)
+      appendLength(match_code - 15, dst);
+  }
+
+  void Compression::compressLZ(const char* src, size_t size, std::vector<char>& dst){
+    // positions of the last occurrences of 4-byte sequences (by hash)
+    std::vector<uint32_t> table(1 << LZ_HASH_BITS, 0xffffffff);
+    size_t anchor = 0;
+    size_t i = 0;
+    while (i + LZ_MIN_MATCH <= size){
+      uint32_t sequence = readUInt32(src + i);
+      uint32_t& entry = table[(sequence * 2654435761u) >> (32 - LZ_HASH_BITS)];
+      size_t candidate = entry;
+      entry = (uint32_t) i;
+      if (candidate == 0xffffffff || i - candidate > LZ_MAX_OFFSET || readUInt32(src + candidate) != sequence){
+        ++i;
+        continue;
+      }
+
+      size_t length = LZ_MIN_MATCH;
+      while (i + length < size && src[candidate + length] == src[i + length])
+        ++length;
+      appendSequence(src + anchor, i - anchor, i - candidate, length, dst);
+      i += length;
+      anchor = i;
+    }
+    appendSequence(src + anchor, size - anchor, 0, 0, dst);
+  }
+
+  bool Compression::decompressLZ(const char* src, size_t size, char* dst, size_t dst_size){
+    const unsigned char* in = (const unsigned char*) src;
+    const unsigned char* in_end = in + size;
+    char* out = dst;
+    char* out_end = dst + dst_size;
+    // blocks always end with a sequence of (possibly no) literals
+    while (true){
+      if (in == in_end)
+        return false;
+      unsigned char token = *in++;
+      size_t num_literals = token >> 4;
+      if (num_literals == 15 && !readLength(in, in_end, num_literals))
+        return false;
+      if (num_literals > (size_t) (in_end - in) || num_literals > (size_t) (out_end - out))
+        return false;
+      memcpy(out, in, num_literals);
+      in += num_literals;
+      out += num_literals;
+      if (in == in_end) // last sequence
+        break;
+
+      if (in_end - in < 2)
+        return false;
+      size_t offset = in[0] | (in[1] << 8);
+      in += 2;
+      size_t match_length = token & 15;
+      if (match_length == 15 && !readLength(in, in_end, match_length))
+        return false;
+      match_length += LZ_MIN_MATCH;
+      if (offset == 0 || offset > (size_t) (out - dst) || match_length > (size_t) (out_end - out))
+        return false;
+      // byte-wise, matches may overlap with their output
+      const char* match = out - offset;
+      for (size_t j = 0; j < match_length; ++j)
+        out[j] = match[j];
+      out += match_length;
+    }
+    return out == out_end;
+  }
+
+  MemoryStreamBuf::pos_type MemoryStreamBuf::seekoff(off_type off, std::ios_base::seekdir dir,
+                                                     std::ios_base::openmode which){
+    char* pos = gptr();
+    if (dir == std::ios_base::beg)
+      pos = eback() + off;
+    else if (dir == std::ios_base::cur)
+      pos = gptr() + off;
+    else if (dir == std::ios_base::end)
+      pos = egptr() + off;
+    if (!(which & std::ios_base::in) || pos < eback() || pos > egptr())
+      return pos_type(off_type(-1));
+    setg(eback(), pos, egptr());
+    return pos_type(pos - eback());
+  }
+
+  MemoryStreamBuf::pos_type MemoryStreamBuf::seekpos(pos_type pos, std::ios_base::openmode which){
+    return seekoff(off_type(pos), std::ios_base::beg, which);
+  }
+
+  bool Compression::isAvailable(Codec codec){
+    if (codec == LZ)
+      return true;
+#ifdef OCTOMAP_ZLIB
+    if (codec == ZLIB)
+      return true;
+#endif
+    return false;
+  }
+
+  Compression::Codec Compression::defaultCodec(){
+    return isAvailable(ZLIB) ? ZLIB : LZ;
+  }
+
+  bool Compression::compressBlock(Codec codec, const char* src, size_t size, std::vector<char>& dst){
+    dst.clear();
+    if (codec == LZ){
+      dst.reserve(size + size / 255 + 16);
+      compressLZ(src, size, dst);
+      return true;
+    }
+#ifdef OCTOMAP_ZLIB
+    if (codec == ZLIB){
+      uLongf dst_size = compressBound((uLong) size);
+      dst.resize(dst_size);
+      if (compress2((Bytef*) &dst[0], &dst_size, (const Bytef*) src, (uLong) size, Z_DEFAULT_COMPRESSION) != Z_OK)
+        return false;
+      dst.resize(dst_size);
+      return true;
+    }
+#endif
+    return false;
+  }
+
+  bool Compression::decompressBlock(Codec codec, const char* src, size_t size, char* dst, size_t dst_size){
+    if (codec == LZ)
+      return decompressLZ(src, size, dst, dst_size);
+#ifdef OCTOMAP_ZLIB
+    if (codec == ZLIB){
+      uLongf size_read = (uLongf) dst_size;
+      return uncompress((Bytef*) dst, &size_read, (const Bytef*) src, (uLong) size) == Z_OK && size_read == dst_size;
+    }
+#endif
+    return false;
+  }
+
+  bool Compression::write(std::ostream& s, const std::string& data, Codec codec, size_t block_size){
+    if (!isAvailable(codec)){
+      OCTOMAP_ERROR("Compression codec %d is not available in this build\n", (int) codec);
+      return false;
+    }
+    if (block_size == 0 || block_size > 0xffffffffu){
+      OCTOMAP_ERROR("Invalid block size for compression\n");
+      return false;
+    }
+
+    const int num_blocks = (int) ((data.size() + block_size - 1) / block_size);
+    std::vector<std::vector<char> > blocks(num_blocks);
+    std::vector<char> success(num_blocks, 0);
+#ifdef _OPENMP
+    #pragma omp parallel for schedule(dynamic)
+#endif
+    for (int i = 0; i < num_blocks; ++i){
+      size_t begin = i * block_size;
+      size_t size = std::min(block_size, data.size() - begin);
+      success[i] = compressBlock(codec, data.data() + begin, size, blocks[i])
+          && blocks[i].size() <= 0xffffffffu;
+    }
+
+    s << fileHeader << "\n";
+    s << "codec " << ((codec == ZLIB) ? "zlib" : "lz") << "\n";
+    s << "size " << data.size() << "\n";
+    s << "blocksize " << block_size << "\n";
+    s << "blocks " << num_blocks << "\n";
+    s << "data" << std::endl;
+    for (int i = 0; i < num_blocks; ++i){
+      if (!success[i]){
+        OCTOMAP_ERROR("Error compressing block %d\n", i);
+        return false;
+      }
+      uint32_t compressed_size = (uint32_t) blocks[i].size();
+      s.write((const char*) &compressed_size, sizeof(compressed_size));
+    }
+    for (int i = 0; i < num_blocks; ++i){
+      if (!blocks[i].empty())
+        s.write(&blocks[i][0], blocks[i].size());
+    }
+
+    if (!s.good()){
+      OCTOMAP_WARNING_STR("Output stream not \"good\" after writing compressed data");
+      return false;
+    }
+    return true;
+  }
+
+  bool Compression::read(std::istream& s, std::string& data){
+    data.clear();
+    std::string codec_name;
+    size_t size = 0;
+    size_t block_size = 0;
+    size_t num_blocks = 0;
+    std::string token;
+    bool header_read = false;
+    while (s.good() && !header_read){
+      s >> token;
+      if (token == "data"){
+        header_read = true;
+        // skip forward until end of line:
+        char c;
+        do {
+          c = s.get();
+        } while (s.good() && (c != '\n'));
+      }
+      else if (token == "codec")
+        s >> codec_name;
+      else if (token == "size")
+        s >> size;
+      else if (token == "blocksize")
+        s >> block_size;
+      else if (token == "blocks")
+        s >> num_blocks;
+      else {
+        OCTOMAP_WARNING_STR("Unknown keyword in compressed file header, skipping: " << token);
+        char c;
+        do {
+          c = s.get();
+        } while (s.good() && (c != '\n'));
+      }
+    }
+
+    Codec codec;
+    if (codec_name == "lz")
+      codec = LZ;
+    else if (codec_name == "zlib")
+      codec = ZLIB;
+    else {
+      OCTOMAP_ERROR_STR("Unknown compression codec \"" << codec_name << "\"");
+      return false;
+    }
+    if (!header_read || block_size == 0 || block_size > 0xffffffffu
+        || num_blocks != size / block_size + (size % block_size != 0)){
+      OCTOMAP_ERROR_STR("Error reading compressed file header");
+      return false;
+    }
+    if (!isAvailable(codec)){
+      OCTOMAP_ERROR_STR("Compression codec \"" << codec_name << "\" is not available in this build");
+      return false;
+    }
+
+    // read all blocks, then decompress in parallel
+    std::vector<char> size_data;
+    if (num_blocks > std::numeric_limits<size_t>::max() / sizeof(uint32_t)
+        || !readChunked(s, num_blocks * sizeof(uint32_t), size_data)){
+      OCTOMAP_ERROR_STR("Compressed file is truncated");
+      return false;
+    }
+    std::vector<uint32_t> compressed_sizes(num_blocks);
+    std::vector<size_t> offsets(num_blocks + 1, 0);
+    for (size_t i = 0; i < num_blocks; ++i){
+      compressed_sizes[i] = readUInt32(&size_data[i * sizeof(uint32_t)]);
+      size_t block_end = std::min(block_size, size - i * block_size);
+      if (compressed_sizes[i] == 0 || compressed_sizes[i] > std::numeric_limits<size_t>::max() - offsets[i]
+          || block_end / MAX_COMPRESSION_RATIO > compressed_sizes[i]){
+        OCTOMAP_ERROR_STR("Invalid size of compressed block " << i);
+        return false;
+      }
+      offsets[i+1] = offsets[i] + compressed_sizes[i];
+    }
+    std::vector<char> compressed;
+    if (!readChunked(s, offsets[num_blocks], compressed)){
+      OCTOMAP_ERROR_STR("Compressed file is truncated");
+      return false;
+    }
+
+    // each block decompresses to exactly its part of size (see decompressBlock())
+    data.resize(size);
+    std::vector<char> success(num_blocks, 0);
+#ifdef _OPENMP
+    #pragma omp parallel for schedule(dynamic)
+#endif
+    for (int i = 0; i < (int) num_blocks; ++i){
+      size_t begin = i * block_size;
+      success[i] = decompressBlock(codec, &compressed[0] + offsets[i], compressed_sizes[i],
+                                   &data[begin], std::min(block_size, size - begin));
+    }
+    for (size_t i = 0; i < num_blocks; ++i){
+      if (!success[i]){
+        OCTOMAP_ERROR("Error decompressing block %zu\n", i);
+        data.clear();
+        return false;
+      }
+    }
+    return true;
+  }
+
+} // namespace
@@ -0,0 +1,401 @@
+/*
+ * OctoMap - An Efficient Probabilistic 3D Mapping Framework Based on Octrees
+ * http://octomap.github.com/
+ *
+ * Copyright (c) 2009-2013, K.M. Wurm and A. Hornung, University of Freiburg
+ * All rights reserved.
+ * License: New BSD
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the University of Freiburg nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <octomap/LinearOcTree.h>
+
+#include <limits>
+
+namespace octomap {
+
+  LinearOcTree::LinearOcTree()
+    : index_shift(48), resolution(0.0), resolution_factor(0.0), tree_depth(16), tree_max_val(32768),
+      occupancy_thres_log(0.0f)
+  {
+  }
+
+  void LinearOcTree::clear(){
+    codes.clear();
+    nodes.clear();
+    index.clear();
+    index_shift = 3 * tree_depth;
+  }
+
+  size_t LinearOcTree::memoryUsage() const {
+    return sizeof(LinearOcTree) + codes.size() * sizeof(uint64_t) + nodes.size() * sizeof(LinearOcTreeNode)
+      + index.size() * sizeof(uint32_t);
+  }
+
+  void LinearOcTree::finishBuild(){
+    assert(tree_depth == 16); // Morton codes of 48 bits
+    if (codes.size() >= 0xffffffffu){
+      OCTOMAP_ERROR_STR("Tree with " << codes.size() << " leafs is too large for a LinearOcTree");
+      clear();
+      return;
+    }
+
+    // leaf iterators visit the children in the order of their index, which is
+    // the Morton order, trees with another order are sorted
+    bool sorted = true;
+    for (size_t i = 1; i < codes.size() && sorted; ++i)
+      sorted = codes[i - 1] < codes[i];
+    if (!sorted){
+      std::vector<std::pair<uint64_t, size_t> > order(codes.size());
+      for (size_t i = 0; i < codes.size(); ++i)
+        order[i] = std::make_pair(codes[i], i);
+      std::sort(order.begin(), order.end());
+      std::vector<LinearOcTreeNode> sorted_nodes(nodes.size());
+      for (size_t i = 0; i < order.size(); ++i){
+        codes[i] = order[i].first;
+        sorted_nodes[i] = nodes[order[i].second];
+      }
+      nodes.swap(sorted_nodes);
+    }
+
+    // index over the top levels, about 8 leafs per bucket and at most 8^6 buckets
+    unsigned int levels = 0;
+    while (levels < 6 && (size_t(8) << (3 * (levels + 1))) <= codes.size())
+      ++levels;
+    index_shift = 3 * (tree_depth - levels);
+    const size_t num_buckets = size_t(1) << (3 * levels);
+    index.resize(num_buckets + 1);
+    size_t i = 0;
+    for (size_t bucket = 0; bucket <= num_buckets; ++bucket){
+      const uint64_t start = uint64_t(bucket) << index_shift;
+      while (i < codes.size() && codes[i] < start)
+        ++i;
+      index[bucket] = (uint32_t) i;
+    }
+  }
+
+  OcTreeKey LinearOcTree::getLeafKey(size_t i) const {
+    OcTreeKey key = MortonKey::decode(codes[i]);
+    const unsigned int level = tree_depth - nodes[i].depth;
+    if (level > 0){
+      for (unsigned int j = 0; j < 3; ++j)
+        key[j] = (key_type) (key[j] + (1 << (level - 1)));
+    }
+    return key;
+  }
+
+  size_t LinearOcTree::findLeaf(uint64_t code, size_t& hint) const {
+    const size_t n = codes.size();
+    if (n == 0)
+      return NOT_FOUND;
+    if (hint >= n)
+      hint = n - 1;
+
+    // gallop in steps of 1, 2, 4, ... to a range [begin, end) containing the first leaf after code
+    size_t begin, end;
+    if (codes[hint] <= code){
+      size_t bound = 1;
+      while (hint + bound < n && codes[hint + bound] <= code)
+        bound *= 2;
+      begin = hint + bound / 2 + 1;
+      end = std::min(hint + bound, n);
+    } else {
+      size_t bound = 1;
+      while (bound <= hint && codes[hint - bound] > code)
+        bound *= 2;
+      begin = (bound > hint) ? 0 : hint - bound + 1;
+      end = hint - bound / 2;
+    }
+    size_t i = std::upper_bound(codes.begin() + begin, codes.begin() + end, code) - codes.begin();
+    hint = (i == 0) ? 0 : i - 1;
+    return coveringLeaf(i, code);
+  }
+
+  const LinearOcTreeNode* LinearOcTree::search(const point3d& value) const {
+    OcTreeKey key;
+    if (!coordToKeyChecked(value, key)){
+      OCTOMAP_ERROR_STR("Error in search: ["<< value <<"] is out of OcTree bounds!");
+      return NULL;
+    }
+    return search(key);
+  }
+
+  const LinearOcTreeNode* LinearOcTree::search(double x, double y, double z) const {
+    return search(point3d(float(x), float(y), float(z)));
+  }
+
+  bool LinearOcTree::coordToKeyChecked(double coordinate, key_type& keyval) const {
+    int scaled_coord = ((int) floor(resolution_factor * coordinate)) + tree_max_val;
+    if ((scaled_coord >= 0) && (((unsigned int) scaled_coord) < (2*tree_max_val))) {
+      keyval = scaled_coord;
+      return true;
+    }
+    return false;
+  }
+
+  bool LinearOcTree::coordToKeyChecked(const point3d& coord, OcTreeKey& key) const {
+    for (unsigned int i = 0; i < 3; ++i){
+      if (!coordToKeyChecked(coord(i), key[i]))
+        return false;
+    }
+    return true;
+  }
+
+  double LinearOcTree::keyToCoord(key_type key, unsigned depth) const {
+    assert(depth <= tree_depth);
+    if (depth == 0)
+      return 0.0;
+    else if (depth == tree_depth)
+      return keyToCoord(key);
+    else
+      return (floor((double(key) - double(tree_max_val)) / double(1 << (tree_depth - depth))) + 0.5) * getNodeSize(depth);
+  }
+
+  LinearOcTree::RayState LinearOcTree::searchRayNode(const OcTreeKey& key, OcTreeKey& node_min,
+                                                     OcTreeKey& node_max, size_t& hint) const {
+    const uint64_t code = MortonKey::encode(key);
+    size_t i = findLeaf(code, hint);
+    RayState state;
+    unsigned int level;
+    if (i != NOT_FOUND){
+      state = isNodeOccupied(nodes[i]) ? OCCUPIED : FREE;
+      level = tree_depth - nodes[i].depth;
+    } else {
+      // largest cell around key in the gap between the previous and the next leaf
+      state = UNKNOWN;
+      uint64_t gap_begin = 0;
+      size_t next = 0;
+      if (!codes.empty() && codes[hint] <= code){
+        gap_begin = codes[hint] + leafSpan(nodes[hint].depth);
+        next = hint + 1;
+      }
+      uint64_t gap_end = (next < codes.size()) ? codes[next] : leafSpan(0);
+      level = 0;
+      while (level < tree_depth){
+        uint64_t cell_span = uint64_t(1) << (3 * (level + 1));
+        uint64_t cell_begin = code & ~(cell_span - 1);
+        if (cell_begin < gap_begin || cell_begin + cell_span > gap_end)
+          break;
+        ++level;
+      }
+    }
+
+    for (unsigned int j = 0; j < 3; ++j){
+      node_min[j] = key[j] & (key_type) (0xFFFF << level);
+      node_max[j] = node_min[j] + (key_type) ((1 << level) - 1);
+    }
+    return state;
+  }
+
+  bool LinearOcTree::castRay(const point3d& origin, const point3d& directionP, point3d& end,
+                             bool ignoreUnknown, double maxRange) const {
+    // see MappedOcTree::castRay(), consecutive leafs are found by galloping search
+    OcTreeKey current_key;
+    if (!coordToKeyChecked(origin, current_key)) {
+      OCTOMAP_WARNING_STR("Coordinates out of bounds during ray casting");
+      return false;
+    }
+
+    size_t hint = 0;
+    OcTreeKey node_min;
+    OcTreeKey node_max;
+    RayState state = searchRayNode(current_key, node_min, node_max, hint);
+    if (state == OCCUPIED){
+      end = keyToCoord(current_key);
+      return true;
+    } else if (state == UNKNOWN && !ignoreUnknown){
+      end = keyToCoord(current_key);
+      return false;
+    }
+    bool skip_node = (node_min != node_max);
+
+    point3d direction = directionP.normalized();
+    bool max_range_set = (maxRange > 0.0);
+
+    int step[3];
+    double tMax[3];
+    double tDelta[3];
+    for (unsigned int i = 0; i < 3; ++i) {
+      if (direction(i) > 0.0) step[i] = 1;
+      else if (direction(i) < 0.0) step[i] = -1;
+      else step[i] = 0;
+
+      if (step[i] != 0) {
+        double voxelBorder = keyToCoord(current_key[i]);
+        voxelBorder += double(step[i] * resolution * 0.5);
+        tMax[i] = (voxelBorder - origin(i)) / direction(i);
+        tDelta[i] = resolution / fabs(direction(i));
+      } else {
+        tMax[i] = std::numeric_limits<double>::max();
+        tDelta[i] = std::numeric_limits<double>::max();
+      }
+    }
+
+    if (step[0] == 0 && step[1] == 0 && step[2] == 0){
+      OCTOMAP_ERROR("Raycasting in direction (0,0,0) is not possible!");
+      return false;
+    }
+
+    double maxrange_sq = maxRange * maxRange;
+    const double t_skip_max = max_range_set ? maxRange - resolution : std::numeric_limits<double>::max();
+
+    while (true) {
+      unsigned int dim;
+
+      if (skip_node){
+        // advance to the last voxel on the ray inside the free leaf or unknown cell
+        unsigned int remaining[3] = {0, 0, 0};
+        double t_exit = t_skip_max;
+        for (unsigned int j = 0; j < 3; ++j){
+          if (step[j] == 0)
+            continue;
+          remaining[j] = (step[j] > 0) ? node_max[j] - current_key[j] : current_key[j] - node_min[j];
+          t_exit = std::min(t_exit, tMax[j] + remaining[j] * tDelta[j]);
+        }
+        for (unsigned int j = 0; j < 3; ++j){
+          if (step[j] == 0 || tMax[j] >= t_exit)
+            continue;
+          unsigned int num_steps = std::min(remaining[j], (unsigned int) ceil((t_exit - tMax[j]) / tDelta[j]));
+          current_key[j] += step[j] * (int) num_steps;
+          tMax[j] += num_steps * tDelta[j];
+        }
+        skip_node = false;
+      }
+
+      if (tMax[0] < tMax[1]){
+        if (tMax[0] < tMax[2]) dim = 0;
+        else                   dim = 2;
+      } else {
+        if (tMax[1] < tMax[2]) dim = 1;
+        else                   dim = 2;
+      }
+
+      if ((step[dim] < 0 && current_key[dim] == 0)
+          || (step[dim] > 0 && current_key[dim] == 2 * tree_max_val - 1)) {
+        OCTOMAP_WARNING("Coordinate hit bounds in dim %d, aborting raycast\n", dim);
+        end = keyToCoord(current_key);
+        return false;
+      }
+
+      current_key[dim] += step[dim];
+      tMax[dim] += tDelta[dim];
+
+      if (max_range_set){
+        end = keyToCoord(current_key);
+        double dist_from_origin_sq(0.0);
+        for (unsigned int j = 0; j < 3; j++)
+          dist_from_origin_sq += ((end(j) - origin(j)) * (end(j) - origin(j)));
+        if (dist_from_origin_sq > maxrange_sq)
+          return false;
+      }
+
+      // still within the last free leaf or unknown cell
+      if (current_key[dim] >= node_min[dim] && current_key[dim] <= node_max[dim])
+        continue;
+
+      state = searchRayNode(current_key, node_min, node_max, hint);
+      if (state == OCCUPIED) {
+        break;
+      } else if (state == UNKNOWN && !ignoreUnknown){
+        end = keyToCoord(current_key);
+        return false;
+      }
+      skip_node = (node_min != node_max);
+    }
+
+    end = keyToCoord(current_key);
+    return true;
+  }
+
+
+  // bounding box iterator  --------------------------------------
+
+  LinearOcTree::leaf_bbx_iterator LinearOcTree::begin_leafs_bbx(const point3d& min, const point3d& max) const {
+    OcTreeKey min_key, max_key;
+    if (!coordToKeyChecked(min, min_key) || !coordToKeyChecked(max, max_key)){
+      OCTOMAP_ERROR_STR("Error in bounding box iteration: [" << min << " - " << max << "] is out of OcTree bounds!");
+      return end_leafs_bbx();
+    }
+    return leaf_bbx_iterator(this, min_key, max_key);
+  }
+
+  LinearOcTree::leaf_bbx_iterator::leaf_bbx_iterator(const LinearOcTree* tree, const OcTreeKey& min,
+                                                     const OcTreeKey& max)
+    : tree(tree), min(min), max(max), stack_size(0), current(NOT_FOUND)
+  {
+    if (tree->size() == 0)
+      return;
+
+    StackElement& s = stack[stack_size++];
+    s.code = 0;
+    s.begin = 0;
+    s.end = tree->size();
+    s.level = (uint8_t) tree->tree_depth;
+    next();
+  }
+
+  bool LinearOcTree::leaf_bbx_iterator::intersects(uint64_t code, unsigned int level) const {
+    OcTreeKey node_min = MortonKey::decode(code);
+    for (unsigned int j = 0; j < 3; ++j){
+      unsigned int node_max = (unsigned int) node_min[j] + (1u << level) - 1;
+      if (node_max < min[j] || node_min[j] > max[j])
+        return false;
+    }
+    return true;
+  }
+
+  void LinearOcTree::leaf_bbx_iterator::next(){
+    current = NOT_FOUND;
+    const std::vector<uint64_t>& codes = tree->codes;
+    while (stack_size > 0){
+      StackElement element = stack[--stack_size];
+
+      // all leafs in the range are at least as deep as the node, a leaf at its depth is the node
+      if (tree->nodes[element.begin].depth == tree->tree_depth - element.level){
+        current = element.begin;
+        return;
+      }
+
+      // split the range into the children, pushed in reverse order
+      const unsigned int child_level = element.level - 1;
+      const uint64_t child_span = uint64_t(1) << (3 * child_level);
+      size_t end = element.end;
+      for (int i = 7; i >= 0; --i){
+        const uint64_t child_code = element.code + uint64_t(i) * child_span;
+        size_t begin = std::lower_bound(codes.begin() + element.begin, codes.begin() + end, child_code) - codes.begin();
+        if (begin != end && intersects(child_code, child_level)){
+          StackElement& s = stack[stack_size++];
+          s.code = child_code;
+          s.begin = begin;
+          s.end = end;
+          s.level = (uint8_t) child_level;
+        }
+        end = begin;
+      }
+    }
+  }
+
+} // namespace
@@ -0,0 +1,461 @@
+/*
+ * OctoMap - An Efficient Probabilistic 3D Mapping Framework Based on Octrees
+ * http://octomap.github.com/
+ *
+ * Copyright (c) 2009-2013, K.M. Wurm and A. Hornung, University of Freiburg
+ * All rights reserved.
+ * License: New BSD
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the University of Freiburg nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include <octomap/MappedOcTree.h>
+
+#include <string.h>
+#include <limits>
+#include <algorithm>
+
+#ifdef _WIN32
+  #include <stdlib.h>
+#else
+  #include <fcntl.h>
+  #include <sys/mman.h>
+  #include <sys/stat.h>
+  #include <unistd.h>
+#endif
+
+namespace octomap {
+
+  static const char MAPPED_OCTREE_MAGIC[8] = "OCTOMOT";
+  static const uint32_t MAPPED_OCTREE_BYTE_ORDER = 0x01020304;
+
+  MappedOcTree::MappedOcTree()
+    : header(NULL), nodes(NULL), data(NULL), data_size(0),
+      resolution(0.0), resolution_factor(0.0), tree_depth(0), tree_max_val(0)
+  {
+  }
+
+  MappedOcTree::~MappedOcTree(){
+    close();
+  }
+
+  bool MappedOcTree::open(const std::string& filename){
+    close();
+
+#ifdef _WIN32
+    // no mmap: read the file into memory instead
+    std::ifstream file(filename.c_str(), std::ios_base::in | std::ios_base::binary);
+    if (!file.is_open()){
+      OCTOMAP_ERROR_STR("Filestream to "<< filename << " not open, nothing read.");
+      return false;
+    }
+    file.seekg(0, std::ios_base::end);
+    data_size = (size_t) file.tellg();
+    file.seekg(0, std::ios_base::beg);
+    data = malloc(data_size);
+    if (data == NULL || !file.read((char*) data, data_size)){
+      OCTOMAP_ERROR_STR("Error reading from " << filename);
+      free(data);
+      data = NULL;
+      return false;
+    }
+#else
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0){
+      OCTOMAP_ERROR_STR("Could not open "<< filename << ", nothing read.");
+      return false;
+    }
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) != 0 || file_stat.st_size < (off_t) sizeof(MappedOcTreeHeader)){
+      OCTOMAP_ERROR_STR(filename << " is not a MappedOcTree file (too small).");
+      ::close(fd);
+      return false;
+    }
+    data_size = (size_t) file_stat.st_size;
+    data = mmap(NULL, data_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd); // the mapping stays valid
+    if (data == MAP_FAILED){
+      OCTOMAP_ERROR_STR("Could not map "<< filename << " into memory.");
+      data = NULL;
+      return false;
+    }
+#endif
+
+    const MappedOcTreeHeader* file_header = (const MappedOcTreeHeader*) data;
+    if (data_size < sizeof(MappedOcTreeHeader) || memcmp(file_header->magic, MAPPED_OCTREE_MAGIC, 8) != 0){
+      OCTOMAP_ERROR_STR(filename << " is not a MappedOcTree file.");
+      close();
+      return false;
+    }
+    if (file_header->version != VERSION || file_header->byte_order != MAPPED_OCTREE_BYTE_ORDER){
+      OCTOMAP_ERROR_STR(filename << " has an unsupported version or byte order.");
+      close();
+      return false;
+    }
+    if (file_header->tree_depth != 16 || !(file_header->resolution > 0.0)
+        || file_header->num_nodes > (data_size - sizeof(MappedOcTreeHeader)) / sizeof(MappedOcTreeNode)){
+      OCTOMAP_ERROR_STR(filename << " is corrupt (tree depth, resolution or size).");
+      close();
+      return false;
+    }
+
+    header = file_header;
+    nodes = (const MappedOcTreeNode*) ((const char*) data + sizeof(MappedOcTreeHeader));
+    resolution = header->resolution;
+    resolution_factor = 1.0 / resolution;
+    tree_depth = header->tree_depth;
+    tree_max_val = 1 << (tree_depth - 1);
+    return true;
+  }
+
+  bool MappedOcTree::validate() const {
+    if (!isOpen())
+      return false;
+    // children are stored after their parent (breadth-first) and inside the array
+    for (uint64_t i = 0; i < header->num_nodes; ++i){
+      const MappedOcTreeNode& node = nodes[i];
+      if (node.hasChildren() && (node.children <= i || !childrenInside(&node))){
+        OCTOMAP_ERROR_STR("MappedOcTree is corrupt (children of node " << i << ").");
+        return false;
+      }
+    }
+    return true;
+  }
+
+  void MappedOcTree::close(){
+    if (data != NULL){
+#ifdef _WIN32
+      free(data);
+#else
+      munmap(data, data_size);
+#endif
+    }
+    data = NULL;
+    data_size = 0;
+    header = NULL;
+    nodes = NULL;
+  }
+
+  void MappedOcTree::initHeader(MappedOcTreeHeader& header, const std::string& tree_type, double resolution,
+                                float occupancy_thres_log, unsigned int tree_depth, uint64_t num_nodes){
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, MAPPED_OCTREE_MAGIC, 8);
+    header.version = VERSION;
+    header.byte_order = MAPPED_OCTREE_BYTE_ORDER;
+    strncpy(header.tree_type, tree_type.c_str(), sizeof(header.tree_type) - 1);
+    header.resolution = resolution;
+    header.occupancy_thres_log = occupancy_thres_log;
+    header.tree_depth = tree_depth;
+    header.num_nodes = num_nodes;
+  }
+
+  const MappedOcTreeNode* MappedOcTree::search(const OcTreeKey& key, unsigned int depth) const {
+    assert(depth <= tree_depth);
+    const MappedOcTreeNode* node = getRoot();
+    if (node == NULL)
+      return NULL;
+    if (depth == 0)
+      depth = tree_depth;
+
+    // generate appropriate key at queried depth (see OcTreeBaseImpl::adjustKeyAtDepth)
+    OcTreeKey key_at_depth = key;
+    if (depth != tree_depth){
+      key_type diff = (key_type) (tree_depth - depth);
+      for (unsigned int j = 0; j < 3; ++j)
+        key_at_depth[j] = (((key[j] - tree_max_val) >> diff) << diff) + (1 << (diff-1)) + tree_max_val;
+    }
+
+    for (int i = tree_depth - 1; i >= (int) (tree_depth - depth); --i){
+      unsigned int pos = computeChildIdx(key_at_depth, i);
+      if (node->childExists(pos))
+        node = getNodeChild(node, pos);
+      else if (!node->hasChildren())
+        return node;
+      else
+        return NULL;
+      if (node == NULL)
+        return NULL;
+    }
+    return node;
+  }
+
+  const MappedOcTreeNode* MappedOcTree::search(const point3d& value, unsigned int depth) const {
+    OcTreeKey key;
+    if (!coordToKeyChecked(value, key)){
+      OCTOMAP_ERROR_STR("Error in search: ["<< value <<"] is out of OcTree bounds!");
+      return NULL;
+    }
+    return search(key, depth);
+  }
+
+  const MappedOcTreeNode* MappedOcTree::search(double x, double y, double z, unsigned int depth) const {
+    return search(point3d(float(x), float(y), float(z)), depth);
+  }
+
+  bool MappedOcTree::coordToKeyChecked(double coordinate, key_type& keyval) const {
+    int scaled_coord = ((int) floor(resolution_factor * coordinate)) + tree_max_val;
+    if ((scaled_coord >= 0) && (((unsigned int) scaled_coord) < (2*tree_max_val))) {
+      keyval = scaled_coord;
+      return true;
+    }
+    return false;
+  }
+
+  bool MappedOcTree::coordToKeyChecked(const point3d& coord, OcTreeKey& key) const {
+    for (unsigned int i = 0; i < 3; ++i){
+      if (!coordToKeyChecked(coord(i), key[i]))
+        return false;
+    }
+    return true;
+  }
+
+  double MappedOcTree::keyToCoord(key_type key, unsigned depth) const {
+    assert(depth <= tree_depth);
+    if (depth == 0)
+      return 0.0;
+    else if (depth == tree_depth)
+      return keyToCoord(key);
+    else
+      return (floor((double(key) - double(tree_max_val)) / double(1 << (tree_depth - depth))) + 0.5) * getNodeSize(depth);
+  }
+
+  MappedOcTree::RayCastCache::State MappedOcTree::searchRayNode(const OcTreeKey& key, OcTreeKey& node_min,
+                                                                OcTreeKey& node_max, RayCastCache& cache) const {
+    // start at the deepest node on the path of the last search which also contains key
+    const MappedOcTreeNode* node = getRoot();
+    unsigned int depth = 0;
+    if (cache.path_length > 0){
+      unsigned int diff = (key[0] ^ cache.key[0]) | (key[1] ^ cache.key[1]) | (key[2] ^ cache.key[2]);
+      unsigned int common_depth = tree_depth;
+      for (; diff != 0; diff >>= 1)
+        --common_depth;
+      depth = std::min(common_depth, cache.path_length - 1);
+      node = cache.path[depth];
+    }
+
+    RayCastCache::State state = RayCastCache::UNKNOWN;
+    if (node != NULL){
+      cache.path[depth] = node;
+      for (int i = tree_depth - 1 - depth; i >= 0; --i) {
+        unsigned int pos = computeChildIdx(key, i);
+        if (node->childExists(pos)) {
+          node = getNodeChild(node, pos);
+          if (node == NULL)
+            break; // corrupt file, unknown child
+          ++depth;
+          cache.path[depth] = node;
+        } else if (!node->hasChildren()) {
+          // pruned node
+          break;
+        } else {
+          // unknown child
+          node = NULL;
+          break;
+        }
+      }
+      cache.key = key;
+      cache.path_length = depth + 1;
+      if (node == NULL)
+        ++depth;
+      else
+        state = isNodeOccupied(node) ? RayCastCache::OCCUPIED : RayCastCache::FREE;
+    }
+
+    unsigned int level = tree_depth - depth;
+    for (unsigned int j = 0; j < 3; ++j){
+      node_min[j] = key[j] & (key_type) (0xFFFF << level);
+      node_max[j] = node_min[j] + (key_type) ((1 << level) - 1);
+    }
+    return state;
+  }
+
+  bool MappedOcTree::castRay(const point3d& origin, const point3d& directionP, point3d& end,
+                             bool ignoreUnknown, double maxRange) const {
+    // see OccupancyOcTreeBase::castRayCached()
+    OcTreeKey current_key;
+    if (!coordToKeyChecked(origin, current_key)) {
+      OCTOMAP_WARNING_STR("Coordinates out of bounds during ray casting");
+      return false;
+    }
+
+    RayCastCache cache;
+    OcTreeKey node_min;
+    OcTreeKey node_max;
+    RayCastCache::State state = searchRayNode(current_key, node_min, node_max, cache);
+    if (state == RayCastCache::OCCUPIED){
+      end = keyToCoord(current_key);
+      return true;
+    } else if (state == RayCastCache::UNKNOWN && !ignoreUnknown){
+      end = keyToCoord(current_key);
+      return false;
+    }
+    bool skip_node = (node_min != node_max);
+
+    point3d direction = directionP.normalized();
+    bool max_range_set = (maxRange > 0.0);
+
+    int step[3];
+    double tMax[3];
+    double tDelta[3];
+    for (unsigned int i = 0; i < 3; ++i) {
+      if (direction(i) > 0.0) step[i] = 1;
+      else if (direction(i) < 0.0) step[i] = -1;
+      else step[i] = 0;
+
+      if (step[i] != 0) {
+        double voxelBorder = keyToCoord(current_key[i]);
+        voxelBorder += double(step[i] * resolution * 0.5);
+        tMax[i] = (voxelBorder - origin(i)) / direction(i);
+        tDelta[i] = resolution / fabs(direction(i));
+      } else {
+        tMax[i] = std::numeric_limits<double>::max();
+        tDelta[i] = std::numeric_limits<double>::max();
+      }
+    }
+
+    if (step[0] == 0 && step[1] == 0 && step[2] == 0){
+      OCTOMAP_ERROR("Raycasting in direction (0,0,0) is not possible!");
+      return false;
+    }
+
+    double maxrange_sq = maxRange * maxRange;
+    const double t_skip_max = max_range_set ? maxRange - resolution : std::numeric_limits<double>::max();
+
+    while (true) {
+      unsigned int dim;
+
+      if (skip_node){
+        // advance to the last voxel on the ray inside the free node
+        unsigned int remaining[3] = {0, 0, 0};
+        double t_exit = t_skip_max;
+        for (unsigned int j = 0; j < 3; ++j){
+          if (step[j] == 0)
+            continue;
+          remaining[j] = (step[j] > 0) ? node_max[j] - current_key[j] : current_key[j] - node_min[j];
+          t_exit = std::min(t_exit, tMax[j] + remaining[j] * tDelta[j]);
+        }
+        for (unsigned int j = 0; j < 3; ++j){
+          if (step[j] == 0 || tMax[j] >= t_exit)
+            continue;
+          unsigned int num_steps = std::min(remaining[j], (unsigned int) ceil((t_exit - tMax[j]) / tDelta[j]));
+          current_key[j] += step[j] * (int) num_steps;
+          tMax[j] += num_steps * tDelta[j];
+        }
+        skip_node = false;
+      }
+
+      if (tMax[0] < tMax[1]){
+        if (tMax[0] < tMax[2]) dim = 0;
+        else                   dim = 2;
+      } else {
+        if (tMax[1] < tMax[2]) dim = 1;
+        else                   dim = 2;
+      }
+
+      if ((step[dim] < 0 && current_key[dim] == 0)
+          || (step[dim] > 0 && current_key[dim] == 2 * tree_max_val - 1)) {
+        OCTOMAP_WARNING("Coordinate hit bounds in dim %d, aborting raycast\n", dim);
+        end = keyToCoord(current_key);
+        return false;
+      }
+
+      current_key[dim] += step[dim];
+      tMax[dim] += tDelta[dim];
+
+      if (max_range_set){
+        end = keyToCoord(current_key);
+        double dist_from_origin_sq(0.0);
+        for (unsigned int j = 0; j < 3; j++)
+          dist_from_origin_sq += ((end(j) - origin(j)) * (end(j) - origin(j)));
+        if (dist_from_origin_sq > maxrange_sq)
+          return false;
+      }
+
+      // still within the last free node
+      if (current_key[dim] >= node_min[dim] && current_key[dim] <= node_max[dim])
+        continue;
+
+      state = searchRayNode(current_key, node_min, node_max, cache);
+      if (state == RayCastCache::OCCUPIED) {
+        break;
+      } else if (state == RayCastCache::UNKNOWN && !ignoreUnknown){
+        end = keyToCoord(current_key);
+        return false;
+      }
+      skip_node = (node_min != node_max);
+    }
+
+    end = keyToCoord(current_key);
+    return true;
+  }
+
+
+  // leaf iterator  --------------------------------------
+
+  MappedOcTree::leaf_iterator::leaf_iterator(const MappedOcTree* tree, unsigned char max_depth)
+    : tree(tree), max_depth(max_depth), stack_size(0)
+  {
+    if (tree->getRoot() == NULL)
+      return;
+    if (this->max_depth == 0)
+      this->max_depth = (uint8_t) tree->getTreeDepth();
+
+    StackElement& s = stack[stack_size++];
+    s.node = tree->getRoot();
+    s.key[0] = s.key[1] = s.key[2] = (key_type) tree->tree_max_val;
+    s.depth = 0;
+    descend();
+  }
+
+  MappedOcTree::leaf_iterator& MappedOcTree::leaf_iterator::operator++(){
+    if (stack_size > 0){
+      --stack_size;
+      if (stack_size > 0)
+        descend();
+    }
+    return *this;
+  }
+
+  void MappedOcTree::leaf_iterator::descend(){
+    // (nodes with children outside of the node array of a corrupt file are returned as leafs)
+    while (top().depth < max_depth && top().node->hasChildren() && tree->childrenInside(top().node)){
+      StackElement parent = top();
+      --stack_size;
+      key_type center_offset_key = (key_type) (tree->tree_max_val >> (parent.depth + 1));
+      // push on stack in reverse order, children are consecutive in the array
+      const MappedOcTreeNode* child = tree->nodes + parent.node->children + popcount(parent.node->child_mask) - 1;
+      for (int i = 7; i >= 0; --i) {
+        if (parent.node->childExists(i)) {
+          StackElement& s = stack[stack_size++];
+          computeChildKey(i, center_offset_key, parent.key, s.key);
+          s.node = child--;
+          s.depth = parent.depth + 1;
+        }
+      }
+    }
+  }
+
+} // namespace
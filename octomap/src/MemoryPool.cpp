@@ -0,0 +1,104 @@
+/*
+ * OctoMap - An Efficient Probabilistic 3D Mapping Framework Based on Octrees
+ * http://octomap.github.com/
+ *
+ * Copyright (c) 2009-2013, K.M. Wurm and A. Hornung, University of Freiburg
+ * All rights reserved.
+ * License: New BSD
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the University of Freiburg nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include <cassert>
+#include <new>
+
+#include <octomap/MemoryPool.h>
+
+namespace octomap {
+
+  MemoryPool::MemoryPool(size_t element_size, size_t elements_per_slab)
+    : element_size(element_size), elements_per_slab(elements_per_slab),
+      free_list(NULL), slab_pos(NULL), slab_end(NULL), num_allocated(0)
+  {
+    assert(elements_per_slab > 0);
+
+    // every element needs to be able to hold a free list entry and
+    // must be aligned for pointers and doubles
+    const size_t alignment = (sizeof(void*) > sizeof(double)) ? sizeof(void*) : sizeof(double);
+    if (this->element_size < sizeof(FreeElement))
+      this->element_size = sizeof(FreeElement);
+    this->element_size = ((this->element_size + alignment - 1) / alignment) * alignment;
+  }
+
+  MemoryPool::~MemoryPool(){
+    clear();
+  }
+
+  void* MemoryPool::allocate(){
+    void* ptr;
+    if (free_list != NULL){
+      ptr = free_list;
+      free_list = free_list->next;
+    } else {
+      if (slab_pos == slab_end)
+        addSlab();
+
+      ptr = slab_pos;
+      slab_pos += element_size;
+    }
+
+    ++num_allocated;
+    return ptr;
+  }
+
+  void MemoryPool::deallocate(void* ptr){
+    assert(ptr);
+    assert(num_allocated > 0);
+
+    FreeElement* element = static_cast<FreeElement*>(ptr);
+    element->next = free_list;
+    free_list = element;
+    --num_allocated;
+  }
+
+  void MemoryPool::clear(){
+    for (size_t i = 0; i < slabs.size(); ++i){
+      ::operator delete(slabs[i]);
+    }
+    slabs.clear();
+    free_list = NULL;
+    slab_pos = slab_end = NULL;
+    num_allocated = 0;
+  }
+
+  void MemoryPool::addSlab(){
+    char* slab = static_cast<char*>(::operator new(elements_per_slab * element_size));
+    slabs.push_back(slab);
+    slab_pos = slab;
+    slab_end = slab + elements_per_slab * element_size;
+  }
+
+} // end namespace
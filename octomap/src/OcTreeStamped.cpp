@@ -46,16 +46,28 @@ namespace octomap {
     return root->getTimestamp();
   }
 
-  void OcTreeStamped::degradeOutdatedNodes(unsigned int time_thres) {
-    unsigned int query_time = (unsigned int) time(NULL); 
+  /// integrates a miss into occupied leafs older than time_thres, for degradeOutdatedNodes()
+  struct DegradeOutdatedFunctor {
+    DegradeOutdatedFunctor(const OcTreeStamped* tree, unsigned int query_time, unsigned int time_thres)
+      : tree(tree), query_time(query_time), time_thres(time_thres) {}
 
-    for(leaf_iterator it = this->begin_leafs(), end=this->end_leafs(); 
-        it!= end; ++it) {
-      if ( this->isNodeOccupied(*it) 
-           && ((query_time - it->getTimestamp()) > time_thres) ) {
-        integrateMissNoTime(&*it);
+    void operator()(OcTreeNodeStamped* node, const OcTreeKey&, unsigned int, unsigned int){
+      if ( tree->isNodeOccupied(node)
+           && ((query_time - node->getTimestamp()) > time_thres) ) {
+        tree->integrateMissNoTime(node);
       }
     }
+
+    const OcTreeStamped* tree;
+    unsigned int query_time;
+    unsigned int time_thres;
+  };
+
+  void OcTreeStamped::degradeOutdatedNodes(unsigned int time_thres) {
+    unsigned int query_time = (unsigned int) time(NULL); 
+
+    DegradeOutdatedFunctor functor(this, query_time, time_thres);
+    this->parallelForEachLeaf(functor);
   }  
 
   void OcTreeStamped::updateNodeLogOdds(OcTreeNodeStamped* node, const float& update) const {
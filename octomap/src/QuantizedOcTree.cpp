@@ -0,0 +1,227 @@
+/*
+ * OctoMap - An Efficient Probabilistic 3D Mapping Framework Based on Octrees
+ * http://octomap.github.com/
+ *
+ * Copyright (c) 2009-2013, K.M. Wurm and A. Hornung, University of Freiburg
+ * All rights reserved.
+ * License: New BSD
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the University of Freiburg nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <math.h>
+#include <octomap/QuantizedOcTree.h>
+
+namespace octomap {
+
+  /// @return smallest power of two >= x
+  static float powerOfTwoCeil(float x){
+    if (x <= 0.0f)
+      return 1.0f;
+    int exponent;
+    float mantissa = frexpf(x, &exponent);
+    return (mantissa == 0.5f) ? x : ldexpf(1.0f, exponent);
+  }
+
+  QuantizedOcTree::QuantizedOcTree(double resolution, unsigned int bits, float step)
+    : OccupancyOcTreeBase<OcTreeNode>(resolution),
+      quantization_bits(16), quantization_step(1.0f), inv_quantization_step(1.0f), level_min(0), level_max(0),
+      sensor_hit_log(prob_hit_log), sensor_miss_log(prob_miss_log),
+      sensor_clamping_min(clamping_thres_min), sensor_clamping_max(clamping_thres_max) {
+    quantizedOcTreeMemberInit.ensureLinking();
+    setQuantization(bits, step);
+  };
+
+  void QuantizedOcTree::setQuantization(unsigned int bits, float step){
+    if (bits != 8 && bits != 16){
+      OCTOMAP_ERROR("Quantization to %u bits is not supported, using 16 bits\n", bits);
+      bits = 16;
+    }
+    const float min_step = minQuantizationStep(bits);
+    if (step > 0.0f && step < min_step)
+      OCTOMAP_WARNING("Quantization step %f is too small for the clamping range with %u bits, using %f\n",
+                      step, bits, min_step);
+
+    quantization_bits = bits;
+    quantization_step = (step > 0.0f) ? std::max(powerOfTwoCeil(step), min_step) : min_step;
+    inv_quantization_step = 1.0f / quantization_step;
+    updateQuantizedSensorModel();
+
+    if (root)
+      quantizeNodesRecurs(root);
+  }
+
+  float QuantizedOcTree::minQuantizationStep(unsigned int bits) const{
+    const int max_level = (1 << (bits - 1)) - 1;
+    const float range = std::max(fabsf(sensor_clamping_min), fabsf(sensor_clamping_max));
+    return powerOfTwoCeil(range / max_level);
+  }
+
+  void QuantizedOcTree::updateQuantizedClamping(){
+    // a wider clamping range may not fit into the bits with the current step
+    if (quantization_step < minQuantizationStep(quantization_bits))
+      setQuantization(quantization_bits, quantization_step);
+    else
+      updateQuantizedSensorModel();
+  }
+
+  void QuantizedOcTree::updateQuantizedSensorModel(){
+    // clamping thresholds are rounded inwards and limited to the levels representable in the bits
+    const int max_level = (1 << (quantization_bits - 1)) - 1;
+    level_min = std::max(int(ceil(sensor_clamping_min * inv_quantization_step)), -max_level);
+    level_max = std::min(int(floor(sensor_clamping_max * inv_quantization_step)), max_level);
+    clamping_thres_min = float(level_min) * quantization_step;
+    clamping_thres_max = float(level_max) * quantization_step;
+
+    // updates are at least one level
+    int hit_level = int(floor(sensor_hit_log * inv_quantization_step + 0.5f));
+    int miss_level = int(floor(sensor_miss_log * inv_quantization_step + 0.5f));
+    prob_hit_log = float(std::max(hit_level, 1)) * quantization_step;
+    prob_miss_log = float(std::min(miss_level, -1)) * quantization_step;
+  }
+
+  void QuantizedOcTree::setProbHit(double prob){
+    OccupancyOcTreeBase<OcTreeNode>::setProbHit(prob);
+    sensor_hit_log = prob_hit_log;
+    updateQuantizedSensorModel();
+  }
+
+  void QuantizedOcTree::setProbMiss(double prob){
+    OccupancyOcTreeBase<OcTreeNode>::setProbMiss(prob);
+    sensor_miss_log = prob_miss_log;
+    updateQuantizedSensorModel();
+  }
+
+  void QuantizedOcTree::setClampingThresMin(double thresProb){
+    OccupancyOcTreeBase<OcTreeNode>::setClampingThresMin(thresProb);
+    sensor_clamping_min = clamping_thres_min;
+    updateQuantizedClamping();
+  }
+
+  void QuantizedOcTree::setClampingThresMax(double thresProb){
+    OccupancyOcTreeBase<OcTreeNode>::setClampingThresMax(thresProb);
+    sensor_clamping_max = clamping_thres_max;
+    updateQuantizedClamping();
+  }
+
+  OcTreeNode* QuantizedOcTree::setNodeValue(const OcTreeKey& key, float log_odds_value, bool lazy_eval){
+    return OccupancyOcTreeBase<OcTreeNode>::setNodeValue(key, quantize(log_odds_value), lazy_eval);
+  }
+
+  void QuantizedOcTree::updateNodeLogOdds(OcTreeNode* occupancyNode, const float& update) const {
+    if (update == prob_hit_log || update == prob_miss_log)
+      OccupancyOcTreeBase<OcTreeNode>::updateNodeLogOdds(occupancyNode, update);
+    else
+      occupancyNode->setLogOdds(quantize(occupancyNode->getLogOdds() + update));
+  }
+
+  void QuantizedOcTree::quantizeNodesRecurs(OcTreeNode* node){
+    node->setLogOdds(quantize(node->getLogOdds()));
+    for (unsigned int i=0; i<8; i++) {
+      if (nodeChildExists(node, i))
+        quantizeNodesRecurs(getNodeChild(node, i));
+    }
+  }
+
+  std::ostream& QuantizedOcTree::writeData(std::ostream &s) const{
+    if (root){
+      BufferedWriter writer(s);
+      writer.put(char(quantization_bits));
+      writer.write(quantization_step);
+      if (quantization_bits == 8)
+        writeNodesQuantizedRecurs<int8_t>(root, writer);
+      else
+        writeNodesQuantizedRecurs<int16_t>(root, writer);
+    }
+
+    return s;
+  }
+
+  template <typename LEVEL>
+  void QuantizedOcTree::writeNodesQuantizedRecurs(const OcTreeNode* node, BufferedWriter &s) const{
+    s.write(LEVEL(quantizeLevel(node->getLogOdds())));
+
+    // 1 bit for each children; 0: empty, 1: allocated
+    char children_char = 0;
+    for (unsigned int i=0; i<8; i++) {
+      if (nodeChildExists(node, i))
+        children_char |= (char) (1 << i);
+    }
+    s.put(children_char);
+
+    for (unsigned int i=0; i<8; i++) {
+      if (children_char & (1 << i))
+        writeNodesQuantizedRecurs<LEVEL>(getNodeChild(node, i), s);
+    }
+  }
+
+  std::istream& QuantizedOcTree::readData(std::istream &s){
+    if (root) {
+      OCTOMAP_ERROR_STR("Trying to read into an existing tree.");
+      return s;
+    }
+
+    BufferedReader reader(s);
+    char bits;
+    float step;
+    if (!reader.read(bits) || !reader.read(step) || (bits != 8 && bits != 16) || !(step > 0.0f)){
+      OCTOMAP_ERROR_STR("Invalid quantization in QuantizedOcTree data");
+      s.setstate(std::ios_base::failbit);
+      return s;
+    }
+    setQuantization(bits, step);
+
+    // levels are decoded with the step of the data, which differs from ours if our clamping range is larger
+    root = allocNode();
+    if (bits == 8)
+      readNodesQuantizedRecurs<int8_t>(root, reader, step);
+    else
+      readNodesQuantizedRecurs<int16_t>(root, reader, step);
+
+    tree_size = calcNumNodes();  // compute number of nodes
+    size_changed = true;
+    return s;
+  }
+
+  template <typename LEVEL>
+  void QuantizedOcTree::readNodesQuantizedRecurs(OcTreeNode* node, BufferedReader &s, float step){
+    LEVEL level;
+    if (!s.read(level))
+      return;
+    node->setLogOdds(quantize(float(level) * step));
+
+    char children_char;
+    if (!s.read(children_char))
+      return;
+
+    for (unsigned int i=0; i<8; i++) {
+      if (children_char & (1 << i))
+        readNodesQuantizedRecurs<LEVEL>(createNodeChild(node, i), s, step);
+    }
+  }
+
+  QuantizedOcTree::StaticMemberInitializer QuantizedOcTree::quantizedOcTreeMemberInit;
+
+} // end namespace
@@ -34,6 +34,8 @@
 #include <octomap/AbstractOcTree.h>
 #include <octomap/OcTree.h>
 #include <octomap/ColorOcTree.h>
+#include <octomap/OcTreeStamped.h>
+#include <octomap/MappedOcTree.h>
 #include <fstream>
 #include <iostream>
 #include <string.h>
@@ -44,11 +46,12 @@ using namespace std;
 using namespace octomap;
 
 void printUsage(char* self){
-  std::cerr << "\nUSAGE: " << self << " input.(ot|bt|cot) [output.ot]\n\n";
+  std::cerr << "\nUSAGE: " << self << " input.(ot|bt|cot) [output.(ot|bt|mot)]\n\n";
 
   std::cerr << "This tool converts between OctoMap octree file formats, \n"
       "e.g. to convert old legacy files to the new .ot format or to convert \n"
-      "between .bt and .ot files. The default output format is .ot.\n\n";
+      "between .bt and .ot files. The default output format is .ot.\n"
+      ".mot files are read-only MappedOcTrees, which can be queried without loading.\n\n";
 
   exit(0);
 }
@@ -130,6 +133,23 @@ int main(int argc, char** argv) {
       std::cerr << "Error: Writing to .bt is not supported for this tree type: " << tree->getTreeType() << std::endl;
       exit(-2);
     }
+  } else if (outputFilename.length() > 4 && (outputFilename.compare(outputFilename.length()-4, 4, ".mot") == 0)){
+    std::cerr << "Writing memory-mapped (MappedOcTree) file" << std::endl;
+    bool success = false;
+    if (OcTree* octree = dynamic_cast<OcTree*>(tree))
+      success = MappedOcTree::write(*octree, outputFilename);
+    else if (ColorOcTree* colorTree = dynamic_cast<ColorOcTree*>(tree))
+      success = MappedOcTree::write(*colorTree, outputFilename);
+    else if (OcTreeStamped* stampedTree = dynamic_cast<OcTreeStamped*>(tree))
+      success = MappedOcTree::write(*stampedTree, outputFilename);
+    else {
+      std::cerr << "Error: Writing to .mot is not supported for this tree type: " << tree->getTreeType() << std::endl;
+      exit(-2);
+    }
+    if (!success){
+      std::cerr << "Error writing to " << outputFilename << std::endl;
+      exit(-2);
+    }
   } else{
     std::cerr << "Writing general OcTree file" << std::endl;
     if (!tree->write(outputFilename)){
@@ -50,13 +50,16 @@ int main(int argc, char **argv)
     bool show_help = false;
     string outputFilename("");
     string inputFilename("");
-//    double minX = 0.0;
-//    double minY = 0.0;
-//    double minZ = 0.0;
-//    double maxX = 0.0;
-//    double maxY = 0.0;
-//    double maxZ = 0.0;
-//    bool applyBBX = false;
+    double minX = 0.0;
+    double minY = 0.0;
+    double minZ = 0.0;
+    double maxX = 0.0;
+    double maxY = 0.0;
+    double maxZ = 0.0;
+    bool applyBBX = false;
+    point3d subtreeCoord;
+    int subtreeDepth = -1;
+    std::vector<string> mergeFilenames;
 //    bool applyOffset = false;
     octomap::point3d offset(0.0, 0.0, 0.0);
 
@@ -79,7 +82,10 @@ int main(int argc, char **argv)
 //        cout << "\t --mark-free      Mark not occupied cells as 'free' (default: unknown)" << endl;
 //        cout << "\t --rotate         Rotate left by 90 deg. to fix the coordinate system when exported from Webots" << endl;
         cout << "\t --offset <x> <y> <z>: add an offset to the octree coordinates (translation)\n";
-//        cout << "\t --bb <minx> <miny> <minz> <maxx> <maxy> <maxz>: force bounding box for OcTree" << endl;
+        cout << "\t --bb <minx> <miny> <minz> <maxx> <maxy> <maxz>: write only the OcTree in the bounding box" << endl;
+        cout << "\t --subtree <x> <y> <z> <depth>: write only the subtree of the node at depth containing x,y,z\n";
+        cout << "\t                   (grafted into other trees with --merge)\n";
+        cout << "\t --merge <file>: merge a subtree or bounding box file into the OcTree (repeatable)\n";
         cout << "\t --res <resolution>: set ressolution of OcTree to new value\n";
         cout << "\t --scale <scale>: scale  octree resolution by a value\n";
         exit(0);
@@ -96,21 +102,36 @@ int main(int argc, char **argv)
         outputFilename = argv[i];
         continue;
       } else if (strcmp(argv[i], "--bb") == 0 && i < argc - 7) {
-        OCTOMAP_WARNING_STR(argv[i] << " not yet implemented!\n");
         i++;
-        //minX = atof(argv[i]);
+        minX = atof(argv[i]);
+        i++;
+        minY = atof(argv[i]);
+        i++;
+        minZ = atof(argv[i]);
+        i++;
+        maxX = atof(argv[i]);
+        i++;
+        maxY = atof(argv[i]);
         i++;
-        //minY = atof(argv[i]);
+        maxZ = atof(argv[i]);
+
+        applyBBX = true;
+
+        continue;
+      } else if (strcmp(argv[i], "--subtree") == 0 && i < argc - 4) {
         i++;
-        //minZ = atof(argv[i]);
+        subtreeCoord(0) = (float) atof(argv[i]);
         i++;
-        //maxX = atof(argv[i]);
+        subtreeCoord(1) = (float) atof(argv[i]);
         i++;
-        //maxY = atof(argv[i]);
+        subtreeCoord(2) = (float) atof(argv[i]);
         i++;
-        //maxZ = atof(argv[i]);
+        subtreeDepth = atoi(argv[i]);
 
-        //applyBBX = true;
+        continue;
+      } else if (strcmp(argv[i], "--merge") == 0 && i < argc - 1) {
+        i++;
+        mergeFilenames.push_back(argv[i]);
 
         continue;
       } else if (strcmp(argv[i], "--res") == 0 && i < argc - 1) {
@@ -150,6 +171,20 @@ int main(int argc, char **argv)
       exit(1);
     }
 
+    if (applyBBX && subtreeDepth >= 0){
+      OCTOMAP_ERROR("Use either --bb or --subtree, exiting.\n");
+      exit(1);
+    }
+
+    // merge subtrees / bounding boxes (before changing the resolution):
+    for (size_t i = 0; i < mergeFilenames.size(); ++i){
+      cout << "Merging " << mergeFilenames[i] << endl;
+      if (!tree->readSubtree(mergeFilenames[i])){
+        OCTOMAP_ERROR("Could not merge %s, exiting.\n", mergeFilenames[i].c_str());
+        exit(1);
+      }
+    }
+
     // apply scale / resolution setting:
 
     if (scale != 1.0){
@@ -212,9 +247,26 @@ int main(int argc, char **argv)
  
     // write octree to file  
 
-    cout << "Writing octree to " << outputFilename << endl;
-   
-    if (!tree->writeBinary(outputFilename)){
+    bool success;
+    if (applyBBX){
+      point3d bbxMin(minX, minY, minZ);
+      point3d bbxMax(maxX, maxY, maxZ);
+      cout << "Writing octree in bounding box " << bbxMin << " - " << bbxMax << " to " << outputFilename << endl;
+      success = tree->writeBinary(outputFilename, bbxMin, bbxMax);
+    } else if (subtreeDepth >= 0){
+      OcTreeKey subtreeKey;
+      if (!tree->coordToKeyChecked(subtreeCoord, subtreeKey)){
+        OCTOMAP_ERROR("Subtree coordinate out of OcTree bounds, exiting.\n");
+        exit(1);
+      }
+      cout << "Writing subtree at " << subtreeCoord << ", depth " << subtreeDepth << " to " << outputFilename << endl;
+      success = tree->writeSubtree(outputFilename, subtreeKey, subtreeDepth);
+    } else {
+      cout << "Writing octree to " << outputFilename << endl;
+      success = tree->writeBinary(outputFilename);
+    }
+
+    if (!success){
       OCTOMAP_ERROR("Error writing tree to %s\n", outputFilename.c_str());
       exit(1);
     }
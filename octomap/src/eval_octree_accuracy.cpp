@@ -37,6 +37,7 @@
 #include <fstream>
 
 #include <octomap/octomap.h>
+#include <octomap/QuantizedOcTree.h>
 #include <octomap/octomap_timing.h>
 
 using namespace std;
@@ -51,6 +52,7 @@ void printUsage(char* self){
             "  -res <resolution> (default: 0.1 m)\n"
             "  -m <maxrange> (optional) \n"
             "  -n <max scan no.> (optional) \n"
+            "  -quantized <bits> (store log-odds quantized to 8 or 16 bits in a QuantizedOcTree)\n"
   "\n";
 
   exit(0);
@@ -69,6 +71,7 @@ int main(int argc, char** argv) {
   double maxrange = -1;
   int max_scan_no = -1;
   int skip_scan_eval = 5;
+  unsigned int quantization_bits = 0;
 
   int arg = 1;
   while (++arg < argc) {
@@ -80,11 +83,20 @@ int main(int argc, char** argv) {
       maxrange = atof(argv[++arg]);
     else if (! strcmp(argv[arg], "-n"))
       max_scan_no = atoi(argv[++arg]);
+    else if (! strcmp(argv[arg], "-quantized") && (argc-arg < 2))
+      printUsage(argv[0]);
+    else if (! strcmp(argv[arg], "-quantized"))
+      quantization_bits = atoi(argv[++arg]);
     else {
       printUsage(argv[0]);
     }
   }
 
+  if (quantization_bits != 0 && quantization_bits != 8 && quantization_bits != 16){
+    OCTOMAP_ERROR("Quantization to %u bits is not supported, use 8 or 16\n", quantization_bits);
+    exit(1);
+  }
+
   cout << "\nReading Graph file\n===========================\n";
   ScanGraph* graph = new ScanGraph();
   if (!graph->readBinary(graphFilename))
@@ -101,7 +113,11 @@ int main(int argc, char** argv) {
   }
 
   cout << "\nCreating tree\n===========================\n";
-  OcTree* tree = new OcTree(res);
+  OccupancyOcTreeBase<OcTreeNode>* tree;
+  if (quantization_bits > 0)
+    tree = new QuantizedOcTree(res, quantization_bits);
+  else
+    tree = new OcTree(res);
 
   size_t numScans = graph->size();
   unsigned int currentScan = 1;
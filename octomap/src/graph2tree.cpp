@@ -37,6 +37,7 @@
 #include <fstream>
 
 #include <octomap/octomap.h>
+#include <octomap/QuantizedOcTree.h>
 #include <octomap/octomap_timing.h>
 
 using namespace std;
@@ -62,7 +63,8 @@ void printUsage(char* self){
             "  -simple (simple scan insertion ray by ray instead of optimized) \n"
             "  -discretize (approximate raycasting on discretized coordinates, speeds up insertion) \n"
             "  -clamping <p_min> <p_max> (override default sensor model clamping probabilities between 0..1)\n"
-            "  -sensor <p_miss> <p_hit> (override default sensor model hit and miss probabilities between 0..1)"
+            "  -sensor <p_miss> <p_hit> (override default sensor model hit and miss probabilities between 0..1)\n"
+            "  -quantized <bits> (store log-odds quantized to 8 or 16 bits in a QuantizedOcTree)"
   "\n";
 
 
@@ -71,14 +73,21 @@ void printUsage(char* self){
   exit(0);
 }
 
-void calcThresholdedNodes(const OcTree* tree,
+typedef OccupancyOcTreeBase<OcTreeNode> OccupancyTree;
+
+std::streamoff fileSize(const std::string& filename){
+  std::ifstream file(filename.c_str(), std::ios_base::binary | std::ios_base::ate);
+  return file.is_open() ? std::streamoff(file.tellg()) : 0;
+}
+
+void calcThresholdedNodes(const OccupancyTree* tree,
                           unsigned int& num_thresholded,
                           unsigned int& num_other)
 {
   num_thresholded = 0;
   num_other = 0;
 
-  for(OcTree::tree_iterator it = tree->begin_tree(), end=tree->end_tree(); it!= end; ++it){
+  for(OccupancyTree::tree_iterator it = tree->begin_tree(), end=tree->end_tree(); it!= end; ++it){
     if (tree->isNodeAtThreshold(*it))
       num_thresholded++;
     else
@@ -86,7 +95,7 @@ void calcThresholdedNodes(const OcTree* tree,
   }
 }
 
-void outputStatistics(const OcTree* tree){
+void outputStatistics(const OccupancyTree* tree){
   unsigned int numThresholded, numOther;
   calcThresholdedNodes(tree, numThresholded, numOther);
   size_t memUsage = tree->memoryUsage();
@@ -115,6 +124,7 @@ int main(int argc, char** argv) {
   bool discretize = false;
   bool dontTransformNodes = false;
   unsigned char compression = 1;
+  unsigned int quantizationBits = 0;
 
   // get default sensor model values:
   OcTree emptyTree(0.1);
@@ -165,6 +175,10 @@ int main(int argc, char** argv) {
       probMiss = atof(argv[++arg]);
       probHit = atof(argv[++arg]);
     }
+    else if (! strcmp(argv[arg], "-quantized") && (argc-arg < 2))
+      printUsage(argv[0]);
+    else if (! strcmp(argv[arg], "-quantized"))
+      quantizationBits = atoi(argv[++arg]);
     else {
       printUsage(argv[0]);
     }
@@ -188,6 +202,10 @@ int main(int argc, char** argv) {
     OCTOMAP_ERROR("Error in sensor model (hit/miss prob.):  0.0 <= [%f] < [%f] <= 1.0\n", probMiss, probHit);
     exit(1);
   }
+  if (quantizationBits != 0 && quantizationBits != 8 && quantizationBits != 16){
+    OCTOMAP_ERROR("Quantization to %u bits is not supported, use 8 or 16\n", quantizationBits);
+    exit(1);
+  }
 
 
   std::string treeFilenameOT = treeFilename + ".ot";
@@ -234,7 +252,14 @@ int main(int argc, char** argv) {
 
 
   cout << "\nCreating tree\n===========================\n";
-  OcTree* tree = new OcTree(res);
+  OccupancyTree* tree;
+  if (quantizationBits > 0){
+    QuantizedOcTree* quantizedTree = new QuantizedOcTree(res, quantizationBits);
+    cout << "Log-odds quantized to " << quantizationBits << " bits, step " << quantizedTree->getQuantizationStep() << endl;
+    tree = quantizedTree;
+  }
+  else
+    tree = new OcTree(res);
 
   tree->setClampingThresMin(clampingMin);
   tree->setClampingThresMax(clampingMax);
@@ -296,8 +321,9 @@ int main(int argc, char** argv) {
 
   cout << "\nWriting tree files\n===========================\n";
   tree->write(treeFilenameMLOT);
-  std::cout << "Full Octree (pruned) written to "<< treeFilenameOT << std::endl;
-  std::cout << "Full Octree (max.likelihood, pruned) written to "<< treeFilenameMLOT << std::endl;
+  std::cout << "Full Octree (pruned) written to "<< treeFilenameOT << " (" << fileSize(treeFilenameOT) << " byte)" << std::endl;
+  std::cout << "Full Octree (max.likelihood, pruned) written to "<< treeFilenameMLOT
+            << " (" << fileSize(treeFilenameMLOT) << " byte)" << std::endl;
   tree->writeBinary(treeFilename);
   std::cout << "Bonsai tree written to "<< treeFilename << std::endl;
   cout << endl;
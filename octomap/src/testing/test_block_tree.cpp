@@ -0,0 +1,188 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <fstream>
+#include <sstream>
+
+#include <octomap/octomap_timing.h>
+#include <octomap/octomap.h>
+#include <octomap/BlockOcTree.h>
+#include "testing.h"
+
+using namespace std;
+using namespace octomap;
+
+void printUsage(char* self){
+  std::cerr << "\nUSAGE: " << self << " map.bt scans.graph [lookup_rounds]\n\n";
+  std::cerr << "Compares OcTree with BlockOcTree (contiguous children) in memory and lookup speed\n\n";
+
+  exit(1);
+}
+
+double timediff(const timeval& start, const timeval& stop){
+  return (stop.tv_sec - start.tv_sec) + 1.0e-6 *(stop.tv_usec - start.tv_usec);
+}
+
+/// both trees need to have the same structure and leaf values
+template <class TREE1, class TREE2>
+void compareTrees(const TREE1& tree1, const TREE2& tree2){
+  EXPECT_EQ(tree1.size(), tree2.size());
+  EXPECT_EQ(tree1.getNumLeafNodes(), tree2.getNumLeafNodes());
+  typename TREE2::tree_iterator it2 = tree2.begin_tree();
+  for (typename TREE1::tree_iterator it1 = tree1.begin_tree(); it1 != tree1.end_tree(); ++it1, ++it2){
+    EXPECT_TRUE(it2 != tree2.end_tree());
+    EXPECT_TRUE(it1.getKey() == it2.getKey());
+    EXPECT_EQ(it1.getDepth(), it2.getDepth());
+    EXPECT_EQ(it1.isLeaf(), it2.isLeaf());
+    EXPECT_FLOAT_EQ(it1->getLogOdds(), it2->getLogOdds());
+  }
+  EXPECT_TRUE(it2 == tree2.end_tree());
+}
+
+/// @return lookups per second for all keys in queries
+template <class TREE>
+double lookupThroughput(const TREE& tree, const std::vector<OcTreeKey>& queries, unsigned rounds, unsigned& num_occupied){
+  timeval start;
+  timeval stop;
+  num_occupied = 0;
+  gettimeofday(&start, NULL);
+  for (unsigned r = 0; r < rounds; ++r){
+    for (size_t i = 0; i < queries.size(); ++i){
+      typename TREE::NodeType* node = tree.search(queries[i]);
+      if (node && tree.isNodeOccupied(node))
+        ++num_occupied;
+    }
+  }
+  gettimeofday(&stop, NULL);
+  return double(rounds) * double(queries.size()) / timediff(start, stop);
+}
+
+template <class TREE>
+void insertGraph(TREE& tree, const ScanGraph& graph){
+  for (ScanGraph::const_iterator it = graph.begin(); it != graph.end(); ++it)
+    tree.insertPointCloud((*it)->scan, (*it)->pose.trans(), -1, false, true);
+}
+
+void benchmark(const OcTree& tree, const BlockOcTree& blockTree, unsigned rounds){
+  // query all leaves and the same number of random keys inside the map
+  std::vector<OcTreeKey> queries;
+  for (OcTree::leaf_iterator it = tree.begin_leafs(); it != tree.end_leafs(); ++it)
+    queries.push_back(it.getKey());
+
+  double x, y, z;
+  tree.getMetricMin(x, y, z);
+  point3d min(x, y, z);
+  tree.getMetricMax(x, y, z);
+  point3d size = point3d(x, y, z) - min;
+  srand(42);
+  size_t num_leafs = queries.size();
+  for (size_t i = 0; i < num_leafs; ++i){
+    point3d p(min.x() + size.x() * float(rand()) / RAND_MAX,
+              min.y() + size.y() * float(rand()) / RAND_MAX,
+              min.z() + size.z() * float(rand()) / RAND_MAX);
+    OcTreeKey key;
+    if (tree.coordToKeyChecked(p, key))
+      queries.push_back(key);
+  }
+
+  unsigned occupied, occupiedBlock;
+  double throughput = lookupThroughput(tree, queries, rounds, occupied);
+  double throughputBlock = lookupThroughput(blockTree, queries, rounds, occupiedBlock);
+  EXPECT_EQ(occupied, occupiedBlock);
+
+  std::cout << "  memoryUsage (OcTree / BlockOcTree): " << tree.memoryUsage() / 1024 << " / "
+            << blockTree.memoryUsage() / 1024 << " kB, node size: "
+            << tree.memoryUsageNode() << " / " << blockTree.memoryUsageNode() << " B\n";
+  std::cout << "  lookups/s (OcTree / BlockOcTree):   " << throughput << " / " << throughputBlock
+            << " (" << queries.size() << " keys x " << rounds << ")\n";
+}
+
+int main(int argc, char** argv) {
+  if (argc < 3 || argc > 4)
+    printUsage(argv[0]);
+
+  unsigned rounds = 3;
+  if (argc == 4)
+    rounds = atoi(argv[3]);
+
+  // the bitmask of the children must not enlarge the node
+  EXPECT_EQ(sizeof(BlockOcTreeNode), sizeof(OcTreeNode));
+
+  // binary map file
+  {
+    std::cout << "Map file " << argv[1] << ":\n";
+    OcTree tree(0.1);
+    BlockOcTree blockTree(0.1);
+    EXPECT_TRUE(tree.readBinary(argv[1]));
+    EXPECT_TRUE(blockTree.readBinary(argv[1]));
+    compareTrees(tree, blockTree);
+    EXPECT_EQ(blockTree.size(), blockTree.calcNumNodes());
+    benchmark(tree, blockTree, rounds);
+
+    // binary data needs to be identical (header differs in the tree type)
+    std::stringstream ss, ssBlock;
+    EXPECT_TRUE(tree.writeBinaryConst(ss));
+    EXPECT_TRUE(blockTree.writeBinaryConst(ssBlock));
+    std::string data = ss.str();
+    std::string dataBlock = ssBlock.str();
+    EXPECT_TRUE(data.substr(data.find("\ndata\n")) == dataBlock.substr(dataBlock.find("\ndata\n")));
+
+    // full .ot round trip through the tree factory
+    EXPECT_TRUE(blockTree.write("block_tree.ot"));
+    AbstractOcTree* readTree = AbstractOcTree::read("block_tree.ot");
+    EXPECT_TRUE(readTree);
+    EXPECT_EQ(readTree->getTreeType(), "BlockOcTree");
+    BlockOcTree* readBlockTree = dynamic_cast<BlockOcTree*>(readTree);
+    EXPECT_TRUE(readBlockTree);
+    EXPECT_TRUE(*readBlockTree == blockTree);
+    delete readTree;
+
+    // deep copy, with and without node pool
+    BlockOcTree copy(blockTree);
+    EXPECT_TRUE(copy == blockTree);
+    BlockOcTree pooled(0.1);
+    EXPECT_TRUE(pooled.useNodePool(true));
+    EXPECT_TRUE(pooled.readBinary(argv[1]));
+    EXPECT_TRUE(pooled == blockTree);
+    BlockOcTree pooledCopy(pooled);
+    EXPECT_TRUE(pooledCopy.isNodePoolUsed());
+    EXPECT_TRUE(pooledCopy == blockTree);
+
+    // expanding and pruning again
+    tree.expand();
+    blockTree.expand();
+    compareTrees(tree, blockTree);
+    tree.prune();
+    blockTree.prune();
+    compareTrees(tree, blockTree);
+    EXPECT_TRUE(copy == blockTree);
+  }
+
+  // scan insertion (incl. pruning and deletion of nodes)
+  {
+    std::cout << "Scan graph " << argv[2] << ":\n";
+    ScanGraph graph;
+    EXPECT_TRUE(graph.readBinary(argv[2]));
+    OcTree tree(0.05);
+    BlockOcTree blockTree(0.05);
+    insertGraph(tree, graph);
+    insertGraph(blockTree, graph);
+    compareTrees(tree, blockTree);
+    benchmark(tree, blockTree, rounds);
+
+    point3d bbxMin(0.5f, -1.0f, -1.0f);
+    point3d bbxMax(2.0f, 1.0f, 1.0f);
+    std::vector<std::pair<OcTreeKey, unsigned> > deleted;
+    for (OcTree::leaf_bbx_iterator it = tree.begin_leafs_bbx(bbxMin, bbxMax); it != tree.end_leafs_bbx(); ++it)
+      deleted.push_back(std::make_pair(it.getKey(), it.getDepth()));
+    EXPECT_TRUE(deleted.size() > 0);
+    for (size_t i = 0; i < deleted.size(); ++i){
+      bool result = tree.deleteNode(deleted[i].first, deleted[i].second);
+      EXPECT_EQ(blockTree.deleteNode(deleted[i].first, deleted[i].second), result);
+    }
+    compareTrees(tree, blockTree);
+    EXPECT_EQ(blockTree.size(), blockTree.calcNumNodes());
+  }
+
+  std::cerr << "Test successful.\n";
+  return 0;
+}
@@ -0,0 +1,144 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <sstream>
+
+#include <octomap/octomap_timing.h>
+#include <octomap/octomap.h>
+#include "testing.h"
+
+using namespace std;
+using namespace octomap;
+
+void printUsage(char* self){
+  std::cerr << "\nUSAGE: " << self << " map.bt\n\n";
+  std::cerr << "Writes and reads the map in compressed containers with all available codecs\n\n";
+
+  exit(1);
+}
+
+double timediff(const timeval& start, const timeval& stop){
+  return (stop.tv_sec - start.tv_sec) + 1.0e-6 *(stop.tv_usec - start.tv_usec);
+}
+
+/// LZ round trip of one block
+void testLZ(const std::string& data){
+  std::vector<char> compressed;
+  Compression::compressLZ(data.data(), data.size(), compressed);
+  std::string decompressed(data.size(), '\0');
+  EXPECT_TRUE(Compression::decompressLZ(compressed.empty() ? NULL : &compressed[0], compressed.size(),
+                                        data.empty() ? NULL : &decompressed[0], data.size()));
+  EXPECT_TRUE(decompressed == data);
+
+  // wrong sizes and truncated input are detected
+  if (!data.empty()){
+    std::string too_large(data.size() + 1, '\0');
+    EXPECT_FALSE(Compression::decompressLZ(&compressed[0], compressed.size(), &too_large[0], too_large.size()));
+    EXPECT_FALSE(Compression::decompressLZ(&compressed[0], compressed.size() - 1, &decompressed[0], data.size()));
+  }
+}
+
+int main(int argc, char** argv) {
+  if (argc != 2)
+    printUsage(argv[0]);
+
+  // codec edge cases: empty, short, long runs (overlapping matches), random (incompressible)
+  srand(42);
+  testLZ("");
+  testLZ("abc");
+  testLZ(std::string(100000, 'x'));
+  std::string text;
+  for (unsigned i = 0; i < 10000; ++i)
+    text += (rand() % 10 == 0) ? "octomap " : "octree ";
+  testLZ(text);
+  std::string random(100000, '\0');
+  for (size_t i = 0; i < random.size(); ++i)
+    random[i] = (char) (rand() % 256);
+  testLZ(random);
+
+  OcTree tree(0.1);
+  EXPECT_TRUE(tree.readBinary(argv[1]));
+  std::ostringstream binary;
+  EXPECT_TRUE(tree.writeBinary(binary));
+  std::ostringstream full;
+  EXPECT_TRUE(tree.write(full));
+  std::cout << argv[1] << ": " << tree.size() << " nodes, .bt: " << binary.str().size()
+            << " bytes, .ot: " << full.str().size() << " bytes\n";
+
+  std::vector<Compression::Codec> codecs;
+  codecs.push_back(Compression::LZ);
+  if (Compression::isAvailable(Compression::ZLIB))
+    codecs.push_back(Compression::ZLIB);
+  for (size_t c = 0; c < codecs.size(); ++c){
+    const char* name = (codecs[c] == Compression::LZ) ? "lz" : "zlib";
+    timeval start;
+    timeval stop;
+
+    // binary files
+    std::stringstream compressed;
+    gettimeofday(&start, NULL);
+    EXPECT_TRUE(tree.writeBinaryCompressed(compressed, codecs[c]));
+    gettimeofday(&stop, NULL);
+    double time_write = timediff(start, stop);
+    size_t compressed_size = compressed.str().size();
+
+    OcTree read_tree(0.1);
+    gettimeofday(&start, NULL);
+    EXPECT_TRUE(read_tree.readBinary(compressed));
+    gettimeofday(&stop, NULL);
+    double time_read = timediff(start, stop);
+    EXPECT_TRUE(tree == read_tree);
+    std::cout << ".bt, " << name << ": " << compressed_size << " bytes (ratio "
+              << double(binary.str().size()) / compressed_size << "), write / read: "
+              << time_write << " / " << time_read << " s\n";
+
+    // general files, several small blocks
+    std::stringstream compressed_ot;
+    std::string data = full.str();
+    EXPECT_TRUE(Compression::write(compressed_ot, data, codecs[c], 1 << 16));
+    AbstractOcTree* read_ot = AbstractOcTree::read(compressed_ot);
+    EXPECT_TRUE(read_ot);
+    OcTree* read_octree = dynamic_cast<OcTree*>(read_ot);
+    EXPECT_TRUE(read_octree);
+    EXPECT_TRUE(tree == *read_octree);
+    std::cout << ".ot, " << name << ": " << compressed_ot.str().size() << " bytes (ratio "
+              << double(data.size()) / compressed_ot.str().size() << ")\n";
+    delete read_ot;
+
+    // truncated files fail
+    std::string truncated = compressed.str();
+    truncated.resize(truncated.size() / 2);
+    std::istringstream truncated_stream(truncated);
+    EXPECT_FALSE(read_tree.readBinary(truncated_stream));
+  }
+
+  // implausible headers fail without allocating their sizes
+  const char* invalid_headers[] = {
+    "size 18446744073709551615\nblocksize 2\nblocks 0\n",                     // overflowing block count
+    "size 18446744073709551615\nblocksize 1\nblocks 18446744073709551615\n",  // more blocks than data
+    "size 1000000000000\nblocksize 1000000000000\nblocks 1\n",                // block size
+    "size 1000000000\nblocksize 1000000000\nblocks 1\n"                       // exceeds the compression ratio
+  };
+  for (size_t i = 0; i < sizeof(invalid_headers) / sizeof(invalid_headers[0]); ++i){
+    uint32_t compressed_size = 16;
+    std::string file = std::string("codec lz\n") + invalid_headers[i] + "data\n"
+        + std::string((const char*) &compressed_size, sizeof(compressed_size)) + std::string(16, 'x');
+    std::istringstream stream(file);
+    std::string data;
+    EXPECT_FALSE(Compression::read(stream, data));
+    EXPECT_TRUE(data.empty());
+  }
+
+  // files via file names
+  EXPECT_TRUE(tree.writeBinaryCompressed("compressed_tree.bt"));
+  OcTree read_tree(0.1);
+  EXPECT_TRUE(read_tree.readBinary("compressed_tree.bt"));
+  EXPECT_TRUE(tree == read_tree);
+  EXPECT_TRUE(tree.writeCompressed("compressed_tree.ot"));
+  AbstractOcTree* read_ot = AbstractOcTree::read("compressed_tree.ot");
+  EXPECT_TRUE(read_ot);
+  EXPECT_TRUE(tree == *dynamic_cast<OcTree*>(read_ot));
+  delete read_ot;
+
+  std::cerr << "Test successful.\n";
+  return 0;
+}
@@ -0,0 +1,166 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <sstream>
+
+#include <octomap/octomap_timing.h>
+#include <octomap/octomap.h>
+#include <octomap/math/Utils.h>
+#include "testing.h"
+
+using namespace std;
+using namespace octomap;
+
+void printUsage(char* self){
+  std::cerr << "\nUSAGE: " << self << " map.bt [num_scans]  (optional, default: 10)\n\n";
+  std::cerr << "Synchronizes a copy of the map with writeDelta() / applyDelta() after each scan,\n";
+  std::cerr << "compares delta size and apply time with transferring the full map\n\n";
+
+  exit(1);
+}
+
+double timediff(const timeval& start, const timeval& stop){
+  return (stop.tv_sec - start.tv_sec) + 1.0e-6 *(stop.tv_usec - start.tv_usec);
+}
+
+/// all leafs of tree need to be known in other with the same occupancy
+void expectSameOccupancy(const OcTree& tree, const OcTree& other){
+  for (OcTree::leaf_iterator it = tree.begin_leafs(); it != tree.end_leafs(); ++it){
+    OcTreeNode* node = other.search(it.getKey(), it.getDepth());
+    EXPECT_TRUE(node);
+    EXPECT_EQ(other.isNodeOccupied(node), tree.isNodeOccupied(*it));
+  }
+}
+
+int main(int argc, char** argv) {
+  if (argc < 2 || argc > 3)
+    printUsage(argv[0]);
+  unsigned num_scans = 10;
+  if (argc == 3)
+    num_scans = atoi(argv[2]);
+
+  OcTree server(0.1);
+  EXPECT_TRUE(server.readBinary(argv[1]));
+  OcTree client(server);
+  server.enableChangeDetection(true);
+
+  double x, y, z;
+  server.getMetricMin(x, y, z);
+  point3d min(x, y, z);
+  server.getMetricMax(x, y, z);
+  point3d max(x, y, z);
+
+  srand(42);
+  timeval start;
+  timeval stop;
+  size_t total_delta = 0;
+  size_t total_changes = 0;
+  double total_apply = 0.0;
+  for (unsigned s = 0; s < num_scans; ++s){
+    point3d origin(min.x() + (max.x() - min.x()) * float(rand()) / RAND_MAX,
+                   min.y() + (max.y() - min.y()) * float(rand()) / RAND_MAX,
+                   min.z() + (max.z() - min.z()) * float(rand()) / RAND_MAX);
+    server.insertPointCloud(generateScan(origin), origin);
+    size_t num_changes = server.numChangesDetected();
+    EXPECT_TRUE(num_changes > 0);
+
+    std::stringstream delta;
+    EXPECT_TRUE(server.writeDelta(delta));
+    size_t delta_size = delta.str().size();
+
+    gettimeofday(&start, NULL);
+    EXPECT_TRUE(client.applyDelta(delta));
+    gettimeofday(&stop, NULL);
+    double time_apply = timediff(start, stop);
+    EXPECT_EQ(client.numDirtyNodes(), 0);
+    EXPECT_EQ(client.size(), client.calcNumNodes());
+
+    // changed nodes have the same log-odds, all other nodes the same occupancy
+    for (KeyBoolMap::const_iterator it = server.changedKeysBegin(); it != server.changedKeysEnd(); ++it){
+      OcTreeNode* node = client.search(it->first);
+      EXPECT_TRUE(node);
+      EXPECT_FLOAT_EQ(node->getLogOdds(), server.search(it->first)->getLogOdds());
+    }
+    expectSameOccupancy(server, client);
+    expectSameOccupancy(client, server);
+
+    std::cout << "Scan " << s << ": " << num_changes << " changes, delta " << delta_size << " bytes ("
+              << double(delta_size) / num_changes << " bytes / change), applied in " << time_apply << " s\n";
+    total_delta += delta_size;
+    total_changes += num_changes;
+    total_apply += time_apply;
+    server.resetChangeDetection();
+  }
+
+  // transferring the full map instead
+  std::stringstream full_bt;
+  EXPECT_TRUE(server.writeBinary(full_bt));
+  std::stringstream full_ot;
+  EXPECT_TRUE(server.write(full_ot));
+  OcTree full_copy(server.getResolution());
+  gettimeofday(&start, NULL);
+  EXPECT_TRUE(full_copy.readBinary(full_bt));
+  gettimeofday(&stop, NULL);
+  double time_full = timediff(start, stop);
+  std::cout << "Per scan: " << total_changes / num_scans << " changes, delta " << total_delta / num_scans
+            << " bytes (unencoded keys and log-odds: " << 10 * total_changes / num_scans << " bytes), applied in "
+            << total_apply / num_scans << " s\n";
+  std::cout << "Full map: .bt " << full_bt.str().size() << " bytes, .ot " << full_ot.str().size()
+            << " bytes, .bt read in " << time_full << " s\n";
+
+  // deleted nodes
+  {
+    point3d origin = (min + max) * 0.5;
+    server.insertPointCloud(generateScan(origin), origin);
+    std::vector<OcTreeKey> deleted;
+    for (KeyBoolMap::const_iterator it = server.changedKeysBegin(); it != server.changedKeysEnd() && deleted.size() < 10; ++it)
+      deleted.push_back(it->first);
+    for (size_t i = 0; i < deleted.size(); ++i)
+      server.deleteNode(deleted[i]);
+
+    std::stringstream delta;
+    EXPECT_TRUE(server.writeDelta(delta));
+    EXPECT_TRUE(client.applyDelta(delta));
+    EXPECT_EQ(client.size(), client.calcNumNodes());
+    for (size_t i = 0; i < deleted.size(); ++i){
+      EXPECT_TRUE(server.search(deleted[i]) == NULL);
+      EXPECT_TRUE(client.search(deleted[i]) == NULL);
+    }
+    expectSameOccupancy(server, client);
+    server.resetChangeDetection();
+  }
+
+  // empty delta
+  {
+    std::stringstream delta;
+    EXPECT_TRUE(server.writeDelta(delta));
+    size_t size = client.size();
+    EXPECT_TRUE(client.applyDelta(delta));
+    EXPECT_EQ(client.size(), size);
+  }
+
+  // errors: resolution, format, truncated delta
+  {
+    point3d origin = (min + max) * 0.5;
+    server.insertPointCloud(generateScan(origin + point3d(0.5f, 0.0f, 0.0f)), origin);
+    std::stringstream delta;
+    EXPECT_TRUE(server.writeDelta(delta));
+    std::string data = delta.str();
+
+    OcTree other_res(2.0 * server.getResolution());
+    std::stringstream other_res_delta(data);
+    EXPECT_FALSE(other_res.applyDelta(other_res_delta));
+    EXPECT_EQ(other_res.size(), 0);
+
+    std::stringstream invalid(std::string("OTBT") + data.substr(4));
+    EXPECT_FALSE(client.applyDelta(invalid));
+
+    std::stringstream truncated(data.substr(0, data.size() / 2));
+    OcTree copy(client);
+    EXPECT_FALSE(copy.applyDelta(truncated));
+    EXPECT_EQ(copy.size(), copy.calcNumNodes());
+    EXPECT_EQ(copy.numDirtyNodes(), 0);
+  }
+
+  std::cerr << "Test successful.\n";
+  return 0;
+}
@@ -0,0 +1,134 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <octomap/octomap_timing.h>
+#include <octomap/octomap.h>
+#include <octomap/math/Utils.h>
+#include "testing.h"
+
+using namespace std;
+using namespace octomap;
+
+void printUsage(char* self){
+  std::cerr << "\nUSAGE: " << self << " map.bt [num_scans]  (optional, default: 3)\n\n";
+  std::cerr << "Compares updateDirtyInnerOccupancy() with updateInnerOccupancy() after local lazy updates\n\n";
+
+  exit(1);
+}
+
+double timediff(const timeval& start, const timeval& stop){
+  return (stop.tv_sec - start.tv_sec) + 1.0e-6 *(stop.tv_usec - start.tv_usec);
+}
+
+int main(int argc, char** argv) {
+  if (argc < 2 || argc > 3)
+    printUsage(argv[0]);
+  unsigned num_scans = 3;
+  if (argc == 3)
+    num_scans = atoi(argv[2]);
+
+  OcTree map(0.1);
+  EXPECT_TRUE(map.readBinary(argv[1]));
+  map.prune();
+  EXPECT_EQ(map.numDirtyNodes(), 0);
+
+  double x, y, z;
+  map.getMetricMin(x, y, z);
+  point3d min(x, y, z);
+  map.getMetricMax(x, y, z);
+  point3d max(x, y, z);
+
+  srand(42);
+  timeval start;
+  timeval stop;
+  OcTree full(map);
+  OcTree dirty(map);
+  dirty.enableDirtyTracking(true);
+  for (unsigned s = 0; s < num_scans; ++s){
+    point3d origin(min.x() + (max.x() - min.x()) * float(rand()) / RAND_MAX,
+                   min.y() + (max.y() - min.y()) * float(rand()) / RAND_MAX,
+                   min.z() + (max.z() - min.z()) * float(rand()) / RAND_MAX);
+    Pointcloud scan = generateScan(origin);
+
+    // lazy updates through all tracked functions
+    for (unsigned t = 0; t < 2; ++t){
+      OcTree& tree = (t == 0) ? full : dirty;
+      tree.insertPointCloud(scan, origin, -1., true);
+      for (int i = -5; i <= 5; ++i){
+        tree.updateNode(origin + point3d(0.1f * i, 0.0f, 0.0f), true, true);
+        tree.setNodeValue(origin + point3d(0.0f, 0.1f * i, 0.0f), tree.getClampingThresMaxLog(), true);
+      }
+    }
+
+    size_t num_dirty = dirty.numDirtyNodes();
+    EXPECT_TRUE(num_dirty > 0);
+    // not tracked by default
+    EXPECT_EQ(full.numDirtyNodes(), 0);
+
+    gettimeofday(&start, NULL);
+    full.updateInnerOccupancy();
+    gettimeofday(&stop, NULL);
+    double time_full = timediff(start, stop);
+    EXPECT_EQ(full.numDirtyNodes(), 0);
+
+    gettimeofday(&start, NULL);
+    dirty.updateDirtyInnerOccupancy();
+    gettimeofday(&stop, NULL);
+    double time_dirty = timediff(start, stop);
+    EXPECT_EQ(dirty.numDirtyNodes(), 0);
+    EXPECT_TRUE(full == dirty);
+    for (OcTree::tree_iterator it = full.begin_tree(), dirty_it = dirty.begin_tree(); it != full.end_tree(); ++it, ++dirty_it)
+      EXPECT_FLOAT_EQ(it->getLogOdds(), dirty_it->getLogOdds());
+
+    std::cout << "Scan " << s << ": " << num_dirty << " dirty nodes in " << full.size()
+              << " nodes, updateInnerOccupancy / updateDirtyInnerOccupancy: "
+              << time_full << " / " << time_dirty << " s (speedup " << time_full / time_dirty << ")\n";
+  }
+
+  // deferred pruning (only the newly updated subtrees)
+  full.prune();
+  dirty.prune();
+  point3d origin = (min + max) * 0.5;
+  Pointcloud scan = generateScan(origin);
+  full.insertPointCloud(scan, origin, -1., true);
+  dirty.insertPointCloud(scan, origin, -1., true);
+  full.updateInnerOccupancy();
+  full.prune();
+  dirty.updateDirtyInnerOccupancy(true);
+  EXPECT_EQ(dirty.size(), dirty.calcNumNodes());
+  EXPECT_EQ(full.size(), dirty.size());
+  EXPECT_TRUE(full == dirty);
+
+  // outdated dirty keys of deleted nodes are skipped
+  dirty.updateNode(origin, true, true);
+  dirty.deleteNode(origin);
+  dirty.updateDirtyInnerOccupancy(true);
+  EXPECT_EQ(dirty.size(), dirty.calcNumNodes());
+
+  // without tracking, all inner nodes are updated
+  OcTree untracked(dirty);
+  untracked.enableDirtyTracking(false);
+  untracked.insertPointCloud(scan, origin + point3d(1.0f, 0.0f, 0.0f), -1., true);
+  dirty.insertPointCloud(scan, origin + point3d(1.0f, 0.0f, 0.0f), -1., true);
+  EXPECT_EQ(untracked.numDirtyNodes(), 0);
+  untracked.updateDirtyInnerOccupancy(true);
+  dirty.updateDirtyInnerOccupancy(true);
+  EXPECT_TRUE(untracked == dirty);
+
+  // dirty nodes belong to the tree structure
+  OcTree other(map.getResolution());
+  other.enableDirtyTracking(true);
+  dirty.updateNode(origin, true, true);
+  EXPECT_TRUE(dirty.numDirtyNodes() > 0);
+  dirty.swapContent(other);
+  EXPECT_EQ(dirty.numDirtyNodes(), 0);
+  EXPECT_TRUE(other.numDirtyNodes() > 0);
+  other.clear();
+  EXPECT_EQ(other.numDirtyNodes(), 0);
+  dirty.enableDirtyTracking(false);
+  dirty.updateNode(origin, true, true);
+  EXPECT_EQ(dirty.numDirtyNodes(), 0);
+
+  std::cerr << "Test successful.\n";
+  return 0;
+}
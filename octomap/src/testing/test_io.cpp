@@ -1,9 +1,12 @@
 #include <stdio.h>
 #include <string>
+#include <sstream>
 
+#include <octomap/octomap_timing.h>
 #include <octomap/OcTree.h>
 #include <octomap/ColorOcTree.h>
 #include <octomap/OcTreeStamped.h>
+#include <octomap/CountingOcTree.h>
 #include <octomap/math/Utils.h>
 #include "testing.h"
  
@@ -11,6 +14,201 @@ using namespace std;
 using namespace octomap;
 using namespace octomath;
 
+double timediff(const timeval& start, const timeval& stop){
+  return (stop.tv_sec - start.tv_sec) + 1.0e-6 *(stop.tv_usec - start.tv_usec);
+}
+
+/// tree with the previous file IO (single stream calls per node) as reference
+template <class TREE>
+class StreamIOTree : public TREE {
+public:
+  typedef typename TREE::NodeType NODE;
+
+  StreamIOTree(double resolution) : TREE(resolution) {}
+
+  std::ostream& writeDataStream(std::ostream& s) const{
+    if (this->root)
+      writeNodesStream(this->root, s);
+    return s;
+  }
+
+  std::istream& readDataStream(std::istream& s){
+    this->clear();
+    this->root = this->allocNode();
+    readNodesStream(this->root, s);
+    this->tree_size = this->calcNumNodes();
+    this->size_changed = true;
+    return s;
+  }
+
+  std::ostream& writeBinaryDataStream(std::ostream& s) const{
+    if (this->root)
+      writeBinaryNodeStream(this->root, s);
+    return s;
+  }
+
+  std::istream& readBinaryDataStream(std::istream& s){
+    this->clear();
+    this->root = this->allocNode();
+    readBinaryNodeStream(this->root, s);
+    this->tree_size = this->calcNumNodes();
+    this->size_changed = true;
+    return s;
+  }
+
+protected:
+  void writeNodesStream(const NODE* node, std::ostream& s) const{
+    node->writeData(s);
+    char children = 0;
+    for (unsigned int i=0; i<8; i++){
+      if (this->nodeChildExists(node, i))
+        children |= (char) (1 << i);
+    }
+    s.write(&children, 1);
+    for (unsigned int i=0; i<8; i++){
+      if (children & (1 << i))
+        writeNodesStream(this->getNodeChild(node, i), s);
+    }
+  }
+
+  void readNodesStream(NODE* node, std::istream& s){
+    node->readData(s);
+    char children;
+    s.read(&children, 1);
+    for (unsigned int i=0; i<8; i++){
+      if (children & (1 << i))
+        readNodesStream(this->createNodeChild(node, i), s);
+    }
+  }
+
+  void writeBinaryNodeStream(const NODE* node, std::ostream& s) const{
+    char child_chars[2] = {0, 0};
+    for (unsigned int i=0; i<8; i++){
+      if (this->nodeChildExists(node, i)){
+        const NODE* child = this->getNodeChild(node, i);
+        char code = this->nodeHasChildren(child) ? 3 : (this->isNodeOccupied(child) ? 2 : 1);
+        child_chars[i/4] |= (char) (code << (2 * (i%4)));
+      }
+    }
+    s.write(&child_chars[0], 1);
+    s.write(&child_chars[1], 1);
+    for (unsigned int i=0; i<8; i++){
+      if (this->nodeChildExists(node, i) && this->nodeHasChildren(this->getNodeChild(node, i)))
+        writeBinaryNodeStream(this->getNodeChild(node, i), s);
+    }
+  }
+
+  void readBinaryNodeStream(NODE* node, std::istream& s){
+    char child_chars[2];
+    s.read(&child_chars[0], 1);
+    s.read(&child_chars[1], 1);
+    const uint8_t inner = this->readBinaryChildren(node, (unsigned char) child_chars[0], (unsigned char) child_chars[1]);
+    for (unsigned int i=0; i<8; i++){
+      if (inner & (1 << i)){
+        NODE* child = this->getNodeChild(node, i);
+        readBinaryNodeStream(child, s);
+        child->setLogOdds(child->getMaxChildLogOdds());
+      }
+    }
+  }
+};
+
+/// streambuf of a string which cannot seek
+class ForwardStreamBuf : public std::streambuf {
+public:
+  ForwardStreamBuf(std::string& data){
+    setg(&data[0], &data[0], &data[0] + data.size());
+  }
+};
+
+/// node with additional data which only implements the stream IO (no BufferedReader / BufferedWriter)
+class StreamOnlyNode : public OcTreeNode {
+public:
+  StreamOnlyNode() : OcTreeNode(), extra(0) {}
+  StreamOnlyNode(const StreamOnlyNode& rhs) : OcTreeNode(rhs), extra(rhs.extra) {}
+
+  bool operator==(const StreamOnlyNode& rhs) const{
+    return (rhs.value == value && rhs.extra == extra);
+  }
+
+  void copyData(const StreamOnlyNode& from){
+    OcTreeNode::copyData(from);
+    extra = from.extra;
+  }
+
+  std::istream& readData(std::istream& s){
+    s.read((char*) &value, sizeof(value));
+    s.read((char*) &extra, sizeof(extra));
+    return s;
+  }
+
+  std::ostream& writeData(std::ostream& s) const{
+    s.write((const char*) &value, sizeof(value));
+    s.write((const char*) &extra, sizeof(extra));
+    return s;
+  }
+
+  uint16_t extra;
+};
+
+class StreamOnlyOcTree : public OccupancyOcTreeBase<StreamOnlyNode> {
+public:
+  StreamOnlyOcTree(double resolution) : OccupancyOcTreeBase<StreamOnlyNode>(resolution) {}
+  StreamOnlyOcTree* create() const {return new StreamOnlyOcTree(resolution); }
+  std::string getTreeType() const {return "StreamOnlyOcTree";}
+};
+
+/// compares writeData() / readData() with the reference, prints MB/s
+template <class TREE>
+void benchmarkData(const std::string& name, const StreamIOTree<TREE>& tree){
+  timeval start;
+  timeval stop;
+
+  std::ostringstream stream_out;
+  gettimeofday(&start, NULL);
+  tree.writeDataStream(stream_out);
+  gettimeofday(&stop, NULL);
+  double time_write_stream = timediff(start, stop);
+
+  std::ostringstream buffered_out;
+  gettimeofday(&start, NULL);
+  tree.writeData(buffered_out);
+  gettimeofday(&stop, NULL);
+  double time_write = timediff(start, stop);
+
+  const std::string data = buffered_out.str();
+  EXPECT_TRUE(data == stream_out.str());
+  double mb = data.size() / 1.0e6;
+
+  // reading is dominated by node allocation, times of the 2nd run (warm heap)
+  StreamIOTree<TREE> stream_tree(tree.getResolution());
+  TREE buffered_tree(tree.getResolution());
+  double time_read_stream = 0.0;
+  double time_read = 0.0;
+  for (unsigned run = 0; run < 2; ++run){
+    std::istringstream stream_in(data);
+    gettimeofday(&start, NULL);
+    stream_tree.readDataStream(stream_in);
+    gettimeofday(&stop, NULL);
+    time_read_stream = timediff(start, stop);
+
+    buffered_tree.clear();
+    std::istringstream buffered_in(data);
+    gettimeofday(&start, NULL);
+    buffered_tree.readData(buffered_in);
+    gettimeofday(&stop, NULL);
+    time_read = timediff(start, stop);
+    EXPECT_TRUE(buffered_in.good());
+    EXPECT_TRUE(buffered_in.tellg() == std::istream::pos_type(data.size()));
+  }
+  EXPECT_TRUE(stream_tree == buffered_tree);
+  EXPECT_EQ(buffered_tree.size(), tree.size());
+
+  std::cout << "    " << name << ": " << tree.size() << " nodes, " << mb << " MB, MB/s write (stream / buffered): "
+            << mb / time_write_stream << " / " << mb / time_write << ", read: "
+            << mb / time_read_stream << " / " << mb / time_read << "\n";
+}
+
 int main(int argc, char** argv) {
 
   if (argc != 2){
@@ -177,6 +375,109 @@ int main(int argc, char** argv) {
   }
 
 
+  // Buffered node IO: byte-identical to single stream calls per node
+  {
+    std::cout << "Benchmarking buffered node IO...\n";
+    StreamIOTree<OcTree> tree(0.1);
+    EXPECT_TRUE(tree.readBinary(filename));
+
+    std::ostringstream stream_out;
+    timeval start;
+    timeval stop;
+    gettimeofday(&start, NULL);
+    tree.writeBinaryDataStream(stream_out);
+    gettimeofday(&stop, NULL);
+    double time_write_stream = timediff(start, stop);
+
+    std::ostringstream buffered_out;
+    gettimeofday(&start, NULL);
+    tree.writeBinaryData(buffered_out);
+    gettimeofday(&stop, NULL);
+    double time_write = timediff(start, stop);
+
+    const std::string data = buffered_out.str();
+    EXPECT_TRUE(data == stream_out.str());
+    double mb = data.size() / 1.0e6;
+
+    StreamIOTree<OcTree> stream_tree(0.1);
+    OcTree buffered_tree(0.1);
+    double time_read_stream = 0.0;
+    double time_read = 0.0;
+    for (unsigned run = 0; run < 2; ++run){
+      std::istringstream stream_in(data);
+      gettimeofday(&start, NULL);
+      stream_tree.readBinaryDataStream(stream_in);
+      gettimeofday(&stop, NULL);
+      time_read_stream = timediff(start, stop);
+
+      buffered_tree.clear();
+      std::istringstream buffered_in(data);
+      gettimeofday(&start, NULL);
+      buffered_tree.readBinaryData(buffered_in);
+      gettimeofday(&stop, NULL);
+      time_read = timediff(start, stop);
+    }
+    EXPECT_TRUE(stream_tree == buffered_tree);
+
+    std::cout << "    OcTree (binary): " << tree.size() << " nodes, " << mb << " MB, MB/s write (stream / buffered): "
+              << mb / time_write_stream << " / " << mb / time_write << ", read: "
+              << mb / time_read_stream << " / " << mb / time_read << "\n";
+
+    benchmarkData("OcTree", tree);
+
+    StreamIOTree<ColorOcTree> color_tree(0.1);
+    StreamIOTree<OcTreeStamped> stamped_tree(0.1);
+    StreamIOTree<CountingOcTree> counting_tree(0.1);
+    StreamIOTree<StreamOnlyOcTree> stream_only_tree(0.1);
+    for (OcTree::leaf_iterator it = tree.begin_leafs(), end = tree.end_leafs(); it != end; ++it){
+      ColorOcTreeNode* color_node = color_tree.setNodeValue(it.getKey(), it->getLogOdds(), true);
+      color_node->setColor(it.getKey()[0] % 256, it.getKey()[1] % 256, it.getKey()[2] % 256);
+      stamped_tree.setNodeValue(it.getKey(), it->getLogOdds(), true);
+      counting_tree.updateNode(it.getKey());
+      StreamOnlyNode* stream_only_node = stream_only_tree.setNodeValue(it.getKey(), it->getLogOdds(), true);
+      stream_only_node->extra = it.getKey()[0];
+    }
+    color_tree.updateInnerOccupancy();
+    stamped_tree.updateInnerOccupancy();
+    benchmarkData("ColorOcTree", color_tree);
+    benchmarkData("OcTreeStamped", stamped_tree);
+    benchmarkData("CountingOcTree", counting_tree);
+    stream_only_tree.updateInnerOccupancy();
+    EXPECT_TRUE(BufferedNodeIO<ColorOcTreeNode>::read && BufferedNodeIO<ColorOcTreeNode>::write);
+    EXPECT_TRUE(BufferedNodeIO<OcTreeNodeStamped>::read && BufferedNodeIO<OcTreeNodeStamped>::write);
+    EXPECT_FALSE(BufferedNodeIO<StreamOnlyNode>::read || BufferedNodeIO<StreamOnlyNode>::write);
+    benchmarkData("StreamOnlyOcTree", stream_only_tree);
+
+    // consecutive trees in one stream: data read ahead is returned to the stream
+    std::stringstream both;
+    EXPECT_TRUE(tree.write(both));
+    EXPECT_TRUE(color_tree.writeBinary(both));
+    AbstractOcTree* read_tree = AbstractOcTree::read(both);
+    EXPECT_TRUE(read_tree);
+    EXPECT_TRUE(tree == *dynamic_cast<OcTree*>(read_tree));
+    delete read_tree;
+    ColorOcTree read_color_tree(0.1);
+    EXPECT_TRUE(read_color_tree.readBinary(both));
+    EXPECT_EQ(read_color_tree.size(), color_tree.size());
+
+    // streams which cannot seek are read without buffer
+    std::ostringstream color_out;
+    EXPECT_TRUE(color_tree.write(color_out));
+    std::string color_data = color_out.str();
+    ForwardStreamBuf forward_buf(color_data);
+    std::istream forward(&forward_buf);
+    read_tree = AbstractOcTree::read(forward);
+    EXPECT_TRUE(read_tree);
+    EXPECT_TRUE(color_tree == *dynamic_cast<ColorOcTree*>(read_tree));
+    delete read_tree;
+
+    // truncated data fails the stream
+    OcTree truncated_tree(0.1);
+    std::istringstream truncated(data.substr(0, data.size() / 2));
+    truncated_tree.readBinaryData(truncated);
+    EXPECT_TRUE(truncated.fail());
+  }
+
   std::cerr << "Test successful.\n";
   return 0;
 }
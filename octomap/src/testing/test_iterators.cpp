@@ -209,6 +209,109 @@ void boundingBoxTest(OcTree* tree){
   }
 }
 
+/// depth first order of the leafs with children in index order, as visited by the iterators
+void getLeafKeysRecurs(std::vector<std::pair<OcTreeKey, unsigned int> >& leafs, OcTree* tree, OcTreeNode* node,
+                       const OcTreeKey& key, unsigned int depth, unsigned int max_depth){
+  if (depth == max_depth || !tree->nodeHasChildren(node)){
+    leafs.push_back(std::make_pair(key, depth));
+    return;
+  }
+  key_type center_offset_key = 32768 >> (depth + 1);
+  for (unsigned int i = 0; i < 8; ++i){
+    if (tree->nodeChildExists(node, i)){
+      OcTreeKey child_key;
+      computeChildKey(i, center_offset_key, key, child_key);
+      getLeafKeysRecurs(leafs, tree, tree->getNodeChild(node, i), child_key, depth + 1, max_depth);
+    }
+  }
+}
+
+/// visiting order of the leaf iterator and throughput of all iterators
+void iteratorThroughputTest(OcTree* tree, unsigned char maxDepth){
+  if (tree->getRoot() == NULL)
+    return;
+
+  std::vector<std::pair<OcTreeKey, unsigned int> > leafs;
+  getLeafKeysRecurs(leafs, tree, tree->getRoot(), OcTreeKey(32768, 32768, 32768), 0, maxDepth);
+  size_t i = 0;
+  for (OcTree::leaf_iterator it = tree->begin_leafs(maxDepth), end = tree->end_leafs(); it != end; ++it, ++i){
+    EXPECT_TRUE(i < leafs.size());
+    EXPECT_TRUE(it.getKey() == leafs[i].first);
+    EXPECT_EQ(it.getDepth(), leafs[i].second);
+  }
+  EXPECT_EQ(i, leafs.size());
+
+  double x, y, z;
+  tree->getMetricMin(x, y, z);
+  point3d bbx_min(x, y, z);
+  tree->getMetricMax(x, y, z);
+  point3d bbx_max(x, y, z);
+  point3d quarter = (bbx_max - bbx_min) * 0.25;
+  bbx_min += quarter;
+  bbx_max -= quarter;
+
+  const unsigned int num_passes = 20;
+  timeval start;
+  timeval stop;
+  double times[5];
+  size_t counts[5] = {0, 0, 0, 0, 0};
+  float sum = 0.0f;
+
+  gettimeofday(&start, NULL);
+  for (unsigned int pass = 0; pass < num_passes; ++pass){
+    for (OcTree::leaf_iterator it = tree->begin_leafs(maxDepth), end = tree->end_leafs(); it != end; ++it, ++counts[0])
+      sum += it->getLogOdds();
+  }
+  gettimeofday(&stop, NULL);
+  times[0] = timediff(start, stop);
+
+  // postfix increment, copies the iterator in each step
+  gettimeofday(&start, NULL);
+  for (unsigned int pass = 0; pass < num_passes; ++pass){
+    for (OcTree::leaf_iterator it = tree->begin_leafs(maxDepth), end = tree->end_leafs(); it != end; it++, ++counts[1])
+      sum += it->getLogOdds();
+  }
+  gettimeofday(&stop, NULL);
+  times[1] = timediff(start, stop);
+
+  // end iterator created in each comparison
+  gettimeofday(&start, NULL);
+  for (unsigned int pass = 0; pass < num_passes; ++pass){
+    for (OcTree::leaf_iterator it = tree->begin_leafs(maxDepth); it != tree->end_leafs(); ++it, ++counts[2])
+      sum += it->getLogOdds();
+  }
+  gettimeofday(&stop, NULL);
+  times[2] = timediff(start, stop);
+
+  gettimeofday(&start, NULL);
+  for (unsigned int pass = 0; pass < num_passes; ++pass){
+    for (OcTree::tree_iterator it = tree->begin_tree(maxDepth), end = tree->end_tree(); it != end; ++it, ++counts[3])
+      sum += it->getLogOdds();
+  }
+  gettimeofday(&stop, NULL);
+  times[3] = timediff(start, stop);
+
+  gettimeofday(&start, NULL);
+  for (unsigned int pass = 0; pass < num_passes; ++pass){
+    for (OcTree::leaf_bbx_iterator it = tree->begin_leafs_bbx(bbx_min, bbx_max, maxDepth), end = tree->end_leafs_bbx();
+         it != end; ++it, ++counts[4])
+      sum += it->getLogOdds();
+  }
+  gettimeofday(&stop, NULL);
+  times[4] = timediff(start, stop);
+
+  EXPECT_EQ(counts[0], num_passes * leafs.size());
+  EXPECT_EQ(counts[1], counts[0]);
+  EXPECT_EQ(counts[2], counts[0]);
+  EXPECT_TRUE(counts[4] > 0 && counts[4] < counts[0]);
+  const char* names[5] = {"leaf_iterator", "leaf_iterator (it++)", "leaf_iterator (end_leafs() per step)",
+                          "tree_iterator", "leaf_bbx_iterator"};
+  std::cout << "Iterator throughput (" << sum << "):\n";
+  for (unsigned int t = 0; t < 5; ++t)
+    std::cout << "  " << names[t] << ": " << 1e-6 * counts[t] / times[t] << " M nodes/s\n";
+  std::cout << "========================\n\n";
+}
+
 int main(int argc, char** argv) {
 
 
@@ -410,6 +513,9 @@ int main(int argc, char** argv) {
 
 
 
+    iteratorThroughputTest(tree, maxDepth);
+    iteratorThroughputTest(&emptyTree, maxDepth);
+
   /**
    * bounding box tests
    */
@@ -0,0 +1,201 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <octomap/octomap_timing.h>
+#include <octomap/octomap.h>
+#include "testing.h"
+
+using namespace std;
+using namespace octomap;
+
+typedef unordered_ns::unordered_set<OcTreeKey, OcTreeKey::KeyHash> UnorderedKeySet;
+
+void printUsage(char* self){
+  std::cerr << "\nUSAGE: " << self << " [max_keys]  (optional, default: 10000000)\n\n";
+  std::cerr << "Compares KeySet with an unordered_set for 10k, 100k, ... max_keys keys\n\n";
+
+  exit(1);
+}
+
+double timediff(const timeval& start, const timeval& stop){
+  return (stop.tv_sec - start.tv_sec) + 1.0e-6 *(stop.tv_usec - start.tv_usec);
+}
+
+/// n keys of a dense, axis-aligned box around the map center (worst case for OcTreeKey::KeyHash)
+std::vector<OcTreeKey> generateKeys(size_t n){
+  unsigned side = 1;
+  while (side * side * side < n)
+    ++side;
+  std::vector<OcTreeKey> keys;
+  keys.reserve(n);
+  for (unsigned x = 0; x < side && keys.size() < n; ++x)
+    for (unsigned y = 0; y < side && keys.size() < n; ++y)
+      for (unsigned z = 0; z < side && keys.size() < n; ++z)
+        keys.push_back(OcTreeKey(32768 - side/2 + x, 32768 - side/2 + y, 32768 - side/2 + z));
+  return keys;
+}
+
+struct Timings {
+  double insert, find, iterate, erase;
+  size_t num_found, key_sum;
+};
+
+template <class SET>
+Timings benchmark(const std::vector<OcTreeKey>& keys, const std::vector<OcTreeKey>& queries){
+  Timings t;
+  timeval start;
+  timeval stop;
+  SET set;
+
+  gettimeofday(&start, NULL);
+  for (size_t i = 0; i < keys.size(); ++i)
+    set.insert(keys[i]);
+  gettimeofday(&stop, NULL);
+  t.insert = timediff(start, stop);
+  EXPECT_EQ(set.size(), keys.size());
+
+  t.num_found = 0;
+  gettimeofday(&start, NULL);
+  for (size_t i = 0; i < queries.size(); ++i){
+    if (set.find(queries[i]) != set.end())
+      ++t.num_found;
+  }
+  gettimeofday(&stop, NULL);
+  t.find = timediff(start, stop);
+
+  t.key_sum = 0;
+  gettimeofday(&start, NULL);
+  for (typename SET::const_iterator it = set.begin(); it != set.end(); ++it)
+    t.key_sum += (*it)[0] + (*it)[1] + (*it)[2];
+  gettimeofday(&stop, NULL);
+  t.iterate = timediff(start, stop);
+
+  // erase every other key while iterating
+  gettimeofday(&start, NULL);
+  bool erase = true;
+  for (typename SET::iterator it = set.begin(); it != set.end(); erase = !erase){
+    if (erase)
+      it = set.erase(it);
+    else
+      ++it;
+  }
+  gettimeofday(&stop, NULL);
+  t.erase = timediff(start, stop);
+  EXPECT_EQ(set.size(), keys.size() / 2);
+
+  return t;
+}
+
+void testKeyBoolMap(){
+  KeyBoolMap map;
+  EXPECT_TRUE(map.empty());
+  EXPECT_TRUE(map.begin() == map.end());
+  EXPECT_TRUE(map.find(OcTreeKey(1, 2, 3)) == map.end());
+
+  // insert does not overwrite existing values
+  EXPECT_TRUE(map.insert(std::pair<OcTreeKey,bool>(OcTreeKey(1, 2, 3), true)).second);
+  EXPECT_FALSE(map.insert(std::pair<OcTreeKey,bool>(OcTreeKey(1, 2, 3), false)).second);
+  EXPECT_TRUE(map.find(OcTreeKey(1, 2, 3))->second);
+  map[OcTreeKey(1, 2, 3)] = false;
+  EXPECT_FALSE(map.find(OcTreeKey(1, 2, 3))->second);
+  EXPECT_FALSE(map[OcTreeKey(65535, 0, 65535)]);
+  EXPECT_EQ(map.size(), 2);
+
+  // many inserts and erases (reuse of deleted slots, rehashing)
+  for (unsigned i = 0; i < 10000; ++i)
+    map.insert(std::pair<OcTreeKey,bool>(OcTreeKey(i, i % 7, 100), i % 2 == 0));
+  for (unsigned i = 0; i < 10000; i += 3)
+    EXPECT_EQ(map.erase(OcTreeKey(i, i % 7, 100)), 1);
+  for (unsigned i = 0; i < 10000; ++i){
+    KeyBoolMap::const_iterator it = map.find(OcTreeKey(i, i % 7, 100));
+    if (i % 3 == 0){
+      EXPECT_TRUE(it == map.end());
+    } else {
+      EXPECT_TRUE(it != map.end());
+      EXPECT_TRUE(it->second == (i % 2 == 0));
+    }
+  }
+
+  size_t num_entries = 0;
+  for (KeyBoolMap::const_iterator it = map.begin(); it != map.end(); ++it)
+    ++num_entries;
+  EXPECT_EQ(num_entries, map.size());
+
+  KeyBoolMap copy(map);
+  map.clear();
+  EXPECT_TRUE(map.empty());
+  EXPECT_TRUE(map.begin() == map.end());
+  EXPECT_EQ(copy.size(), num_entries);
+  map.swap(copy);
+  EXPECT_EQ(map.size(), num_entries);
+  EXPECT_TRUE(copy.empty());
+}
+
+void testKeySet(){
+  KeySet set;
+  for (unsigned i = 0; i < 10000; ++i)
+    set.insert(OcTreeKey(i, i % 7, 100));
+  for (unsigned i = 0; i < 10000; i += 3)
+    EXPECT_EQ(set.erase(OcTreeKey(i, i % 7, 100)), 1);
+  set.insert(OcTreeKey(0, 0, 100));
+
+  // iterators refer to the stored keys, also after rehashing
+  size_t num_keys = 0;
+  for (KeySet::const_iterator it = set.begin(); it != set.end(); ++it){
+    const OcTreeKey& key = *it;
+    EXPECT_TRUE(&key == &(*it));
+    EXPECT_EQ(it->k[1], it->k[0] % 7);
+    EXPECT_EQ(it->k[2], 100);
+    EXPECT_TRUE(it->k[0] == 0 || it->k[0] % 3 != 0);
+    ++num_keys;
+  }
+  EXPECT_EQ(num_keys, set.size());
+  EXPECT_TRUE(set.insert(OcTreeKey(1, 1, 100)).first->k[0] == 1);
+
+  KeySet other;
+  other.swap(set);
+  EXPECT_TRUE(set.empty());
+  EXPECT_TRUE(*other.find(OcTreeKey(1, 1, 100)) == OcTreeKey(1, 1, 100));
+  other.clear();
+  EXPECT_TRUE(other.begin() == other.end());
+  other.insert(OcTreeKey(5, 6, 7));
+  EXPECT_TRUE(*other.begin() == OcTreeKey(5, 6, 7));
+}
+
+int main(int argc, char** argv) {
+  size_t max_keys = 10000000;
+  if (argc > 2)
+    printUsage(argv[0]);
+  if (argc == 2)
+    max_keys = atol(argv[1]);
+
+  testKeyBoolMap();
+  testKeySet();
+
+  for (size_t n = 10000; n <= max_keys; n *= 10){
+    std::vector<OcTreeKey> keys = generateKeys(n);
+    // half of the queries are contained
+    std::vector<OcTreeKey> queries;
+    queries.reserve(n);
+    srand(42);
+    for (size_t i = 0; i < n; ++i){
+      OcTreeKey key = keys[rand() % n];
+      if (i % 2)
+        key[2] += 20000;
+      queries.push_back(key);
+    }
+
+    Timings flat = benchmark<KeySet>(keys, queries);
+    Timings unordered = benchmark<UnorderedKeySet>(keys, queries);
+    EXPECT_EQ(flat.num_found, unordered.num_found);
+    EXPECT_EQ(flat.key_sum, unordered.key_sum);
+
+    std::cout << n << " keys (KeySet / unordered_set), insert: " << flat.insert << " / " << unordered.insert
+              << " s, find: " << flat.find << " / " << unordered.find
+              << " s, iterate: " << flat.iterate << " / " << unordered.iterate
+              << " s, erase: " << flat.erase << " / " << unordered.erase << " s\n";
+  }
+
+  std::cerr << "Test successful.\n";
+  return 0;
+}
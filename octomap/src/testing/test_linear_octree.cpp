@@ -0,0 +1,223 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <octomap/octomap_timing.h>
+#include <octomap/octomap.h>
+#include <octomap/LinearOcTree.h>
+#include "testing.h"
+
+using namespace std;
+using namespace octomap;
+
+void printUsage(char* self){
+  std::cerr << "\nUSAGE: " << self << " map.bt [num_queries]  (optional, default: 100000)\n\n";
+  std::cerr << "Converts the map to a LinearOcTree, checks all queries against the OcTree\n";
+  std::cerr << "and compares search throughput for random and coherent query streams\n\n";
+
+  exit(1);
+}
+
+double timediff(const timeval& start, const timeval& stop){
+  return (stop.tv_sec - start.tv_sec) + 1.0e-6 *(stop.tv_usec - start.tv_usec);
+}
+
+/// @return searches per second of the OcTree, the LinearOcTree and the LinearOcTree with hint
+void benchmark(const OcTree& tree, const LinearOcTree& linear, const std::vector<OcTreeKey>& keys,
+               double& throughput_tree, double& throughput_linear, double& throughput_hint){
+  timeval start;
+  timeval stop;
+  unsigned occupied = 0;
+  gettimeofday(&start, NULL);
+  for (size_t i = 0; i < keys.size(); ++i){
+    OcTreeNode* node = tree.search(keys[i]);
+    if (node && tree.isNodeOccupied(node))
+      ++occupied;
+  }
+  gettimeofday(&stop, NULL);
+  throughput_tree = keys.size() / timediff(start, stop);
+
+  unsigned occupied_linear = 0;
+  gettimeofday(&start, NULL);
+  for (size_t i = 0; i < keys.size(); ++i){
+    const LinearOcTreeNode* node = linear.search(keys[i]);
+    if (node && linear.isNodeOccupied(node))
+      ++occupied_linear;
+  }
+  gettimeofday(&stop, NULL);
+  throughput_linear = keys.size() / timediff(start, stop);
+  EXPECT_EQ(occupied_linear, occupied);
+
+  unsigned occupied_hint = 0;
+  size_t hint = 0;
+  gettimeofday(&start, NULL);
+  for (size_t i = 0; i < keys.size(); ++i){
+    const LinearOcTreeNode* node = linear.search(keys[i], hint);
+    if (node && linear.isNodeOccupied(node))
+      ++occupied_hint;
+  }
+  gettimeofday(&stop, NULL);
+  throughput_hint = keys.size() / timediff(start, stop);
+  EXPECT_EQ(occupied_hint, occupied);
+}
+
+int main(int argc, char** argv) {
+  if (argc < 2 || argc > 3)
+    printUsage(argv[0]);
+  unsigned num_queries = 100000;
+  if (argc == 3)
+    num_queries = atoi(argv[2]);
+
+  OcTree tree(0.1);
+  EXPECT_TRUE(tree.readBinary(argv[1]));
+  LinearOcTree linear(tree);
+  EXPECT_EQ(linear.size(), tree.getNumLeafNodes());
+  EXPECT_FLOAT_EQ(linear.getResolution(), tree.getResolution());
+  std::cout << argv[1] << ": " << linear.size() << " leafs, memory (OcTree / LinearOcTree): "
+            << tree.memoryUsage() << " / " << linear.memoryUsage() << " bytes\n";
+
+  // leafs in the order of the leaf iterator
+  size_t i = 0;
+  for (OcTree::leaf_iterator it = tree.begin_leafs(); it != tree.end_leafs(); ++it, ++i){
+    EXPECT_TRUE(linear.getLeafKey(i) == it.getKey());
+    EXPECT_EQ(linear.getLeaf(i).getDepth(), it.getDepth());
+    EXPECT_FLOAT_EQ(linear.getLeaf(i).getLogOdds(), it->getLogOdds());
+    EXPECT_TRUE(linear.search(it.getKey()) == &linear.getLeaf(i));
+  }
+
+  double x, y, z;
+  tree.getMetricMin(x, y, z);
+  point3d min(x, y, z);
+  tree.getMetricMax(x, y, z);
+  point3d size = point3d(x, y, z) - min;
+  srand(42);
+
+  // random queries (with a margin around the map for unknown space) and a robot moving through the map
+  std::vector<OcTreeKey> random_keys;
+  std::vector<OcTreeKey> coherent_keys;
+  point3d position = min + size * 0.5;
+  for (unsigned q = 0; q < num_queries; ++q){
+    random_keys.push_back(tree.coordToKey(randomPoint(min - size * 0.1, size * 1.2)));
+    position += point3d(0.1f * (float(rand()) / RAND_MAX - 0.5f), 0.1f * (float(rand()) / RAND_MAX - 0.5f), 0.0f);
+    for (unsigned j = 0; j < 2; ++j)
+      position(j) = std::min(std::max(position(j), min(j)), min(j) + size(j));
+    coherent_keys.push_back(tree.coordToKey(position + point3d(2.0f * (float(rand()) / RAND_MAX - 0.5f),
+                                                               2.0f * (float(rand()) / RAND_MAX - 0.5f),
+                                                               2.0f * (float(rand()) / RAND_MAX - 0.5f))));
+  }
+  // voxels along rays
+  std::vector<OcTreeKey> ray_keys;
+  while (ray_keys.size() < num_queries){
+    point3d origin = randomPoint(min, size);
+    point3d direction = point3d(float(rand()) / RAND_MAX - 0.5f, float(rand()) / RAND_MAX - 0.5f,
+                                float(rand()) / RAND_MAX - 0.5f).normalized();
+    KeyRay ray;
+    if (tree.computeRayKeys(origin, origin + direction * 5.0, ray))
+      ray_keys.insert(ray_keys.end(), ray.begin(), ray.end());
+  }
+  size_t hint = 0;
+  for (unsigned q = 0; q < num_queries; ++q){
+    const OcTreeKey& key = random_keys[q];
+    OcTreeNode* node = tree.search(key);
+    const LinearOcTreeNode* linear_node = linear.search(key);
+    EXPECT_TRUE((node == NULL) == (linear_node == NULL));
+    if (node)
+      EXPECT_FLOAT_EQ(node->getLogOdds(), linear_node->getLogOdds());
+    EXPECT_TRUE(linear.search(key, hint) == linear_node);
+    EXPECT_TRUE(linear.search(coherent_keys[q], hint) == linear.search(coherent_keys[q]));
+  }
+
+  double throughput_tree, throughput_linear, throughput_hint;
+  benchmark(tree, linear, random_keys, throughput_tree, throughput_linear, throughput_hint);
+  std::cout << "Random queries/s (OcTree / LinearOcTree / with hint):   " << throughput_tree << " / "
+            << throughput_linear << " / " << throughput_hint << "\n";
+  benchmark(tree, linear, coherent_keys, throughput_tree, throughput_linear, throughput_hint);
+  std::cout << "Coherent queries/s (OcTree / LinearOcTree / with hint): " << throughput_tree << " / "
+            << throughput_linear << " / " << throughput_hint << "\n";
+  benchmark(tree, linear, ray_keys, throughput_tree, throughput_linear, throughput_hint);
+  std::cout << "Ray queries/s (OcTree / LinearOcTree / with hint):      " << throughput_tree << " / "
+            << throughput_linear << " / " << throughput_hint << "\n";
+
+  // ray casting
+  for (unsigned run = 0; run < 2; ++run){
+    bool ignore_unknown = (run == 1);
+    double max_range = ignore_unknown ? 0.5 * size.norm() : -1.0;
+    unsigned num_hits = 0;
+    timeval start;
+    timeval stop;
+    double time_tree = 0.0;
+    double time_linear = 0.0;
+    for (unsigned q = 0; q < std::min(num_queries, 20000u); ++q){
+      point3d origin = randomPoint(min, size);
+      point3d direction(float(rand()) / RAND_MAX - 0.5f, float(rand()) / RAND_MAX - 0.5f,
+                        float(rand()) / RAND_MAX - 0.5f);
+      point3d end;
+      point3d linear_end;
+      gettimeofday(&start, NULL);
+      bool hit = tree.castRay(origin, direction, end, ignore_unknown, max_range);
+      gettimeofday(&stop, NULL);
+      time_tree += timediff(start, stop);
+      gettimeofday(&start, NULL);
+      EXPECT_EQ(linear.castRay(origin, direction, linear_end, ignore_unknown, max_range), hit);
+      gettimeofday(&stop, NULL);
+      time_linear += timediff(start, stop);
+      EXPECT_TRUE(end == linear_end);
+      if (hit)
+        ++num_hits;
+    }
+    std::cout << "castRay" << (ignore_unknown ? ", ignoring unknown: " : ": ") << num_hits << " hits, "
+              << time_tree << " / " << time_linear << " s (OcTree / LinearOcTree)\n";
+  }
+
+  // bounding boxes, the same leafs in the same order (OcTree also returns leafs ending directly before the minimum)
+  for (unsigned b = 0; b < 20; ++b){
+    point3d bbx_min = randomPoint(min - size * 0.1, size * 1.2);
+    point3d bbx_max = bbx_min + point3d(4.0f * float(rand()) / RAND_MAX, 4.0f * float(rand()) / RAND_MAX,
+                                        4.0f * float(rand()) / RAND_MAX);
+    OcTreeKey min_key = tree.coordToKey(bbx_min);
+    LinearOcTree::leaf_bbx_iterator linear_it = linear.begin_leafs_bbx(bbx_min, bbx_max);
+    for (OcTree::leaf_bbx_iterator it = tree.begin_leafs_bbx(bbx_min, bbx_max); it != tree.end_leafs_bbx(); ++it){
+      unsigned node_size = 1 << (tree.getTreeDepth() - it.getDepth());
+      bool before_min = false;
+      for (unsigned j = 0; j < 3; ++j)
+        before_min |= (it.getKey()[j] - node_size / 2 + node_size - 1 < min_key[j]);
+      if (before_min)
+        continue;
+      EXPECT_TRUE(linear_it != linear.end_leafs_bbx());
+      EXPECT_TRUE(linear_it.getKey() == it.getKey());
+      EXPECT_EQ(linear_it.getDepth(), it.getDepth());
+      EXPECT_TRUE(linear_it.getCoordinate() == it.getCoordinate());
+      EXPECT_FLOAT_EQ(linear_it->getLogOdds(), it->getLogOdds());
+      ++linear_it;
+    }
+    EXPECT_TRUE(linear_it == linear.end_leafs_bbx());
+  }
+  {
+    size_t num_leafs = 0;
+    for (LinearOcTree::leaf_bbx_iterator it = linear.begin_leafs_bbx(min, min + size); it != linear.end_leafs_bbx(); ++it)
+      ++num_leafs;
+    EXPECT_EQ(num_leafs, linear.size());
+  }
+
+  // empty tree and a pruned root
+  OcTree empty(0.1);
+  linear.build(empty);
+  EXPECT_EQ(linear.size(), 0);
+  EXPECT_FALSE(linear.search(point3d(0.0f, 0.0f, 0.0f)));
+  hint = 0;
+  EXPECT_FALSE(linear.search(OcTreeKey(1, 2, 3), hint));
+  EXPECT_TRUE(linear.begin_leafs_bbx(min, min + size) == linear.end_leafs_bbx());
+  point3d end;
+  EXPECT_FALSE(linear.castRay(point3d(0.0f, 0.0f, 0.0f), point3d(1.0f, 0.0f, 0.0f), end));
+
+  OcTree full(0.1);
+  full.setNodeValue(OcTreeKey(0, 0, 0), 1.0f);
+  full.toMaxLikelihood();
+  linear.build(full);
+  EXPECT_EQ(linear.size(), full.getNumLeafNodes());
+  EXPECT_TRUE(linear.search(OcTreeKey(0, 0, 0)));
+  EXPECT_FALSE(linear.search(OcTreeKey(0, 0, 1)));
+  EXPECT_FALSE(linear.search(OcTreeKey(65535, 65535, 65535)));
+
+  std::cerr << "Test successful.\n";
+  return 0;
+}
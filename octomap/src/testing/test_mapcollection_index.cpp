@@ -0,0 +1,248 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include <octomap/octomap_timing.h>
+#include <octomap/MapCollection.h>
+#include "testing.h"
+
+using namespace std;
+using namespace octomap;
+
+typedef MapNode<OcTree> OcTreeMapNode;
+typedef MapCollection<OcTreeMapNode> OcTreeMapCollection;
+
+void printUsage(char* self){
+  std::cerr << "\nUSAGE: " << self << " [max_submaps] [num_queries]  (optional, default: 10000 1000)\n\n";
+  std::cerr << "Compares the point and ray queries of MapCollections with 100, 1000, ... max_submaps\n";
+  std::cerr << "submaps against a loop over all submaps and measures their speed\n\n";
+
+  exit(1);
+}
+
+double timediff(const timeval& start, const timeval& stop){
+  return (stop.tv_sec - start.tv_sec) + 1.0e-6 *(stop.tv_usec - start.tv_usec);
+}
+
+double randomValue(double min, double max){
+  return min + (max - min) * double(rand()) / RAND_MAX;
+}
+
+point3d randomPoint(double min, double max){
+  return point3d((float) randomValue(min, max), (float) randomValue(min, max), (float) randomValue(min, max));
+}
+
+/// small submap: occupied shell of a box with free inside
+OcTree* generateBoxTree(double size_x, double size_y, double size_z){
+  OcTree* tree = new OcTree(0.1);
+  for (double x = 0.05; x < size_x; x += 0.1){
+    for (double y = 0.05; y < size_y; y += 0.1){
+      for (double z = 0.05; z < size_z; z += 0.1){
+        bool shell = (x < 0.1 || y < 0.1 || z < 0.1 || x + 0.1 > size_x || y + 0.1 > size_y || z + 0.1 > size_z);
+        tree->updateNode(point3d((float) x, (float) y, (float) z), shell);
+      }
+    }
+  }
+  return tree;
+}
+
+// Queries of the collection as a loop over all submaps, for reference
+
+bool isOccupiedLinear(OcTreeMapCollection& collection, const point3d& p){
+  for (OcTreeMapCollection::iterator it = collection.begin(); it != collection.end(); ++it){
+    point3d ptrans = (*it)->getOrigin().inv().transform(p);
+    OcTreeNode* n = (*it)->getMap()->search(ptrans);
+    if (n && (*it)->getMap()->isNodeOccupied(n))
+      return true;
+  }
+  return false;
+}
+
+double getOccupancyLinear(OcTreeMapCollection& collection, const point3d& p){
+  double max_occ_val = 0;
+  bool is_unknown = true;
+  for (OcTreeMapCollection::iterator it = collection.begin(); it != collection.end(); ++it){
+    point3d ptrans = (*it)->getOrigin().inv().transform(p);
+    OcTreeNode* n = (*it)->getMap()->search(ptrans);
+    if (n){
+      max_occ_val = std::max(max_occ_val, n->getOccupancy());
+      is_unknown = false;
+    }
+  }
+  return is_unknown ? 0.5 : max_occ_val;
+}
+
+bool castRayLinear(OcTreeMapCollection& collection, const point3d& origin, const point3d& direction, point3d& end,
+                   bool ignoreUnknownCells, double maxRange){
+  bool hit_obstacle = false;
+  double min_dist = 1e6;
+  for (OcTreeMapCollection::iterator it = collection.begin(); it != collection.end(); ++it){
+    point3d origin_trans = (*it)->getOrigin().inv().transform(origin);
+    point3d direction_trans = (*it)->getOrigin().inv().rot().rotate(direction);
+    point3d temp_endpoint;
+    if ((*it)->getMap()->castRay(origin_trans, direction_trans, temp_endpoint, ignoreUnknownCells, maxRange)){
+      double current_dist = origin_trans.distance(temp_endpoint);
+      if (current_dist < min_dist){
+        min_dist = current_dist;
+        end = (*it)->getOrigin().transform(temp_endpoint);
+      }
+      hit_obstacle = true;
+    }
+  }
+  return hit_obstacle;
+}
+
+int main(int argc, char** argv) {
+  if (argc > 3)
+    printUsage(argv[0]);
+  unsigned int max_submaps = 10000;
+  unsigned int num_queries = 1000;
+  if (argc > 1)
+    max_submaps = atoi(argv[1]);
+  if (argc > 2)
+    num_queries = atoi(argv[2]);
+  if (max_submaps < 1 || num_queries < 1)
+    printUsage(argv[0]);
+
+  srand(42);
+
+  // A few distinct submaps, shared by the MapNodes with different poses. MapNodes delete
+  // their maps, so they are not deleted here (MapCollection does not delete them either).
+  std::vector<OcTree*> trees;
+  for (unsigned int i = 0; i < std::min(max_submaps, 50u); ++i)
+    trees.push_back(generateBoxTree(randomValue(0.5, 1.5), randomValue(0.5, 1.5), randomValue(0.5, 1.5)));
+
+  std::cout << "submaps | point query: linear, indexed [us] | ray query: linear, indexed [us] | hits\n";
+  for (unsigned int num_submaps = std::min(100u, max_submaps); num_submaps <= max_submaps; num_submaps *= 10){
+    // submaps spread in a cube with one submap per 4^3 m^3 on average
+    const double world_size = 4.0 * pow(double(num_submaps), 1.0 / 3.0);
+    OcTreeMapCollection collection;
+    for (unsigned int i = 0; i < num_submaps; ++i){
+      point3d position = randomPoint(0.0, world_size);
+      pose6d origin(position.x(), position.y(), position.z(),
+                    randomValue(-0.3, 0.3), randomValue(-0.3, 0.3), randomValue(-M_PI, M_PI));
+      OcTreeMapNode* node = new OcTreeMapNode(trees[i % trees.size()], origin);
+      collection.addNode(node);
+    }
+    EXPECT_EQ(collection.size(), (size_t) num_submaps);
+
+    std::vector<point3d> points(num_queries);
+    std::vector<point3d> origins(num_queries);
+    std::vector<point3d> directions(num_queries);
+    for (unsigned int q = 0; q < num_queries; ++q){
+      points[q] = randomPoint(0.0, world_size);
+      origins[q] = randomPoint(0.0, world_size);
+      directions[q] = randomPoint(-1.0, 1.0);
+    }
+    const double max_range = 10.0;
+
+    // reference results for a subset of the queries, the loop over all submaps is slow
+    const unsigned int num_linear = std::min(num_queries, std::max(10u, 200000u / num_submaps));
+    timeval start;
+    timeval stop;
+    std::vector<char> occupied_linear(num_linear);
+    std::vector<double> occupancy_linear(num_linear);
+    gettimeofday(&start, NULL);
+    for (unsigned int q = 0; q < num_linear; ++q){
+      occupied_linear[q] = isOccupiedLinear(collection, points[q]);
+      occupancy_linear[q] = getOccupancyLinear(collection, points[q]);
+    }
+    gettimeofday(&stop, NULL);
+    double time_points_linear = timediff(start, stop) / num_linear;
+
+    std::vector<char> hits_linear(num_linear);
+    std::vector<point3d> ends_linear(num_linear);
+    gettimeofday(&start, NULL);
+    for (unsigned int q = 0; q < num_linear; ++q)
+      hits_linear[q] = castRayLinear(collection, origins[q], directions[q], ends_linear[q], true, max_range);
+    gettimeofday(&stop, NULL);
+    double time_rays_linear = timediff(start, stop) / num_linear;
+
+    // indexed queries
+    gettimeofday(&start, NULL);
+    collection.updateIndex();
+    gettimeofday(&stop, NULL);
+    double time_index = timediff(start, stop);
+
+    size_t num_occupied = 0;
+    gettimeofday(&start, NULL);
+    for (unsigned int q = 0; q < num_queries; ++q){
+      bool occupied = collection.isOccupied(points[q]);
+      double occupancy = collection.getOccupancy(points[q]);
+      if (occupied)
+        ++num_occupied;
+      if (q < num_linear){
+        EXPECT_EQ(occupied, (bool) occupied_linear[q]);
+        EXPECT_EQ(occupancy, occupancy_linear[q]);
+      }
+    }
+    gettimeofday(&stop, NULL);
+    double time_points = timediff(start, stop) / num_queries;
+
+    size_t num_hits = 0;
+    gettimeofday(&start, NULL);
+    for (unsigned int q = 0; q < num_queries; ++q){
+      point3d end;
+      bool hit = collection.castRay(origins[q], directions[q], end, true, max_range);
+      if (hit)
+        ++num_hits;
+      if (q < num_linear){
+        EXPECT_EQ(hit, (bool) hits_linear[q]);
+        if (hit)
+          EXPECT_TRUE(end == ends_linear[q]);
+      }
+    }
+    gettimeofday(&stop, NULL);
+    double time_rays = timediff(start, stop) / num_queries;
+    EXPECT_TRUE(collection.isIndexValid());
+
+    // queryNode() returns the first submap occupied at the point
+    for (unsigned int q = 0; q < num_linear; ++q){
+      OcTreeMapNode* node = collection.queryNode(points[q]);
+      EXPECT_EQ((node != NULL), (bool) occupied_linear[q]);
+      if (node){
+        OcTreeMapNode* first = NULL;
+        for (OcTreeMapCollection::iterator it = collection.begin(); it != collection.end() && !first; ++it){
+          OcTreeNode* n = (*it)->getMap()->search((*it)->getOrigin().inv().transform(points[q]));
+          if (n && (*it)->getMap()->isNodeOccupied(n))
+            first = *it;
+        }
+        EXPECT_TRUE(node == first);
+      }
+    }
+
+    printf("%7u | %10.2f %10.2f | %10.2f %10.2f | %u/%u rays, %u/%u points occupied (index built in %.2f ms)\n",
+           num_submaps, 1e6 * time_points_linear, 1e6 * time_points, 1e6 * time_rays_linear, 1e6 * time_rays,
+           (unsigned int) num_hits, num_queries, (unsigned int) num_occupied, num_queries, 1e3 * time_index);
+  }
+
+  // adding nodes and non-const access to nodes invalidate the index
+  OcTreeMapCollection collection;
+  collection.addNode(new OcTreeMapNode(trees[0], pose6d(0, 0, 0, 0, 0, 0)));
+  EXPECT_FALSE(collection.isIndexValid());
+  point3d end;
+  EXPECT_TRUE(collection.castRay(point3d(-1.0f, 0.25f, 0.25f), point3d(1, 0, 0), end, true, -1.0));
+  collection.updateIndex();
+  EXPECT_TRUE(collection.castRay(point3d(-1.0f, 0.25f, 0.25f), point3d(1, 0, 0), end, true, -1.0));
+  EXPECT_FALSE(collection.isOccupied(point3d(10.05f, 0.05f, 0.05f)));
+  collection.addNode(new OcTreeMapNode(trees[0], pose6d(10, 0, 0, 0, 0, 0)));
+  EXPECT_FALSE(collection.isIndexValid());
+  EXPECT_TRUE(collection.isOccupied(point3d(10.05f, 0.05f, 0.05f)));
+  collection.updateIndex();
+  EXPECT_TRUE(collection.isOccupied(point3d(10.05f, 0.05f, 0.05f)));
+  EXPECT_EQ(collection.getOccupancy(point3d(-5.0f, -5.0f, -5.0f)), 0.5);
+  EXPECT_FALSE(collection.isOccupied(point3d(5.05f, 0.05f, 0.05f)));
+  (*collection.begin())->getMap()->updateNode(point3d(5.05f, 0.05f, 0.05f), true);
+  EXPECT_FALSE(collection.isIndexValid());
+  EXPECT_TRUE(collection.isOccupied(point3d(5.05f, 0.05f, 0.05f)));
+  collection.updateIndex();
+  EXPECT_TRUE(collection.isOccupied(point3d(5.05f, 0.05f, 0.05f)));
+  EXPECT_TRUE(collection.queryNode(point3d(5.05f, 0.05f, 0.05f)) != NULL);
+  EXPECT_FALSE(collection.isIndexValid());
+
+  for (size_t i = 0; i < trees.size(); ++i)
+    delete trees[i];
+
+  std::cerr << "Test successful.\n";
+  return 0;
+}
@@ -0,0 +1,177 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <sstream>
+
+#include <octomap/octomap_timing.h>
+#include <octomap/octomap.h>
+#include <octomap/MappedOcTree.h>
+#include "testing.h"
+
+using namespace std;
+using namespace octomap;
+
+void printUsage(char* self){
+  std::cerr << "\nUSAGE: " << self << " map.bt [num_queries]  (optional, default: 100000)\n\n";
+  std::cerr << "Converts the map to a MappedOcTree, compares the startup latency with reading\n";
+  std::cerr << "an .ot file and checks all queries against the OcTree\n\n";
+
+  exit(1);
+}
+
+double timediff(const timeval& start, const timeval& stop){
+  return (stop.tv_sec - start.tv_sec) + 1.0e-6 *(stop.tv_usec - start.tv_usec);
+}
+
+int main(int argc, char** argv) {
+  if (argc < 2 || argc > 3)
+    printUsage(argv[0]);
+  unsigned num_queries = 100000;
+  if (argc == 3)
+    num_queries = atoi(argv[2]);
+
+  OcTree tree(0.1);
+  EXPECT_TRUE(tree.readBinary(argv[1]));
+  EXPECT_TRUE(tree.write("mapped_octree.ot"));
+  EXPECT_TRUE(MappedOcTree::write(tree, "mapped_octree.mot"));
+
+  // startup: time until the first query can be answered
+  timeval start;
+  timeval stop;
+  gettimeofday(&start, NULL);
+  AbstractOcTree* read_tree = AbstractOcTree::read("mapped_octree.ot");
+  EXPECT_TRUE(read_tree);
+  OcTree* ot_tree = dynamic_cast<OcTree*>(read_tree);
+  EXPECT_TRUE(ot_tree);
+  ot_tree->search(point3d(0.0f, 0.0f, 0.0f));
+  gettimeofday(&stop, NULL);
+  double time_read = timediff(start, stop);
+  delete read_tree;
+
+  MappedOcTree mapped;
+  gettimeofday(&start, NULL);
+  EXPECT_TRUE(mapped.open("mapped_octree.mot"));
+  mapped.search(point3d(0.0f, 0.0f, 0.0f));
+  gettimeofday(&stop, NULL);
+  double time_open = timediff(start, stop);
+  std::cout << argv[1] << ": " << tree.size() << " nodes, startup (AbstractOcTree::read / MappedOcTree::open): "
+            << time_read << " / " << time_open << " s\n";
+
+  EXPECT_EQ(mapped.size(), tree.size());
+  EXPECT_EQ(mapped.getTreeType(), tree.getTreeType());
+  EXPECT_FLOAT_EQ(mapped.getResolution(), tree.getResolution());
+
+  // leaf iterators, also limited in depth
+  for (unsigned char max_depth = 0; max_depth <= 12; max_depth += 12){
+    size_t num_leafs = 0;
+    OcTree::leaf_iterator it = tree.begin_leafs(max_depth);
+    for (MappedOcTree::leaf_iterator mapped_it = mapped.begin_leafs(max_depth); mapped_it != mapped.end_leafs(); ++mapped_it, ++it){
+      EXPECT_TRUE(it != tree.end_leafs());
+      EXPECT_TRUE(mapped_it.getKey() == it.getKey());
+      EXPECT_EQ(mapped_it.getDepth(), it.getDepth());
+      EXPECT_TRUE(mapped_it.getCoordinate() == it.getCoordinate());
+      EXPECT_FLOAT_EQ(mapped_it.getSize(), it.getSize());
+      EXPECT_FLOAT_EQ(mapped_it->getLogOdds(), it->getLogOdds());
+      EXPECT_EQ(mapped.isNodeOccupied(*mapped_it), tree.isNodeOccupied(*it));
+      ++num_leafs;
+    }
+    EXPECT_TRUE(it == tree.end_leafs());
+    std::cout << "Leafs (max. depth " << int(max_depth) << "): " << num_leafs << "\n";
+  }
+
+  // searches and ray casting from random points in the bounding box
+  double x, y, z;
+  tree.getMetricMin(x, y, z);
+  point3d min(x, y, z);
+  tree.getMetricMax(x, y, z);
+  point3d size = point3d(x, y, z) - min;
+  srand(42);
+  std::vector<point3d> points;
+  std::vector<point3d> directions;
+  for (unsigned i = 0; i < num_queries; ++i){
+    points.push_back(point3d(min.x() + size.x() * float(rand()) / RAND_MAX,
+                             min.y() + size.y() * float(rand()) / RAND_MAX,
+                             min.z() + size.z() * float(rand()) / RAND_MAX));
+    directions.push_back(point3d(float(rand()) / RAND_MAX - 0.5f, float(rand()) / RAND_MAX - 0.5f,
+                                 float(rand()) / RAND_MAX - 0.5f));
+  }
+
+  for (unsigned i = 0; i < num_queries; ++i){
+    for (unsigned depth = 0; depth <= 14; depth += 7){
+      OcTreeNode* node = tree.search(points[i], depth);
+      const MappedOcTreeNode* mapped_node = mapped.search(points[i], depth);
+      EXPECT_TRUE((node == NULL) == (mapped_node == NULL));
+      if (node)
+        EXPECT_FLOAT_EQ(node->getLogOdds(), mapped_node->getLogOdds());
+    }
+  }
+
+  for (unsigned run = 0; run < 2; ++run){
+    bool ignore_unknown = (run == 1);
+    double max_range = ignore_unknown ? 0.5 * size.norm() : -1.0;
+    unsigned num_hits = 0;
+    for (unsigned i = 0; i < num_queries; ++i){
+      point3d end;
+      point3d mapped_end;
+      bool hit = tree.castRay(points[i], directions[i], end, ignore_unknown, max_range);
+      EXPECT_EQ(mapped.castRay(points[i], directions[i], mapped_end, ignore_unknown, max_range), hit);
+      EXPECT_TRUE(end == mapped_end);
+      if (hit)
+        ++num_hits;
+    }
+    std::cout << "castRay" << (ignore_unknown ? ", ignoring unknown: " : ": ") << num_hits << " / " << num_queries << " hits\n";
+  }
+
+  // empty trees and other files
+  OcTree empty(0.1);
+  EXPECT_TRUE(MappedOcTree::write(empty, "mapped_octree.mot"));
+  EXPECT_TRUE(mapped.open("mapped_octree.mot"));
+  EXPECT_EQ(mapped.size(), 0);
+  EXPECT_FALSE(mapped.search(point3d(0.0f, 0.0f, 0.0f)));
+  EXPECT_TRUE(mapped.begin_leafs() == mapped.end_leafs());
+  EXPECT_FALSE(mapped.open("mapped_octree.ot"));
+  EXPECT_FALSE(mapped.isOpen());
+
+  // truncated files are not opened, corrupt child indices are found by validate()
+  // and are not followed by queries
+  std::stringstream stream;
+  EXPECT_TRUE(MappedOcTree::write(tree, stream));
+  const std::string file = stream.str();
+  std::string corrupt = file;
+  uint64_t num_nodes = uint64_t(1) << 60; // size of the node array overflows
+  memcpy(&corrupt[offsetof(MappedOcTreeHeader, num_nodes)], &num_nodes, sizeof(num_nodes));
+  std::ofstream("mapped_octree.mot", std::ios_base::binary).write(corrupt.data(), corrupt.size());
+  EXPECT_FALSE(mapped.open("mapped_octree.mot"));
+  corrupt = file.substr(0, file.size() - sizeof(MappedOcTreeNode));
+  std::ofstream("mapped_octree.mot", std::ios_base::binary).write(corrupt.data(), corrupt.size());
+  EXPECT_FALSE(mapped.open("mapped_octree.mot"));
+  corrupt = file;
+  uint32_t children = 0; // children of the root before it
+  memcpy(&corrupt[sizeof(MappedOcTreeHeader) + offsetof(MappedOcTreeNode, children)], &children, sizeof(children));
+  std::ofstream("mapped_octree.mot", std::ios_base::binary).write(corrupt.data(), corrupt.size());
+  EXPECT_TRUE(mapped.open("mapped_octree.mot"));
+  EXPECT_FALSE(mapped.validate());
+  corrupt = file;
+  num_nodes = tree.size() - 1; // last children outside of the array
+  memcpy(&corrupt[offsetof(MappedOcTreeHeader, num_nodes)], &num_nodes, sizeof(num_nodes));
+  std::ofstream("mapped_octree.mot", std::ios_base::binary).write(corrupt.data(), corrupt.size());
+  EXPECT_TRUE(mapped.open("mapped_octree.mot"));
+  EXPECT_FALSE(mapped.validate());
+  size_t num_leafs = 0;
+  for (MappedOcTree::leaf_iterator it = mapped.begin_leafs(), end = mapped.end_leafs(); it != end; ++it)
+    ++num_leafs;
+  EXPECT_TRUE(num_leafs > 0);
+  for (OcTree::leaf_iterator it = tree.begin_leafs(), end = tree.end_leafs(); it != end; ++it){
+    mapped.search(it.getKey());
+    point3d ray_end;
+    mapped.castRay(it.getCoordinate(), point3d(1.0f, 0.3f, 0.1f), ray_end, true, 2.0);
+  }
+  std::ofstream("mapped_octree.mot", std::ios_base::binary).write(file.data(), file.size());
+  EXPECT_TRUE(mapped.open("mapped_octree.mot"));
+  EXPECT_TRUE(mapped.validate());
+  EXPECT_EQ(mapped.size(), tree.size());
+
+  std::cerr << "Test successful.\n";
+  return 0;
+}
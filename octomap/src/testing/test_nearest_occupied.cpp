@@ -0,0 +1,196 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <algorithm>
+
+#include <octomap/octomap_timing.h>
+#include <octomap/octomap.h>
+#include "testing.h"
+
+using namespace std;
+using namespace octomap;
+
+void printUsage(char* self){
+  std::cerr << "\nUSAGE: " << self << " map.bt [num_queries]  (optional, default: 1000)\n\n";
+  std::cerr << "Compares nearest occupied and radius searches with a search over all leafs\n";
+  std::cerr << "for random query points and measures their speed\n\n";
+
+  exit(1);
+}
+
+double timediff(const timeval& start, const timeval& stop){
+  return (stop.tv_sec - start.tv_sec) + 1.0e-6 *(stop.tv_usec - start.tv_usec);
+}
+
+struct OccupiedLeaf {
+  point3d center;
+  double half_size;
+};
+
+/// @return distances from query to all occupied leafs, sorted if requested
+std::vector<float> bruteForceDistances(const std::vector<OccupiedLeaf>& leafs, const point3d& query, bool sorted = true){
+  std::vector<float> distances(leafs.size());
+  for (size_t i = 0; i < leafs.size(); ++i){
+    double distance_sq = 0.0;
+    for (unsigned int j = 0; j < 3; ++j){
+      double d = fabs(double(query(j)) - double(leafs[i].center(j))) - leafs[i].half_size;
+      if (d > 0.0)
+        distance_sq += d * d;
+    }
+    distances[i] = (float) sqrt(distance_sq);
+  }
+  if (sorted)
+    std::sort(distances.begin(), distances.end());
+  return distances;
+}
+
+std::vector<OccupiedLeaf> occupiedLeafs(const OcTree& tree, unsigned int max_depth){
+  std::vector<OccupiedLeaf> leafs;
+  for (OcTree::leaf_iterator it = tree.begin_leafs(max_depth), end = tree.end_leafs(); it != end; ++it){
+    if (!tree.isNodeOccupied(*it))
+      continue;
+    OccupiedLeaf leaf;
+    leaf.center = it.getCoordinate();
+    leaf.half_size = it.getSize() / 2.0;
+    leafs.push_back(leaf);
+  }
+  return leafs;
+}
+
+/// checks the results against the distances of all leafs: sorted, consistent with their nodes and the closest ones
+void checkResults(const OcTree& tree, const NearestOccupiedResults& results, const point3d& query,
+                  const std::vector<float>& all_distances, size_t expected_size){
+  EXPECT_EQ(results.size(), expected_size);
+  EXPECT_EQ(results.distances.size(), results.size());
+  EXPECT_EQ(results.centers.size(), results.size());
+  EXPECT_EQ(results.depths.size(), results.size());
+  for (size_t i = 0; i < results.size(); ++i){
+    EXPECT_NEAR(results.distances[i], all_distances[i], 1e-4);
+    if (i > 0)
+      EXPECT_TRUE(results.distances[i - 1] <= results.distances[i]);
+    OcTreeNode* node = tree.search(results.keys[i], results.depths[i]);
+    EXPECT_TRUE(node != NULL);
+    EXPECT_TRUE(tree.isNodeOccupied(node));
+    EXPECT_TRUE(results.centers[i] == tree.keyToCoord(results.keys[i], results.depths[i]));
+    OccupiedLeaf leaf;
+    leaf.center = results.centers[i];
+    leaf.half_size = tree.getNodeSize(results.depths[i]) / 2.0;
+    EXPECT_NEAR(results.distances[i], bruteForceDistances(std::vector<OccupiedLeaf>(1, leaf), query)[0], 1e-4);
+  }
+}
+
+int main(int argc, char** argv) {
+  if (argc < 2 || argc > 3)
+    printUsage(argv[0]);
+  unsigned int num_queries = 1000;
+  if (argc == 3)
+    num_queries = atoi(argv[2]);
+
+  OcTree tree(0.1);
+  EXPECT_TRUE(tree.readBinary(std::string(argv[1])));
+  EXPECT_TRUE(tree.size() > 0);
+
+  double min_x, min_y, min_z, max_x, max_y, max_z;
+  tree.getMetricMin(min_x, min_y, min_z);
+  tree.getMetricMax(max_x, max_y, max_z);
+  // queries also around the map
+  point3d query_min((float) min_x - 2.0f, (float) min_y - 2.0f, (float) min_z - 2.0f);
+  point3d query_size((float) (max_x - min_x) + 4.0f, (float) (max_y - min_y) + 4.0f, (float) (max_z - min_z) + 4.0f);
+
+  std::vector<OccupiedLeaf> leafs = occupiedLeafs(tree, 0);
+  std::vector<OccupiedLeaf> leafs_depth14 = occupiedLeafs(tree, 14);
+  std::cout << "Map with " << tree.getNumLeafNodes() << " leafs, " << leafs.size() << " occupied" << std::endl;
+
+  srand(42);
+  std::vector<point3d> queries(num_queries);
+  for (unsigned int q = 0; q < num_queries; ++q)
+    queries[q] = randomPoint(query_min, query_size);
+
+  // k nearest, radius search and maximum depth against all leafs (for a subset, it is slow)
+  const unsigned int num_checked = std::min(num_queries, 100u);
+  NearestOccupiedResults results;
+  for (unsigned int q = 0; q < num_checked; ++q){
+    const point3d& query = queries[q];
+    std::vector<float> all_distances = bruteForceDistances(leafs, query);
+
+    EXPECT_EQ(tree.getNearestOccupied(query, 1, results), (size_t) 1);
+    checkResults(tree, results, query, all_distances, 1);
+    tree.getNearestOccupied(query, 10, results);
+    checkResults(tree, results, query, all_distances, 10);
+
+    point3d closest;
+    EXPECT_FLOAT_EQ(tree.getDistanceToNearestOccupied(query, closest), all_distances[0]);
+
+    const double radius = 0.5 + 1.5 * (q % 3);
+    // leafs right on the boundary may differ by rounding
+    size_t num_inside = std::upper_bound(all_distances.begin(), all_distances.end(), float(radius - 1e-4)) - all_distances.begin();
+    size_t num_touching = std::upper_bound(all_distances.begin(), all_distances.end(), float(radius + 1e-4)) - all_distances.begin();
+    tree.getOccupiedInRadius(query, radius, results);
+    EXPECT_TRUE(results.size() >= num_inside && results.size() <= num_touching);
+    checkResults(tree, results, query, all_distances, results.size());
+
+    // k nearest within a maximum distance
+    tree.getNearestOccupied(query, 10, results, radius);
+    EXPECT_TRUE(results.size() >= std::min((size_t) 10, num_inside) && results.size() <= std::min((size_t) 10, num_touching));
+    checkResults(tree, results, query, all_distances, results.size());
+
+    std::vector<float> distances_depth14 = bruteForceDistances(leafs_depth14, query);
+    tree.getNearestOccupied(query, 5, results, -1.0, 14);
+    checkResults(tree, results, query, distances_depth14, 5);
+    for (size_t i = 0; i < results.size(); ++i)
+      EXPECT_TRUE(results.depths[i] <= 14);
+  }
+
+  // nothing found
+  point3d closest;
+  EXPECT_EQ(tree.getNearestOccupied(queries[0], 0, results), (size_t) 0);
+  EXPECT_EQ(tree.getOccupiedInRadius(point3d(1000, 1000, 1000), 10.0, results), (size_t) 0);
+  EXPECT_EQ(tree.getDistanceToNearestOccupied(point3d(1000, 1000, 1000), closest, 10.0), -1.0);
+  OcTree empty_tree(0.1);
+  EXPECT_EQ(empty_tree.getNearestOccupied(queries[0], 1, results), (size_t) 0);
+  // a query inside an occupied leaf has distance 0
+  EXPECT_EQ(tree.getDistanceToNearestOccupied(leafs[0].center, closest), 0.0);
+  EXPECT_TRUE(closest == leafs[0].center);
+
+  // timing against the search over all leafs
+  timeval start;
+  timeval stop;
+  double sum_brute_force = 0.0;
+  gettimeofday(&start, NULL);
+  for (unsigned int q = 0; q < num_checked; ++q){
+    std::vector<float> distances = bruteForceDistances(leafs, queries[q], false);
+    sum_brute_force += *std::min_element(distances.begin(), distances.end());
+  }
+  gettimeofday(&stop, NULL);
+  double time_brute_force = timediff(start, stop) / num_checked;
+
+  double sum_nearest = 0.0;
+  gettimeofday(&start, NULL);
+  for (unsigned int q = 0; q < num_queries; ++q)
+    sum_nearest += tree.getDistanceToNearestOccupied(queries[q], closest);
+  gettimeofday(&stop, NULL);
+  double time_nearest = timediff(start, stop) / num_queries;
+
+  size_t num_knn = 0;
+  gettimeofday(&start, NULL);
+  for (unsigned int q = 0; q < num_queries; ++q)
+    num_knn += tree.getNearestOccupied(queries[q], 10, results);
+  gettimeofday(&stop, NULL);
+  double time_knn = timediff(start, stop) / num_queries;
+
+  size_t num_radius = 0;
+  gettimeofday(&start, NULL);
+  for (unsigned int q = 0; q < num_queries; ++q)
+    num_radius += tree.getOccupiedInRadius(queries[q], 1.0, results);
+  gettimeofday(&stop, NULL);
+  double time_radius = timediff(start, stop) / num_queries;
+
+  std::cout << "Nearest occupied queries (per query):\n"
+            << "  all leafs, nearest:  " << 1e6 * time_brute_force << " us (mean distance " << sum_brute_force / num_checked << ")\n"
+            << "  nearest:             " << 1e6 * time_nearest << " us (mean distance " << sum_nearest / num_queries << ")\n"
+            << "  10 nearest:          " << 1e6 * time_knn << " us\n"
+            << "  radius 1 m:          " << 1e6 * time_radius << " us (" << double(num_radius) / num_queries << " leafs)\n";
+
+  std::cerr << "Test successful.\n";
+  return 0;
+}
@@ -0,0 +1,151 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <fstream>
+#ifdef __linux__
+  #include <unistd.h>
+#endif
+
+#include <octomap/octomap_timing.h>
+#include <octomap/octomap.h>
+#include <octomap/math/Utils.h>
+#include "testing.h"
+
+using namespace std;
+using namespace octomap;
+
+void printUsage(char* self){
+  std::cerr << "\nUSAGE: " << self << " [num_scans]  (optional, default: 2)\n\n";
+
+  exit(1);
+}
+
+double timediff(const timeval& start, const timeval& stop){
+  return (stop.tv_sec - start.tv_sec) + 1.0e-6 *(stop.tv_usec - start.tv_usec);
+}
+
+/// @return resident set size of the process in MB (0 if unavailable)
+double residentMemoryMB(){
+  double rss = 0.0;
+#ifdef __linux__
+  std::ifstream statm("/proc/self/statm");
+  unsigned long pages_total, pages_resident;
+  if (statm >> pages_total >> pages_resident)
+    rss = double(pages_resident) * double(sysconf(_SC_PAGESIZE)) / (1024.0 * 1024.0);
+#endif
+  return rss;
+}
+
+/// spherical scans around shifted origins, similar to unit_tests InsertScan
+void generateScans(unsigned num_scans, std::vector<Pointcloud>& scans, std::vector<point3d>& origins){
+  unsigned sphere_beams = 200;
+  double angle = 2.0*M_PI/double(sphere_beams);
+  for (unsigned s = 0; s < num_scans; ++s){
+    point3d origin (0.01f + 0.37f*s, 0.01f - 0.21f*s, 0.02f + 0.05f*s);
+    point3d point_on_surface (4.01f, 0.01f, 0.01f);
+    Pointcloud p;
+    for (unsigned i=0; i<sphere_beams; i++) {
+      for (unsigned j=0; j<sphere_beams; j++) {
+        p.push_back(origin+point_on_surface);
+        point_on_surface.rotate_IP (0,0,angle);
+      }
+      point_on_surface.rotate_IP (0,angle,0);
+    }
+    scans.push_back(p);
+    origins.push_back(origin);
+  }
+}
+
+int main(int argc, char** argv) {
+  unsigned num_scans = 2;
+  if (argc > 2)
+    printUsage(argv[0]);
+  if (argc == 2)
+    num_scans = atoi(argv[1]);
+
+  std::vector<Pointcloud> scans;
+  std::vector<point3d> origins;
+  generateScans(num_scans, scans, origins);
+
+  timeval start;
+  timeval stop;
+
+  // run 0: plain heap allocation, run 1: node pool
+  OcTree* reference = NULL;
+  for (unsigned run = 0; run < 2; ++run){
+    bool pooled = (run == 1);
+    double rss_before = residentMemoryMB();
+
+    OcTree* tree = new OcTree(0.1);
+    EXPECT_TRUE(tree->useNodePool(pooled));
+    EXPECT_EQ(tree->isNodePoolUsed(), pooled);
+
+    gettimeofday(&start, NULL);
+    for (size_t s = 0; s < scans.size(); ++s)
+      tree->insertPointCloud(scans[s], origins[s]);
+    // solid block: incremental pruning returns nodes to the pool
+    for (int x=-32; x<32; x++)
+      for (int y=-32; y<32; y++)
+        for (int z=-32; z<32; z++)
+          tree->updateNode(point3d(x*0.1f + 10.01f, y*0.1f + 0.01f, z*0.1f + 0.01f), true);
+    gettimeofday(&stop, NULL);
+    double time_insert = timediff(start, stop);
+    double rss_tree = residentMemoryMB();
+    size_t num_nodes = tree->size();
+
+    gettimeofday(&start, NULL);
+    tree->toMaxLikelihood();
+    tree->prune();
+    gettimeofday(&stop, NULL);
+    double time_prune = timediff(start, stop);
+    EXPECT_EQ(tree->size(), tree->calcNumNodes());
+
+    std::cout << (pooled ? "Node pool:  " : "Heap:       ")
+              << num_nodes << " nodes (" << tree->size() << " pruned), insert: " << time_insert
+              << " s, prune: " << time_prune << " s";
+
+    if (!pooled){
+      reference = tree;
+      std::cout << ", RSS: +" << rss_tree - rss_before << " MB\n";
+      continue;
+    }
+
+    // trees need to be identical, independent of allocation
+    EXPECT_TRUE(*tree == *reference);
+
+    // deep copies keep the allocation mode
+    OcTree copy(*tree);
+    EXPECT_TRUE(copy.isNodePoolUsed());
+    EXPECT_TRUE(copy == *reference);
+
+    // allocation can't be changed on a non-empty tree
+    EXPECT_FALSE(tree->useNodePool(false));
+
+    gettimeofday(&start, NULL);
+    delete tree;
+    gettimeofday(&stop, NULL);
+    double time_pooled_delete = timediff(start, stop);
+
+    gettimeofday(&start, NULL);
+    delete reference;
+    gettimeofday(&stop, NULL);
+    double time_heap_delete = timediff(start, stop);
+
+    std::cout << ", RSS: +" << rss_tree - rss_before << " MB\n";
+    std::cout << "Destruction (heap / node pool): " << time_heap_delete << " / " << time_pooled_delete << " s\n";
+  }
+
+  // swapping content between differently allocated trees
+  OcTree heapTree(0.1);
+  OcTree pooledTree(0.1);
+  pooledTree.useNodePool(true);
+  pooledTree.insertPointCloud(scans[0], origins[0]);
+  size_t pooledSize = pooledTree.size();
+  heapTree.swapContent(pooledTree);
+  EXPECT_TRUE(heapTree.isNodePoolUsed());
+  EXPECT_FALSE(pooledTree.isNodePoolUsed());
+  EXPECT_EQ(heapTree.size(), pooledSize);
+  EXPECT_EQ(pooledTree.size(), 0);
+
+  std::cerr << "Test successful.\n";
+  return 0;
+}
@@ -0,0 +1,160 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <octomap/octomap_timing.h>
+#include <octomap/octomap.h>
+#include <octomap/math/Utils.h>
+#include "testing.h"
+
+using namespace std;
+using namespace octomap;
+
+void printUsage(char* self){
+  std::cerr << "\nUSAGE: " << self << " [num_points] [max_threads]  (optional, default: 100000 32)\n\n";
+  std::cerr << "Benchmarks insertPointCloud() for 1, 2, 4, ... max_threads threads\n\n";
+
+  exit(1);
+}
+
+double timediff(const timeval& start, const timeval& stop){
+  return (stop.tv_sec - start.tv_sec) + 1.0e-6 *(stop.tv_usec - start.tv_usec);
+}
+
+/// random scan of a room-like environment: endpoints at 2-12 m around the origin
+Pointcloud generateScan(unsigned num_points, const point3d& origin){
+  Pointcloud scan;
+  scan.reserve(num_points);
+  for (unsigned i = 0; i < num_points; ++i){
+    double yaw = 2.0 * M_PI * double(rand()) / RAND_MAX;
+    double pitch = 0.5 * M_PI * (double(rand()) / RAND_MAX - 0.5);
+    double range = 2.0 + 10.0 * double(rand()) / RAND_MAX;
+    point3d dir(cos(pitch) * cos(yaw), cos(pitch) * sin(yaw), sin(pitch));
+    scan.push_back(origin + dir * range);
+  }
+  return scan;
+}
+
+bool equalKeySets(const KeySet& a, const KeySet& b){
+  if (a.size() != b.size())
+    return false;
+  for (KeySet::const_iterator it = a.begin(); it != a.end(); ++it){
+    if (b.find(*it) == b.end())
+      return false;
+  }
+  return true;
+}
+
+/// computeUpdate() with num_threads for plain, maxrange and BBX-limited updates
+/// @return time for the plain update
+double computeUpdates(unsigned num_threads, const Pointcloud& scan, const point3d& origin,
+                      KeySet* free_cells, KeySet* occupied_cells){
+  OcTree tree(0.05);
+  tree.setNumThreads(num_threads);
+  timeval start;
+  timeval stop;
+  gettimeofday(&start, NULL);
+  tree.computeUpdate(scan, origin, free_cells[0], occupied_cells[0], -1.);
+  gettimeofday(&stop, NULL);
+  tree.computeUpdate(scan, origin, free_cells[1], occupied_cells[1], 6.);
+  point3d bbx_min(-3.0f, -4.0f, -1.0f);
+  point3d bbx_max(5.0f, 2.0f, 1.5f);
+  tree.setBBXMin(bbx_min);
+  tree.setBBXMax(bbx_max);
+  tree.useBBXLimit(true);
+  tree.computeUpdate(scan, origin, free_cells[2], occupied_cells[2], 9.);
+  return timediff(start, stop);
+}
+
+int main(int argc, char** argv) {
+  unsigned num_points = 100000;
+  unsigned max_threads = 32;
+  if (argc > 3)
+    printUsage(argv[0]);
+  if (argc > 1)
+    num_points = atoi(argv[1]);
+  if (argc > 2)
+    max_threads = atoi(argv[2]);
+
+  srand(42);
+  point3d origins[2] = {point3d(0.01f, 0.01f, 0.02f), point3d(1.51f, -0.49f, 0.02f)};
+  Pointcloud scans[2] = {generateScan(num_points, origins[0]), generateScan(num_points, origins[1])};
+
+  // ray tracing into thread-local key sets needs to give the same sets
+  KeySet reference_free[3], reference_occupied[3];
+  double reference_update_time = computeUpdates(1, scans[0], origins[0], reference_free, reference_occupied);
+  for (unsigned num_threads = 2; num_threads <= max_threads; num_threads *= 2){
+    OcTree tree(0.05);
+    tree.setNumThreads(num_threads);
+    if (tree.getNumThreads() != num_threads)
+      break;
+
+    KeySet free_cells[3], occupied_cells[3];
+    double time = computeUpdates(num_threads, scans[0], origins[0], free_cells, occupied_cells);
+    for (unsigned i = 0; i < 3; ++i){
+      EXPECT_TRUE(equalKeySets(free_cells[i], reference_free[i]));
+      EXPECT_TRUE(equalKeySets(occupied_cells[i], reference_occupied[i]));
+    }
+    std::cout << "computeUpdate, " << num_threads << " threads: " << time
+              << " s (speedup " << reference_update_time / time << ")\n";
+  }
+
+  // without key rays (see clearKeyRays()), empty updates are still possible
+  {
+    OcTree tree(0.05);
+    tree.clearKeyRays();
+    KeySet free_cells, occupied_cells;
+    tree.computeUpdate(Pointcloud(), origins[0], free_cells, occupied_cells, -1.);
+    EXPECT_TRUE(free_cells.empty());
+    EXPECT_TRUE(occupied_cells.empty());
+  }
+
+  timeval start;
+  timeval stop;
+  OcTree* reference = NULL;
+  double reference_time = 0.0;
+  for (unsigned num_threads = 1; num_threads <= max_threads; num_threads *= 2){
+    OcTree* tree = new OcTree(0.05);
+    tree->setNumThreads(num_threads);
+    if (tree->getNumThreads() != num_threads){
+      std::cout << "Compiled without OpenMP, no parallel insertion available.\n";
+      delete tree;
+      break;
+    }
+
+    // second scan updates the existing map (incl. expanding pruned nodes)
+    gettimeofday(&start, NULL);
+    for (unsigned s = 0; s < 2; ++s)
+      tree->insertPointCloud(scans[s], origins[s]);
+    gettimeofday(&stop, NULL);
+    double time = timediff(start, stop);
+    EXPECT_EQ(tree->size(), tree->calcNumNodes());
+
+    if (reference == NULL){
+      reference = tree;
+      reference_time = time;
+    } else {
+      EXPECT_TRUE(*tree == *reference);
+      delete tree;
+    }
+
+    std::cout << num_threads << " threads: " << time << " s for " << 2 * num_points
+              << " points (speedup " << reference_time / time << ")\n";
+  }
+
+  if (reference){
+    // lazy evaluation, inner nodes updated afterwards
+    OcTree lazyTree(0.05);
+    lazyTree.setNumThreads(std::min(max_threads, 4u));
+    for (unsigned s = 0; s < 2; ++s)
+      lazyTree.insertPointCloud(scans[s], origins[s], -1., true);
+    lazyTree.updateInnerOccupancy();
+    lazyTree.prune();
+    OcTree prunedReference(*reference);
+    prunedReference.prune();
+    EXPECT_TRUE(lazyTree == prunedReference);
+    delete reference;
+  }
+
+  std::cerr << "Test successful.\n";
+  return 0;
+}
@@ -0,0 +1,296 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include <octomap/octomap_timing.h>
+#include <octomap/octomap.h>
+#include <octomap/OcTreeStamped.h>
+#include "testing.h"
+
+using namespace std;
+using namespace octomap;
+
+void printUsage(char* self){
+  std::cerr << "\nUSAGE: " << self << " [num_leafs] [max_threads]  (optional, default: 1000000 4)\n\n";
+  std::cerr << "Compares parallelForEachLeaf() / parallelForEachNode() with the iterators on a map\n";
+  std::cerr << "of about num_leafs leafs for 1, 2, 4, ... max_threads threads\n\n";
+
+  exit(1);
+}
+
+double timediff(const timeval& start, const timeval& stop){
+  return (stop.tv_sec - start.tv_sec) + 1.0e-6 *(stop.tv_usec - start.tv_usec);
+}
+
+/// statistics of the visited nodes, accumulated per thread
+struct StatisticsFunctor {
+  struct Statistics {
+    size_t num_nodes;
+    size_t num_occupied;
+    double sum_log_odds;
+    double sum_keys;
+    size_t depth_count[17];
+  };
+
+  StatisticsFunctor(const OcTree& tree) : tree(tree), thread_statistics(tree.getNumThreads()) {
+    for (size_t t = 0; t < thread_statistics.size(); ++t)
+      clear(thread_statistics[t]);
+  }
+
+  static void clear(Statistics& s){
+    s.num_nodes = 0;
+    s.num_occupied = 0;
+    s.sum_log_odds = 0.0;
+    s.sum_keys = 0.0;
+    for (unsigned int d = 0; d < 17; ++d)
+      s.depth_count[d] = 0;
+  }
+
+  void operator()(OcTreeNode* node, const OcTreeKey& key, unsigned int depth, unsigned int thread){
+    add(thread_statistics[thread], node, key, depth);
+  }
+
+  void add(Statistics& s, const OcTreeNode* node, const OcTreeKey& key, unsigned int depth) const {
+    ++s.num_nodes;
+    if (tree.isNodeOccupied(node))
+      ++s.num_occupied;
+    s.sum_log_odds += node->getLogOdds();
+    s.sum_keys += key[0] + 3.0 * key[1] + 7.0 * key[2];
+    ++s.depth_count[depth];
+  }
+
+  Statistics total() const {
+    Statistics s;
+    clear(s);
+    for (size_t t = 0; t < thread_statistics.size(); ++t){
+      s.num_nodes += thread_statistics[t].num_nodes;
+      s.num_occupied += thread_statistics[t].num_occupied;
+      s.sum_log_odds += thread_statistics[t].sum_log_odds;
+      s.sum_keys += thread_statistics[t].sum_keys;
+      for (unsigned int d = 0; d < 17; ++d)
+        s.depth_count[d] += thread_statistics[t].depth_count[d];
+    }
+    return s;
+  }
+
+  const OcTree& tree;
+  std::vector<Statistics> thread_statistics;
+};
+
+void expectEqual(const StatisticsFunctor::Statistics& a, const StatisticsFunctor::Statistics& b){
+  EXPECT_EQ(a.num_nodes, b.num_nodes);
+  EXPECT_EQ(a.num_occupied, b.num_occupied);
+  EXPECT_TRUE(fabs(a.sum_log_odds - b.sum_log_odds) < 1e-6 * (1.0 + fabs(a.sum_log_odds)));
+  EXPECT_FLOAT_EQ(a.sum_keys, b.sum_keys);
+  for (unsigned int d = 0; d < 17; ++d)
+    EXPECT_EQ(a.depth_count[d], b.depth_count[d]);
+}
+
+/// @return true if the node overlaps the key bounding box
+bool inKeyBBX(const OcTreeKey& key, unsigned int depth, const OcTreeKey& min, const OcTreeKey& max){
+  unsigned int size = 1u << (16 - depth);
+  for (unsigned int i = 0; i < 3; ++i){
+    unsigned int node_min = key[i] - (size >> 1);
+    if (node_min > max[i] || node_min + size - 1 < min[i])
+      return false;
+  }
+  return true;
+}
+
+int main(int argc, char** argv) {
+  unsigned num_leafs = 1000000;
+  unsigned max_threads = 4;
+  if (argc > 3)
+    printUsage(argv[0]);
+  if (argc > 1)
+    num_leafs = atoi(argv[1]);
+  if (argc > 2)
+    max_threads = atoi(argv[2]);
+
+  // dense block of random occupancy, with pruned cubes of 16^3 voxels
+  srand(42);
+  OcTree tree(0.05);
+  unsigned side = (unsigned) ceil(pow(double(num_leafs), 1.0 / 3.0));
+  timeval start;
+  timeval stop;
+  gettimeofday(&start, NULL);
+  OcTreeKey key;
+  for (unsigned x = 0; x < side; ++x){
+    key[0] = 32768 - side / 2 + x;
+    for (unsigned y = 0; y < side; ++y){
+      key[1] = 32768 - side / 2 + y;
+      for (unsigned z = 0; z < side; ++z){
+        key[2] = 32768 - side / 2 + z;
+        bool pruned_cube = ((key[0] >> 4) + (key[1] >> 4) + (key[2] >> 4)) % 5 == 0;
+        float log_odds = pruned_cube ? 2.0f : 4.0f * float(rand()) / RAND_MAX - 2.0f;
+        tree.setNodeValue(key, log_odds, true);
+      }
+    }
+  }
+  tree.updateInnerOccupancy();
+  tree.prune();
+  gettimeofday(&stop, NULL);
+  std::cout << "Map with " << tree.getNumLeafNodes() << " leafs, " << tree.size() << " nodes created in "
+            << timediff(start, stop) << " s\n";
+
+  // reference with the iterators
+  StatisticsFunctor reference_functor(tree);
+  StatisticsFunctor::Statistics leafs, nodes, leafs_depth, leafs_bbx;
+  StatisticsFunctor::clear(leafs);
+  StatisticsFunctor::clear(nodes);
+  StatisticsFunctor::clear(leafs_depth);
+  StatisticsFunctor::clear(leafs_bbx);
+  gettimeofday(&start, NULL);
+  for (OcTree::leaf_iterator it = tree.begin_leafs(), end = tree.end_leafs(); it != end; ++it)
+    reference_functor.add(leafs, &*it, it.getKey(), it.getDepth());
+  gettimeofday(&stop, NULL);
+  double time_leaf_iterator = timediff(start, stop);
+  gettimeofday(&start, NULL);
+  for (OcTree::tree_iterator it = tree.begin_tree(), end = tree.end_tree(); it != end; ++it)
+    reference_functor.add(nodes, &*it, it.getKey(), it.getDepth());
+  gettimeofday(&stop, NULL);
+  double time_tree_iterator = timediff(start, stop);
+  for (OcTree::leaf_iterator it = tree.begin_leafs(13), end = tree.end_leafs(); it != end; ++it)
+    reference_functor.add(leafs_depth, &*it, it.getKey(), it.getDepth());
+  // leaf_bbx_iterator also returns leafs ending right before the box, filtered here
+  OcTreeKey bbx_min(32768 - side / 4, 32768 - side / 3, 32768 - side / 2 + 5);
+  OcTreeKey bbx_max(32768 + side / 5, 32768 + side / 2 - 3, 32768);
+  for (OcTree::leaf_bbx_iterator it = tree.begin_leafs_bbx(bbx_min, bbx_max), end = tree.end_leafs_bbx(); it != end; ++it){
+    if (inKeyBBX(it.getKey(), it.getDepth(), bbx_min, bbx_max))
+      reference_functor.add(leafs_bbx, &*it, it.getKey(), it.getDepth());
+  }
+  EXPECT_EQ(leafs.num_nodes, tree.getNumLeafNodes());
+  EXPECT_EQ(nodes.num_nodes, tree.size());
+  EXPECT_TRUE(leafs_bbx.num_nodes > 0 && leafs_bbx.num_nodes < leafs.num_nodes);
+  std::cout << "Iterators: leafs " << time_leaf_iterator << " s, all nodes " << time_tree_iterator << " s\n";
+
+  for (unsigned num_threads = 1; num_threads <= max_threads; num_threads *= 2){
+    tree.setNumThreads(num_threads);
+    StatisticsFunctor leaf_functor(tree);
+    gettimeofday(&start, NULL);
+    tree.parallelForEachLeaf(leaf_functor);
+    gettimeofday(&stop, NULL);
+    double time_leafs = timediff(start, stop);
+    expectEqual(leaf_functor.total(), leafs);
+
+    StatisticsFunctor node_functor(tree);
+    gettimeofday(&start, NULL);
+    tree.parallelForEachNode(node_functor);
+    gettimeofday(&stop, NULL);
+    double time_nodes = timediff(start, stop);
+    expectEqual(node_functor.total(), nodes);
+
+    StatisticsFunctor depth_functor(tree);
+    tree.parallelForEachLeaf(depth_functor, 13);
+    expectEqual(depth_functor.total(), leafs_depth);
+
+    StatisticsFunctor bbx_functor(tree);
+    tree.parallelForEachLeafBBX(bbx_min, bbx_max, bbx_functor);
+    expectEqual(bbx_functor.total(), leafs_bbx);
+
+    // explicit split depths: only the root, below the pruned cubes, at the leafs
+    unsigned int split_depths[3] = {1, 13, 16};
+    for (unsigned int i = 0; i < 3; ++i){
+      StatisticsFunctor split_functor(tree);
+      tree.parallelForEachNode(split_functor, 0, split_depths[i]);
+      expectEqual(split_functor.total(), nodes);
+      StatisticsFunctor split_bbx_functor(tree);
+      tree.parallelForEachLeafBBX(bbx_min, bbx_max, split_bbx_functor, 0, split_depths[i]);
+      expectEqual(split_bbx_functor.total(), leafs_bbx);
+    }
+
+    std::cout << num_threads << " threads: leafs " << time_leafs << " s (" << time_leaf_iterator / time_leafs
+              << "x), all nodes " << time_nodes << " s (" << time_tree_iterator / time_nodes << "x)\n";
+  }
+
+  // whole map passes using the parallel traversal
+  {
+    tree.setNumThreads(max_threads);
+    OcTree ml_tree(tree);
+    OcTree reference_ml_tree(tree);
+    for (OcTree::tree_iterator it = reference_ml_tree.begin_tree(), end = reference_ml_tree.end_tree(); it != end; ++it)
+      reference_ml_tree.nodeToMaxLikelihood(&*it);
+    ml_tree.setNumThreads(max_threads);
+    gettimeofday(&start, NULL);
+    ml_tree.toMaxLikelihood();
+    gettimeofday(&stop, NULL);
+    EXPECT_TRUE(ml_tree == reference_ml_tree);
+    std::cout << "toMaxLikelihood: " << timediff(start, stop) << " s\n";
+
+    double min[3] = {1e10, 1e10, 1e10};
+    double max[3] = {-1e10, -1e10, -1e10};
+    for (OcTree::leaf_iterator it = tree.begin_leafs(), end = tree.end_leafs(); it != end; ++it){
+      double size = it.getSize();
+      for (unsigned int i = 0; i < 3; ++i){
+        double node_min = tree.keyToCoord(it.getKey()[i], it.getDepth()) - size / 2.0;
+        min[i] = std::min(min[i], node_min);
+        max[i] = std::max(max[i], node_min + size);
+      }
+    }
+    double x, y, z;
+    tree.getMetricMin(x, y, z);
+    EXPECT_TRUE(x == min[0] && y == min[1] && z == min[2]);
+    tree.getMetricMax(x, y, z);
+    EXPECT_TRUE(x == max[0] && y == max[1] && z == max[2]);
+
+    // the thread count does not depend on the ray buffers
+    unsigned int num_threads = tree.getNumThreads();
+    tree.clearKeyRays();
+    EXPECT_EQ(tree.getNumThreads(), num_threads);
+    tree.getMetricMin(x, y, z);
+    EXPECT_TRUE(x == min[0] && y == min[1] && z == min[2]);
+  }
+
+  // ray buffers are recreated as needed after clearKeyRays()
+  {
+    Pointcloud scan;
+    for (int i = 0; i < 2000; ++i)
+      scan.push_back(point3d(2.0f + 0.001f * i, -1.0f + 0.002f * i, 0.5f));
+    OcTree reference(0.1);
+    OcTree cleared(0.1);
+    reference.setNumThreads(max_threads);
+    cleared.setNumThreads(max_threads);
+    cleared.clearKeyRays();
+    reference.insertPointCloud(scan, point3d(0.0f, 0.0f, 0.0f));
+    cleared.insertPointCloud(scan, point3d(0.0f, 0.0f, 0.0f));
+    EXPECT_TRUE(cleared == reference);
+    cleared.clearKeyRays();
+    std::vector<point3d> ray;
+    EXPECT_TRUE(cleared.computeRay(point3d(0.0f, 0.0f, 0.0f), point3d(2.0f, 1.0f, 0.5f), ray));
+    EXPECT_TRUE(ray.size() > 0);
+  }
+
+  // outdated occupied leafs are degraded
+  {
+    OcTreeStamped stamped(0.1);
+    stamped.setNumThreads(max_threads);
+    for (unsigned i = 0; i < 1000; ++i)
+      stamped.updateNode(point3d(0.1f * (i % 10), 0.1f * ((i / 10) % 10), 0.1f * (i / 100)), i % 3 != 0);
+    std::vector<float> log_odds;
+    std::vector<bool> outdated;
+    for (OcTreeStamped::leaf_iterator it = stamped.begin_leafs(), end = stamped.end_leafs(); it != end; ++it){
+      log_odds.push_back(it->getLogOdds());
+      outdated.push_back(log_odds.size() % 2 == 0 && stamped.isNodeOccupied(*it));
+      if (log_odds.size() % 2 == 0)
+        it->setTimestamp(0);
+    }
+    stamped.degradeOutdatedNodes(3600);
+    size_t i = 0;
+    for (OcTreeStamped::leaf_iterator it = stamped.begin_leafs(), end = stamped.end_leafs(); it != end; ++it, ++i){
+      float expected = outdated[i] ? log_odds[i] + stamped.getProbMissLog() : log_odds[i];
+      EXPECT_FLOAT_EQ(it->getLogOdds(), expected);
+    }
+    EXPECT_EQ(i, log_odds.size());
+  }
+
+  // empty tree
+  {
+    OcTree empty(0.1);
+    StatisticsFunctor functor(empty);
+    empty.parallelForEachNode(functor);
+    EXPECT_EQ(functor.total().num_nodes, 0);
+  }
+
+  std::cerr << "Test successful.\n";
+  return 0;
+}
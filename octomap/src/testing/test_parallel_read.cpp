@@ -0,0 +1,174 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <bitset>
+#include <sstream>
+
+#include <octomap/octomap_timing.h>
+#include <octomap/octomap.h>
+#include "testing.h"
+
+using namespace std;
+using namespace octomap;
+
+void printUsage(char* self){
+  std::cerr << "\nUSAGE: " << self << " [map.bt] [num_nodes] [max_threads]  (optional, default: none, 1000000, 8)\n\n";
+  std::cerr << "Benchmarks reading binary files: previous bitset decoding, table decoding and\n";
+  std::cerr << "parallel decoding of subtrees, for the map and a random map of about num_nodes nodes\n\n";
+
+  exit(1);
+}
+
+double timediff(const timeval& start, const timeval& stop){
+  return (stop.tv_sec - start.tv_sec) + 1.0e-6 *(stop.tv_usec - start.tv_usec);
+}
+
+/// OcTree with the previous decoding of binary data
+class BitsetOcTree : public OcTree {
+public:
+  BitsetOcTree(double resolution) : OcTree(resolution) {}
+
+  void readBinaryDataBitset(std::istream& s){
+    root = allocNode();
+    readBinaryNodeBitset(s, root);
+    size_changed = true;
+    tree_size = calcNumNodes();
+  }
+
+protected:
+  void readBinaryNodeBitset(std::istream& s, OcTreeNode* node){
+    char child1to4_char;
+    char child5to8_char;
+    s.read((char*)&child1to4_char, sizeof(char));
+    s.read((char*)&child5to8_char, sizeof(char));
+    std::bitset<8> child1to4 ((unsigned long long) child1to4_char);
+    std::bitset<8> child5to8 ((unsigned long long) child5to8_char);
+
+    node->setLogOdds(clamping_thres_max);
+    for (unsigned int i=0; i<8; i++) {
+      const std::bitset<8>& bits = (i < 4) ? child1to4 : child5to8;
+      unsigned int j = i % 4;
+      if (bits[j*2] == 1 && bits[j*2+1] == 0)
+        createNodeChild(node, i)->setLogOdds(clamping_thres_min);
+      else if (bits[j*2] == 0 && bits[j*2+1] == 1)
+        createNodeChild(node, i)->setLogOdds(clamping_thres_max);
+      else if (bits[j*2] == 1 && bits[j*2+1] == 1)
+        createNodeChild(node, i)->setLogOdds(-200.);
+    }
+    for (unsigned int i=0; i<8; i++) {
+      if (nodeChildExists(node, i)) {
+        OcTreeNode* child = getNodeChild(node, i);
+        if (fabs(child->getLogOdds() + 200.)<1e-3) {
+          readBinaryNodeBitset(s, child);
+          child->setLogOdds(child->getMaxChildLogOdds());
+        }
+      }
+    }
+  }
+};
+
+/// random occupancy in a cube, about num_nodes nodes
+void generateMap(OcTree& tree, size_t num_nodes){
+  unsigned side = (unsigned) ceil(pow(num_nodes * 7.0 / 8.0, 1.0 / 3.0));
+  std::vector<std::pair<OcTreeKey, float> > updates;
+  srand(42);
+  for (unsigned x = 0; x < side; ++x)
+    for (unsigned y = 0; y < side; ++y)
+      for (unsigned z = 0; z < side; ++z)
+        updates.push_back(std::make_pair(OcTreeKey(32768 - side/2 + x, 32768 - side/2 + y, 32768 - side/2 + z),
+                                         (rand() % 2) ? tree.getProbHitLog() : tree.getProbMissLog()));
+  tree.updateNodes(updates);
+}
+
+void benchmark(const std::string& name, OcTree& tree, unsigned max_threads){
+  std::stringstream file;
+  tree.useSubtreeIndex(true);
+  EXPECT_TRUE(tree.writeBinary(file));
+  tree.useSubtreeIndex(false);
+  const std::string data = file.str();
+  std::cout << name << ": " << tree.size() << " nodes, " << data.size() << " bytes\n";
+
+  // same file without subtree sizes in the header (as written by default)
+  size_t subtrees_begin = data.find("\nsubtrees ");
+  EXPECT_TRUE(subtrees_begin != std::string::npos);
+  size_t subtrees_end = data.find('\n', subtrees_begin + 1);
+  const std::string data_without_subtrees = data.substr(0, subtrees_begin) + data.substr(subtrees_end);
+  std::stringstream default_file;
+  EXPECT_TRUE(tree.writeBinary(default_file));
+  EXPECT_TRUE(default_file.str() == data_without_subtrees);
+  timeval start;
+  timeval stop;
+
+  BitsetOcTree bitset_tree(tree.getResolution());
+  std::istringstream bitset_stream(data_without_subtrees.substr(data_without_subtrees.find("\ndata\n") + 6));
+  gettimeofday(&start, NULL);
+  bitset_tree.readBinaryDataBitset(bitset_stream);
+  gettimeofday(&stop, NULL);
+  double time_bitset = timediff(start, stop);
+  EXPECT_TRUE(tree == bitset_tree);
+  std::cout << "  bitset decoding:     " << time_bitset << " s\n";
+
+  OcTree serial_tree(tree.getResolution());
+  std::istringstream serial_stream(data_without_subtrees);
+  gettimeofday(&start, NULL);
+  EXPECT_TRUE(serial_tree.readBinary(serial_stream));
+  gettimeofday(&stop, NULL);
+  EXPECT_TRUE(tree == serial_tree);
+  std::cout << "  table decoding:      " << timediff(start, stop) << " s (speedup "
+            << time_bitset / timediff(start, stop) << ")\n";
+
+  for (unsigned num_threads = 1; num_threads <= max_threads; num_threads *= 2){
+    OcTree parallel_tree(tree.getResolution());
+    parallel_tree.setNumThreads(num_threads);
+    if (parallel_tree.getNumThreads() != num_threads)
+      break;
+    std::istringstream stream(data);
+    gettimeofday(&start, NULL);
+    EXPECT_TRUE(parallel_tree.readBinary(stream));
+    gettimeofday(&stop, NULL);
+    EXPECT_TRUE(tree == parallel_tree);
+    std::cout << "  subtrees, " << num_threads << " threads: " << timediff(start, stop) << " s (speedup "
+              << time_bitset / timediff(start, stop) << ")\n";
+  }
+
+  // inconsistent subtree sizes are detected
+  std::string corrupt = data;
+  corrupt.replace(corrupt.find(' ', corrupt.find(' ', subtrees_begin + 10) + 1), 1, " 1");
+  std::istringstream corrupt_stream(corrupt);
+  OcTree corrupt_tree(tree.getResolution());
+  EXPECT_FALSE(corrupt_tree.readBinary(corrupt_stream));
+
+  // implausible subtree counts and sizes fail before allocating
+  std::string header = data.substr(0, subtrees_begin);
+  const std::string data_begin = data.substr(data.find("\ndata\n"));
+  std::istringstream count_stream(header + "\nsubtrees 2 100000000000" + data_begin);
+  EXPECT_FALSE(corrupt_tree.readBinary(count_stream));
+  std::istringstream sizes_stream(header + "\nsubtrees 2 2 18446744073709551615 3" + data_begin);
+  EXPECT_FALSE(corrupt_tree.readBinary(sizes_stream));
+}
+
+int main(int argc, char** argv) {
+  size_t num_nodes = 1000000;
+  unsigned max_threads = 8;
+  if (argc > 4)
+    printUsage(argv[0]);
+  if (argc >= 3)
+    num_nodes = atol(argv[2]);
+  if (argc == 4)
+    max_threads = atoi(argv[3]);
+
+  if (argc > 1){
+    OcTree tree(0.1);
+    EXPECT_TRUE(tree.readBinary(argv[1]));
+    benchmark(argv[1], tree, max_threads);
+  }
+
+  {
+    OcTree tree(0.05);
+    generateMap(tree, num_nodes);
+    benchmark("Random map", tree, max_threads);
+  }
+
+  std::cerr << "Test successful.\n";
+  return 0;
+}
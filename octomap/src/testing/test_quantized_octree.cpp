@@ -0,0 +1,196 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <sstream>
+
+#include <octomap/octomap_timing.h>
+#include <octomap/octomap.h>
+#include <octomap/QuantizedOcTree.h>
+#include <octomap/math/Utils.h>
+#include "testing.h"
+
+using namespace std;
+using namespace octomap;
+
+void printUsage(char* self){
+  std::cerr << "\nUSAGE: " << self << " scans.graph [num_scans]  (optional, default: 20)\n\n";
+  std::cerr << "Compares QuantizedOcTree with 8 and 16 bits with OcTree in accuracy, insertion time and file size\n\n";
+
+  exit(1);
+}
+
+double timediff(const timeval& start, const timeval& stop){
+  return (stop.tv_sec - start.tv_sec) + 1.0e-6 *(stop.tv_usec - start.tv_usec);
+}
+
+/// @return insertion time of the graph and the scans
+template <class TREE>
+double insertScans(TREE& tree, const ScanGraph& graph, const std::vector<Pointcloud>& scans,
+                   const std::vector<point3d>& origins){
+  timeval start;
+  timeval stop;
+  gettimeofday(&start, NULL);
+  for (ScanGraph::const_iterator it = graph.begin(); it != graph.end(); ++it)
+    tree.insertPointCloud((*it)->scan, (*it)->pose.trans());
+  for (size_t i = 0; i < scans.size(); ++i)
+    tree.insertPointCloud(scans[i], origins[i]);
+  gettimeofday(&stop, NULL);
+  return timediff(start, stop);
+}
+
+/// all values need to be on the levels of the quantization, within the clamping thresholds
+void expectQuantized(const QuantizedOcTree& tree){
+  for (QuantizedOcTree::tree_iterator it = tree.begin_tree(); it != tree.end_tree(); ++it){
+    EXPECT_EQ(it->getLogOdds(), tree.quantize(it->getLogOdds()));
+    EXPECT_TRUE(it->getLogOdds() >= tree.getClampingThresMinLog());
+    EXPECT_TRUE(it->getLogOdds() <= tree.getClampingThresMaxLog());
+  }
+}
+
+/// compares the leafs of the quantized tree with the reference, @return fraction with equal occupancy
+double compareOccupancy(const OcTree& reference, const QuantizedOcTree& tree, float& max_error){
+  size_t num_leafs = 0;
+  size_t num_equal = 0;
+  max_error = 0.0f;
+  for (OcTree::leaf_iterator it = reference.begin_leafs(); it != reference.end_leafs(); ++it){
+    OcTreeNode* node = tree.search(it.getKey(), it.getDepth());
+    EXPECT_TRUE(node);
+    ++num_leafs;
+    if (tree.isNodeOccupied(node) == reference.isNodeOccupied(*it))
+      ++num_equal;
+    max_error = std::max(max_error, fabsf(node->getLogOdds() - it->getLogOdds()));
+  }
+  return double(num_equal) / num_leafs;
+}
+
+int main(int argc, char** argv) {
+  if (argc < 2 || argc > 3)
+    printUsage(argv[0]);
+  unsigned num_scans = 20;
+  if (argc == 3)
+    num_scans = atoi(argv[2]);
+
+  ScanGraph graph;
+  EXPECT_TRUE(graph.readBinary(argv[1]));
+  std::vector<Pointcloud> scans;
+  std::vector<point3d> origins;
+  srand(42);
+  for (unsigned s = 0; s < num_scans; ++s){
+    point3d origin(0.1f * s, 0.05f * s, 0.0f);
+    scans.push_back(generateScan(origin));
+    origins.push_back(origin);
+  }
+
+  OcTree reference(0.05);
+  double time_reference = insertScans(reference, graph, scans, origins);
+  std::stringstream reference_ot;
+  EXPECT_TRUE(reference.write(reference_ot));
+  std::cout << "OcTree: " << reference.size() << " nodes, inserted in " << time_reference << " s, .ot "
+            << reference_ot.str().size() << " bytes\n";
+
+  for (unsigned bits = 8; bits <= 16; bits += 8){
+    QuantizedOcTree tree(0.05, bits);
+    EXPECT_EQ(tree.getQuantizationBits(), bits);
+    EXPECT_EQ(tree.memoryUsageNode(), reference.memoryUsageNode());
+
+    // sensor model on the levels, close to the one of OcTree
+    float step = tree.getQuantizationStep();
+    EXPECT_TRUE(step > 0.0f);
+    EXPECT_EQ(tree.getProbHitLog(), tree.quantize(tree.getProbHitLog()));
+    EXPECT_EQ(tree.getProbMissLog(), tree.quantize(tree.getProbMissLog()));
+    EXPECT_TRUE(fabsf(tree.getProbHitLog() - reference.getProbHitLog()) <= 0.5f * step);
+    EXPECT_TRUE(fabsf(tree.getProbMissLog() - reference.getProbMissLog()) <= 0.5f * step);
+    EXPECT_TRUE(reference.getClampingThresMinLog() - tree.getClampingThresMinLog() <= 0.0f);
+    EXPECT_TRUE(reference.getClampingThresMaxLog() - tree.getClampingThresMaxLog() >= 0.0f);
+
+    double time = insertScans(tree, graph, scans, origins);
+    expectQuantized(tree);
+    float max_error;
+    double equal = compareOccupancy(reference, tree, max_error);
+    EXPECT_TRUE(equal > 0.99);
+
+    // lossless .ot round trip through the tree factory, smaller than with floats
+    std::stringstream ot;
+    EXPECT_TRUE(tree.write(ot));
+    AbstractOcTree* read_tree = AbstractOcTree::read(ot);
+    EXPECT_TRUE(read_tree);
+    EXPECT_EQ(read_tree->getTreeType(), "QuantizedOcTree");
+    QuantizedOcTree* read_quantized = dynamic_cast<QuantizedOcTree*>(read_tree);
+    EXPECT_TRUE(read_quantized);
+    EXPECT_EQ(read_quantized->getQuantizationBits(), bits);
+    EXPECT_EQ(read_quantized->getQuantizationStep(), step);
+    EXPECT_TRUE(*read_quantized == tree);
+    delete read_tree;
+    size_t ot_size = ot.str().size();
+    EXPECT_TRUE(ot_size < reference_ot.str().size() * (bits / 8 + 1) / 5 + reference_ot.str().size() / 10);
+
+    std::cout << "QuantizedOcTree " << bits << " bit (step " << step << "): " << tree.size()
+              << " nodes, inserted in " << time << " s, .ot " << ot_size << " bytes, "
+              << 100.0 * equal << "% leafs with the same occupancy, max. log-odds error " << max_error << "\n";
+
+    // arbitrary updates and values are rounded to the levels
+    OcTreeKey key = tree.coordToKey(origins[0]);
+    tree.updateNode(key, 0.3f);
+    tree.updateNode(key, -0.123f);
+    tree.setNodeValue(key, 0.777f);
+    EXPECT_EQ(tree.search(key)->getLogOdds(), tree.quantize(0.777f));
+    tree.setNodeValue(key, 100.0f);
+    EXPECT_EQ(tree.search(key)->getLogOdds(), tree.getClampingThresMaxLog());
+    expectQuantized(tree);
+
+    // changed sensor model
+    tree.setProbHit(0.9);
+    EXPECT_EQ(tree.getProbHitLog(), tree.quantize(tree.getProbHitLog()));
+    tree.insertPointCloud(scans[0], origins[0]);
+    expectQuantized(tree);
+  }
+
+  // requantization to 8 bits with a coarse step
+  {
+    QuantizedOcTree tree(0.05);
+    insertScans(tree, graph, scans, origins);
+    size_t size = tree.size();
+    tree.setQuantization(8, 0.1f);
+    EXPECT_EQ(tree.getQuantizationStep(), 0.125f);
+    expectQuantized(tree);
+    tree.prune();
+    EXPECT_TRUE(tree.size() <= size);
+    EXPECT_EQ(tree.size(), tree.calcNumNodes());
+
+  }
+
+  // a wider clamping range increases the step instead of clipping the thresholds
+  {
+    QuantizedOcTree tree(0.05, 8);
+    tree.insertPointCloud(scans[0], origins[0]);
+    float step = tree.getQuantizationStep();
+    tree.setClampingThresMin(0.001);
+    tree.setClampingThresMax(0.999);
+    EXPECT_TRUE(tree.getQuantizationStep() > step);
+    EXPECT_TRUE(fabsf(tree.getClampingThresMinLog() - logodds(0.001)) < tree.getQuantizationStep());
+    EXPECT_TRUE(fabsf(tree.getClampingThresMaxLog() - logodds(0.999)) < tree.getQuantizationStep());
+    expectQuantized(tree);
+  }
+
+  // reading 8 bit data into a tree with a larger clamping range, i.e. a coarser step
+  {
+    QuantizedOcTree tree(0.05, 8);
+    insertScans(tree, graph, scans, origins);
+    std::stringstream ot;
+    EXPECT_TRUE(tree.write(ot));
+    std::string data = ot.str();
+    std::stringstream data_stream(data.substr(data.find("\ndata\n") + 6));
+    QuantizedOcTree other(0.05, 16);
+    other.setClampingThresMin(0.001);
+    other.setClampingThresMax(0.999);
+    other.readData(data_stream);
+    EXPECT_EQ(other.getQuantizationBits(), 8);
+    EXPECT_TRUE(other.getQuantizationStep() > tree.getQuantizationStep());
+    EXPECT_EQ(other.size(), tree.size());
+    expectQuantized(other);
+    for (QuantizedOcTree::leaf_iterator it = tree.begin_leafs(); it != tree.end_leafs(); ++it)
+      EXPECT_EQ(other.search(it.getKey(), it.getDepth())->getLogOdds(), other.quantize(it->getLogOdds()));
+  }
+
+  std::cerr << "Test successful.\n";
+  return 0;
+}
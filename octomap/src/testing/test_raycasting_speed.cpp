@@ -0,0 +1,285 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <octomap/octomap_timing.h>
+#include <octomap/octomap.h>
+#include <octomap/math/Utils.h>
+#include "testing.h"
+
+using namespace std;
+using namespace octomap;
+
+void printUsage(char* self){
+  std::cerr << "\nUSAGE: " << self << " [map.bt] [num_rays] [max_threads]  (optional, default: room only, 100000, 8)\n\n";
+  std::cerr << "Benchmarks castRay() on pruned maps against a voxel-wise reference,\n";
+  std::cerr << "and castRays() for a lidar sweep with 1, 2, 4, ... max_threads threads\n\n";
+
+  exit(1);
+}
+
+double timediff(const timeval& start, const timeval& stop){
+  return (stop.tv_sec - start.tv_sec) + 1.0e-6 *(stop.tv_usec - start.tv_usec);
+}
+
+/// castRay() stepping through all voxels with a search from the root for each (previous implementation)
+bool castRayVoxelwise(const OcTree& tree, const point3d& origin, const point3d& directionP, point3d& end,
+                      bool ignoreUnknown, double maxRange){
+  OcTreeKey current_key;
+  if (!tree.coordToKeyChecked(origin, current_key))
+    return false;
+
+  OcTreeNode* startingNode = tree.search(current_key);
+  if (startingNode){
+    if (tree.isNodeOccupied(startingNode)){
+      end = tree.keyToCoord(current_key);
+      return true;
+    }
+  } else if (!ignoreUnknown){
+    end = tree.keyToCoord(current_key);
+    return false;
+  }
+
+  point3d direction = directionP.normalized();
+  bool max_range_set = (maxRange > 0.0);
+  double resolution = tree.getResolution();
+
+  int step[3];
+  double tMax[3];
+  double tDelta[3];
+  for (unsigned int i = 0; i < 3; ++i){
+    if (direction(i) > 0.0) step[i] = 1;
+    else if (direction(i) < 0.0) step[i] = -1;
+    else step[i] = 0;
+
+    if (step[i] != 0){
+      double voxelBorder = tree.keyToCoord(current_key[i]);
+      voxelBorder += double(step[i] * resolution * 0.5);
+      tMax[i] = (voxelBorder - origin(i)) / direction(i);
+      tDelta[i] = resolution / fabs(direction(i));
+    } else {
+      tMax[i] = std::numeric_limits<double>::max();
+      tDelta[i] = std::numeric_limits<double>::max();
+    }
+  }
+
+  double maxrange_sq = maxRange * maxRange;
+  while (true){
+    unsigned int dim;
+    if (tMax[0] < tMax[1]){
+      if (tMax[0] < tMax[2]) dim = 0;
+      else                   dim = 2;
+    } else {
+      if (tMax[1] < tMax[2]) dim = 1;
+      else                   dim = 2;
+    }
+
+    if ((step[dim] < 0 && current_key[dim] == 0)
+        || (step[dim] > 0 && current_key[dim] == 2 * 32768 - 1)){
+      end = tree.keyToCoord(current_key);
+      return false;
+    }
+
+    current_key[dim] += step[dim];
+    tMax[dim] += tDelta[dim];
+    end = tree.keyToCoord(current_key);
+
+    if (max_range_set){
+      double dist_from_origin_sq(0.0);
+      for (unsigned int j = 0; j < 3; j++)
+        dist_from_origin_sq += ((end(j) - origin(j)) * (end(j) - origin(j)));
+      if (dist_from_origin_sq > maxrange_sq)
+        return false;
+    }
+
+    OcTreeNode* currentNode = tree.search(current_key);
+    if (currentNode){
+      if (tree.isNodeOccupied(currentNode))
+        return true;
+    } else if (!ignoreUnknown){
+      return false;
+    }
+  }
+}
+
+/// box-shaped room (walls at +-size) with random box obstacles, completely known, as pruned maximum likelihood map
+void generateRoom(OcTree& tree, const point3d& size, unsigned num_obstacles){
+  OcTreeKey min_key = tree.coordToKey(-size);
+  OcTreeKey max_key = tree.coordToKey(size);
+  std::vector<OcTreeKey> obstacle_min, obstacle_max;
+  srand(42);
+  for (unsigned i = 0; i < num_obstacles; ++i){
+    OcTreeKey key;
+    for (unsigned j = 0; j < 3; ++j)
+      key[j] = min_key[j] + rand() % (max_key[j] - min_key[j]);
+    obstacle_min.push_back(key);
+    for (unsigned j = 0; j < 3; ++j)
+      key[j] += 1 + rand() % 10;
+    obstacle_max.push_back(key);
+  }
+
+  std::vector<std::pair<OcTreeKey, float> > updates;
+  for (key_type x = min_key[0]; x <= max_key[0]; ++x){
+    for (key_type y = min_key[1]; y <= max_key[1]; ++y){
+      for (key_type z = min_key[2]; z <= max_key[2]; ++z){
+        OcTreeKey key(x, y, z);
+        bool occupied = false;
+        for (unsigned j = 0; j < 3; ++j)
+          occupied = occupied || key[j] == min_key[j] || key[j] == max_key[j];
+        for (unsigned i = 0; i < num_obstacles && !occupied; ++i){
+          occupied = true;
+          for (unsigned j = 0; j < 3; ++j)
+            occupied = occupied && key[j] >= obstacle_min[i][j] && key[j] <= obstacle_max[i][j];
+        }
+        updates.push_back(std::make_pair(key, occupied ? tree.getProbHitLog() : tree.getProbMissLog()));
+      }
+    }
+  }
+  tree.updateNodes(updates, true);
+  tree.toMaxLikelihood();
+  tree.updateInnerOccupancy();
+  tree.prune();
+}
+
+/// casts rays from random free voxels in the bounding box, compares with castRayVoxelwise()
+void benchmark(const std::string& name, const OcTree& tree, unsigned num_rays){
+  double x, y, z;
+  tree.getMetricMin(x, y, z);
+  point3d min(x, y, z);
+  tree.getMetricMax(x, y, z);
+  point3d size = point3d(x, y, z) - min;
+
+  std::vector<point3d> origins;
+  std::vector<point3d> directions;
+  srand(42);
+  while (origins.size() < num_rays){
+    point3d p(min.x() + size.x() * float(rand()) / RAND_MAX,
+              min.y() + size.y() * float(rand()) / RAND_MAX,
+              min.z() + size.z() * float(rand()) / RAND_MAX);
+    OcTreeNode* node = tree.search(p);
+    if (!node || tree.isNodeOccupied(node))
+      continue;
+    origins.push_back(p);
+    directions.push_back(point3d(float(rand()) / RAND_MAX - 0.5f, float(rand()) / RAND_MAX - 0.5f,
+                                 float(rand()) / RAND_MAX - 0.5f));
+  }
+
+  // unknown cells stop the ray / are ignored within a maximum range
+  for (unsigned run = 0; run < 2; ++run){
+    bool ignore_unknown = (run == 1);
+    double max_range = ignore_unknown ? 0.5 * size.norm() : -1.0;
+    std::vector<point3d> ends(num_rays);
+    std::vector<point3d> reference_ends(num_rays);
+    std::vector<char> hits(num_rays);
+    std::vector<char> reference_hits(num_rays);
+    timeval start;
+    timeval stop;
+
+    gettimeofday(&start, NULL);
+    for (unsigned i = 0; i < num_rays; ++i)
+      reference_hits[i] = castRayVoxelwise(tree, origins[i], directions[i], reference_ends[i], ignore_unknown, max_range);
+    gettimeofday(&stop, NULL);
+    double time_reference = timediff(start, stop);
+
+    gettimeofday(&start, NULL);
+    for (unsigned i = 0; i < num_rays; ++i)
+      hits[i] = tree.castRay(origins[i], directions[i], ends[i], ignore_unknown, max_range);
+    gettimeofday(&stop, NULL);
+    double time = timediff(start, stop);
+
+    unsigned num_hits = 0;
+    for (unsigned i = 0; i < num_rays; ++i){
+      EXPECT_EQ(hits[i], reference_hits[i]);
+      EXPECT_TRUE(ends[i] == reference_ends[i]);
+      if (hits[i])
+        ++num_hits;
+    }
+
+    std::cout << name << (ignore_unknown ? ", ignoring unknown: " : ": ") << num_hits << " / " << num_rays
+              << " hits, rays/s (voxel-wise / castRay): " << num_rays / time_reference << " / " << num_rays / time
+              << " (speedup " << time_reference / time << ")\n";
+  }
+}
+
+/// 64-beam lidar sweep (1024 steps, +-15 deg vertical) from origin with castRays(), compared to single castRay() calls
+void lidarSweep(OcTree& tree, const point3d& origin, unsigned max_threads){
+  std::vector<point3d> origins(1, origin);
+  std::vector<point3d> directions;
+  for (unsigned a = 0; a < 1024; ++a){
+    double yaw = 2.0 * M_PI * a / 1024.0;
+    for (unsigned b = 0; b < 64; ++b){
+      double pitch = DEG2RAD(-15.0 + 30.0 * b / 63.0);
+      directions.push_back(point3d(cos(pitch) * cos(yaw), cos(pitch) * sin(yaw), sin(pitch)));
+    }
+  }
+  const unsigned num_rays = directions.size();
+  timeval start;
+  timeval stop;
+
+  CastRayResults reference;
+  reference.resize(num_rays);
+  gettimeofday(&start, NULL);
+  for (unsigned i = 0; i < num_rays; ++i)
+    reference.hits[i] = tree.castRay(origin, directions[i], reference.ends[i], false, 20.0);
+  gettimeofday(&stop, NULL);
+  double time_reference = timediff(start, stop);
+  std::cout << "Lidar sweep, castRay():  " << num_rays / time_reference << " rays/s\n";
+
+  CastRayOptions options;
+  options.max_range = 20.0;
+  for (unsigned num_threads = 1; num_threads <= max_threads; num_threads *= 2){
+    tree.setNumThreads(num_threads);
+    if (tree.getNumThreads() != num_threads)
+      break;
+
+    for (unsigned packet_size = 1; packet_size <= 64; packet_size *= 64){
+      options.packet_size = packet_size;
+      CastRayResults results;
+      gettimeofday(&start, NULL);
+      tree.castRays(origins, directions, results, options);
+      gettimeofday(&stop, NULL);
+      double time = timediff(start, stop);
+
+      EXPECT_EQ(results.hits.size(), num_rays);
+      for (unsigned i = 0; i < num_rays; ++i){
+        EXPECT_EQ(results.hits[i], reference.hits[i]);
+        EXPECT_TRUE(results.ends[i] == reference.ends[i]);
+        EXPECT_TRUE(results.keys[i] == tree.coordToKey(reference.ends[i]));
+        EXPECT_FLOAT_EQ(results.distances[i], (reference.ends[i] - origin).norm());
+      }
+      std::cout << "Lidar sweep, castRays(), " << num_threads << " threads, packets of " << packet_size << ": "
+                << num_rays / time << " rays/s (speedup " << time_reference / time << ")\n";
+    }
+  }
+  tree.setNumThreads(1);
+}
+
+int main(int argc, char** argv) {
+  unsigned num_rays = 100000;
+  unsigned max_threads = 8;
+  if (argc > 4)
+    printUsage(argv[0]);
+  if (argc >= 3)
+    num_rays = atoi(argv[2]);
+  if (argc == 4)
+    max_threads = atoi(argv[3]);
+
+  {
+    OcTree room(0.1);
+    generateRoom(room, point3d(8.0f, 6.0f, 2.5f), 50);
+    std::cout << "Room: " << room.size() << " nodes\n";
+    benchmark("Room", room, num_rays);
+    lidarSweep(room, point3d(0.01f, 0.01f, 0.02f), max_threads);
+  }
+
+  if (argc > 1){
+    OcTree tree(0.1);
+    EXPECT_TRUE(tree.readBinary(argv[1]));
+    tree.toMaxLikelihood();
+    tree.prune();
+    std::cout << argv[1] << ": " << tree.size() << " nodes\n";
+    benchmark(argv[1], tree, num_rays);
+  }
+
+  std::cerr << "Test successful.\n";
+  return 0;
+}
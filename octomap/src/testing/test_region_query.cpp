@@ -0,0 +1,316 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include <octomap/octomap_timing.h>
+#include <octomap/octomap.h>
+#include "testing.h"
+
+using namespace std;
+using namespace octomap;
+
+void printUsage(char* self){
+  std::cerr << "\nUSAGE: " << self << " map.bt [num_queries]  (optional, default: 100)\n\n";
+  std::cerr << "Compares region queries (boxes, spheres, oriented boxes) with the iterators\n";
+  std::cerr << "on random regions of the map and measures their speed\n\n";
+
+  exit(1);
+}
+
+double timediff(const timeval& start, const timeval& stop){
+  return (stop.tv_sec - start.tv_sec) + 1.0e-6 *(stop.tv_usec - start.tv_usec);
+}
+
+struct LeafEntry {
+  OcTreeKey key;
+  unsigned int depth;
+  bool operator==(const LeafEntry& other) const { return key == other.key && depth == other.depth; }
+};
+
+/// records the visited leafs in order
+struct CollectFunctor {
+  void operator()(OcTreeNode*, const OcTreeKey& key, unsigned int depth){
+    LeafEntry entry;
+    entry.key = key;
+    entry.depth = depth;
+    leafs.push_back(entry);
+  }
+  std::vector<LeafEntry> leafs;
+};
+
+/// counts the visited leafs (for timing)
+struct CountFunctor {
+  CountFunctor() : count(0), sum(0.0) {}
+  void operator()(OcTreeNode* node, const OcTreeKey&, unsigned int){
+    ++count;
+    sum += node->getLogOdds();
+  }
+  size_t count;
+  double sum;
+};
+
+/// @return true if the node at depth with (center) key overlaps the key bounding box
+bool inKeyBBX(const OcTree& tree, const OcTreeKey& key, unsigned int depth, const OcTreeKey& min, const OcTreeKey& max){
+  unsigned int size = 1u << (tree.getTreeDepth() - depth);
+  for (unsigned int i = 0; i < 3; ++i){
+    unsigned int node_min = key[i] - (size >> 1);
+    if (node_min > max[i] || node_min + size - 1 < min[i])
+      return false;
+  }
+  return true;
+}
+
+/// reference result: all leafs of the key bounding box of the region which are not classified
+/// as outside, with node sizes scaled by size_factor
+template <class REGION>
+std::vector<LeafEntry> referenceQuery(const OcTree& tree, const REGION& region, unsigned int max_depth,
+                                      double size_factor = 1.0){
+  std::vector<LeafEntry> result;
+  point3d min, max;
+  region.getBounds(min, max);
+  OcTreeKey min_key, max_key;
+  if (!tree.coordToKeyChecked(min, min_key) || !tree.coordToKeyChecked(max, max_key))
+    return result;
+
+  for (OcTree::leaf_iterator it = tree.begin_leafs(max_depth), end = tree.end_leafs(); it != end; ++it){
+    if (!inKeyBBX(tree, it.getKey(), it.getDepth(), min_key, max_key))
+      continue;
+    if (region.classify(it.getCoordinate(), size_factor * it.getSize() / 2.0) == region::OUTSIDE)
+      continue;
+    LeafEntry entry;
+    entry.key = it.getKey();
+    entry.depth = it.getDepth();
+    result.push_back(entry);
+  }
+  return result;
+}
+
+/// @return true if a is a subsequence of b
+bool isSubsequence(const std::vector<LeafEntry>& a, const std::vector<LeafEntry>& b){
+  size_t j = 0;
+  for (size_t i = 0; i < a.size(); ++i){
+    while (j < b.size() && !(b[j] == a[i]))
+      ++j;
+    if (j == b.size())
+      return false;
+    ++j;
+  }
+  return true;
+}
+
+/// Compares with the reference. Nodes touching the region within float precision may be
+/// classified differently than their parents (pruned or not), so the result is checked to lie
+/// between the leafs of the slightly shrunken and of the slightly enlarged nodes, in iterator order.
+template <class REGION>
+size_t compareWithReference(const OcTree& tree, const REGION& region, unsigned int max_depth){
+  CollectFunctor collect;
+  tree.forEachLeafInRegion(region, collect, max_depth);
+  std::vector<LeafEntry> reference_inner = referenceQuery(tree, region, max_depth, 1.0 - 1e-3);
+  std::vector<LeafEntry> reference_outer = referenceQuery(tree, region, max_depth, 1.0 + 1e-3);
+  EXPECT_TRUE(isSubsequence(reference_inner, collect.leafs));
+  EXPECT_TRUE(isSubsequence(collect.leafs, reference_outer));
+  return collect.leafs.size();
+}
+
+bool inSphere(const RegionSphere& sphere, const point3d& p){
+  return (p - sphere.center).norm() <= sphere.radius;
+}
+
+bool inOBB(const RegionOBB& obb, const point3d& p){
+  point3d t = p - obb.center;
+  for (unsigned int j = 0; j < 3; ++j){
+    double d = obb.axes[j][0] * t.x() + obb.axes[j][1] * t.y() + obb.axes[j][2] * t.z();
+    if (fabs(d) > obb.half_extents(j) + 1e-6)
+      return false;
+  }
+  return true;
+}
+
+/// checks the classification of random cubes against samples on a grid of the cube
+template <class REGION, class CONTAINS>
+void checkClassify(const REGION& region, CONTAINS contains, const point3d& min, const point3d& size){
+  const unsigned int n = 6;
+  for (unsigned int c = 0; c < 2000; ++c){
+    point3d center = randomPoint(min, size);
+    double half_size = 0.05 * (1 << (rand() % 6));
+    region::Overlap overlap = region.classify(center, half_size);
+    unsigned int num_inside = 0;
+    for (unsigned int i = 0; i < n; ++i){
+      for (unsigned int j = 0; j < n; ++j){
+        for (unsigned int k = 0; k < n; ++k){
+          point3d offset(float(-half_size + 2.0 * half_size * i / (n - 1)),
+                         float(-half_size + 2.0 * half_size * j / (n - 1)),
+                         float(-half_size + 2.0 * half_size * k / (n - 1)));
+          if (contains(region, center + offset))
+            ++num_inside;
+        }
+      }
+    }
+    if (num_inside > 0)
+      EXPECT_TRUE(overlap != region::OUTSIDE);
+    if (overlap == region::INSIDE)
+      EXPECT_EQ(num_inside, n * n * n);
+  }
+}
+
+int main(int argc, char** argv) {
+  if (argc < 2 || argc > 3)
+    printUsage(argv[0]);
+  unsigned int num_queries = 100;
+  if (argc == 3)
+    num_queries = atoi(argv[2]);
+
+  OcTree tree(0.1);
+  EXPECT_TRUE(tree.readBinary(std::string(argv[1])));
+  EXPECT_TRUE(tree.size() > 0);
+
+  double min_x, min_y, min_z, max_x, max_y, max_z;
+  tree.getMetricMin(min_x, min_y, min_z);
+  tree.getMetricMax(max_x, max_y, max_z);
+  point3d map_min((float) min_x, (float) min_y, (float) min_z);
+  point3d map_size((float) (max_x - min_x), (float) (max_y - min_y), (float) (max_z - min_z));
+  std::cout << "Map with " << tree.getNumLeafNodes() << " leafs, size " << map_size << std::endl;
+
+  srand(42);
+
+  // exactness of the classifications
+  RegionSphere test_sphere(map_min + map_size * 0.5, 2.0);
+  checkClassify(test_sphere, inSphere, test_sphere.center - point3d(3, 3, 3), point3d(6, 6, 6));
+  RegionOBB test_obb(map_min + map_size * 0.5, point3d(2.0, 0.5, 1.0), octomath::Quaternion(0.3, -0.4, 0.8));
+  checkClassify(test_obb, inOBB, test_obb.center - point3d(3, 3, 3), point3d(6, 6, 6));
+
+  // boxes: same leafs and order as leaf_bbx_iterator
+  size_t num_box_leafs = 0;
+  for (unsigned int q = 0; q < num_queries; ++q){
+    point3d a = randomPoint(map_min, map_size);
+    point3d b = randomPoint(map_min, map_size);
+    point3d min(std::min(a.x(), b.x()), std::min(a.y(), b.y()), std::min(a.z(), b.z()));
+    point3d max(std::max(a.x(), b.x()), std::max(a.y(), b.y()), std::max(a.z(), b.z()));
+    unsigned int max_depth = (q % 4 == 3) ? 14 : 0;
+
+    CollectFunctor collect;
+    tree.forEachLeafInRegion(RegionAABB(min, max), collect, max_depth);
+
+    // leaf_bbx_iterator also returns leafs ending right before the box, filtered here
+    OcTreeKey min_key = tree.coordToKey(min);
+    OcTreeKey max_key = tree.coordToKey(max);
+    std::vector<LeafEntry> reference;
+    for (OcTree::leaf_bbx_iterator it = tree.begin_leafs_bbx(min, max, max_depth), end = tree.end_leafs_bbx(); it != end; ++it){
+      if (!inKeyBBX(tree, it.getKey(), it.getDepth(), min_key, max_key))
+        continue;
+      LeafEntry entry;
+      entry.key = it.getKey();
+      entry.depth = it.getDepth();
+      reference.push_back(entry);
+    }
+    EXPECT_EQ(collect.leafs.size(), reference.size());
+    EXPECT_TRUE(collect.leafs == reference);
+    num_box_leafs += reference.size();
+  }
+  EXPECT_TRUE(num_box_leafs > 0);
+
+  // spheres and oriented boxes: same leafs and order as full iteration with classify()
+  size_t num_sphere_leafs = 0;
+  size_t num_obb_leafs = 0;
+  for (unsigned int q = 0; q < num_queries; ++q){
+    unsigned int max_depth = (q % 4 == 3) ? 14 : 0;
+    point3d center = randomPoint(map_min, map_size);
+    num_sphere_leafs += compareWithReference(tree, RegionSphere(center, 0.2 + 3.0 * rand() / RAND_MAX), max_depth);
+    point3d half_extents = randomPoint(point3d(0.1f, 0.1f, 0.1f), point3d(3, 3, 3));
+    octomath::Quaternion rotation(2.0 * rand() / RAND_MAX, 2.0 * rand() / RAND_MAX, 6.0 * rand() / RAND_MAX);
+    num_obb_leafs += compareWithReference(tree, RegionOBB(center, half_extents, rotation), max_depth);
+  }
+  EXPECT_TRUE(num_sphere_leafs > 0);
+  EXPECT_TRUE(num_obb_leafs > 0);
+
+  // regions larger than or outside of the tree are clipped
+  point3d far(1.0e6f, 1.0e6f, 1.0e6f);
+  CollectFunctor all;
+  tree.forEachLeafInRegion(RegionAABB(-far, far), all);
+  EXPECT_EQ(all.leafs.size(), tree.getNumLeafNodes());
+  CollectFunctor none;
+  tree.forEachLeafInRegion(RegionSphere(far, 10.0), none);
+  tree.forEachLeafInRegion(RegionAABB(far, far * 2.0), none);
+  EXPECT_EQ(none.leafs.size(), (size_t) 0);
+  OcTree empty_tree(0.1);
+  empty_tree.forEachLeafInRegion(RegionAABB(-far, far), none);
+  EXPECT_EQ(none.leafs.size(), (size_t) 0);
+
+  // leaf buffer
+  LeafBuffer<float> buffer(tree.getNumLeafNodes());
+  size_t capacity = buffer.capacity();
+  EXPECT_EQ(tree.getLeafsInRegion(RegionAABB(-far, far), buffer), tree.getNumLeafNodes());
+  EXPECT_EQ(buffer.capacity(), capacity);
+  size_t i = 0;
+  for (OcTree::leaf_iterator it = tree.begin_leafs(), end = tree.end_leafs(); it != end; ++it, ++i){
+    EXPECT_TRUE(buffer.getCenter(i) == it.getCoordinate());
+    EXPECT_FLOAT_EQ(buffer.size[i], it.getSize());
+    EXPECT_FLOAT_EQ(buffer.value[i], it->getLogOdds());
+  }
+  CollectFunctor sphere_leafs;
+  tree.forEachLeafInRegion(test_sphere, sphere_leafs);
+  EXPECT_EQ(tree.getLeafsInRegion(test_sphere, buffer), sphere_leafs.leafs.size());
+  EXPECT_EQ(buffer.capacity(), capacity);
+
+  // timing: boxes against leaf_bbx_iterator, spheres against iterating the bounding box
+  std::vector<point3d> centers(num_queries);
+  for (unsigned int q = 0; q < num_queries; ++q)
+    centers[q] = randomPoint(map_min, map_size);
+  const double radius = 2.0;
+  point3d half_box((float) radius, (float) radius, (float) radius);
+  timeval start;
+  timeval stop;
+  double sum_iterator = 0.0, sum_region = 0.0;
+
+  gettimeofday(&start, NULL);
+  for (unsigned int q = 0; q < num_queries; ++q){
+    for (OcTree::leaf_bbx_iterator it = tree.begin_leafs_bbx(centers[q] - half_box, centers[q] + half_box),
+         end = tree.end_leafs_bbx(); it != end; ++it)
+      sum_iterator += it->getLogOdds();
+  }
+  gettimeofday(&stop, NULL);
+  double time_bbx_iterator = timediff(start, stop);
+
+  CountFunctor count_box;
+  gettimeofday(&start, NULL);
+  for (unsigned int q = 0; q < num_queries; ++q)
+    tree.forEachLeafInRegion(RegionAABB(centers[q] - half_box, centers[q] + half_box), count_box);
+  gettimeofday(&stop, NULL);
+  double time_box = timediff(start, stop);
+  EXPECT_TRUE(count_box.count > 0);
+
+  gettimeofday(&start, NULL);
+  for (unsigned int q = 0; q < num_queries; ++q){
+    RegionSphere sphere(centers[q], radius);
+    for (OcTree::leaf_bbx_iterator it = tree.begin_leafs_bbx(centers[q] - half_box, centers[q] + half_box),
+         end = tree.end_leafs_bbx(); it != end; ++it){
+      if (sphere.classify(it.getCoordinate(), it.getSize() / 2.0) != region::OUTSIDE)
+        sum_region += it->getLogOdds();
+    }
+  }
+  gettimeofday(&stop, NULL);
+  double time_sphere_iterator = timediff(start, stop);
+
+  CountFunctor count_sphere;
+  gettimeofday(&start, NULL);
+  for (unsigned int q = 0; q < num_queries; ++q)
+    tree.forEachLeafInRegion(RegionSphere(centers[q], radius), count_sphere);
+  gettimeofday(&stop, NULL);
+  double time_sphere = timediff(start, stop);
+
+  gettimeofday(&start, NULL);
+  for (unsigned int q = 0; q < num_queries; ++q)
+    tree.getLeafsInRegion(RegionSphere(centers[q], radius), buffer);
+  gettimeofday(&stop, NULL);
+  double time_buffer = timediff(start, stop);
+
+  std::cout << "Region queries (" << num_queries << " queries, radius / half size " << radius << "):\n"
+            << "  box, leaf_bbx_iterator:            " << time_bbx_iterator << " s (" << sum_iterator << ")\n"
+            << "  box, forEachLeafInRegion:          " << time_box << " s (" << count_box.sum << ")\n"
+            << "  sphere, leaf_bbx_iterator+classify: " << time_sphere_iterator << " s (" << sum_region << ")\n"
+            << "  sphere, forEachLeafInRegion:       " << time_sphere << " s (" << count_sphere.sum << ")\n"
+            << "  sphere, getLeafsInRegion:          " << time_buffer << " s\n";
+
+  std::cerr << "Test successful.\n";
+  return 0;
+}
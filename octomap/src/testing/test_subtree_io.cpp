@@ -0,0 +1,193 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <sstream>
+
+#include <octomap/octomap_timing.h>
+#include <octomap/octomap.h>
+#include "testing.h"
+
+using namespace std;
+using namespace octomap;
+
+void printUsage(char* self){
+  std::cerr << "\nUSAGE: " << self << " map.bt\n\n";
+  std::cerr << "Tests writing bounding boxes / subtrees and grafting them with readSubtree()\n\n";
+
+  exit(1);
+}
+
+double timediff(const timeval& start, const timeval& stop){
+  return (stop.tv_sec - start.tv_sec) + 1.0e-6 *(stop.tv_usec - start.tv_usec);
+}
+
+/// maximum likelihood tree of all voxels of tree in [min_key, max_key], pruned
+void cropReference(const OcTree& tree, const OcTreeKey& min_key, const OcTreeKey& max_key, OcTree& reference){
+  for (unsigned x = min_key[0]; x <= max_key[0]; ++x){
+    for (unsigned y = min_key[1]; y <= max_key[1]; ++y){
+      for (unsigned z = min_key[2]; z <= max_key[2]; ++z){
+        OcTreeKey key(x, y, z);
+        OcTreeNode* node = tree.search(key);
+        if (node)
+          reference.setNodeValue(key, tree.isNodeOccupied(node) ? reference.getClampingThresMaxLog()
+                                                                  : reference.getClampingThresMinLog(), true);
+      }
+    }
+  }
+  reference.updateInnerOccupancy();
+  reference.prune();
+}
+
+int main(int argc, char** argv) {
+  if (argc != 2)
+    printUsage(argv[0]);
+
+  OcTree tree(0.1);
+  EXPECT_TRUE(tree.readBinary(argv[1]));
+  // maximum likelihood map as reference for binary data
+  tree.toMaxLikelihood();
+  tree.prune();
+  const size_t tree_size = tree.size();
+  const double res = tree.getResolution();
+
+  timeval start;
+  timeval stop;
+
+  // bounding box tile, nodes crossing the box are split
+  point3d bbx_min(-1.23f, -2.07f, 0.05f);
+  point3d bbx_max(2.31f, 1.49f, 1.43f);
+  OcTreeKey min_key = tree.coordToKey(bbx_min);
+  OcTreeKey max_key = tree.coordToKey(bbx_max);
+  std::stringstream bbx_stream;
+  gettimeofday(&start, NULL);
+  EXPECT_TRUE(tree.writeBinary(bbx_stream, bbx_min, bbx_max));
+  gettimeofday(&stop, NULL);
+  double time_bbx = timediff(start, stop);
+  EXPECT_EQ(tree.size(), tree_size);
+
+  OcTree tile(res);
+  EXPECT_TRUE(tile.readBinary(bbx_stream));
+  OcTree reference(res);
+  cropReference(tree, min_key, max_key, reference);
+  EXPECT_EQ(tile.size(), reference.size());
+  EXPECT_TRUE(tile == reference);
+  std::cout << "Bounding box tile: " << tile.size() << " nodes, written in " << time_bbx << " s\n";
+
+  // previous way: copy the tree, delete outside the bounding box, write (only the copy is timed)
+  gettimeofday(&start, NULL);
+  {
+    OcTree copy(tree);
+  }
+  gettimeofday(&stop, NULL);
+  std::cout << "Copying the tree alone: " << timediff(start, stop) << " s\n";
+
+  // an empty bounding box gives an empty tree
+  std::stringstream empty_stream;
+  EXPECT_TRUE(tree.writeBinary(empty_stream, point3d(1000.0f, 1000.0f, 1000.0f), point3d(1001.0f, 1001.0f, 1001.0f)));
+  OcTree empty(res);
+  EXPECT_TRUE(empty.readBinary(empty_stream));
+  EXPECT_EQ(empty.size(), 0);
+  std::stringstream invalid_stream;
+  EXPECT_FALSE(tree.writeBinary(invalid_stream, bbx_max, bbx_min));
+
+  // subtree at depth 12 around a known point: same as the bounding box of the node
+  const unsigned depth = 12;
+  point3d center(0.5f, 0.5f, 0.5f);
+  OcTreeKey key = tree.coordToKey(center);
+  std::stringstream subtree_stream;
+  gettimeofday(&start, NULL);
+  EXPECT_TRUE(tree.writeSubtree(subtree_stream, key, depth));
+  gettimeofday(&stop, NULL);
+  double time_subtree = timediff(start, stop);
+  const std::string subtree_data = subtree_stream.str();
+
+  OcTree grafted(res);
+  EXPECT_TRUE(grafted.readSubtree(subtree_stream));
+  OcTreeKey node_min = computeIndexKey(16 - depth, key);
+  OcTreeKey node_max(node_min[0] + (1 << (16 - depth)) - 1, node_min[1] + (1 << (16 - depth)) - 1,
+                     node_min[2] + (1 << (16 - depth)) - 1);
+  OcTree node_reference(res);
+  cropReference(tree, node_min, node_max, node_reference);
+  EXPECT_EQ(grafted.size(), node_reference.size());
+  EXPECT_TRUE(grafted == node_reference);
+  EXPECT_EQ(grafted.size(), grafted.calcNumNodes());
+  std::cout << "Subtree (depth " << depth << "): " << subtree_data.size() << " bytes, written in " << time_subtree << " s\n";
+
+  // subtrees are not readable as complete trees
+  std::istringstream subtree_in(subtree_data);
+  OcTree not_a_tree(res);
+  EXPECT_FALSE(not_a_tree.readBinary(subtree_in));
+
+  // grafting restores the changed subtree in the map, without copying the map
+  OcTree changed(tree);
+  for (OcTree::leaf_bbx_iterator it = changed.begin_leafs_bbx(node_min, node_max), end = changed.end_leafs_bbx();
+       it != end; ++it){
+    OcTreeKey k = it.getKey();
+    bool inside = it.getDepth() >= depth; // not a leaf above the subtree's node
+    for (unsigned i = 0; i < 3; ++i)
+      inside = inside && k[i] >= node_min[i] && k[i] <= node_max[i];
+    if (!inside)
+      continue;
+    it->setLogOdds(changed.isNodeOccupied(*it) ? changed.getClampingThresMinLog() : changed.getClampingThresMaxLog());
+  }
+  changed.updateInnerOccupancy();
+  EXPECT_FALSE(changed == tree);
+  std::istringstream graft_in(subtree_data);
+  gettimeofday(&start, NULL);
+  EXPECT_TRUE(changed.readSubtree(graft_in));
+  gettimeofday(&stop, NULL);
+  std::cout << "Grafted the subtree into the map in " << timediff(start, stop) << " s\n";
+  EXPECT_EQ(changed.size(), changed.calcNumNodes());
+  EXPECT_TRUE(changed == tree);
+
+  // unknown parts of the subtree keep the map, known ones replace it (also pruned leafs of the map)
+  OcTree merged(res);
+  point3d free_point(0.05f, 0.05f, 0.05f);
+  merged.updateNode(free_point, false);
+  merged.setNodeValue(OcTreeKey(0, 0, 0), merged.getClampingThresMaxLog());
+  std::istringstream merge_in(subtree_data);
+  EXPECT_TRUE(merged.readSubtree(merge_in));
+  EXPECT_EQ(merged.size(), merged.calcNumNodes());
+  EXPECT_TRUE(merged.search(OcTreeKey(0, 0, 0)) != NULL);
+  OcTreeNode* merged_node = merged.search(free_point);
+  OcTreeNode* tree_node = tree.search(free_point);
+  EXPECT_TRUE(merged_node != NULL);
+  if (tree_node)
+    EXPECT_EQ(merged.isNodeOccupied(merged_node), tree.isNodeOccupied(tree_node));
+  for (OcTree::leaf_iterator it = grafted.begin_leafs(), end = grafted.end_leafs(); it != end; ++it){
+    OcTreeNode* node = merged.search(it.getKey(), it.getDepth());
+    EXPECT_TRUE(node != NULL);
+    EXPECT_EQ(merged.isNodeOccupied(node), grafted.isNodeOccupied(*it));
+  }
+
+  // bounding box tiles are grafted at the root
+  bbx_stream.clear();
+  bbx_stream.seekg(0);
+  OcTree merged_tile(res);
+  EXPECT_TRUE(merged_tile.readSubtree(bbx_stream));
+  EXPECT_TRUE(merged_tile == tile);
+
+  // grafting at another node of the same depth moves the subtree
+  OcTreeKey moved_key(key[0] + (1 << (16 - depth)), key[1], key[2]);
+  std::istringstream moved_in(subtree_data);
+  OcTree moved(res);
+  EXPECT_TRUE(moved.readSubtree(moved_in, moved_key));
+  EXPECT_EQ(moved.getNumLeafNodes(), grafted.getNumLeafNodes());
+  for (OcTree::leaf_iterator it = grafted.begin_leafs(), end = grafted.end_leafs(); it != end; ++it){
+    OcTreeKey k = it.getKey();
+    k[0] += (1 << (16 - depth));
+    OcTreeNode* node = moved.search(k, it.getDepth());
+    EXPECT_TRUE(node != NULL);
+    EXPECT_EQ(moved.isNodeOccupied(node), grafted.isNodeOccupied(*it));
+  }
+
+  // resolutions need to match, truncated data fails
+  std::istringstream res_in(subtree_data);
+  OcTree other_res(res / 2.0);
+  EXPECT_FALSE(other_res.readSubtree(res_in));
+  std::istringstream truncated_in(subtree_data.substr(0, subtree_data.size() - 1));
+  OcTree truncated(res);
+  EXPECT_FALSE(truncated.readSubtree(truncated_in));
+
+  std::cerr << "Test successful.\n";
+  return 0;
+}
@@ -0,0 +1,218 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <sstream>
+
+#include <octomap/octomap_timing.h>
+#include <octomap/octomap.h>
+#include <octomap/TiledOcTree.h>
+#include <octomap/math/Utils.h>
+#include "testing.h"
+
+using namespace std;
+using namespace octomap;
+
+typedef TiledOcTree<OcTree> TiledMap;
+
+void printUsage(char* self){
+  std::cerr << "\nUSAGE: " << self << " map.bt [tile_depth]  (optional, default: 10)\n\n";
+  std::cerr << "Splits the map into tiles, compares queries, ray casts and updates on a TiledOcTree\n";
+  std::cerr << "with a memory budget of a quarter of the map with the complete map in memory\n\n";
+
+  exit(1);
+}
+
+double timediff(const timeval& start, const timeval& stop){
+  return (stop.tv_sec - start.tv_sec) + 1.0e-6 *(stop.tv_usec - start.tv_usec);
+}
+
+/// all leafs of reference need to be in the tiled map with the same value, all loaded leafs in reference
+void compareMaps(const OcTree& reference, TiledMap& tiled){
+  for (OcTree::leaf_iterator it = reference.begin_leafs(); it != reference.end_leafs(); ++it){
+    OcTreeNode* node = tiled.search(it.getKey());
+    EXPECT_TRUE(node);
+    EXPECT_FLOAT_EQ(node->getLogOdds(), it->getLogOdds());
+  }
+  const OcTree& loaded = tiled.getTree();
+  EXPECT_EQ(loaded.size(), loaded.calcNumNodes());
+  for (OcTree::leaf_iterator it = loaded.begin_leafs(); it != loaded.end_leafs(); ++it)
+    EXPECT_TRUE(reference.search(it.getKey(), it.getDepth()));
+}
+
+int main(int argc, char** argv) {
+  if (argc < 2 || argc > 3)
+    printUsage(argv[0]);
+  unsigned tile_depth = 10;
+  if (argc == 3)
+    tile_depth = atoi(argv[2]);
+
+  OcTree reference(0.1);
+  EXPECT_TRUE(reference.readBinary(argv[1]));
+  const double res = reference.getResolution();
+  double x, y, z;
+  reference.getMetricMin(x, y, z);
+  point3d min(x, y, z);
+  reference.getMetricMax(x, y, z);
+  point3d max(x, y, z);
+  const point3d size = max - min;
+
+  const std::string directory = "tiled_map";
+  mkdir(directory.c_str(), 0755);
+  EXPECT_TRUE(TiledMap::writeTiles(reference, directory, tile_depth));
+  size_t map_memory = reference.size() * (reference.memoryUsageNode() + sizeof(OcTreeNode*));
+  timeval start;
+  timeval stop;
+  srand(42);
+
+  {
+    TiledMap tiled(directory, res, tile_depth, map_memory / 4);
+    EXPECT_EQ(tiled.getTileDepth(), tile_depth);
+    EXPECT_EQ(tiled.numLoadedTiles(), 0);
+    std::cout << "Map with " << reference.size() << " nodes in " << tiled.numTiles() << " tiles at depth "
+              << tile_depth << ", memory budget " << tiled.getMaxMemory() << " bytes\n";
+
+    // random queries, the loaded tiles stay within the memory budget
+    size_t max_loaded = 0;
+    for (unsigned i = 0; i < 1000; ++i){
+      point3d p = randomPoint(min, size);
+      OcTreeNode* node = tiled.search(p);
+      OcTreeNode* reference_node = reference.search(p);
+      EXPECT_TRUE((node == NULL) == (reference_node == NULL));
+      if (node)
+        EXPECT_FLOAT_EQ(node->getLogOdds(), reference_node->getLogOdds());
+      max_loaded = std::max(max_loaded, tiled.numLoadedTiles());
+    }
+    EXPECT_TRUE(tiled.numTileEvictions() > 0);
+    EXPECT_TRUE(max_loaded < tiled.numTiles());
+
+    // queries around a robot moving through the map
+    std::vector<point3d> points;
+    point3d position = (min + max) * 0.5;
+    for (unsigned i = 0; i < 200000; ++i){
+      position += point3d(0.1f * (float(rand()) / RAND_MAX - 0.5f), 0.1f * (float(rand()) / RAND_MAX - 0.5f), 0.0f);
+      for (unsigned j = 0; j < 2; ++j)
+        position(j) = std::min(std::max(position(j), min(j)), max(j));
+      points.push_back(position + point3d(2.0f * (float(rand()) / RAND_MAX - 0.5f),
+                                          2.0f * (float(rand()) / RAND_MAX - 0.5f),
+                                          2.0f * (float(rand()) / RAND_MAX - 0.5f)));
+    }
+    gettimeofday(&start, NULL);
+    for (size_t i = 0; i < points.size(); ++i)
+      reference.search(points[i]);
+    gettimeofday(&stop, NULL);
+    double time_reference = timediff(start, stop);
+    size_t num_loads = tiled.numTileLoads();
+    gettimeofday(&start, NULL);
+    for (size_t i = 0; i < points.size(); ++i)
+      tiled.search(points[i]);
+    gettimeofday(&stop, NULL);
+    double time_tiled = timediff(start, stop);
+    for (size_t i = 0; i < points.size(); i += 10){
+      OcTreeNode* node = tiled.search(points[i]);
+      OcTreeNode* reference_node = reference.search(points[i]);
+      EXPECT_TRUE((node == NULL) == (reference_node == NULL));
+      if (node)
+        EXPECT_FLOAT_EQ(node->getLogOdds(), reference_node->getLogOdds());
+    }
+    std::cout << "Local search: " << points.size() / time_reference << " / " << points.size() / time_tiled
+              << " queries/s (in memory / tiled), " << tiled.numTileLoads() - num_loads << " tile loads\n";
+
+    // ray casts, unknown cells stop the ray / are ignored within a maximum range
+    for (unsigned run = 0; run < 2; ++run){
+      bool ignore_unknown = (run == 1);
+      double max_range = ignore_unknown ? 5.0 : -1.0;
+      unsigned num_hits = 0;
+      num_loads = tiled.numTileLoads();
+      gettimeofday(&start, NULL);
+      for (unsigned i = 0; i < 1000; ++i){
+        point3d origin = points[i * 100];
+        point3d direction(float(rand()) / RAND_MAX - 0.5f, float(rand()) / RAND_MAX - 0.5f,
+                          float(rand()) / RAND_MAX - 0.5f);
+        point3d end, reference_end;
+        bool hit = tiled.castRay(origin, direction, end, ignore_unknown, max_range);
+        EXPECT_EQ(hit, reference.castRay(origin, direction, reference_end, ignore_unknown, max_range));
+        EXPECT_TRUE(end == reference_end);
+        if (hit)
+          ++num_hits;
+      }
+      gettimeofday(&stop, NULL);
+      std::cout << "castRay" << (ignore_unknown ? ", ignoring unknown: " : ": ") << num_hits << " / 1000 hits in "
+                << timediff(start, stop) << " s, " << tiled.numTileLoads() - num_loads << " tile loads\n";
+    }
+
+    // updates are written back on eviction
+    gettimeofday(&start, NULL);
+    for (unsigned s = 0; s < 20; ++s){
+      point3d origin = randomPoint(min, size);
+      Pointcloud scan = generateScan(origin);
+      reference.insertPointCloud(scan, origin);
+      tiled.insertPointCloud(scan, origin);
+      point3d p = randomPoint(min, size);
+      reference.updateNode(p, true);
+      tiled.updateNode(p, true);
+    }
+    gettimeofday(&stop, NULL);
+    std::cout << "20 scans inserted in " << timediff(start, stop) << " s, " << tiled.numTileLoads()
+              << " tile loads, " << tiled.numTileEvictions() << " evictions\n";
+    EXPECT_TRUE(tiled.flush());
+  }
+
+  // reopened with enough memory for all tiles
+  {
+    TiledMap tiled(directory, res, 1, 2 * map_memory);
+    EXPECT_EQ(tiled.getTileDepth(), tile_depth);
+    compareMaps(reference, tiled);
+  }
+
+  // new map, tiles created while mapping
+  {
+    const std::string new_directory = "tiled_map_new";
+    mkdir(new_directory.c_str(), 0755);
+    remove((new_directory + "/tiles.index").c_str());
+    OcTree new_reference(res);
+    {
+      TiledMap tiled(new_directory, res, tile_depth, 0);
+      EXPECT_EQ(tiled.numTiles(), 0);
+      point3d origin = (min + max) * 0.5;
+      for (unsigned s = 0; s < 10; ++s){
+        origin += point3d(0.5f, 0.3f, 0.0f);
+        Pointcloud scan = generateScan(origin);
+        new_reference.insertPointCloud(scan, origin);
+        tiled.insertPointCloud(scan, origin);
+      }
+      EXPECT_TRUE(tiled.numTiles() > 1);
+      EXPECT_TRUE(tiled.numTileEvictions() > 0);
+    }
+    TiledMap tiled(new_directory, res, tile_depth, 2 * map_memory);
+    compareMaps(new_reference, tiled);
+  }
+
+  // an index which cannot be read is never overwritten
+  {
+    const std::string index_filename = directory + "/tiles.index";
+    std::ifstream index_file(index_filename.c_str());
+    std::stringstream index;
+    index << index_file.rdbuf();
+    index_file.close();
+    const std::string truncated = index.str().substr(0, index.str().size() / 2);
+    std::ofstream(index_filename.c_str()) << truncated;
+    {
+      TiledMap tiled(directory, res, tile_depth, 0);
+      EXPECT_FALSE(tiled.isOpen());
+      EXPECT_EQ(tiled.numTiles(), 0);
+      tiled.updateNode((min + max) * 0.5, true);
+      EXPECT_FALSE(tiled.flush());
+    }
+    std::ifstream reread_file(index_filename.c_str());
+    std::stringstream reread;
+    reread << reread_file.rdbuf();
+    EXPECT_TRUE(reread.str() == truncated);
+    std::ofstream(index_filename.c_str()) << index.str();
+    TiledMap tiled(directory, res, tile_depth, 2 * map_memory);
+    EXPECT_TRUE(tiled.isOpen());
+    compareMaps(reference, tiled);
+  }
+
+  std::cerr << "Test successful.\n";
+  return 0;
+}
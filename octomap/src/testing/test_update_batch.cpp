@@ -0,0 +1,136 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <octomap/octomap_timing.h>
+#include <octomap/octomap.h>
+#include "testing.h"
+
+using namespace std;
+using namespace octomap;
+
+typedef std::vector<std::pair<OcTreeKey, float> > UpdateBatch;
+
+void printUsage(char* self){
+  std::cerr << "\nUSAGE: " << self << " [num_updates]  (optional, default: 1000000)\n\n";
+  std::cerr << "Compares updateNodes() with single updateNode() calls for dense and sparse batches\n\n";
+
+  exit(1);
+}
+
+double timediff(const timeval& start, const timeval& stop){
+  return (stop.tv_sec - start.tv_sec) + 1.0e-6 *(stop.tv_usec - start.tv_usec);
+}
+
+/// random hits and misses in a cube of side^3 voxels around the map center (incl. duplicate keys)
+UpdateBatch generateBatch(const OcTree& tree, size_t num_updates, unsigned side, float hit_ratio){
+  UpdateBatch batch;
+  batch.reserve(num_updates);
+  for (size_t i = 0; i < num_updates; ++i){
+    OcTreeKey key(32768 - side/2 + rand() % side, 32768 - side/2 + rand() % side, 32768 - side/2 + rand() % side);
+    float update = (float(rand()) / RAND_MAX < hit_ratio) ? tree.getProbHitLog() : tree.getProbMissLog();
+    batch.push_back(std::make_pair(key, update));
+  }
+  return batch;
+}
+
+/// applies all batches to both trees (single updates / updateNodes()), which need to stay identical
+void compareUpdates(const std::string& name, const std::vector<UpdateBatch>& batches,
+                    OcTree& single, OcTree& batched, bool lazy_eval){
+  timeval start;
+  timeval stop;
+  double time_single = 0.0;
+  double time_batched = 0.0;
+  size_t num_updates = 0;
+  for (size_t b = 0; b < batches.size(); ++b){
+    const UpdateBatch& batch = batches[b];
+    num_updates += batch.size();
+
+    gettimeofday(&start, NULL);
+    for (size_t i = 0; i < batch.size(); ++i)
+      single.updateNode(batch[i].first, batch[i].second, lazy_eval);
+    gettimeofday(&stop, NULL);
+    time_single += timediff(start, stop);
+
+    gettimeofday(&start, NULL);
+    batched.updateNodes(batch, lazy_eval);
+    gettimeofday(&stop, NULL);
+    time_batched += timediff(start, stop);
+  }
+
+  if (lazy_eval){
+    single.updateInnerOccupancy();
+    batched.updateInnerOccupancy();
+    single.prune();
+    batched.prune();
+  }
+  EXPECT_EQ(batched.size(), batched.calcNumNodes());
+  EXPECT_EQ(single.size(), batched.size());
+  EXPECT_TRUE(single == batched);
+
+  std::cout << name << ": " << num_updates << " updates, " << batched.size() << " nodes, updateNode / updateNodes: "
+            << time_single << " / " << time_batched << " s (speedup " << time_single / time_batched << ")\n";
+}
+
+int main(int argc, char** argv) {
+  size_t num_updates = 1000000;
+  if (argc > 2)
+    printUsage(argv[0]);
+  if (argc == 2)
+    num_updates = atol(argv[1]);
+
+  srand(42);
+  OcTree params(0.05);
+
+  // dense: many updates per voxel, saturation and pruning of solid blocks
+  std::vector<UpdateBatch> dense;
+  dense.push_back(generateBatch(params, num_updates, 64, 1.0f));
+  dense.push_back(generateBatch(params, num_updates, 64, 1.0f));
+  dense.push_back(generateBatch(params, num_updates, 64, 0.5f));
+  {
+    OcTree single(0.05);
+    OcTree batched(0.05);
+    compareUpdates("dense", dense, single, batched, false);
+  }
+  {
+    OcTree single(0.05);
+    OcTree batched(0.05);
+    compareUpdates("dense, lazy", dense, single, batched, true);
+  }
+
+  // sparse: about one update per voxel in a large volume
+  std::vector<UpdateBatch> sparse;
+  sparse.push_back(generateBatch(params, num_updates, 4096, 0.3f));
+  sparse.push_back(generateBatch(params, num_updates, 4096, 0.3f));
+  {
+    OcTree single(0.05);
+    OcTree batched(0.05);
+    compareUpdates("sparse", sparse, single, batched, false);
+  }
+
+  // changes need to be tracked the same way
+  {
+    OcTree single(0.05);
+    OcTree batched(0.05);
+    single.enableChangeDetection(true);
+    batched.enableChangeDetection(true);
+    std::vector<UpdateBatch> batches;
+    batches.push_back(generateBatch(params, num_updates / 10, 32, 0.5f));
+    compareUpdates("change detection", batches, single, batched, false);
+    single.resetChangeDetection();
+    batched.resetChangeDetection();
+    batches[0] = generateBatch(params, num_updates / 10, 32, 0.5f);
+    compareUpdates("change detection", batches, single, batched, false);
+    EXPECT_EQ(single.numChangesDetected(), batched.numChangesDetected());
+    KeyBoolMap batched_changes;
+    for (KeyBoolMap::const_iterator it = batched.changedKeysBegin(); it != batched.changedKeysEnd(); ++it)
+      batched_changes.insert(*it);
+    for (KeyBoolMap::const_iterator it = single.changedKeysBegin(); it != single.changedKeysEnd(); ++it){
+      KeyBoolMap::const_iterator batched_it = batched_changes.find(it->first);
+      EXPECT_TRUE(batched_it != batched_changes.end());
+      EXPECT_EQ(batched_it->second, it->second);
+    }
+  }
+
+  std::cerr << "Test successful.\n";
+  return 0;
+}
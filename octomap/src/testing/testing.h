@@ -1,5 +1,6 @@
 #include <math.h>
 #include <stdlib.h>
+#include <octomap/Pointcloud.h>
 
 // this is mimicing gtest expressions
 
@@ -29,3 +30,25 @@
       exit(1);                                                         \
     } }
 
+
+// test data
+
+/// small random spherical scan (0.5 - 2 m range) around origin
+inline octomap::Pointcloud generateScan(const octomap::point3d& origin){
+  octomap::Pointcloud scan;
+  for (unsigned i = 0; i < 2000; ++i){
+    double yaw = 2.0 * M_PI * double(rand()) / RAND_MAX;
+    double pitch = M_PI * (double(rand()) / RAND_MAX - 0.5);
+    double range = 0.5 + 1.5 * double(rand()) / RAND_MAX;
+    octomap::point3d dir(cos(pitch) * cos(yaw), cos(pitch) * sin(yaw), sin(pitch));
+    scan.push_back(origin + dir * range);
+  }
+  return scan;
+}
+
+/// uniformly distributed random point in the box [min, min + size]
+inline octomap::point3d randomPoint(const octomap::point3d& min, const octomap::point3d& size){
+  return octomap::point3d(min.x() + size.x() * float(rand()) / RAND_MAX,
+                          min.y() + size.y() * float(rand()) / RAND_MAX,
+                          min.z() + size.z() * float(rand()) / RAND_MAX);
+}
@@ -1,5 +1,6 @@
 #include <stdio.h>
 #include <string>
+#include <limits>
 #ifdef _WIN32
   #include <Windows.h>  // to define Sleep()
 #else
@@ -200,6 +201,99 @@ int main(int argc, char** argv) {
     EXPECT_FLOAT_EQ (0.025, p_inv.y());
     EXPECT_FLOAT_EQ (0.025, p_inv.z());
 
+  // ------------------------------------------------------------
+  } else if (test_name == "MortonKey") {
+    srand(42);
+    std::vector<OcTreeKey> keys;
+    keys.push_back(OcTreeKey(0, 0, 0));
+    keys.push_back(OcTreeKey(65535, 65535, 65535));
+    for (unsigned i = 0; i < 1000; ++i)
+      keys.push_back(OcTreeKey(rand() % 65536, rand() % 65536, rand() % 65536));
+
+    for (size_t i = 0; i < keys.size(); ++i){
+      MortonKey morton(keys[i]);
+      EXPECT_TRUE (morton.toKey() == keys[i]);
+      for (unsigned level = 0; level < 16; ++level){
+        EXPECT_EQ (morton.childIdx(level), computeChildIdx(keys[i], level));
+        EXPECT_TRUE (morton.ancestor(level).toKey() == computeIndexKey(level, keys[i]));
+      }
+
+      // common ancestor: the deepest level at which both index keys agree
+      const OcTreeKey& other = keys[(i + 1) % keys.size()];
+      unsigned level = 0;
+      while (level < 16 && computeIndexKey(level, keys[i]) != computeIndexKey(level, other))
+        ++level;
+      EXPECT_EQ (morton.commonAncestorLevel(MortonKey(other)), level);
+    }
+    EXPECT_EQ (MortonKey(keys[1]).commonAncestorLevel(MortonKey(keys[1])), 0);
+
+    // sorted keys are ordered depth first, children in index order
+    sortKeysMorton(keys);
+    for (size_t i = 1; i < keys.size(); ++i){
+      unsigned level = MortonKey(keys[i-1]).commonAncestorLevel(MortonKey(keys[i]));
+      EXPECT_TRUE (level > 0);
+      EXPECT_TRUE (computeChildIdx(keys[i-1], level-1) < computeChildIdx(keys[i], level-1));
+    }
+
+  // ------------------------------------------------------------
+  } else if (test_name == "CoordsToKeys") {
+    srand(42);
+    OcTree tree (0.05);
+    Pointcloud points;
+    for (unsigned i = 0; i < 10000; ++i){
+      points.push_back(point3d(4000.0f * (float(rand()) / RAND_MAX - 0.5f),
+                               4000.0f * (float(rand()) / RAND_MAX - 0.5f),
+                               200.0f * (float(rand()) / RAND_MAX - 0.5f)));
+    }
+    // voxel borders, tree bounds and points outside
+    for (int k = -20; k <= 20; ++k){
+      float border = float(k * tree.getResolution());
+      points.push_back(point3d(border, -border, border + 1e-7f));
+    }
+    float bound = float(32768 * tree.getResolution());
+    points.push_back(point3d(bound, 0.0f, 0.0f));
+    points.push_back(point3d(-bound, -bound, -bound));
+    points.push_back(point3d(0.0f, bound - 0.001f, -bound - 0.001f));
+    points.push_back(point3d(1e10f, -1e10f, 0.0f));
+    points.push_back(point3d(0.0f, 0.0f, std::numeric_limits<float>::quiet_NaN()));
+    points.push_back(point3d(std::numeric_limits<float>::infinity(), 0.0f, 0.0f));
+
+    std::vector<OcTreeKey> keys;
+    std::vector<bool> valid;
+    size_t num_valid = tree.coordsToKeys(points, keys, valid);
+    EXPECT_EQ (keys.size(), points.size());
+    EXPECT_EQ (valid.size(), points.size());
+    size_t num_checked_valid = 0;
+    std::vector<OcTreeKey> valid_keys;
+    for (size_t i = 0; i < points.size(); ++i){
+      OcTreeKey key;
+      bool checked_valid = tree.coordToKeyChecked(points[i], key);
+      EXPECT_EQ (valid[i], checked_valid);
+      if (checked_valid){
+        EXPECT_TRUE (keys[i] == key);
+        valid_keys.push_back(key);
+        ++num_checked_valid;
+      }
+    }
+    EXPECT_EQ (num_valid, num_checked_valid);
+    EXPECT_TRUE (num_valid < points.size());
+    EXPECT_TRUE (!valid[points.size() - 1] && !valid[points.size() - 2] && !valid[points.size() - 3]);
+
+    // inverse, exactly the same floats as keyToCoord()
+    Pointcloud centers;
+    centers.push_back(point3d(1.0f, 2.0f, 3.0f));
+    tree.keysToCoords(valid_keys, centers);
+    EXPECT_EQ (centers.size(), valid_keys.size());
+    for (size_t i = 0; i < valid_keys.size(); ++i){
+      point3d center = tree.keyToCoord(valid_keys[i]);
+      EXPECT_TRUE (centers[i].x() == center.x() && centers[i].y() == center.y() && centers[i].z() == center.z());
+    }
+
+    // empty input
+    Pointcloud empty;
+    EXPECT_EQ (tree.coordsToKeys(empty, keys, valid), 0);
+    EXPECT_EQ (keys.size(), 0);
+
   // ------------------------------------------------------------
   } else {
     std::cerr << "Invalid test name specified: " << test_name << std::endl;